@@ -1,10 +1,35 @@
 if (process.argv.length < 4) {
-    console.log("Usage: node convert.js <source.json> <destination>")
+    console.log("Usage: node convert.js <source.json> <destination> [--lod <count>] [--meshlets]")
     return
 }
 
 const fs = require('fs')
 
+// 簡略化したLODの数 (0ならLODを生成しない)
+let lodCount = 0
+// LOD0をメッシュレットに分けるか
+let isMeshletsOut = false
+for (let i = 4; i < process.argv.length; ++i) {
+    if (process.argv[i] === "--lod" && i + 1 < process.argv.length) {
+        lodCount = Number(process.argv[i + 1])
+        i += 1
+    } else if (process.argv[i] === "--meshlets") {
+        isMeshletsOut = true
+    } else {
+        console.error("[ error ] converter.js: invalid option: " + process.argv[i])
+        return
+    }
+}
+
+// LOD毎に、前のLODから残す三角形の割合
+const LOD_REDUCTION = 0.5
+// 境界の辺を保つための平面の重み
+const BOUNDARY_WEIGHT = 10.0
+
+// メッシュレット一つあたりの頂点数と三角形数の上限
+const MESHLET_MAX_VERTICES = 64
+const MESHLET_MAX_TRIANGLES = 124
+
 const modelJSON = JSON.parse(fs.readFileSync(process.argv[2]))
 const isNormalIn = "normal" in modelJSON
 const isUVIn = "uv" in modelJSON
@@ -23,7 +48,445 @@ if (isUVIn) {
     sizePerVertex += 2
 }
 
-const bufferSize = 4 * (1 + 1 + sizePerVertex * vtxCount + 1 + idxCount)
+// ================================================================================================================== //
+//     LOD                                                                                                            //
+// ================================================================================================================== //
+
+// 対称4x4行列(二次誤差)を10要素で表す
+function planeQuadric(a, b, c, d, w) {
+    return [
+        w * a * a, w * a * b, w * a * c, w * a * d,
+        w * b * b, w * b * c, w * b * d,
+        w * c * c, w * c * d,
+        w * d * d,
+    ]
+}
+
+function addQuadric(q, r) {
+    for (let i = 0; i < 10; ++i) q[i] += r[i]
+}
+
+function evalQuadric(q, x, y, z) {
+    return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x
+        + q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y
+        + q[7] * z * z + 2 * q[8] * z
+        + q[9]
+}
+
+function sub(a, b) {
+    return [a[0] - b[0], a[1] - b[1], a[2] - b[2]]
+}
+
+function cross(a, b) {
+    return [a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]]
+}
+
+function dot(a, b) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]
+}
+
+function length(a) {
+    return Math.sqrt(dot(a, a))
+}
+
+// コストの小さい順に取り出す二分ヒープ
+class Heap {
+    constructor() {
+        this.items = []
+    }
+    push(item) {
+        const items = this.items
+        items.push(item)
+        let i = items.length - 1
+        while (i > 0) {
+            const parent = (i - 1) >> 1
+            if (items[parent].cost <= items[i].cost) break
+            const t = items[parent]; items[parent] = items[i]; items[i] = t
+            i = parent
+        }
+    }
+    pop() {
+        const items = this.items
+        const top = items[0]
+        const last = items.pop()
+        if (items.length > 0) {
+            items[0] = last
+            let i = 0
+            while (true) {
+                const l = 2 * i + 1
+                const r = l + 1
+                let m = i
+                if (l < items.length && items[l].cost < items[m].cost) m = l
+                if (r < items.length && items[r].cost < items[m].cost) m = r
+                if (m === i) break
+                const t = items[m]; items[m] = items[i]; items[i] = t
+                i = m
+            }
+        }
+        return top
+    }
+    get length() {
+        return this.items.length
+    }
+}
+
+// 二次誤差(QEM)による辺の縮約で、簡略化したLODの連なりを作る
+//
+// 頂点は既存の頂点に寄せる(half-edge collapse)ため、新たな位置を作らない。
+// 位置の同じ頂点は一つにまとめてから簡略化し、まとめた頂点は法線ベクトルを平均して頂点データの末尾に追加する。
+// 各LODの誤差は、それまでの縮約の二次誤差の最大値の平方根(モデル空間での距離)とする。
+//
+// 戻り値: { vertices: 追加する頂点データ(float配列), lods: [{ indices, error }] }
+function generateLods(positions, normals, indices, count) {
+    // 位置の同じ頂点をまとめる
+    const weldMap = new Map()
+    const weldOf = new Array(positions.length / 3)
+    const P = []
+    const N = []
+    for (let i = 0; i < weldOf.length; ++i) {
+        const p = [positions[3 * i + 0], positions[3 * i + 1], positions[3 * i + 2]]
+        const key = p.join(",")
+        let w = weldMap.get(key)
+        if (w === undefined) {
+            w = P.length
+            weldMap.set(key, w)
+            P.push(p)
+            N.push([0, 0, 0])
+        }
+        weldOf[i] = w
+        if (normals !== null) {
+            N[w][0] += normals[3 * i + 0]
+            N[w][1] += normals[3 * i + 1]
+            N[w][2] += normals[3 * i + 2]
+        }
+    }
+
+    // 三角形と頂点毎の隣接三角形を作る
+    const tris = []
+    for (let i = 0; i + 2 < indices.length; i += 3) {
+        const t = [weldOf[indices[i + 0]], weldOf[indices[i + 1]], weldOf[indices[i + 2]]]
+        if (t[0] === t[1] || t[1] === t[2] || t[2] === t[0]) continue
+        tris.push(t)
+    }
+    const alive = new Array(tris.length).fill(true)
+    let aliveCount = tris.length
+    const adjacency = P.map(() => new Set())
+    tris.forEach((t, i) => t.forEach((v) => adjacency[v].add(i)))
+
+    // 頂点毎の二次誤差を、隣接する三角形の平面から求める
+    //
+    // NOTE: 重み付けしないため、二次誤差は平面への距離の二乗和であり、その平方根をモデル空間の誤差とみなせる。
+    const Q = P.map(() => new Array(10).fill(0))
+    const edgeUses = new Map()
+    const edgeKey = (a, b) => a < b ? a * P.length + b : b * P.length + a
+    for (const t of tris) {
+        const n = cross(sub(P[t[1]], P[t[0]]), sub(P[t[2]], P[t[0]]))
+        const area = length(n)
+        if (area === 0) continue
+        const u = [n[0] / area, n[1] / area, n[2] / area]
+        const q = planeQuadric(u[0], u[1], u[2], -dot(u, P[t[0]]), 1.0)
+        t.forEach((v) => addQuadric(Q[v], q))
+        for (let k = 0; k < 3; ++k) {
+            const key = edgeKey(t[k], t[(k + 1) % 3])
+            const use = edgeUses.get(key)
+            if (use === undefined) {
+                edgeUses.set(key, { count: 1, a: t[k], b: t[(k + 1) % 3], n: u })
+            } else {
+                use.count += 1
+            }
+        }
+    }
+    // 境界の辺は、辺を含み面に垂直な平面で縁を保つ
+    for (const use of edgeUses.values()) {
+        if (use.count !== 1) continue
+        const e = sub(P[use.b], P[use.a])
+        const m = cross(e, use.n)
+        const len = length(m)
+        if (len === 0) continue
+        const u = [m[0] / len, m[1] / len, m[2] / len]
+        const q = planeQuadric(u[0], u[1], u[2], -dot(u, P[use.a]), BOUNDARY_WEIGHT)
+        addQuadric(Q[use.a], q)
+        addQuadric(Q[use.b], q)
+    }
+
+    // 縮約の候補をヒープに積む
+    //
+    // NOTE: 頂点が縮約で変わる度に版を上げ、積んだ時点と版が異なる候補は取り出したときに捨てる。
+    const version = new Array(P.length).fill(0)
+    const heap = new Heap()
+    const pushEdge = (a, b) => {
+        const cab = evalQuadric(Q[a], P[b][0], P[b][1], P[b][2]) + evalQuadric(Q[b], P[b][0], P[b][1], P[b][2])
+        const cba = evalQuadric(Q[a], P[a][0], P[a][1], P[a][2]) + evalQuadric(Q[b], P[a][0], P[a][1], P[a][2])
+        const from = cab <= cba ? a : b
+        const to = cab <= cba ? b : a
+        heap.push({ cost: Math.max(Math.min(cab, cba), 0), from, to, vf: version[from], vt: version[to] })
+    }
+    for (const use of edgeUses.values()) {
+        pushEdge(use.a, use.b)
+    }
+
+    // fromをtoへ寄せたとき、fromの隣接三角形が裏返らないか
+    const isValidCollapse = (from, to) => {
+        for (const i of adjacency[from]) {
+            const t = tris[i]
+            if (t.includes(to)) continue
+            const before = cross(sub(P[t[1]], P[t[0]]), sub(P[t[2]], P[t[0]]))
+            const moved = t.map((v) => v === from ? P[to] : P[v])
+            const after = cross(sub(moved[1], moved[0]), sub(moved[2], moved[0]))
+            if (dot(before, after) <= 0) return false
+        }
+        return true
+    }
+
+    // LOD毎に目標の三角形数まで縮約する
+    const lods = []
+    let maxCost = 0
+    let target = aliveCount
+    for (let l = 0; l < count; ++l) {
+        target = Math.floor(target * LOD_REDUCTION)
+        while (aliveCount > target && heap.length > 0) {
+            const c = heap.pop()
+            if (c.vf !== version[c.from] || c.vt !== version[c.to]) continue
+            if (!isValidCollapse(c.from, c.to)) continue
+            // 縮約する
+            for (const i of adjacency[c.from]) {
+                const t = tris[i]
+                if (t.includes(c.to)) {
+                    alive[i] = false
+                    aliveCount -= 1
+                    t.forEach((v) => { if (v !== c.from) adjacency[v].delete(i) })
+                    continue
+                }
+                t[t.indexOf(c.from)] = c.to
+                adjacency[c.to].add(i)
+            }
+            adjacency[c.from].clear()
+            addQuadric(Q[c.to], Q[c.from])
+            version[c.from] += 1
+            version[c.to] += 1
+            maxCost = Math.max(maxCost, c.cost)
+            // 寄せた先の頂点に接する辺の候補を積み直す
+            const neighbors = new Set()
+            for (const i of adjacency[c.to]) tris[i].forEach((v) => { if (v !== c.to) neighbors.add(v) })
+            for (const v of neighbors) pushEdge(c.to, v)
+        }
+        // NOTE: 三角形が残らない、あるいは前のLODから減らなかったならば打ち切る。
+        if (aliveCount === 0) break
+        if (lods.length > 0 && aliveCount >= lods[lods.length - 1].indices.length / 3) break
+        const lodIndices = []
+        tris.forEach((t, i) => { if (alive[i]) lodIndices.push(t[0], t[1], t[2]) })
+        lods.push({ indices: lodIndices, error: Math.sqrt(maxCost) })
+        if (heap.length === 0) break
+    }
+
+    // まとめた頂点の頂点データを作る
+    //
+    // NOTE: UV座標はまとめた頂点のうち最初のものを使う。
+    const vertices = []
+    const firstOf = new Array(P.length).fill(-1)
+    weldOf.forEach((w, i) => { if (firstOf[w] < 0) firstOf[w] = i })
+    for (let w = 0; w < P.length; ++w) {
+        vertices.push(P[w][0], P[w][1], P[w][2])
+        if (normals !== null) {
+            const len = length(N[w])
+            vertices.push(...(len > 0 ? N[w].map((x) => x / len) : [0, 0, 1]))
+        }
+        if (isUVIn) {
+            vertices.push(Number(modelJSON["uv"][2 * firstOf[w] + 0]), Number(modelJSON["uv"][2 * firstOf[w] + 1]))
+        }
+    }
+    return { vertices, lods }
+}
+
+let lodVertices = []
+let lods = []
+if (lodCount > 0) {
+    const positions = modelJSON["position"].map(Number)
+    const normals = isNormalIn ? modelJSON["normal"].map(Number) : null
+    const indices = modelJSON["index"].map(Number)
+    const result = generateLods(positions, normals, indices, lodCount)
+    lodVertices = result.vertices
+    // NOTE: まとめた頂点は元の頂点の後ろに置くため、インデックスをずらす。
+    lods = result.lods.map((lod) => ({ indices: lod.indices.map((i) => i + vtxCount), error: lod.error }))
+    flag |= 4
+    lods.forEach((lod, i) => {
+        console.log("[ info ] converter.js: lod " + (i + 1) + ": " + (lod.indices.length / 3) + " triangles, error " + lod.error.toFixed(5))
+    })
+}
+const lodVtxCount = lodVertices.length / sizePerVertex
+const lodIdxCount = lods.reduce((sum, lod) => sum + lod.indices.length, 0)
+const lodTableSize = lods.length > 0 ? 1 + 3 * (1 + lods.length) : 0
+
+// ================================================================================================================== //
+//     Meshlet                                                                                                        //
+// ================================================================================================================== //
+
+// 三角形をメッシュレット(頂点数と三角形数に上限のあるクラスタ)に分ける
+//
+// 貪欲に、今のメッシュレットに隣接する三角形のうち新たな頂点の最も少ないもの(同数ならメッシュレットの重心に近いもの)を加えていく。
+// 隣接は位置の同じ頂点を一つにまとめて判定し、上限は元の頂点インデックスの数で判定する。
+// 隣接する三角形が無くなれば、まだ加えていない三角形のうちインデックスデータで最も前のものから始め直す。
+//
+// 各メッシュレットは、カリングのための次の範囲を持つ。
+// - 境界球: 頂点のAABBの中心と、そこから最も遠い頂点までの距離
+// - 法線の円錐: 三角形の法線の平均を軸とし、cutoffはsin(軸と法線の最大の角度)
+//   - 視線と軸の成すcosがcutoffを超えれば、全ての三角形が裏を向いている
+//   - 法線が半球を越えて散らばる場合は、cutoffを1として裏面カリングしない
+//
+// 戻り値: { meshlets: [{ vertices, triangles, center, radius, axis, cutoff }] }
+function buildMeshlets(positions, indices) {
+    const trisCount = Math.floor(indices.length / 3)
+    const P = (v) => [positions[3 * v + 0], positions[3 * v + 1], positions[3 * v + 2]]
+
+    // 位置の同じ頂点をまとめ、まとめた頂点毎に隣接する三角形を集める
+    const weldMap = new Map()
+    const trisOfWeld = []
+    const weldOf = (v) => {
+        const key = P(v).join(",")
+        let w = weldMap.get(key)
+        if (w === undefined) {
+            w = trisOfWeld.length
+            weldMap.set(key, w)
+            trisOfWeld.push([])
+        }
+        return w
+    }
+    const triWelds = []
+    for (let t = 0; t < trisCount; ++t) {
+        const ws = [weldOf(indices[3 * t + 0]), weldOf(indices[3 * t + 1]), weldOf(indices[3 * t + 2])]
+        ws.forEach((w) => trisOfWeld[w].push(t))
+        triWelds.push(ws)
+    }
+    const triCenter = (t) => {
+        const a = P(indices[3 * t + 0])
+        const b = P(indices[3 * t + 1])
+        const c = P(indices[3 * t + 2])
+        return [(a[0] + b[0] + c[0]) / 3, (a[1] + b[1] + c[1]) / 3, (a[2] + b[2] + c[2]) / 3]
+    }
+
+    const used = new Array(trisCount).fill(false)
+    const meshlets = []
+    let current = null
+    let candidates = new Set()
+    let cursor = 0
+
+    const flush = () => {
+        if (current === null || current.triangles.length === 0) return
+        // 境界球
+        const vs = current.vertices.map(P)
+        const min = [Infinity, Infinity, Infinity]
+        const max = [-Infinity, -Infinity, -Infinity]
+        vs.forEach((p) => p.forEach((x, k) => { min[k] = Math.min(min[k], x); max[k] = Math.max(max[k], x) }))
+        const center = [0, 1, 2].map((k) => (min[k] + max[k]) * 0.5)
+        const radius = vs.reduce((r, p) => Math.max(r, length(sub(p, center))), 0)
+        // 法線の円錐
+        const normals = []
+        for (const tri of current.triangles) {
+            const n = cross(sub(vs[tri[1]], vs[tri[0]]), sub(vs[tri[2]], vs[tri[0]]))
+            const len = length(n)
+            if (len > 0) normals.push([n[0] / len, n[1] / len, n[2] / len])
+        }
+        const sum = normals.reduce((s, n) => [s[0] + n[0], s[1] + n[1], s[2] + n[2]], [0, 0, 0])
+        const sumLength = length(sum)
+        let axis = [0, 0, 1]
+        let cutoff = 1
+        if (sumLength > 0) {
+            axis = sum.map((x) => x / sumLength)
+            const minDot = normals.reduce((m, n) => Math.min(m, dot(n, axis)), 1)
+            cutoff = minDot <= 0 ? 1 : Math.sqrt(1 - minDot * minDot)
+        }
+        meshlets.push({ vertices: current.vertices, triangles: current.triangles, center, radius, axis, cutoff })
+        current = null
+        candidates = new Set()
+    }
+
+    while (true) {
+        // 次に加える三角形を選ぶ
+        let best = -1
+        if (current !== null) {
+            let bestNew = Infinity
+            let bestDistance = Infinity
+            const centroid = current.centroid.map((x) => x / current.triangles.length)
+            for (const t of candidates) {
+                if (used[t]) {
+                    candidates.delete(t)
+                    continue
+                }
+                let newCount = 0
+                for (let k = 0; k < 3; ++k) {
+                    if (!current.local.has(indices[3 * t + k])) newCount += 1
+                }
+                const distance = length(sub(triCenter(t), centroid))
+                if (newCount < bestNew || (newCount === bestNew && distance < bestDistance)) {
+                    best = t
+                    bestNew = newCount
+                    bestDistance = distance
+                }
+            }
+        }
+        if (best < 0) {
+            flush()
+            while (cursor < trisCount && used[cursor]) cursor += 1
+            if (cursor === trisCount) break
+            best = cursor
+        }
+
+        // 上限を超えるならメッシュレットを閉じ、この三角形から新たなメッシュレットを始める
+        if (current !== null) {
+            let newCount = 0
+            for (let k = 0; k < 3; ++k) {
+                if (!current.local.has(indices[3 * best + k])) newCount += 1
+            }
+            if (current.vertices.length + newCount > MESHLET_MAX_VERTICES || current.triangles.length + 1 > MESHLET_MAX_TRIANGLES) {
+                flush()
+            }
+        }
+        if (current === null) {
+            current = { vertices: [], local: new Map(), triangles: [], centroid: [0, 0, 0] }
+        }
+
+        // 三角形を加える
+        used[best] = true
+        candidates.delete(best)
+        const tri = []
+        for (let k = 0; k < 3; ++k) {
+            const v = indices[3 * best + k]
+            if (!current.local.has(v)) {
+                current.local.set(v, current.vertices.length)
+                current.vertices.push(v)
+            }
+            tri.push(current.local.get(v))
+        }
+        current.triangles.push(tri)
+        const c = triCenter(best)
+        for (let k = 0; k < 3; ++k) current.centroid[k] += c[k]
+        for (const w of triWelds[best]) {
+            for (const t of trisOfWeld[w]) {
+                if (!used[t]) candidates.add(t)
+            }
+        }
+    }
+    flush()
+    return { meshlets }
+}
+
+let meshlets = []
+if (isMeshletsOut) {
+    meshlets = buildMeshlets(modelJSON["position"].map(Number), modelJSON["index"].map(Number)).meshlets
+    flag |= 8
+    const trisCount = meshlets.reduce((sum, m) => sum + m.triangles.length, 0)
+    const vtxRefsCount = meshlets.reduce((sum, m) => sum + m.vertices.length, 0)
+    console.log(
+        "[ info ] converter.js: meshlets: " + meshlets.length
+        + ", " + (trisCount / meshlets.length).toFixed(1) + " triangles/meshlet"
+        + ", " + (vtxRefsCount / meshlets.length).toFixed(1) + " vertices/meshlet"
+    )
+}
+const meshletVtxCount = meshlets.reduce((sum, m) => sum + m.vertices.length, 0)
+const meshletTriCount = meshlets.reduce((sum, m) => sum + m.triangles.length, 0)
+const meshletsSize = meshlets.length > 0 ? 1 + 12 * meshlets.length + 1 + meshletVtxCount + 1 + meshletTriCount : 0
+
+const bufferSize = 4 * (1 + 1 + sizePerVertex * (vtxCount + lodVtxCount) + 1 + idxCount + lodIdxCount + lodTableSize + meshletsSize)
 const buffer = Buffer.alloc(bufferSize)
 
 let offset = 0
@@ -31,7 +494,7 @@ let offset = 0
 buffer.writeUInt32LE(flag, offset)
 offset += 4
 
-buffer.writeUInt32LE(vtxCount, offset)
+buffer.writeUInt32LE(vtxCount + lodVtxCount, offset)
 offset += 4
 
 for (let i = 0; i < vtxCount; ++i) {
@@ -57,13 +520,80 @@ for (let i = 0; i < vtxCount; ++i) {
     }
 }
 
-buffer.writeUInt32LE(idxCount, offset)
+for (const v of lodVertices) {
+    buffer.writeFloatLE(v, offset)
+    offset += 4
+}
+
+buffer.writeUInt32LE(idxCount + lodIdxCount, offset)
 offset += 4
 
 for (let i = 0; i < idxCount; ++i) {
     buffer.writeUInt32LE(Number(modelJSON["index"][i]), offset)
     offset += 4
 }
+for (const lod of lods) {
+    for (const i of lod.indices) {
+        buffer.writeUInt32LE(i, offset)
+        offset += 4
+    }
+}
+
+// LODの表 (元のインデックスデータをLOD0とする)
+if (lods.length > 0) {
+    buffer.writeUInt32LE(1 + lods.length, offset)
+    offset += 4
+    let firstIndex = 0
+    const table = [{ count: idxCount, error: 0 }].concat(lods.map((lod) => ({ count: lod.indices.length, error: lod.error })))
+    for (const entry of table) {
+        buffer.writeUInt32LE(firstIndex, offset)
+        offset += 4
+        buffer.writeUInt32LE(entry.count, offset)
+        offset += 4
+        buffer.writeFloatLE(entry.error, offset)
+        offset += 4
+        firstIndex += entry.count
+    }
+}
+
+// メッシュレット
+//
+// NOTE: メッシュレット毎に 頂点の先頭・頂点数・三角形の先頭・三角形数・境界球(xyz, 半径)・法線の円錐(軸xyz, cutoff) の12ワード。
+//       頂点は元の頂点インデックス、三角形はメッシュレット内の頂点の番号を8ビットずつ詰めたもの。
+if (meshlets.length > 0) {
+    buffer.writeUInt32LE(meshlets.length, offset)
+    offset += 4
+    let vertexOffset = 0
+    let triangleOffset = 0
+    for (const m of meshlets) {
+        for (const x of [vertexOffset, m.vertices.length, triangleOffset, m.triangles.length]) {
+            buffer.writeUInt32LE(x, offset)
+            offset += 4
+        }
+        for (const x of [...m.center, m.radius, ...m.axis, m.cutoff]) {
+            buffer.writeFloatLE(x, offset)
+            offset += 4
+        }
+        vertexOffset += m.vertices.length
+        triangleOffset += m.triangles.length
+    }
+    buffer.writeUInt32LE(meshletVtxCount, offset)
+    offset += 4
+    for (const m of meshlets) {
+        for (const v of m.vertices) {
+            buffer.writeUInt32LE(v, offset)
+            offset += 4
+        }
+    }
+    buffer.writeUInt32LE(meshletTriCount, offset)
+    offset += 4
+    for (const m of meshlets) {
+        for (const t of m.triangles) {
+            buffer.writeUInt32LE(t[0] | (t[1] << 8) | (t[2] << 16), offset)
+            offset += 4
+        }
+    }
+}
 
 if (offset === bufferSize) {
     fs.writeFileSync(process.argv[3], buffer)
@@ -0,0 +1,27 @@
+#version 450
+
+// NOTE: 深度プリパスの後に本描画を深度EQUALで行うため、ui.vertと全く同じ深度を出さなければならない。
+//       同じ式で計算し、invariantで最適化による誤差を防ぐ。
+invariant gl_Position;
+
+layout(binding=0) uniform Camera {
+    mat4 proj;
+} camera;
+
+layout(push_constant) uniform PushConstant {
+    vec4 scl;
+    vec4 trs;
+    vec4 uv;
+} constant;
+
+layout(location=0) in vec3 inPos;
+
+void main() {
+    vec4 pos = vec4(inPos, 1.0);
+    vec4 scl = vec4(constant.scl.xyz, 1.0);
+    vec4 trs = vec4(constant.trs.xyz, 0.0);
+    pos *= scl;
+    pos += trs;
+    pos *= camera.proj;
+    gl_Position = pos;
+}
@@ -0,0 +1,26 @@
+#version 450
+
+// NOTE: 機能フラグは特殊化定数で与える。
+layout(constant_id=0) const bool NORMAL_AS_COLOR = false;
+
+layout(binding=0) uniform Camera {
+    mat4 view;
+    mat4 proj;
+    vec4 lightDir;
+} camera;
+
+layout(location=0) in vec3 inNormal;
+layout(location=1) in vec4 inColor;
+
+layout(location=0) out vec4 outColor;
+
+void main() {
+    vec3 normal = normalize(inNormal);
+    if (NORMAL_AS_COLOR) {
+        outColor = vec4(normal * 0.5 + 0.5, 1.0);
+    } else {
+        // 平行光源によるランバート反射と環境光
+        float diffuse = max(dot(normal, -camera.lightDir.xyz), 0.0);
+        outColor = vec4(inColor.rgb * (0.2 + 0.8 * diffuse), inColor.a);
+    }
+}
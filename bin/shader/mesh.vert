@@ -0,0 +1,34 @@
+#version 450
+
+// NOTE: 深度プリパス(mesh_depth.vert)と同じ深度を出すため、invariantとする。
+invariant gl_Position;
+
+layout(binding=0) uniform Camera {
+    mat4 view;
+    mat4 proj;
+    vec4 lightDir;
+} camera;
+
+struct Object {
+    mat4 model;
+    vec4 color;
+};
+
+// NOTE: インスタンス毎の変換はストレージバッファからgl_InstanceIndexで引く。
+layout(std430, binding=1) readonly buffer Objects {
+    Object objects[];
+};
+
+layout(location=0) in vec3 inPos;
+layout(location=1) in vec3 inNormal;
+
+layout(location=0) out vec3 outNormal;
+layout(location=1) out vec4 outColor;
+
+void main() {
+    Object object = objects[gl_InstanceIndex];
+    gl_Position = camera.proj * (camera.view * (object.model * vec4(inPos, 1.0)));
+    // NOTE: モデル行列は一様な拡大しか含まないため、法線の変換に逆転置行列は要らない。
+    outNormal = mat3(object.model) * inNormal;
+    outColor = object.color;
+}
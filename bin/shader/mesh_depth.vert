@@ -0,0 +1,27 @@
+#version 450
+
+// NOTE: 深度プリパスの後に本描画を深度EQUALで行うため、mesh.vertと全く同じ深度を出さなければならない。
+//       同じ式で計算し、invariantで最適化による誤差を防ぐ。
+invariant gl_Position;
+
+layout(binding=0) uniform Camera {
+    mat4 view;
+    mat4 proj;
+    vec4 lightDir;
+} camera;
+
+struct Object {
+    mat4 model;
+    vec4 color;
+};
+
+layout(std430, binding=1) readonly buffer Objects {
+    Object objects[];
+};
+
+layout(location=0) in vec3 inPos;
+
+void main() {
+    Object object = objects[gl_InstanceIndex];
+    gl_Position = camera.proj * (camera.view * (object.model * vec4(inPos, 1.0)));
+}
@@ -1,7 +1,16 @@
 #version 450
 
+// NOTE: 機能フラグは特殊化定数で与える。パイプライン作成時に定数として畳み込まれるため、分岐のコストはかからない。
+layout(constant_id=0) const bool UV_AS_COLOR = false;
+
+layout(location=0) in vec2 inUV;
+
 layout(location=0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(1.0);
+    if (UV_AS_COLOR) {
+        outColor = vec4(inUV, 0.0, 1.0);
+    } else {
+        outColor = vec4(1.0);
+    }
 }
@@ -1,5 +1,8 @@
 #version 450
 
+// NOTE: 深度プリパス(depth.vert)と同じ深度を出すため、invariantとする。
+invariant gl_Position;
+
 layout(binding=0) uniform Camera {
     mat4 proj;
 } camera;
@@ -11,7 +14,9 @@ layout(push_constant) uniform PushConstant {
 } constant;
 
 layout(location=0) in vec3 inPos;
-layout(location=1) in vec3 inUV;
+layout(location=1) in vec2 inUV;
+
+layout(location=0) out vec2 outUV;
 
 void main() {
     vec4 pos = vec4(inPos, 1.0);
@@ -21,4 +26,5 @@ void main() {
     pos += trs;
     pos *= camera.proj;
     gl_Position = pos;
+    outUV = constant.uv.xy + inUV * constant.uv.zw;
 }
@@ -7,10 +7,15 @@ if not exist %~dp0bin mkdir %~dp0bin
 cd %~dp0bin
 
 node .\model\converter.js .\model\square.json .\model\square.raw
-node .\model\converter.js .\model\utah.json .\model\utah.raw
+node .\model\converter.js .\model\utah.json .\model\utah.raw --lod 4 --meshlets
 
 glslc -o .\shader\ui.vert.spv .\shader\ui.vert
 glslc -o .\shader\ui.frag.spv .\shader\ui.frag
+glslc -o .\shader\depth.vert.spv .\shader\depth.vert
+glslc -o .\shader\mesh.vert.spv .\shader\mesh.vert
+glslc -o .\shader\mesh.frag.spv .\shader\mesh.frag
+glslc -o .\shader\mesh_depth.vert.spv .\shader\mesh_depth.vert
+glslc -o .\shader\cull.comp.spv .\shader\cull.comp
 
 cl ^
     /Fe:sample-vulkan-jp.exe ^
@@ -28,6 +33,10 @@ cl ^
     ..\src\vulkan\util\memory\*.c ^
     ..\src\vulkan\pipelines\*.c ^
     ..\src\vulkan\*.c ^
+    ..\src\apps\*.c ^
+    ..\src\apps\bench\*.c ^
+    ..\src\apps\headless\*.c ^
+    ..\src\apps\linux\*.c ^
     ..\src\apps\offscreen\*.c ^
     ..\src\apps\windows\*.c ^
     ..\src\*.c ^
@@ -0,0 +1,56 @@
+#!/bin/sh
+
+set -e
+
+cd "$(dirname "$0")"
+
+mkdir -p bin
+
+cd bin
+
+node ./model/converter.js ./model/square.json ./model/square.raw
+node ./model/converter.js ./model/utah.json ./model/utah.raw --lod 4 --meshlets
+
+glslc -o ./shader/ui.vert.spv ./shader/ui.vert
+glslc -o ./shader/ui.frag.spv ./shader/ui.frag
+glslc -o ./shader/depth.vert.spv ./shader/depth.vert
+glslc -o ./shader/mesh.vert.spv ./shader/mesh.vert
+glslc -o ./shader/mesh.frag.spv ./shader/mesh.frag
+glslc -o ./shader/mesh_depth.vert.spv ./shader/mesh_depth.vert
+glslc -o ./shader/cull.comp.spv ./shader/cull.comp
+
+# xcbが無ければ、xcbのウィンドウへの描画(linux)を除いてビルドする
+#
+# NOTE: NO_XCB=1を与えれば、xcbがあっても除く (headlessのみを使うCI等)。
+if [ -z "${NO_XCB}" ] && pkg-config --exists xcb 2>/dev/null; then
+    XCB_FLAGS="-lxcb"
+else
+    echo "[ info ] build.sh: xcbを使わずにビルドする (linuxは使えない)"
+    XCB_FLAGS="-DAPP_NO_XCB"
+fi
+
+# NOTE: プロファイラ等のマクロはCFLAGS環境変数で与える (例: CFLAGS=-DENABLE_PROFILER ./build.sh)
+${CC:-cc} \
+    -o sample-vulkan-jp \
+    \
+    -std=c11 -O2 \
+    -DNDEBUG \
+    -Wall -Wextra -Wno-unused-parameter -Wno-missing-field-initializers \
+    ${CFLAGS} \
+    \
+    ../src/vulkan/util/*.c \
+    ../src/vulkan/util/memory/*.c \
+    ../src/vulkan/pipelines/*.c \
+    ../src/vulkan/*.c \
+    ../src/apps/*.c \
+    ../src/apps/bench/*.c \
+    ../src/apps/headless/*.c \
+    ../src/apps/linux/*.c \
+    ../src/apps/offscreen/*.c \
+    ../src/apps/windows/*.c \
+    ../src/*.c \
+    \
+    -lvulkan \
+    ${XCB_FLAGS} \
+    -lpthread \
+    -lm
@@ -0,0 +1,313 @@
+#include "bench.h"
+
+// snprintf()関数の使用に対してwarningを出さないためにこのマクロを定義する
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "../../vulkan/core.h"
+#include "../../vulkan/pipelines/ui.h"
+#include "../../vulkan/rendering.h"
+#include "../../vulkan/util/error.h"
+#include "../../vulkan/util/model.h"
+#include "../../vulkan/util/timer.h"
+#include "../offscreen/offscreen.h"
+#include "measure.h"
+
+#include <stdio.h>
+#include <vulkan/vulkan.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// 各工程の計測で共有するオブジェクトを持つ構造体
+typedef struct BenchContext_t {
+    VulkanAppCore core;
+    VulkanAppOffscreen offscreen;
+    VulkanAppRendering renderer;
+    uint32_t width;
+    uint32_t height;
+    // createModelFromFile()関数で読み込むファイルのパス
+    const char *modelPath;
+    // createPipelineForUI()関数で使うパイプラインキャッシュ (VK_NULL_HANDLEなら毎回空のものを作成する)
+    VkPipelineCache pipelineCache;
+} BenchContext;
+
+static double getElapsedMs(uint64_t startNs) {
+    return (double)(getTimeNs() - startNs) / 1000000.0;
+}
+
+// NOTE: 検証レイヤーは計測を大きく歪めるため有効にしない。
+static VulkanAppCore createBenchCore(void) {
+    return createVulkanAppCore(0, NULL, 0, NULL, 0, NULL, 0, NULL);
+}
+
+static int benchCreateCore(void *context, double *elapsedMs) {
+    (void)context;
+    const uint64_t startNs = getTimeNs();
+    const VulkanAppCore core = createBenchCore();
+    *elapsedMs = getElapsedMs(startNs);
+    if (core == NULL) {
+        return 0;
+    }
+    deleteVulkanAppCore(core);
+    return 1;
+}
+
+static int benchCreateModel(void *context, double *elapsedMs) {
+    const BenchContext *ctx = (const BenchContext *)context;
+    const uint64_t startNs = getTimeNs();
+    const Model model = createModelFromFile(ctx->core->device, ctx->core->allocator, ctx->core->queue, ctx->core->cmdPool, ctx->modelPath);
+    *elapsedMs = getElapsedMs(startNs);
+    if (model == NULL) {
+        return 0;
+    }
+    deleteModel(ctx->core->device, model);
+    return 1;
+}
+
+// NOTE: PipelineCompilerを与えず、既定のバリアントを呼び出したスレッドで作成させる。
+//       シェーダモジュールとパイプラインレイアウトはShaderLibraryが共有するため、初回以降はパイプラインの作成のみを計測することになる。
+static int benchCreatePipeline(void *context, double *elapsedMs) {
+    const BenchContext *ctx = (const BenchContext *)context;
+    const VkDevice device = ctx->core->device;
+
+    VkPipelineCache pipelineCache = ctx->pipelineCache;
+    if (pipelineCache == VK_NULL_HANDLE) {
+        const VkPipelineCacheCreateInfo ci = {
+            VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+            NULL,
+            0,
+            0,
+            NULL,
+        };
+        ERROR_IF(vkCreatePipelineCache(device, &ci, NULL, &pipelineCache) != VK_SUCCESS, "benchCreatePipeline()", "パイプラインキャッシュの作成に失敗", {}, 0);
+    }
+
+    const uint64_t startNs = getTimeNs();
+    const PipelineForUI pipeline = createPipelineForUI(
+        device,
+        ctx->renderer->shaderLibrary,
+        pipelineCache,
+        NULL,
+        ctx->renderer->renderPass,
+        ctx->renderer->samples,
+        ctx->width,
+        ctx->height
+    );
+    *elapsedMs = getElapsedMs(startNs);
+
+    if (pipeline != NULL) deletePipelineForUI(device, pipeline);
+    if (ctx->pipelineCache == VK_NULL_HANDLE) vkDestroyPipelineCache(device, pipelineCache, NULL);
+    return pipeline != NULL;
+}
+
+static int renderOnce(const BenchContext *ctx) {
+    return render(ctx->core, ctx->renderer, 0, 0, 0, ctx->width, ctx->height, 0, NULL, NULL, 0, NULL);
+}
+
+// NOTE: 前のフレームの完了を待ってから計測し、render()関数の中のフェンスの待機が計測に含まれないようにする。
+static int benchRender(void *context, double *elapsedMs) {
+    const BenchContext *ctx = (const BenchContext *)context;
+    vkDeviceWaitIdle(ctx->core->device);
+    const uint64_t startNs = getTimeNs();
+    const int ok = renderOnce(ctx);
+    *elapsedMs = getElapsedMs(startNs);
+    return ok;
+}
+
+static int benchRenderAndWait(void *context, double *elapsedMs) {
+    const BenchContext *ctx = (const BenchContext *)context;
+    vkDeviceWaitIdle(ctx->core->device);
+    const uint64_t startNs = getTimeNs();
+    const int ok = renderOnce(ctx);
+    vkDeviceWaitIdle(ctx->core->device);
+    *elapsedMs = getElapsedMs(startNs);
+    return ok;
+}
+
+static int benchSaveRenderingResult(void *context, double *elapsedMs) {
+    const BenchContext *ctx = (const BenchContext *)context;
+    const uint64_t startNs = getTimeNs();
+    const int ok = saveRenderingResult(ctx->core, ctx->offscreen);
+    *elapsedMs = getElapsedMs(startNs);
+    return ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void deleteBenchContext(BenchContext *ctx, BenchReport report) {
+    if (ctx->core != NULL) {
+        if (ctx->pipelineCache != NULL) vkDestroyPipelineCache(ctx->core->device, ctx->pipelineCache, NULL);
+        if (ctx->renderer != NULL) deleteVulkanAppRendering(ctx->core, ctx->renderer);
+        if (ctx->offscreen != NULL) deleteVulkanAppOffscreen(ctx->core, ctx->offscreen);
+        deleteVulkanAppCore(ctx->core);
+    }
+    if (report != NULL) deleteBenchReport(report);
+}
+
+// 物理デバイスの情報を付加情報として追加する関数
+static void addDeviceInfo(BenchReport report, const VulkanAppCore core) {
+    const VkPhysicalDeviceProperties *props = &core->physDevProps;
+    char buffer[BENCH_MAX_INFO_VALUE];
+
+    addBenchReportInfo(report, "device", props->deviceName);
+
+    const char *type = "other";
+    switch (props->deviceType) {
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: type = "integrated-gpu"; break;
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:   type = "discrete-gpu";   break;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:    type = "virtual-gpu";    break;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:            type = "cpu";            break;
+        default: break;
+    }
+    addBenchReportInfo(report, "deviceType", type);
+
+    snprintf(
+        buffer,
+        sizeof(buffer),
+        "%u.%u.%u",
+        VK_API_VERSION_MAJOR(props->apiVersion),
+        VK_API_VERSION_MINOR(props->apiVersion),
+        VK_API_VERSION_PATCH(props->apiVersion)
+    );
+    addBenchReportInfo(report, "apiVersion", buffer);
+
+    snprintf(buffer, sizeof(buffer), "0x%08x", props->driverVersion);
+    addBenchReportInfo(report, "driverVersion", buffer);
+}
+
+int runBenchmark(int width, int height, const AppOptions *options) {
+#define CHECK(p, m) ERROR_IF(!(p), "runBenchmark()", (m), deleteBenchContext(&ctx, report), 1)
+
+    BenchContext ctx = {
+        NULL,
+        NULL,
+        NULL,
+        (uint32_t)width,
+        (uint32_t)height,
+        NULL,
+        VK_NULL_HANDLE,
+    };
+    BenchReport report = NULL;
+
+    // 計測結果オブジェクトを作成する
+    {
+        report = createBenchReport("frame", options->benchWarmup, options->benchRepetitions, options->benchFilter);
+        CHECK(report != NULL, "計測結果オブジェクトの作成に失敗");
+        char buffer[BENCH_MAX_INFO_VALUE];
+        snprintf(buffer, sizeof(buffer), "%dx%d", width, height);
+        addBenchReportInfo(report, "resolution", buffer);
+    }
+
+    // インスタンスと論理デバイスの作成を計測する
+    //
+    // NOTE: 計測の度に作成と破棄を繰り返すため、以降で使うものは改めて作成する。
+    {
+        CHECK(runBenchCase(report, "createVulkanAppCore", benchCreateCore, NULL, 0.0), "主要オブジェクトの作成の計測に失敗");
+        ctx.core = createBenchCore();
+        CHECK(ctx.core != NULL, "主要オブジェクトの作成に失敗");
+        addDeviceInfo(report, ctx.core);
+    }
+
+    // モデルの読込みを計測する
+    {
+        ctx.modelPath = "./model/square.raw";
+        CHECK(runBenchCase(report, "createModelFromFile(square)", benchCreateModel, &ctx, 0.0), "squareの読込みの計測に失敗");
+        ctx.modelPath = "./model/utah.raw";
+        CHECK(runBenchCase(report, "createModelFromFile(utah)", benchCreateModel, &ctx, 0.0), "utahの読込みの計測に失敗");
+    }
+
+    // オフスクリーン依存オブジェクトとレンダリングオブジェクトを作成する
+    {
+        ctx.offscreen = createVulkanAppOffscreen(ctx.core, width, height, options->readbackRgb);
+        CHECK(ctx.offscreen != NULL, "オフスクリーン依存オブジェクトの作成に失敗");
+        const VkImageView imageViews[] = { ctx.offscreen->imageView };
+        ctx.renderer = createVulkanAppRendering(ctx.core, imageViews, 1, ctx.width, ctx.height, ctx.offscreen->layout, VK_SAMPLE_COUNT_1_BIT);
+        CHECK(ctx.renderer != NULL, "レンダリングオブジェクトの作成に失敗");
+        waitForPipelines(ctx.renderer);
+    }
+
+    // パイプラインの作成を計測する
+    //
+    // NOTE: cold: 毎回空のパイプラインキャッシュを与える
+    //       warm: 一つのパイプラインキャッシュを使い回す (ウォームアップで中身が入る)
+    //       ドライバが独自にディスクへキャッシュする場合(Mesa等)は、coldでもその恩恵を受けることに注意。
+    {
+        ctx.pipelineCache = VK_NULL_HANDLE;
+        CHECK(runBenchCase(report, "createPipelineForUI(cold)", benchCreatePipeline, &ctx, 0.0), "パイプラインの作成(cold)の計測に失敗");
+        const VkPipelineCacheCreateInfo ci = {
+            VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+            NULL,
+            0,
+            0,
+            NULL,
+        };
+        CHECK(vkCreatePipelineCache(ctx.core->device, &ci, NULL, &ctx.pipelineCache) == VK_SUCCESS, "パイプラインキャッシュの作成に失敗");
+        if (report->warmup == 0) {
+            double elapsedMs = 0.0;
+            CHECK(benchCreatePipeline(&ctx, &elapsedMs), "パイプラインキャッシュの準備に失敗");
+        }
+        CHECK(runBenchCase(report, "createPipelineForUI(warm)", benchCreatePipeline, &ctx, 0.0), "パイプラインの作成(warm)の計測に失敗");
+    }
+
+    // 描画を計測する
+    {
+        CHECK(runBenchCase(report, "render", benchRender, &ctx, 0.0), "描画の計測に失敗");
+        CHECK(runBenchCase(report, "render+wait", benchRenderAndWait, &ctx, 0.0), "描画の完了までの計測に失敗");
+    }
+
+    // マルチサンプルの描画を計測する
+    //
+    // NOTE: サンプル数毎にレンダリングオブジェクトを作り直し、描画の完了までを計測する。
+    //       物理デバイスが対応していないサンプル数は計測しない(ベースラインとの比較でも飛ばされる)。
+    //       後の読み戻しの計測のため、最後にマルチサンプルしないレンダリングオブジェクトへ戻す。
+    {
+#define MSAA_SAMPLE_COUNTS_COUNT 3
+        const uint32_t sampleCounts[MSAA_SAMPLE_COUNTS_COUNT] = { 2, 4, 8 };
+        const VkImageView imageViews[] = { ctx.offscreen->imageView };
+        for (uint32_t i = 0; i < MSAA_SAMPLE_COUNTS_COUNT; ++i) {
+            const VkSampleCountFlagBits samples = selectRenderingSampleCount(ctx.core, sampleCounts[i]);
+            if ((uint32_t)samples != sampleCounts[i]) {
+                continue;
+            }
+            deleteVulkanAppRendering(ctx.core, ctx.renderer);
+            ctx.renderer = createVulkanAppRendering(ctx.core, imageViews, 1, ctx.width, ctx.height, ctx.offscreen->layout, samples);
+            CHECK(ctx.renderer != NULL, "マルチサンプルのレンダリングオブジェクトの作成に失敗");
+            waitForPipelines(ctx.renderer);
+            char name[BENCH_MAX_NAME];
+            snprintf(name, sizeof(name), "render+wait(msaa %ux)", sampleCounts[i]);
+            CHECK(runBenchCase(report, name, benchRenderAndWait, &ctx, 0.0), "マルチサンプルの描画の完了までの計測に失敗");
+        }
+        if (ctx.renderer->samples != VK_SAMPLE_COUNT_1_BIT) {
+            deleteVulkanAppRendering(ctx.core, ctx.renderer);
+            ctx.renderer = createVulkanAppRendering(ctx.core, imageViews, 1, ctx.width, ctx.height, ctx.offscreen->layout, VK_SAMPLE_COUNT_1_BIT);
+            CHECK(ctx.renderer != NULL, "レンダリングオブジェクトの作成に失敗");
+            waitForPipelines(ctx.renderer);
+        }
+#undef MSAA_SAMPLE_COUNTS_COUNT
+    }
+
+    // 描画結果の読み戻しと符号化を計測する
+    //
+    // NOTE: スループットは描画先イメージのバイト数を基準とする。
+    {
+        const double bytes = (double)width * (double)height * 4.0;
+        CHECK(runBenchCase(report, "saveRenderingResult", benchSaveRenderingResult, &ctx, bytes), "描画結果の保存の計測に失敗");
+    }
+
+    // 結果を書き出す
+    CHECK(writeBenchReport(report, options->benchOutputPath), "計測結果の書出しに失敗");
+
+    // ベースラインと比べる
+    if (options->benchBaselinePath != NULL) {
+        const int regressionsCount = compareBenchReport(report, options->benchBaselinePath, (double)options->benchThreshold);
+        CHECK(regressionsCount == 0, "ベースラインより悪化した、あるいはベースラインとの比較に失敗");
+    }
+
+    deleteBenchContext(&ctx, report);
+    return 0;
+
+#undef CHECK
+}
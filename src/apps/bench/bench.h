@@ -0,0 +1,27 @@
+/// @file bench.h
+/// @brief オフスクリーンレンダリングのベンチマークを定義するモジュール
+
+#pragma once
+
+#include "../options.h"
+
+/// @brief オフスクリーンレンダリングの各工程を繰り返し計測し、結果をJSONファイルに書き出す関数
+///
+/// ウィンドウを必要としないため、lavapipeやSwiftShader等のソフトウェア実装のVulkanでも実行できる。
+/// 計測する工程は次の通り。
+/// - createVulkanAppCore: インスタンスと論理デバイスの作成
+/// - createModelFromFile(square/utah): モデルの読込み
+/// - createPipelineForUI(cold/warm): 空のパイプラインキャッシュ・作成済みのパイプラインキャッシュでのパイプラインの作成
+/// - render: コマンドの記録と提出 (ホスト側の時間)
+/// - render+wait: 描画の完了まで
+/// - render+wait(msaa 2x/4x/8x): マルチサンプルで描画した場合の描画の完了まで (物理デバイスが対応するもののみ)
+/// - saveRenderingResult: 描画結果の読み戻しとPNGへの符号化
+///
+/// 結果はoptions->benchOutputPathに書き出す。
+/// options->benchBaselinePathが与えられれば、それと比べて悪化した場合に異常終了する。
+///
+/// @param width スクリーン幅
+/// @param height スクリーン高
+/// @param options コマンドラインオプション
+/// @returns 正常終了時に0を返す。
+int runBenchmark(int width, int height, const AppOptions *options);
@@ -0,0 +1,268 @@
+#include "measure.h"
+
+// fopen()関数とstrncpy()関数の使用に対してwarningを出さないためにこのマクロを定義する
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "../../vulkan/util/error.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int compareDouble(const void *a, const void *b) {
+    const double x = *(const double *)a;
+    const double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// 昇順に並べた標本のパーセンタイルを求める関数
+static double getPercentile(const double *sorted, uint32_t count, double percent) {
+    const double position = percent / 100.0 * (double)(count - 1);
+    const uint32_t lower = (uint32_t)position;
+    if (lower + 1 >= count) {
+        return sorted[count - 1];
+    }
+    const double fraction = position - (double)lower;
+    return sorted[lower] + (sorted[lower + 1] - sorted[lower]) * fraction;
+}
+
+void computeBenchStats(double *samples, uint32_t count, BenchStats *stats) {
+    qsort((void *)samples, count, sizeof(double), compareDouble);
+
+    double sum = 0.0;
+    for (uint32_t i = 0; i < count; ++i) {
+        sum += samples[i];
+    }
+    const double mean = sum / (double)count;
+    double variance = 0.0;
+    for (uint32_t i = 0; i < count; ++i) {
+        variance += (samples[i] - mean) * (samples[i] - mean);
+    }
+    variance = count > 1 ? variance / (double)(count - 1) : 0.0;
+
+    stats->count = count;
+    stats->min = samples[0];
+    stats->mean = mean;
+    stats->stddev = sqrt(variance);
+    stats->p50 = getPercentile(samples, count, 50.0);
+    stats->p90 = getPercentile(samples, count, 90.0);
+    stats->p99 = getPercentile(samples, count, 99.0);
+    stats->max = samples[count - 1];
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void deleteBenchReport(BenchReport report) {
+    if (report == NULL) {
+        return;
+    }
+    free((void *)report);
+}
+
+BenchReport createBenchReport(const char *suite, uint32_t warmup, uint32_t repetitions, const char *filter) {
+    const BenchReport report = (BenchReport)malloc(sizeof(struct BenchReport_t));
+    ERROR_IF(report == NULL, "createBenchReport()", "BenchReportの確保に失敗", {}, NULL);
+    memset(report, 0, sizeof(struct BenchReport_t));
+    report->suite = suite;
+    report->warmup = warmup;
+    report->repetitions = repetitions > 0 ? repetitions : 1;
+    report->filter = filter;
+    return report;
+}
+
+void addBenchReportInfo(BenchReport report, const char *key, const char *value) {
+    if (report->infosCount >= BENCH_MAX_INFOS) {
+        printf("[ warning ] addBenchReportInfo(): 付加情報が多すぎるため捨てる: %s\n", key);
+        return;
+    }
+    char *dst = report->infoValues[report->infosCount];
+    strncpy(dst, value, BENCH_MAX_INFO_VALUE - 1);
+    dst[BENCH_MAX_INFO_VALUE - 1] = '\0';
+    for (char *c = dst; *c != '\0'; ++c) {
+        if (*c == '"' || *c == '\\' || (unsigned char)*c < 0x20) *c = '_';
+    }
+    report->infoKeys[report->infosCount] = key;
+    report->infosCount += 1;
+}
+
+int addBenchReportResult(BenchReport report, const char *name, double *samples, uint32_t count, double bytes) {
+    ERROR_IF(report->resultsCount >= BENCH_MAX_RESULTS, "addBenchReportResult()", "計測結果が多すぎる", {}, 0);
+    ERROR_IF(count == 0, "addBenchReportResult()", "標本が無い", {}, 0);
+
+    BenchResult *result = &report->results[report->resultsCount];
+    strncpy(result->name, name, BENCH_MAX_NAME - 1);
+    result->name[BENCH_MAX_NAME - 1] = '\0';
+    result->bytes = bytes;
+    computeBenchStats(samples, count, &result->stats);
+    report->resultsCount += 1;
+
+    const BenchStats *s = &result->stats;
+    printf("[ info ] bench: %-32s p50=%9.3fms p90=%9.3fms p99=%9.3fms", name, s->p50, s->p90, s->p99);
+    if (bytes > 0.0 && s->p50 > 0.0) {
+        printf(" %9.1fMB/s", bytes / (1024.0 * 1024.0) / (s->p50 / 1000.0));
+    }
+    printf("\n");
+    return 1;
+}
+
+// NOTE: 計測結果は一行に一つずつ書き出し、行単位でも比較しやすくする。
+int writeBenchReport(const BenchReport report, const char *path) {
+    FILE *file = fopen(path, "w");
+    ERROR_IF(file == NULL, "writeBenchReport()", "JSONファイルのオープンに失敗", {}, 0);
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"suite\": \"%s\",\n", report->suite);
+    fprintf(file, "  \"warmup\": %u,\n", report->warmup);
+    fprintf(file, "  \"repetitions\": %u,\n", report->repetitions);
+    fprintf(file, "  \"info\": {");
+    for (uint32_t i = 0; i < report->infosCount; ++i) {
+        fprintf(file, "%s\n    \"%s\": \"%s\"", i > 0 ? "," : "", report->infoKeys[i], report->infoValues[i]);
+    }
+    fprintf(file, "%s},\n", report->infosCount > 0 ? "\n  " : "");
+    fprintf(file, "  \"results\": [");
+    for (uint32_t i = 0; i < report->resultsCount; ++i) {
+        const BenchResult *r = &report->results[i];
+        const BenchStats *s = &r->stats;
+        fprintf(
+            file,
+            "%s\n    {\"name\": \"%s\", \"unit\": \"ms\", \"count\": %u, \"min\": %.6f, \"mean\": %.6f, \"stddev\": %.6f, \"p50\": %.6f, \"p90\": %.6f, \"p99\": %.6f, \"max\": %.6f",
+            i > 0 ? "," : "",
+            r->name,
+            s->count,
+            s->min,
+            s->mean,
+            s->stddev,
+            s->p50,
+            s->p90,
+            s->p99,
+            s->max
+        );
+        if (r->bytes > 0.0 && s->p50 > 0.0) {
+            fprintf(file, ", \"bytes\": %.0f, \"throughputMBps\": %.3f", r->bytes, r->bytes / (1024.0 * 1024.0) / (s->p50 / 1000.0));
+        }
+        fprintf(file, "}");
+    }
+    fprintf(file, "%s]\n", report->resultsCount > 0 ? "\n  " : "");
+    fprintf(file, "}\n");
+
+    const int ok = ferror(file) == 0;
+    fclose(file);
+    ERROR_IF(!ok, "writeBenchReport()", "JSONファイルの書出しに失敗", {}, 0);
+    printf("[ info ] bench: %u results -> %s\n", report->resultsCount, path);
+    return 1;
+}
+
+// ベースラインの一行から計測の名前とp50を読み取る関数
+//
+// NOTE: writeBenchReport()関数が計測結果を一行に一つずつ書き出すことを前提とし、汎用のJSONパーサは持たない。
+static int parseBaselineLine(const char *line, char *name, double *p50) {
+    const char *nameKey = "{\"name\": \"";
+    const char *p50Key = "\"p50\": ";
+    const char *nameBegin = strstr(line, nameKey);
+    if (nameBegin == NULL) {
+        return 0;
+    }
+    nameBegin += strlen(nameKey);
+    const char *nameEnd = strchr(nameBegin, '"');
+    const char *p50Begin = strstr(line, p50Key);
+    if (nameEnd == NULL || p50Begin == NULL || nameEnd - nameBegin >= BENCH_MAX_NAME) {
+        return 0;
+    }
+    memcpy((void *)name, (const void *)nameBegin, (size_t)(nameEnd - nameBegin));
+    name[nameEnd - nameBegin] = '\0';
+    char *end = NULL;
+    *p50 = strtod(p50Begin + strlen(p50Key), &end);
+    return end != p50Begin + strlen(p50Key);
+}
+
+int compareBenchReport(const BenchReport report, const char *path, double thresholdPercent) {
+    FILE *file = fopen(path, "r");
+    ERROR_IF(file == NULL, "compareBenchReport()", "ベースラインのオープンに失敗", {}, -1);
+
+    int regressionsCount = 0;
+    uint32_t comparedCount = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char name[BENCH_MAX_NAME];
+        double baseline = 0.0;
+        if (!parseBaselineLine(line, name, &baseline)) {
+            continue;
+        }
+        for (uint32_t i = 0; i < report->resultsCount; ++i) {
+            const BenchResult *r = &report->results[i];
+            if (strcmp(r->name, name) != 0) {
+                continue;
+            }
+            const double current = r->stats.p50;
+            const double change = baseline > 0.0 ? (current - baseline) / baseline * 100.0 : 0.0;
+            const int regressed = change > thresholdPercent && current - baseline >= BENCH_MIN_REGRESSION_MS;
+            printf(
+                "[ %s ] bench: %-32s baseline=%9.3fms current=%9.3fms %+7.1f%%%s\n",
+                regressed ? "error" : "info",
+                name,
+                baseline,
+                current,
+                change,
+                regressed ? " (regressed)" : ""
+            );
+            regressionsCount += regressed;
+            comparedCount += 1;
+            break;
+        }
+    }
+    fclose(file);
+
+    printf(
+        "[ info ] bench: compared %u results with %s, %d regressed (threshold %.1f%%)\n",
+        comparedCount,
+        path,
+        regressionsCount,
+        thresholdPercent
+    );
+    return regressionsCount;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int isBenchCaseEnabled(const BenchReport report, const char *name) {
+    return report->filter == NULL || strstr(name, report->filter) != NULL;
+}
+
+int runBenchCase(BenchReport report, const char *name, BenchCaseFunction function, void *context, double bytes) {
+#define CHECK(p, m) ERROR_IF(!(p), "runBenchCase()", (m), free((void *)samples), 0)
+
+    if (!isBenchCaseEnabled(report, name)) {
+        return 1;
+    }
+
+    double *samples = (double *)malloc(sizeof(double) * report->repetitions);
+    CHECK(samples != NULL, "標本の配列の確保に失敗");
+
+    // ウォームアップする
+    //
+    // NOTE: 初回はファイルキャッシュやドライバ内部の遅延初期化が効いていないため、計測から除く。
+    for (uint32_t i = 0; i < report->warmup; ++i) {
+        double elapsedMs = 0.0;
+        CHECK(function(context, &elapsedMs), name);
+    }
+
+    // 計測する
+    for (uint32_t i = 0; i < report->repetitions; ++i) {
+        CHECK(function(context, &samples[i]), name);
+    }
+
+    const int ok = addBenchReportResult(report, name, samples, report->repetitions, bytes);
+    free((void *)samples);
+    return ok;
+
+#undef CHECK
+}
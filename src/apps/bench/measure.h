@@ -0,0 +1,154 @@
+/// @file measure.h
+/// @brief ベンチマークの計測・集計・出力を行うモジュール
+///
+/// - runBenchCase()
+///   - 一回分の処理をウォームアップの回数だけ捨ててから、指定回数だけ繰り返し計測する
+/// - BenchStats
+///   - 計測した時間の最小・平均・標準偏差・パーセンタイル・最大
+/// - BenchReport
+///   - 計測結果を集め、CIで追跡できるようJSONファイルに書き出す
+///   - 以前に書き出したJSONファイルをベースラインとして、p50が閾値を超えて悪化した計測を検出する
+
+#pragma once
+
+#include <stdint.h>
+
+/// @brief BenchReportに追加できる計測結果の最大数
+#define BENCH_MAX_RESULTS 64
+
+/// @brief BenchReportに追加できる付加情報の最大数
+#define BENCH_MAX_INFOS 16
+
+/// @brief 付加情報の値の最大長 (終端文字を含む)
+#define BENCH_MAX_INFO_VALUE 256
+
+/// @brief 計測結果の名前の最大長 (終端文字を含む)
+#define BENCH_MAX_NAME 64
+
+/// @brief ベースラインとの比較で悪化とみなすのに必要な最小の差(ms)
+///
+/// 極めて短い計測では、わずかな揺らぎでも割合が大きくなるため、これより小さな差は無視する。
+#define BENCH_MIN_REGRESSION_MS 0.05
+
+/// @brief 計測した時間(ms)の統計量
+typedef struct BenchStats_t {
+    uint32_t count;
+    double min;
+    double mean;
+    double stddev;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+} BenchStats;
+
+/// @brief 計測した時間の統計量を求める関数
+///
+/// パーセンタイルは、昇順に並べた標本の隣り合う二つの値を線形補間して求める。
+///
+/// @param samples 計測した時間(ms)の配列 (昇順に並べ替えられる)
+/// @param count samplesの要素数 (1以上)
+/// @param stats 統計量の格納先
+void computeBenchStats(double *samples, uint32_t count, BenchStats *stats);
+
+/// @brief 計測結果
+typedef struct BenchResult_t {
+    char name[BENCH_MAX_NAME];
+    BenchStats stats;
+    // 一回の処理で扱うバイト数 (0ならスループットを出力しない)
+    double bytes;
+} BenchResult;
+
+/// @brief 計測結果を集めるためのオブジェクトを持つ構造体
+typedef struct BenchReport_t {
+    // ベンチマークの種類 (文字列リテラル)
+    const char *suite;
+    uint32_t warmup;
+    uint32_t repetitions;
+    // 名前にこの文字列を含む計測のみを行う (NULLなら全て)
+    const char *filter;
+    uint32_t infosCount;
+    const char *infoKeys[BENCH_MAX_INFOS];
+    char infoValues[BENCH_MAX_INFOS][BENCH_MAX_INFO_VALUE];
+    uint32_t resultsCount;
+    BenchResult results[BENCH_MAX_RESULTS];
+} *BenchReport;
+
+/// @brief BenchReportを破棄する関数
+/// @param report 計測結果オブジェクトハンドル
+void deleteBenchReport(BenchReport report);
+
+/// @brief BenchReportを作成する関数
+/// @param suite ベンチマークの種類 (文字列リテラル)
+/// @param warmup 計測せずに捨てる回数
+/// @param repetitions 計測する回数 (1以上)
+/// @param filter 名前にこの文字列を含む計測のみを行う (NULLなら全て)
+/// @returns 失敗時にNULLを返す。
+BenchReport createBenchReport(const char *suite, uint32_t warmup, uint32_t repetitions, const char *filter);
+
+/// @brief 付加情報を追加する関数
+///
+/// デバイス名や画像サイズ等、計測結果を比べるときに揃っているべき条件を記録する。
+/// JSONの文字列に含められない文字は'_'に置き換える。
+///
+/// @param report 計測結果オブジェクトハンドル
+/// @param key キー (文字列リテラル)
+/// @param value 値
+void addBenchReportInfo(BenchReport report, const char *key, const char *value);
+
+/// @brief 計測結果を追加し、標準出力に出力する関数
+/// @param report 計測結果オブジェクトハンドル
+/// @param name 名前 (BENCH_MAX_NAME文字以上は切り詰める)
+/// @param samples 計測した時間(ms)の配列 (昇順に並べ替えられる)
+/// @param count samplesの要素数 (1以上)
+/// @param bytes 一回の処理で扱うバイト数 (0ならスループットを出力しない)
+/// @returns 失敗時に0を返す。
+int addBenchReportResult(BenchReport report, const char *name, double *samples, uint32_t count, double bytes);
+
+/// @brief 計測結果をJSONファイルに書き出す関数
+/// @param report 計測結果オブジェクトハンドル
+/// @param path JSONファイルのパス
+/// @returns 失敗時に0を返す。
+int writeBenchReport(const BenchReport report, const char *path);
+
+/// @brief 計測結果をベースラインと比べる関数
+///
+/// 同じ名前の計測のp50を比べ、ベースラインよりthresholdPercent%を超えて、かつBENCH_MIN_REGRESSION_MS以上遅くなったものを悪化として報告する。
+/// ベースラインに無い計測や、ベースラインにあって今回行わなかった計測は比べない。
+///
+/// @param report 計測結果オブジェクトハンドル
+/// @param path writeBenchReport()関数で書き出したJSONファイルのパス
+/// @param thresholdPercent 悪化とみなす閾値(%)
+/// @returns 悪化した計測の数を返す。失敗時に-1を返す。
+int compareBenchReport(const BenchReport report, const char *path, double thresholdPercent);
+
+/// @brief 計測を行うか確認する関数
+///
+/// 入力データの準備が重い計測で、行わない計測のための準備を省くために用いる。
+///
+/// @param report 計測結果オブジェクトハンドル
+/// @param name 名前
+/// @returns 名前がreport->filterを含めば1を返す。
+int isBenchCaseEnabled(const BenchReport report, const char *name);
+
+/// @brief 一回分の処理を行い、その時間を計測する関数の型
+///
+/// 準備や後始末を計測から除けるよう、時間の計測も関数に任せる。
+///
+/// @param context 任意のデータ
+/// @param elapsedMs 計測した時間(ms)の格納先
+/// @returns 失敗時に0を返す。
+typedef int (*BenchCaseFunction)(void *context, double *elapsedMs);
+
+/// @brief 処理を繰り返し計測し、その結果をBenchReportに追加する関数
+///
+/// report->warmup回だけ計測せずに実行してから、report->repetitions回だけ計測する。
+/// 名前がreport->filterを含まなければ何もせず成功とする。
+///
+/// @param report 計測結果オブジェクトハンドル
+/// @param name 名前 (BENCH_MAX_NAME文字以上は切り詰める)
+/// @param function 一回分の処理を行う関数
+/// @param context functionに与える任意のデータ
+/// @param bytes 一回の処理で扱うバイト数 (0ならスループットを出力しない)
+/// @returns 失敗時に0を返す。
+int runBenchCase(BenchReport report, const char *name, BenchCaseFunction function, void *context, double bytes);
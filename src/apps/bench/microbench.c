@@ -0,0 +1,388 @@
+#include "microbench.h"
+
+// fopen()関数とsnprintf()関数の使用に対してwarningを出さないためにこのマクロを定義する
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "../../vulkan/util/error.h"
+#include "../../vulkan/util/file.h"
+#include "../../vulkan/util/model.h"
+#include "../../vulkan/util/timer.h"
+#include "../offscreen/offscreen.h"
+#include "../offscreen/png.h"
+#include "../offscreen/stb_image_write.h"
+#include "measure.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 計測のために一時的に書き出すファイルのパス
+#define MICROBENCH_MODEL_PATH "./microbench-model.raw"
+#define MICROBENCH_MODEL_JSON_PATH "./microbench-model.json"
+#define MICROBENCH_CONVERTED_PATH "./microbench-converted.raw"
+#define MICROBENCH_IMAGE_PATH "./microbench-image.png"
+
+#ifdef _WIN32
+# define MICROBENCH_NULL_DEVICE "NUL"
+#else
+# define MICROBENCH_NULL_DEVICE "/dev/null"
+#endif
+
+// converter.jsで変換する合成メッシュの最大頂点数
+//
+// NOTE: 10M頂点ではJSONが数百MBとなり、nodeの文字列の長さの上限を超えるため計測しない。
+#define MICROBENCH_CONVERTER_MAX_VERTICES 1000000
+
+// 合成メッシュの大きさ
+typedef struct MicroBenchMesh_t {
+    const char *label;
+    uint32_t verticesCount;
+} MicroBenchMesh;
+
+// 合成画像の大きさ
+typedef struct MicroBenchImage_t {
+    const char *label;
+    uint32_t width;
+    uint32_t height;
+} MicroBenchImage;
+
+static const MicroBenchMesh MICROBENCH_MESHES[] = {
+    { "1k",   1000 },
+    { "10k",  10000 },
+    { "100k", 100000 },
+    { "1M",   1000000 },
+    { "10M",  10000000 },
+};
+
+static const MicroBenchImage MICROBENCH_IMAGES[] = {
+    { "640x480",   640,  480 },
+    { "1920x1080", 1920, 1080 },
+    { "3840x2160", 3840, 2160 },
+    { "7680x4320", 7680, 4320 },
+};
+
+// 各計測で共有するデータを持つ構造体
+typedef struct MicroBenchContext_t {
+    // 合成メッシュのモデルデータ
+    uint32_t *modelData;
+    long int modelSize;
+    // 合成画像の画素 (BGRAとその並べ替え先のRGBA)
+    uint32_t width;
+    uint32_t height;
+    uint8_t *bgra;
+    uint8_t *rgba;
+    // 最適化で処理が省かれないよう、結果を書き込む先
+    volatile uint32_t sink;
+} MicroBenchContext;
+
+static double getElapsedMs(uint64_t startNs) {
+    return (double)(getTimeNs() - startNs) / 1000000.0;
+}
+
+// 線形合同法による擬似乱数
+//
+// NOTE: 入力を実行毎・環境毎に揃えるため、標準ライブラリのrand()関数は使わない。
+static uint32_t nextMicroBenchRandom(uint32_t *state) {
+    *state = *state * 1664525u + 1013904223u;
+    return *state;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// 合成メッシュのモデルデータを作成する関数
+//
+// NOTE: 頂点は位置とUV座標を持つ(フラグ2)。
+//       インデックスは頂点を散らばって参照するTRIANGLE_LISTとする。
+static int createSyntheticModel(MicroBenchContext *ctx, uint32_t verticesCount) {
+    const uint32_t sizePerVertex = 5;
+    const uint32_t indicesCount = verticesCount / 3 * 3;
+    const uint64_t wordsCount = 2 + (uint64_t)sizePerVertex * verticesCount + 1 + indicesCount;
+    ctx->modelData = (uint32_t *)malloc(sizeof(uint32_t) * (size_t)wordsCount);
+    ERROR_IF(ctx->modelData == NULL, "createSyntheticModel()", "モデルデータの確保に失敗", {}, 0);
+    ctx->modelSize = (long int)(sizeof(uint32_t) * wordsCount);
+
+    uint32_t state = verticesCount;
+    ctx->modelData[0] = 2;
+    ctx->modelData[1] = verticesCount;
+    float *vertices = (float *)&ctx->modelData[2];
+    for (uint32_t i = 0; i < verticesCount; ++i) {
+        float *v = &vertices[(uint64_t)i * sizePerVertex];
+        v[0] = (float)(nextMicroBenchRandom(&state) >> 8) / 16777216.0f * 2.0f - 1.0f;
+        v[1] = (float)(nextMicroBenchRandom(&state) >> 8) / 16777216.0f * 2.0f - 1.0f;
+        v[2] = (float)(nextMicroBenchRandom(&state) >> 8) / 16777216.0f;
+        v[3] = (v[0] + 1.0f) * 0.5f;
+        v[4] = (v[1] + 1.0f) * 0.5f;
+    }
+    uint32_t *indices = &ctx->modelData[2 + (uint64_t)sizePerVertex * verticesCount];
+    indices[0] = indicesCount;
+    for (uint32_t i = 0; i < indicesCount; ++i) {
+        indices[1 + i] = nextMicroBenchRandom(&state) % verticesCount;
+    }
+    return 1;
+}
+
+// 合成メッシュをconverter.jsの入力となるJSONファイルに書き出す関数
+static int writeSyntheticModelJson(const MicroBenchContext *ctx, const char *path) {
+    FILE *file = fopen(path, "w");
+    ERROR_IF(file == NULL, "writeSyntheticModelJson()", "JSONファイルのオープンに失敗", {}, 0);
+
+    const uint32_t verticesCount = ctx->modelData[1];
+    const float *vertices = (const float *)&ctx->modelData[2];
+    const uint32_t *indices = &ctx->modelData[2 + (uint64_t)5 * verticesCount];
+    const uint32_t indicesCount = indices[0];
+
+    fprintf(file, "{\"vertex\":%u,\"position\":[", verticesCount);
+    for (uint32_t i = 0; i < verticesCount; ++i) {
+        const float *v = &vertices[(uint64_t)i * 5];
+        fprintf(file, "%s%.6g,%.6g,%.6g", i > 0 ? "," : "", v[0], v[1], v[2]);
+    }
+    fprintf(file, "],\"uv\":[");
+    for (uint32_t i = 0; i < verticesCount; ++i) {
+        const float *v = &vertices[(uint64_t)i * 5];
+        fprintf(file, "%s%.6g,%.6g", i > 0 ? "," : "", v[3], v[4]);
+    }
+    fprintf(file, "],\"index\":[");
+    for (uint32_t i = 0; i < indicesCount; ++i) {
+        fprintf(file, "%s%u", i > 0 ? "," : "", indices[1 + i]);
+    }
+    fprintf(file, "]}\n");
+
+    const int ok = ferror(file) == 0;
+    fclose(file);
+    ERROR_IF(!ok, "writeSyntheticModelJson()", "JSONファイルの書出しに失敗", {}, 0);
+    return 1;
+}
+
+// 合成画像の画素を作成する関数
+//
+// NOTE: 単色ではPNGの圧縮が効きすぎるため、グラデーションに細かなノイズを加える。
+static int createSyntheticImage(MicroBenchContext *ctx, uint32_t width, uint32_t height) {
+    const size_t size = (size_t)width * (size_t)height * 4;
+    ctx->width = width;
+    ctx->height = height;
+    ctx->bgra = (uint8_t *)malloc(size);
+    ctx->rgba = (uint8_t *)malloc(size);
+    ERROR_IF(ctx->bgra == NULL || ctx->rgba == NULL, "createSyntheticImage()", "画素の配列の確保に失敗", {}, 0);
+
+    uint32_t state = width ^ (height << 16);
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            uint8_t *p = &ctx->bgra[((size_t)y * width + x) * 4];
+            const uint32_t noise = nextMicroBenchRandom(&state) >> 28;
+            p[0] = (uint8_t)(x * 255 / width + noise);
+            p[1] = (uint8_t)(y * 255 / height + noise);
+            p[2] = (uint8_t)((x + y) * 127 / (width + height) + noise);
+            p[3] = 255;
+        }
+    }
+    return 1;
+}
+
+static void releaseMicroBenchContext(MicroBenchContext *ctx) {
+    if (ctx->modelData != NULL) free((void *)ctx->modelData);
+    if (ctx->bgra != NULL) free((void *)ctx->bgra);
+    if (ctx->rgba != NULL) free((void *)ctx->rgba);
+    ctx->modelData = NULL;
+    ctx->modelSize = 0;
+    ctx->bgra = NULL;
+    ctx->rgba = NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int benchReadBinaryFile(void *context, double *elapsedMs) {
+    MicroBenchContext *ctx = (MicroBenchContext *)context;
+    long int size = 0;
+    const uint64_t startNs = getTimeNs();
+    const char *data = readBinaryFile(MICROBENCH_MODEL_PATH, &size);
+    *elapsedMs = getElapsedMs(startNs);
+    if (data == NULL) {
+        return 0;
+    }
+    ctx->sink += (uint32_t)data[size - 1];
+    free((void *)data);
+    return size == ctx->modelSize;
+}
+
+static int benchParseModelData(void *context, double *elapsedMs) {
+    MicroBenchContext *ctx = (MicroBenchContext *)context;
+    ModelData modelData;
+    const uint64_t startNs = getTimeNs();
+    const int ok = parseModelData((const char *)ctx->modelData, ctx->modelSize, &modelData);
+    *elapsedMs = getElapsedMs(startNs);
+    if (!ok) {
+        return 0;
+    }
+    ctx->sink += modelData.indicesCount;
+    return 1;
+}
+
+static int benchConverter(void *context, double *elapsedMs) {
+    (void)context;
+    const char *command = "node ./model/converter.js " MICROBENCH_MODEL_JSON_PATH " " MICROBENCH_CONVERTED_PATH " > " MICROBENCH_NULL_DEVICE;
+    const uint64_t startNs = getTimeNs();
+    const int status = system(command);
+    *elapsedMs = getElapsedMs(startNs);
+    return status == 0;
+}
+
+static int benchConvertBGRAToRGBA(void *context, double *elapsedMs) {
+    MicroBenchContext *ctx = (MicroBenchContext *)context;
+    const uint64_t startNs = getTimeNs();
+    convertBGRAToRGBA(ctx->bgra, ctx->rgba, ctx->width * ctx->height);
+    *elapsedMs = getElapsedMs(startNs);
+    ctx->sink += ctx->rgba[0];
+    return 1;
+}
+
+static int benchWritePng(void *context, double *elapsedMs) {
+    MicroBenchContext *ctx = (MicroBenchContext *)context;
+    const uint64_t startNs = getTimeNs();
+    const int ok = stbi_write_png(MICROBENCH_IMAGE_PATH, (int)ctx->width, (int)ctx->height, 4, (const void *)ctx->rgba, 0);
+    *elapsedMs = getElapsedMs(startNs);
+    return ok;
+}
+
+// NOTE: 読み戻したBGRAの画素から直接、行毎に並べ替え・圧縮して書き出す。並べ替えの時間も含む。
+static int benchWritePngRows(void *context, double *elapsedMs) {
+    MicroBenchContext *ctx = (MicroBenchContext *)context;
+    const uint64_t startNs = getTimeNs();
+    PngWriter writer = createPngWriter(MICROBENCH_IMAGE_PATH, ctx->width, ctx->height, 4);
+    int ok = writer != NULL;
+    for (uint32_t y = 0; y < ctx->height && ok; ++y) {
+        ok = writePngRow(writer, ctx->bgra + (size_t)y * ctx->width * 4, PNG_PIXEL_LAYOUT_BGRA);
+    }
+    ok = ok && finishPngWriter(writer);
+    deletePngWriter(writer);
+    *elapsedMs = getElapsedMs(startNs);
+    return ok;
+}
+
+// NOTE: デバイスで変換してから読み戻したRGBAの画素を、並べ替えずに行毎に圧縮して書き出す。
+//       変換後の画素は計測の外で用意するため、書き出しのみの時間となる。
+static int benchWritePngRowsPacked(void *context, double *elapsedMs) {
+    MicroBenchContext *ctx = (MicroBenchContext *)context;
+    convertBGRAToRGBA(ctx->bgra, ctx->rgba, ctx->width * ctx->height);
+    const uint64_t startNs = getTimeNs();
+    PngWriter writer = createPngWriter(MICROBENCH_IMAGE_PATH, ctx->width, ctx->height, 4);
+    int ok = writer != NULL;
+    for (uint32_t y = 0; y < ctx->height && ok; ++y) {
+        ok = writePngRow(writer, ctx->rgba + (size_t)y * ctx->width * 4, PNG_PIXEL_LAYOUT_PACKED);
+    }
+    ok = ok && finishPngWriter(writer);
+    deletePngWriter(writer);
+    *elapsedMs = getElapsedMs(startNs);
+    return ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void deleteMicroBenchResources(MicroBenchContext *ctx, BenchReport report) {
+    releaseMicroBenchContext(ctx);
+    remove(MICROBENCH_MODEL_PATH);
+    remove(MICROBENCH_MODEL_JSON_PATH);
+    remove(MICROBENCH_CONVERTED_PATH);
+    remove(MICROBENCH_IMAGE_PATH);
+    if (report != NULL) deleteBenchReport(report);
+}
+
+int runMicroBenchmark(const AppOptions *options) {
+#define CHECK(p, m) ERROR_IF(!(p), "runMicroBenchmark()", (m), deleteMicroBenchResources(&ctx, report), 1)
+#define NAME_SIZE 64
+
+    MicroBenchContext ctx;
+    memset(&ctx, 0, sizeof(MicroBenchContext));
+    BenchReport report = NULL;
+
+    // 計測結果オブジェクトを作成する
+    {
+        report = createBenchReport("micro", options->benchWarmup, options->benchRepetitions, options->benchFilter);
+        CHECK(report != NULL, "計測結果オブジェクトの作成に失敗");
+    }
+
+    // converter.jsを実行できるか確認する
+    //
+    // NOTE: nodeが無い環境ではconverter.jsの計測のみを省く。
+    int hasNode = 0;
+    {
+        hasNode = system("node --version > " MICROBENCH_NULL_DEVICE " 2>&1") == 0 && existsFile("./model/converter.js");
+        if (!hasNode) printf("[ warning ] runMicroBenchmark(): nodeあるいはconverter.jsが無いため、converter.jsの計測を省く\n");
+        addBenchReportInfo(report, "node", hasNode ? "yes" : "no");
+    }
+
+    // 合成メッシュで計測する
+    for (uint32_t i = 0; i < sizeof(MICROBENCH_MESHES) / sizeof(MicroBenchMesh); ++i) {
+        const MicroBenchMesh *mesh = &MICROBENCH_MESHES[i];
+        char readName[NAME_SIZE];
+        char parseName[NAME_SIZE];
+        char convertName[NAME_SIZE];
+        snprintf(readName, NAME_SIZE, "readBinaryFile(%s)", mesh->label);
+        snprintf(parseName, NAME_SIZE, "parseModelData(%s)", mesh->label);
+        snprintf(convertName, NAME_SIZE, "converter.js(%s)", mesh->label);
+        const int convertEnabled = hasNode && mesh->verticesCount <= MICROBENCH_CONVERTER_MAX_VERTICES && isBenchCaseEnabled(report, convertName);
+        if (!isBenchCaseEnabled(report, readName) && !isBenchCaseEnabled(report, parseName) && !convertEnabled) {
+            continue;
+        }
+
+        CHECK(createSyntheticModel(&ctx, mesh->verticesCount), "合成メッシュの作成に失敗");
+        CHECK(writeBinaryFile(MICROBENCH_MODEL_PATH, (const void *)ctx.modelData, (size_t)ctx.modelSize), "合成メッシュの書出しに失敗");
+        CHECK(runBenchCase(report, readName, benchReadBinaryFile, &ctx, (double)ctx.modelSize), "モデルデータファイルの読込みの計測に失敗");
+        CHECK(runBenchCase(report, parseName, benchParseModelData, &ctx, 0.0), "モデルデータの解釈の計測に失敗");
+        if (convertEnabled) {
+            CHECK(writeSyntheticModelJson(&ctx, MICROBENCH_MODEL_JSON_PATH), "合成メッシュのJSONの書出しに失敗");
+            CHECK(runBenchCase(report, convertName, benchConverter, &ctx, (double)ctx.modelSize), "converter.jsの計測に失敗");
+        }
+        releaseMicroBenchContext(&ctx);
+    }
+
+    // 合成画像で計測する
+    for (uint32_t i = 0; i < sizeof(MICROBENCH_IMAGES) / sizeof(MicroBenchImage); ++i) {
+        const MicroBenchImage *image = &MICROBENCH_IMAGES[i];
+        char swizzleName[NAME_SIZE];
+        char pngName[NAME_SIZE];
+        char pngRowsName[NAME_SIZE];
+        char pngPackedRowsName[NAME_SIZE];
+        snprintf(swizzleName, NAME_SIZE, "convertBGRAToRGBA(%s)", image->label);
+        snprintf(pngName, NAME_SIZE, "stbi_write_png(%s)", image->label);
+        snprintf(pngRowsName, NAME_SIZE, "writePngRow(%s)", image->label);
+        snprintf(pngPackedRowsName, NAME_SIZE, "writePngRow-packed(%s)", image->label);
+        if (
+            !isBenchCaseEnabled(report, swizzleName)
+            && !isBenchCaseEnabled(report, pngName)
+            && !isBenchCaseEnabled(report, pngRowsName)
+            && !isBenchCaseEnabled(report, pngPackedRowsName)
+        ) {
+            continue;
+        }
+
+        const double bytes = (double)image->width * (double)image->height * 4.0;
+        CHECK(createSyntheticImage(&ctx, image->width, image->height), "合成画像の作成に失敗");
+        CHECK(runBenchCase(report, swizzleName, benchConvertBGRAToRGBA, &ctx, bytes), "画素の並べ替えの計測に失敗");
+        CHECK(runBenchCase(report, pngName, benchWritePng, &ctx, bytes), "PNGの書出しの計測に失敗");
+        CHECK(runBenchCase(report, pngRowsName, benchWritePngRows, &ctx, bytes), "PNGの行毎の書出しの計測に失敗");
+        CHECK(runBenchCase(report, pngPackedRowsName, benchWritePngRowsPacked, &ctx, bytes), "並べ替えないPNGの行毎の書出しの計測に失敗");
+        releaseMicroBenchContext(&ctx);
+    }
+
+    // 結果を書き出す
+    CHECK(writeBenchReport(report, options->benchOutputPath), "計測結果の書出しに失敗");
+
+    // ベースラインと比べる
+    if (options->benchBaselinePath != NULL) {
+        const int regressionsCount = compareBenchReport(report, options->benchBaselinePath, (double)options->benchThreshold);
+        CHECK(regressionsCount == 0, "ベースラインより悪化した、あるいはベースラインとの比較に失敗");
+    }
+
+    deleteMicroBenchResources(&ctx, report);
+    return 0;
+
+#undef NAME_SIZE
+#undef CHECK
+}
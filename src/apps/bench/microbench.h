@@ -0,0 +1,26 @@
+/// @file microbench.h
+/// @brief デバイスを必要としないCPU側の処理のマイクロベンチマークを定義するモジュール
+
+#pragma once
+
+#include "../options.h"
+
+/// @brief CPU側の処理を固定の合成データで繰り返し計測し、結果をJSONファイルに書き出す関数
+///
+/// Vulkanのインスタンスやデバイスを作成しないため、GPUの無い環境でも実行できる。
+/// 計測する処理は次の通り。
+/// - 合成メッシュ(1k〜10M頂点)
+///   - readBinaryFile: モデルデータファイルの読込み
+///   - parseModelData: モデルデータの解釈
+///   - converter.js: JSONからモデルデータへの変換 (nodeがあれば。1M頂点まで)
+/// - 合成画像(640x480〜7680x4320)
+///   - convertBGRAToRGBA: 画素の並べ替え
+///   - stbi_write_png: PNGへの符号化と書出し
+///   - writePngRow: BGRAの画素からPngWriterで行毎に並べ替え・符号化・書出し
+///
+/// 結果はoptions->benchOutputPathに書き出す。
+/// options->benchBaselinePathが与えられれば、それと比べて悪化した場合に異常終了する。
+///
+/// @param options コマンドラインオプション
+/// @returns 正常終了時に0を返す。
+int runMicroBenchmark(const AppOptions *options);
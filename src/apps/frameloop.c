@@ -0,0 +1,150 @@
+#include "frameloop.h"
+
+#include "../vulkan/util/error.h"
+#include "../vulkan/util/profiler.h"
+
+#include <stdio.h>
+
+VulkanAppPresentation createSurfacePresentation(
+    const VulkanAppCore core,
+    const VkSurfaceKHR surface,
+    uint32_t width,
+    uint32_t height,
+    const AppOptions *options
+) {
+    return createVulkanAppPresentation(
+        core,
+        surface,
+        width,
+        height,
+        (PresentPreference)options->presentPreference,
+        options->swapchainImages
+    );
+}
+
+VulkanAppRendering createSurfaceRendering(const VulkanAppCore core, const VulkanAppPresentation presenter, const AppOptions *options) {
+#define CHECK(p, m) ERROR_IF(!(p), "createSurfaceRendering()", (m), deleteVulkanAppRendering(core, renderer), NULL)
+
+    // レンダリングオブジェクトを作成する
+    PROFILE_ZONE_BEGIN("createVulkanAppRendering");
+    const VulkanAppRendering renderer = createVulkanAppRendering(
+        core,
+        presenter->imageViews,
+        presenter->imagesCount,
+        presenter->width,
+        presenter->height,
+        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        selectRenderingSampleCount(core, options->msaaSamples)
+    );
+    PROFILE_ZONE_END("createVulkanAppRendering");
+    CHECK(renderer != NULL, "レンダリングオブジェクトの作成に失敗");
+
+    // シェーダのホットリロードを有効にする
+    if (options->hotReload) {
+        CHECK(enableShaderHotReload(renderer, "./shader"), "シェーダのホットリロードの有効化に失敗");
+    }
+
+    // メッシュのインスタンス描画を有効にする
+    //
+    // NOTE: 深度プリパスを有効にする前に行い、メッシュの深度プリパスも併せて行わせる。
+    if (options->meshInstances > 0) {
+        CHECK(
+            enableMeshInstances(core, renderer, APP_MESH_MODEL_PATH, options->meshInstances),
+            "メッシュのインスタンス描画の有効化に失敗"
+        );
+    }
+
+    // メッシュレットのカリングを有効にする
+    if (options->meshletCull) {
+        CHECK(options->meshInstances > 0, "--meshlet-cullには--instancesが必要");
+        CHECK(enableMeshletCulling(core, renderer), "メッシュレットのカリングの有効化に失敗");
+    }
+
+    // 深度プリパスを有効にする
+    if (options->depthPrepass) {
+        CHECK(enableDepthPrepass(core, renderer), "深度プリパスの有効化に失敗");
+    }
+
+    // パス毎の描画の仕事量の計測を有効にする
+    if (options->gpuStats) {
+        CHECK(enableDrawStats(core, renderer), "描画の仕事量の計測の有効化に失敗");
+    }
+
+    return renderer;
+
+#undef CHECK
+}
+
+int renderAndPresentFrame(
+    const VulkanAppCore core,
+    const VulkanAppPresentation presenter,
+    const VulkanAppRendering renderer,
+    FramePacer *pacer,
+    int *paced
+) {
+    // フレームの開始時刻まで待つ
+    //
+    // NOTE: 次のイメージの取得に失敗してやり直す場合に二重に待たないよう、イメージを取得するまで一度だけ待つ。
+    //       そうしなければ、やり直しのたびに待ち時間とフレーム数が数えられてしまう。
+    if (!*paced) {
+        PROFILE_ZONE_BEGIN("waitFramePacer");
+        waitFramePacer(pacer);
+        PROFILE_ZONE_END("waitFramePacer");
+        *paced = 1;
+    }
+
+    // 描画可能な次のイメージのインデックスを取得する
+    //
+    // NOTE: ゾーンの開始と終了の間でreturnしないよう、結果を変数に受けてから判定する。
+    PROFILE_ZONE_BEGIN("acquireNextImageIndex");
+    const int acquired = acquireNextImageIndex(core, presenter);
+    PROFILE_ZONE_END("acquireNextImageIndex");
+    if (!acquired) {
+        return 0;
+    }
+    *paced = 0;
+
+    // 描画する
+    const uint32_t waitSemaphoresCount = 1;
+    const VkSemaphore waitSemaphores[] = { presenter->waitForImageEnabledSemaphore };
+    const VkPipelineStageFlags waitDstStageMasks[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+    const uint32_t signalSemaphoresCount = 1;
+    const VkSemaphore signalSemaphores[] = { presenter->waitForRenderingSemaphore };
+    PROFILE_ZONE_BEGIN("render");
+    const int rendered = render(
+        core,
+        renderer,
+        presenter->imageIndex,
+        0,
+        0,
+        presenter->width,
+        presenter->height,
+        waitSemaphoresCount,
+        waitSemaphores,
+        waitDstStageMasks,
+        signalSemaphoresCount,
+        signalSemaphores
+    );
+    PROFILE_ZONE_END("render");
+    if (!rendered) {
+        return 0;
+    }
+
+    // プレゼンテーションを行う
+    PROFILE_ZONE_BEGIN("present");
+    const int presented = present(core, presenter);
+    PROFILE_ZONE_END("present");
+    return presented;
+}
+
+void printFramePacerStats(const FramePacer *pacer) {
+    if (pacer->intervalNs == 0) {
+        return;
+    }
+    printf(
+        "[ info ] frame-pacer: frames=%llu late=%llu 平均待ち時間=%.3fms\n",
+        (unsigned long long)pacer->framesCount,
+        (unsigned long long)pacer->lateFramesCount,
+        pacer->framesCount > 0 ? (double)pacer->totalWaitNs / (double)pacer->framesCount / 1000000.0 : 0.0
+    );
+}
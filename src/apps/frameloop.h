@@ -0,0 +1,82 @@
+/// @file frameloop.h
+/// @brief サーフェスへ表示するアプリケーションで共有するフレームの処理を定義するモジュール
+///
+/// ウィンドウシステム毎のモジュールはサーフェスの作成とイベントの処理のみを受け持ち、
+/// プレゼンテーションオブジェクト・レンダリングオブジェクトの作成とフレーム毎の取得・描画・表示はここで行う。
+
+#pragma once
+
+#include "../vulkan/core.h"
+#include "../vulkan/presentation.h"
+#include "../vulkan/rendering.h"
+#include "../vulkan/util/timer.h"
+#include "options.h"
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+/// @brief サーフェス向けのプレゼンテーションオブジェクトを作成する関数
+///
+/// コマンドラインオプションに応じてプレゼンテーションモードと描画先イメージの個数を決める。
+///
+/// @param core 主要オブジェクトハンドル
+/// @param surface サーフェス
+/// @param width サーフェスが大きさを決めない場合の描画先イメージの幅
+/// @param height サーフェスが大きさを決めない場合の描画先イメージの高
+/// @param options コマンドラインオプション
+/// @returns 失敗時にNULLを返す。
+VulkanAppPresentation createSurfacePresentation(
+    const VulkanAppCore core,
+    const VkSurfaceKHR surface,
+    uint32_t width,
+    uint32_t height,
+    const AppOptions *options
+);
+
+/// @brief サーフェス向けのレンダリングオブジェクトを作成する関数
+///
+/// スワップチェーンの描画先イメージに描画し、レンダーパスの最後にそのレイアウトをVK_IMAGE_LAYOUT_PRESENT_SRC_KHRとする。
+/// コマンドラインオプションに応じてシェーダのホットリロード・メッシュのインスタンス描画・メッシュレットのカリング・深度プリパス・
+/// 描画の仕事量の計測を有効にする。
+/// オフスクリーンと異なりパイプラインの作成の完了は待たず、作成中は代替のパイプラインで描画する。
+///
+/// @param core 主要オブジェクトハンドル
+/// @param presenter プレゼンテーションオブジェクトハンドル
+/// @param options コマンドラインオプション
+/// @returns 失敗時にNULLを返す。
+VulkanAppRendering createSurfaceRendering(const VulkanAppCore core, const VulkanAppPresentation presenter, const AppOptions *options);
+
+/// @brief 1フレームを描画して表示する関数
+///
+/// 次を順に行う。
+/// 1. フレームリミッタで次のフレームの開始時刻まで待つ (*pacedが0の場合のみ)
+/// 2. 描画可能な次の描画先イメージを取得する
+/// 3. そのイメージへ描画する (イメージの取得を待ち、描画の完了をシグナルする)
+/// 4. 描画の完了を待って表示する
+///
+/// イメージの取得に失敗してやり直す場合に二重に待たないよう、待ったら*pacedを1とし、イメージを取得したら0に戻す。
+/// 呼び出し側は*pacedを0で初期化し、呼び出しの間で保持すること。
+///
+/// スワップチェーンがサーフェスと合わなくなった場合もpresenter->outOfDateを1にして0を返す。
+/// 作り直しには対応しないため、呼び出し側はやり直さずにループを抜けること。
+///
+/// @param core 主要オブジェクトハンドル
+/// @param presenter プレゼンテーションオブジェクトハンドル
+/// @param renderer レンダリングオブジェクトハンドル
+/// @param pacer フレームリミッタ
+/// @param paced 現在のフレームでフレームリミッタを待ったか
+/// @returns いずれかに失敗した場合に0を返す。
+int renderAndPresentFrame(
+    const VulkanAppCore core,
+    const VulkanAppPresentation presenter,
+    const VulkanAppRendering renderer,
+    FramePacer *pacer,
+    int *paced
+);
+
+/// @brief フレームリミッタの統計を出力する関数
+///
+/// フレームを制限していなければ何も出力しない。
+///
+/// @param pacer フレームリミッタ
+void printFramePacerStats(const FramePacer *pacer);
@@ -0,0 +1,165 @@
+#include "headless.h"
+
+#include "../../vulkan/core.h"
+#include "../../vulkan/presentation.h"
+#include "../../vulkan/rendering.h"
+#include "../../vulkan/util/error.h"
+#include "../../vulkan/util/profiler.h"
+#include "../../vulkan/util/timer.h"
+#include "../frameloop.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vulkan/vulkan.h>
+
+// デバイスメモリの統計情報を出力する間隔(ms)
+#define MEMORY_STATS_DUMP_INTERVAL_MS 10000
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Vulkanアプリケーションのうちヘッドレスのサーフェスを持つ構造体
+typedef struct VulkanAppHeadless_t {
+    VkSurfaceKHR surface;
+} *VulkanAppHeadless;
+
+void deleteVulkanAppHeadless(const VulkanAppCore core, VulkanAppHeadless headless) {
+    if (headless == NULL) {
+        return;
+    }
+    vkDeviceWaitIdle(core->device);
+    if (headless->surface != NULL) vkDestroySurfaceKHR(core->instance, headless->surface, NULL);
+    free((void *)headless);
+}
+
+VulkanAppHeadless createVulkanAppHeadless(const VulkanAppCore core) {
+#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "createVulkanAppHeadless()", (m), (p), deleteVulkanAppHeadless(core, headless), NULL)
+#define CHECK(p, m)    ERROR_IF     (!(p),              "createVulkanAppHeadless()", (m),      deleteVulkanAppHeadless(core, headless), NULL)
+
+    const VulkanAppHeadless headless = (VulkanAppHeadless)malloc(sizeof(struct VulkanAppHeadless_t));
+    CHECK(headless != NULL, "VulkanAppHeadlessのメモリ確保に失敗");
+    memset(headless, 0, sizeof(struct VulkanAppHeadless_t));
+
+    // サーフェスを作成する
+    //
+    // NOTE: 拡張機能の関数はローダーが直接公開しているとは限らないため、インスタンスから取得する。
+    {
+        const PFN_vkCreateHeadlessSurfaceEXT createHeadlessSurface =
+            (PFN_vkCreateHeadlessSurfaceEXT)vkGetInstanceProcAddr(core->instance, "vkCreateHeadlessSurfaceEXT");
+        CHECK(createHeadlessSurface != NULL, "vkCreateHeadlessSurfaceEXT()関数の取得に失敗");
+        const VkHeadlessSurfaceCreateInfoEXT ci = {
+            VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT,
+            NULL,
+            0,
+        };
+        CHECK_VK(createHeadlessSurface(core->instance, &ci, NULL, &headless->surface), "サーフェスの作成に失敗");
+    }
+
+    return headless;
+
+#undef CHECK
+#undef CHECK_VK
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// ヘッドレス向けVulkanアプリケーションで必要なモジュールを持つ構造体
+typedef struct ModulesForHeadless_t {
+    VulkanAppCore core;
+    VulkanAppHeadless headless;
+    VulkanAppPresentation presenter;
+    VulkanAppRendering renderer;
+} ModulesForHeadless;
+
+void deleteModulesForHeadless(const ModulesForHeadless *mods) {
+    if (mods == NULL) {
+        return;
+    }
+    if (mods->renderer != NULL) deleteVulkanAppRendering(mods->core, mods->renderer);
+    if (mods->presenter != NULL) deleteVulkanAppPresentation(mods->core, mods->presenter);
+    if (mods->headless != NULL) deleteVulkanAppHeadless(mods->core, mods->headless);
+    if (mods->core != NULL) deleteVulkanAppCore(mods->core);
+}
+
+int runOnHeadless(int width, int height, const AppOptions *options) {
+#define CHECK(p, m) ERROR_IF(!(p), "runOnHeadless()", (m), deleteModulesForHeadless(&mods), 1)
+
+    ModulesForHeadless mods = {
+        NULL,
+        NULL,
+        NULL,
+        NULL,
+    };
+
+    // 主要オブジェクトを作成する
+    //
+    // NOTE: CIで性能を測るため、計測を大きく歪める検証レイヤーは有効にしない。
+    const uint32_t instLayerNamesCount = 0;
+    const char *instLayerNames[] = { "" };
+    const uint32_t instExtNamesCount = 2;
+    const char *instExtNames[] = { "VK_KHR_surface", "VK_EXT_headless_surface" };
+    const uint32_t devLayerNamesCount = 0;
+    const char *devLayerNames[] = { "" };
+    const uint32_t devExtNamesCount = 1;
+    const char *devExtNames[] = { "VK_KHR_swapchain" };
+    PROFILE_ZONE_BEGIN("createVulkanAppCore");
+    mods.core = createVulkanAppCore(
+        instLayerNamesCount,
+        instLayerNames,
+        instExtNamesCount,
+        instExtNames,
+        devLayerNamesCount,
+        devLayerNames,
+        devExtNamesCount,
+        devExtNames
+    );
+    PROFILE_ZONE_END("createVulkanAppCore");
+    CHECK(mods.core != NULL, "主要オブジェクトの作成に失敗");
+
+    // ヘッドレス依存オブジェクトを作成する
+    mods.headless = createVulkanAppHeadless(mods.core);
+    CHECK(mods.headless != NULL, "ヘッドレス依存オブジェクトの作成に失敗");
+
+    // プレゼンテーションオブジェクトを作成する
+    mods.presenter = createSurfacePresentation(mods.core, mods.headless->surface, (uint32_t)width, (uint32_t)height, options);
+    CHECK(mods.presenter != NULL, "プレゼンテーションオブジェクトの作成に失敗");
+
+    // レンダリングオブジェクトを作成する
+    mods.renderer = createSurfaceRendering(mods.core, mods.presenter, options);
+    CHECK(mods.renderer != NULL, "レンダリングオブジェクトの作成に失敗");
+
+    // フレームリミッタを初期化する
+    FramePacer pacer;
+    initFramePacer(&pacer, options->fpsLimit);
+
+    // メインループ
+    //
+    // NOTE: イベントを待つウィンドウが無いため、フレームの取得・描画・表示だけを繰り返す。
+    //       失敗を読み飛ばして繰り返すと終わらないことがあるため、一度でも失敗したら異常終了する。
+    const uint64_t framesCount = options->frames > 0 ? options->frames : APP_HEADLESS_DEFAULT_FRAMES;
+    const uint64_t startNs = getTimeNs();
+    int paced = 0;
+    for (uint64_t i = 0; i < framesCount; ++i) {
+        CHECK(renderAndPresentFrame(mods.core, mods.presenter, mods.renderer, &pacer, &paced), "フレームの描画と表示に失敗");
+        dumpMemoryStatsPeriodically(mods.core->allocator, MEMORY_STATS_DUMP_INTERVAL_MS);
+    }
+    vkDeviceWaitIdle(mods.core->device);
+    const double elapsedMs = (double)(getTimeNs() - startNs) / 1000000.0;
+
+    printf(
+        "[ info ] headless: frames=%llu 経過時間=%.3fms 平均フレーム時間=%.3fms\n",
+        (unsigned long long)framesCount,
+        elapsedMs,
+        elapsedMs / (double)framesCount
+    );
+    printFramePacerStats(&pacer);
+
+    deleteModulesForHeadless(&mods);
+    return 0;
+
+#undef CHECK
+}
@@ -0,0 +1,22 @@
+/// @file headless.h
+/// @brief ディスプレイを必要としないサーフェス(VK_EXT_headless_surface)へ表示するシステムを定義するモジュール
+
+#pragma once
+
+#include "../options.h"
+
+/// @brief VulkanアプリケーションをVK_EXT_headless_surfaceのサーフェスで実行するための関数
+///
+/// @details
+/// ウィンドウを持たないサーフェスにスワップチェーンを作り、ウィンドウへ表示する場合と同じく
+/// 次の描画先イメージの取得・描画・表示を繰り返す。表示された結果はどこにも映らない。
+/// ディスプレイの無い環境(CI等)で、スワップチェーンとフレームループの性能を測るために用いる。
+///
+/// options->framesのフレームを表示したら終了し、平均のフレーム時間を出力する。
+/// options->framesが0ならAPP_HEADLESS_DEFAULT_FRAMESとする。
+///
+/// @param width スクリーン幅 (サーフェスが大きさを決めないため、スワップチェーンの大きさとなる)
+/// @param height スクリーン高
+/// @param options コマンドラインオプション
+/// @returns 正常終了時に0を返す。
+int runOnHeadless(int width, int height, const AppOptions *options);
@@ -0,0 +1,302 @@
+#include "linux.h"
+
+// NOTE: build.shはxcbが無ければAPP_NO_XCBを定義し、この関数を対応していないものとしてビルドする。
+#if defined(__linux__) && !defined(APP_NO_XCB)
+
+// このマクロを<vulkan/vulkan.h>のinclude前に定義しないとxcbウィンドウに関するAPIが使えない。
+# define VK_USE_PLATFORM_XCB_KHR
+
+# include "../../vulkan/core.h"
+# include "../../vulkan/presentation.h"
+# include "../../vulkan/rendering.h"
+# include "../../vulkan/util/error.h"
+# include "../../vulkan/util/profiler.h"
+# include "../../vulkan/util/timer.h"
+# include "../frameloop.h"
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <vulkan/vulkan.h>
+# include <xcb/xcb.h>
+
+// デバイスメモリの統計情報を出力する間隔(ms)
+# define MEMORY_STATS_DUMP_INTERVAL_MS 10000
+
+// ウィンドウのタイトル
+# define WINDOW_TITLE "SampleVulkanJP"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// VulkanアプリケーションのうちLinux依存オブジェクトを持つ構造体
+typedef struct VulkanAppLinux_t {
+    xcb_connection_t *connection;
+    xcb_window_t window;
+    // ウィンドウが閉じられたことを通知するクライアントメッセージのアトム
+    xcb_atom_t deleteWindowAtom;
+    VkSurfaceKHR surface;
+} *VulkanAppLinux;
+
+void deleteVulkanAppLinux(const VulkanAppCore core, VulkanAppLinux app) {
+    if (app == NULL) {
+        return;
+    }
+    vkDeviceWaitIdle(core->device);
+    if (app->surface != NULL) vkDestroySurfaceKHR(core->instance, app->surface, NULL);
+    if (app->connection != NULL) {
+        if (app->window != 0) xcb_destroy_window(app->connection, app->window);
+        xcb_disconnect(app->connection);
+    }
+    free((void *)app);
+}
+
+// アトムを取得する関数
+//
+// NOTE: 取得に失敗した場合はXCB_ATOM_NONEを返す。
+static xcb_atom_t internAtom(xcb_connection_t *connection, const char *name) {
+    const xcb_intern_atom_cookie_t cookie = xcb_intern_atom(connection, 0, (uint16_t)strlen(name), name);
+    xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(connection, cookie, NULL);
+    if (reply == NULL) {
+        return XCB_ATOM_NONE;
+    }
+    const xcb_atom_t atom = reply->atom;
+    free(reply);
+    return atom;
+}
+
+VulkanAppLinux createVulkanAppLinux(const VulkanAppCore core, int width, int height) {
+# define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "createVulkanAppLinux()", (m), (p), deleteVulkanAppLinux(core, app), NULL)
+# define CHECK(p, m)    ERROR_IF     (!(p),              "createVulkanAppLinux()", (m),      deleteVulkanAppLinux(core, app), NULL)
+
+    const VulkanAppLinux app = (VulkanAppLinux)malloc(sizeof(struct VulkanAppLinux_t));
+    CHECK(app != NULL, "VulkanAppLinuxのメモリ確保に失敗");
+    memset(app, 0, sizeof(struct VulkanAppLinux_t));
+
+    // Xサーバに接続する
+    //
+    // NOTE: 接続先はDISPLAY環境変数で決まる。
+    //       xcb_connect()関数は失敗してもNULLでなくエラー状態の接続を返すため、破棄のために保持してから確認する。
+    int screenNumber = 0;
+    {
+        app->connection = xcb_connect(NULL, &screenNumber);
+        CHECK(xcb_connection_has_error(app->connection) == 0, "Xサーバへの接続に失敗");
+    }
+
+    // ウィンドウを作成する
+    //
+    // NOTE: ウィンドウマネージャからウィンドウを閉じる要求を受け取るため、WM_PROTOCOLSにWM_DELETE_WINDOWを登録する。
+    {
+        xcb_screen_iterator_t iter = xcb_setup_roots_iterator(xcb_get_setup(app->connection));
+        for (int i = 0; i < screenNumber && iter.rem > 0; ++i) {
+            xcb_screen_next(&iter);
+        }
+        CHECK(iter.rem > 0, "スクリーンの取得に失敗");
+        const xcb_screen_t *screen = iter.data;
+
+        app->window = xcb_generate_id(app->connection);
+        const uint32_t valueMask = XCB_CW_EVENT_MASK;
+        const uint32_t values[] = { XCB_EVENT_MASK_STRUCTURE_NOTIFY };
+        xcb_create_window(
+            app->connection,
+            XCB_COPY_FROM_PARENT,
+            app->window,
+            screen->root,
+            0,
+            0,
+            (uint16_t)width,
+            (uint16_t)height,
+            0,
+            XCB_WINDOW_CLASS_INPUT_OUTPUT,
+            screen->root_visual,
+            valueMask,
+            values
+        );
+
+        const xcb_atom_t protocolsAtom = internAtom(app->connection, "WM_PROTOCOLS");
+        app->deleteWindowAtom = internAtom(app->connection, "WM_DELETE_WINDOW");
+        CHECK(protocolsAtom != XCB_ATOM_NONE && app->deleteWindowAtom != XCB_ATOM_NONE, "アトムの取得に失敗");
+        xcb_change_property(
+            app->connection,
+            XCB_PROP_MODE_REPLACE,
+            app->window,
+            protocolsAtom,
+            XCB_ATOM_ATOM,
+            32,
+            1,
+            &app->deleteWindowAtom
+        );
+        xcb_change_property(
+            app->connection,
+            XCB_PROP_MODE_REPLACE,
+            app->window,
+            XCB_ATOM_WM_NAME,
+            XCB_ATOM_STRING,
+            8,
+            (uint32_t)strlen(WINDOW_TITLE),
+            WINDOW_TITLE
+        );
+
+        xcb_map_window(app->connection, app->window);
+        CHECK(xcb_flush(app->connection) > 0, "ウィンドウの表示に失敗");
+    }
+
+    // サーフェスを作成する
+    {
+        const VkXcbSurfaceCreateInfoKHR ci = {
+            VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR,
+            NULL,
+            0,
+            app->connection,
+            app->window,
+        };
+        CHECK_VK(vkCreateXcbSurfaceKHR(core->instance, &ci, NULL, &app->surface), "サーフェスの作成に失敗");
+    }
+
+    return app;
+
+# undef CHECK
+# undef CHECK_VK
+}
+
+// ウィンドウのイベントを処理する関数
+//
+// NOTE: 溜まっているイベントを全て処理し、ウィンドウが閉じられたか接続が切れたら0を返す。
+static int processLinuxEvents(const VulkanAppLinux app) {
+    int running = 1;
+    xcb_generic_event_t *event = NULL;
+    while ((event = xcb_poll_for_event(app->connection)) != NULL) {
+        // NOTE: 最上位ビットはイベントがSendEventで送られたかを表すため除く。
+        if ((event->response_type & 0x7f) == XCB_CLIENT_MESSAGE) {
+            const xcb_client_message_event_t *message = (const xcb_client_message_event_t *)event;
+            if (message->data.data32[0] == app->deleteWindowAtom) {
+                running = 0;
+            }
+        }
+        free(event);
+    }
+    if (xcb_connection_has_error(app->connection) != 0) {
+        running = 0;
+    }
+    return running;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Linux向けVulkanアプリケーションで必要なモジュールを持つ構造体
+typedef struct ModulesForLinux_t {
+    VulkanAppCore core;
+    VulkanAppLinux app;
+    VulkanAppPresentation presenter;
+    VulkanAppRendering renderer;
+} ModulesForLinux;
+
+void deleteModulesForLinux(const ModulesForLinux *mods) {
+    if (mods == NULL) {
+        return;
+    }
+    if (mods->renderer != NULL) deleteVulkanAppRendering(mods->core, mods->renderer);
+    if (mods->presenter != NULL) deleteVulkanAppPresentation(mods->core, mods->presenter);
+    if (mods->app != NULL) deleteVulkanAppLinux(mods->core, mods->app);
+    if (mods->core != NULL) deleteVulkanAppCore(mods->core);
+}
+
+int runOnLinux(int width, int height, const AppOptions *options) {
+# define CHECK(p, m) ERROR_IF(!(p), "runOnLinux()", (m), deleteModulesForLinux(&mods), 1)
+
+    ModulesForLinux mods = {
+        NULL,
+        NULL,
+        NULL,
+        NULL,
+    };
+
+    // 主要オブジェクトを作成する
+    const uint32_t instLayerNamesCount = 1;
+    const char *instLayerNames[] = { "VK_LAYER_KHRONOS_validation" };
+    const uint32_t instExtNamesCount = 2;
+    const char *instExtNames[] = { "VK_KHR_surface", "VK_KHR_xcb_surface" };
+    const uint32_t devLayerNamesCount = 0;
+    const char *devLayerNames[] = { "" };
+    const uint32_t devExtNamesCount = 1;
+    const char *devExtNames[] = { "VK_KHR_swapchain" };
+    PROFILE_ZONE_BEGIN("createVulkanAppCore");
+    mods.core = createVulkanAppCore(
+        instLayerNamesCount,
+        instLayerNames,
+        instExtNamesCount,
+        instExtNames,
+        devLayerNamesCount,
+        devLayerNames,
+        devExtNamesCount,
+        devExtNames
+    );
+    PROFILE_ZONE_END("createVulkanAppCore");
+    CHECK(mods.core != NULL, "主要オブジェクトの作成に失敗");
+
+    // Linux依存オブジェクトを作成する
+    mods.app = createVulkanAppLinux(mods.core, width, height);
+    CHECK(mods.app != NULL, "Linux依存オブジェクトの作成に失敗");
+
+    // プレゼンテーションオブジェクトを作成する
+    mods.presenter = createSurfacePresentation(mods.core, mods.app->surface, (uint32_t)width, (uint32_t)height, options);
+    CHECK(mods.presenter != NULL, "プレゼンテーションオブジェクトの作成に失敗");
+
+    // レンダリングオブジェクトを作成する
+    mods.renderer = createSurfaceRendering(mods.core, mods.presenter, options);
+    CHECK(mods.renderer != NULL, "レンダリングオブジェクトの作成に失敗");
+
+    // フレームリミッタを初期化する
+    FramePacer pacer;
+    initFramePacer(&pacer, options->fpsLimit);
+
+    // メインループ
+    //
+    // NOTE: --framesが与えられれば、その数のフレームを表示したら終了する。
+    uint64_t framesCount = 0;
+    int paced = 0;
+    while (options->frames == 0 || framesCount < options->frames) {
+        // ウィンドウのイベントを処理する
+        if (!processLinuxEvents(mods.app)) {
+            break;
+        }
+        // 描画して表示する
+        //
+        // NOTE: スワップチェーンが使えなくなったら、作り直しには対応しないため終了する。
+        if (!renderAndPresentFrame(mods.core, mods.presenter, mods.renderer, &pacer, &paced)) {
+            if (mods.presenter->outOfDate) {
+                printf("[ info ] スワップチェーンがサーフェスと合わなくなったため終了\n");
+                break;
+            }
+            continue;
+        }
+        framesCount += 1;
+        // デバイスメモリの統計情報を定期的に出力する
+        dumpMemoryStatsPeriodically(mods.core->allocator, MEMORY_STATS_DUMP_INTERVAL_MS);
+    }
+
+    printFramePacerStats(&pacer);
+
+    deleteModulesForLinux(&mods);
+    return 0;
+
+# undef CHECK
+}
+
+#else
+
+# include <stdio.h>
+
+// NOTE: MSVCの/W4 /WXでは未使用の引数が警告(エラー)となるため、明示的に捨てる。
+int runOnLinux(int width, int height, const AppOptions *options) {
+    (void)width;
+    (void)height;
+    (void)options;
+    printf("[ info ] runOnLinux(): Linux向けに対応していないか、xcb無しでビルドされています\n");
+    return 1;
+}
+
+#endif
@@ -0,0 +1,19 @@
+/// @file linux.h
+/// @brief Linux向けのシステムを定義するモジュール
+
+#pragma once
+
+#include "../options.h"
+
+/// @brief VulkanアプリケーションをX11ウィンドウ(xcb)で実行するための関数
+///
+/// @details
+/// 指定されたスクリーンサイズを持つウィンドウを表示し、そこへレンダリングする。
+/// レンダリングはウィンドウが閉じられるまで(options->framesが与えられればそのフレーム数まで)行われる。
+/// Waylandのセッションでは、XWaylandを介して表示される。
+///
+/// @param width スクリーン幅
+/// @param height スクリーン高
+/// @param options コマンドラインオプション
+/// @returns 正常終了時に0を返す。
+int runOnLinux(int width, int height, const AppOptions *options);
@@ -0,0 +1,486 @@
+#include "batch.h"
+
+// snprintf()関数の使用に対してwarningを出さないためにこのマクロを定義する
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "../../vulkan/core.h"
+#include "../../vulkan/rendering.h"
+#include "../../vulkan/util/error.h"
+#include "../../vulkan/util/memory/buffer.h"
+#include "../../vulkan/util/profiler.h"
+#include "../../vulkan/util/thread.h"
+#include "../../vulkan/util/timer.h"
+#include "offscreen.h"
+#include "png.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vulkan/vulkan.h>
+
+// 書き出すファイルのパスの最大長 (一時ファイルの拡張子を含まない)
+#define BATCH_PATH_SIZE 128
+
+// 一時ファイルの拡張子
+#define BATCH_TEMPORARY_SUFFIX ".tmp"
+
+// 一時ファイルのパスも入る、パスの格納先の大きさ
+#define BATCH_OUTPUT_PATH_SIZE (BATCH_PATH_SIZE + sizeof(BATCH_TEMPORARY_SUFFIX) - 1)
+
+// 一つのフレームの読み戻し先
+typedef struct BatchReadbackSlot_t {
+    Buffer buffer;
+    const uint8_t *mapped;
+    // コピーが完了したらシグナルされるフェンス
+    VkFence fence;
+    // コピーを提出し、まだ符号化していなければ1
+    int pending;
+    uint32_t frame;
+} BatchReadbackSlot;
+
+struct BatchJob_t;
+
+// 一つの物理デバイスを受け持つワーカー
+//
+// NOTE: キューは等差数列(queueFirstから公差queueStrideでqueueCount個)で表す。
+//       初めはワーカーの番号から始まり公差がワーカー数の数列とし、全てのワーカーが先頭のフレームから順に進むようにする。
+//       盗む側は数列の後ろ半分を取るため、盗んだ後も等差数列のままである。
+typedef struct BatchWorker_t {
+    struct BatchJob_t *job;
+    uint32_t index;
+    VulkanAppCore core;
+    VulkanAppOffscreen offscreen;
+    VulkanAppRendering renderer;
+    BatchReadbackSlot slots[BATCH_READBACK_SLOTS_COUNT];
+    Mutex queueMutex;
+    uint32_t queueFirst;
+    uint32_t queueCount;
+    uint32_t queueStride;
+    Thread thread;
+    // 描画したフレーム数と、他のワーカーから盗んだ回数
+    uint32_t framesCount;
+    uint32_t stealsCount;
+} BatchWorker;
+
+// バッチ処理全体
+typedef struct BatchJob_t {
+    uint32_t framesCount;
+    uint32_t workersCount;
+    BatchWorker workers[BATCH_MAX_WORKERS];
+    // 以下はcommitMutexで保護する
+    Mutex commitMutex;
+    // フレーム毎の書き出しが終わったか
+    uint8_t *written;
+    // 名前を変えて公開したフレーム数 (先頭からこの数のフレームが公開済み)
+    uint32_t committedCount;
+    // いずれかのワーカーが失敗したか
+    int failed;
+} BatchJob;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// フレームの書き出し先のパスを求める関数
+//
+// NOTE: 格納先はBATCH_OUTPUT_PATH_SIZEバイトとし、一時ファイルの拡張子を付けても切り詰められないようにする。
+static void getBatchOutputPath(char path[BATCH_OUTPUT_PATH_SIZE], uint32_t frame, int temporary) {
+    char name[BATCH_PATH_SIZE];
+    snprintf(name, BATCH_PATH_SIZE, APP_BATCH_OUTPUT_FORMAT, frame);
+    snprintf(path, BATCH_OUTPUT_PATH_SIZE, "%s%s", name, temporary ? BATCH_TEMPORARY_SUFFIX : "");
+}
+
+static void failBatchJob(BatchJob *job) {
+    lockMutex(job->commitMutex);
+    job->failed = 1;
+    unlockMutex(job->commitMutex);
+}
+
+static int isBatchJobFailed(BatchJob *job) {
+    lockMutex(job->commitMutex);
+    const int failed = job->failed;
+    unlockMutex(job->commitMutex);
+    return failed;
+}
+
+// フレームの書き出しの完了を記録し、先頭から続く書き出し済みのフレームを公開する関数
+//
+// NOTE: 公開は一時ファイルの名前を変えるだけであるため、ロックしたまま行っても他のワーカーを殆ど待たせない。
+static int commitBatchFrame(BatchJob *job, uint32_t frame) {
+    int succeeded = 1;
+    lockMutex(job->commitMutex);
+    job->written[frame] = 1;
+    while (job->committedCount < job->framesCount && job->written[job->committedCount]) {
+        char temporaryPath[BATCH_OUTPUT_PATH_SIZE];
+        char path[BATCH_OUTPUT_PATH_SIZE];
+        getBatchOutputPath(temporaryPath, job->committedCount, 1);
+        getBatchOutputPath(path, job->committedCount, 0);
+        // NOTE: Windowsのrename()関数は変更先が既にあると失敗するため、先に消しておく。
+        remove(path);
+        if (rename(temporaryPath, path) != 0) {
+            job->failed = 1;
+            succeeded = 0;
+            break;
+        }
+        job->committedCount += 1;
+    }
+    unlockMutex(job->commitMutex);
+    return succeeded;
+}
+
+// 次に描画するフレームを取り出す関数
+//
+// NOTE: 自身のキューが空ならば、残りが最も多いワーカーのキューの後ろ半分を盗む。
+//       二つのミューテックスを同時にロックしないため、デッドロックしない。
+//       盗む相手を選んでからロックするまでに相手のキューが減ることがあるため、ロックしてから数え直す。
+static int takeBatchFrame(BatchWorker *worker, uint32_t *frame) {
+    BatchJob *job = worker->job;
+    while (!isBatchJobFailed(job)) {
+        // 自身のキューの先頭から取り出す
+        lockMutex(worker->queueMutex);
+        if (worker->queueCount > 0) {
+            *frame = worker->queueFirst;
+            worker->queueFirst += worker->queueStride;
+            worker->queueCount -= 1;
+            unlockMutex(worker->queueMutex);
+            return 1;
+        }
+        unlockMutex(worker->queueMutex);
+
+        // 盗む相手を選ぶ
+        BatchWorker *victim = NULL;
+        uint32_t victimCount = 0;
+        for (uint32_t i = 0; i < job->workersCount; ++i) {
+            BatchWorker *other = &job->workers[i];
+            if (other == worker) {
+                continue;
+            }
+            lockMutex(other->queueMutex);
+            const uint32_t count = other->queueCount;
+            unlockMutex(other->queueMutex);
+            if (count > victimCount) {
+                victim = other;
+                victimCount = count;
+            }
+        }
+        if (victim == NULL) {
+            return 0;
+        }
+
+        // 後ろ半分を盗む
+        uint32_t first = 0;
+        uint32_t count = 0;
+        uint32_t stride = 1;
+        lockMutex(victim->queueMutex);
+        if (victim->queueCount > 0) {
+            count = (victim->queueCount + 1) / 2;
+            victim->queueCount -= count;
+            first = victim->queueFirst + victim->queueCount * victim->queueStride;
+            stride = victim->queueStride;
+        }
+        unlockMutex(victim->queueMutex);
+        if (count == 0) {
+            continue;
+        }
+        lockMutex(worker->queueMutex);
+        worker->queueFirst = first;
+        worker->queueCount = count;
+        worker->queueStride = stride;
+        worker->stealsCount += 1;
+        unlockMutex(worker->queueMutex);
+    }
+    return 0;
+}
+
+// フレームのコピーの完了を待ち、一時バッファから一行ずつPNGへ符号化して公開する関数
+static int consumeBatchReadbackSlot(BatchWorker *worker, BatchReadbackSlot *slot) {
+#define CHECK(p, m) ERROR_IF(!(p), "consumeBatchReadbackSlot()", (m), deletePngWriter(writer), 0)
+
+    PngWriter writer = NULL;
+    const VulkanAppCore core = worker->core;
+    const uint32_t width = worker->offscreen->image->extent.width;
+    const uint32_t height = worker->offscreen->image->extent.height;
+    slot->pending = 0;
+
+    // コピーの完了を待ち、デバイスの書き込みをホストから見えるようにする
+    {
+        PROFILE_ZONE_BEGIN("vkWaitForFences");
+        const VkResult waited = vkWaitForFences(core->device, 1, &slot->fence, VK_TRUE, UINT64_MAX);
+        PROFILE_ZONE_END("vkWaitForFences");
+        CHECK(waited == VK_SUCCESS, "フェンスの待機に失敗");
+        CHECK(
+            invalidateMappedDeviceMemory(core->device, core->allocator, slot->buffer->devMemory, slot->buffer->memTypeIndex),
+            "一時バッファの無効化に失敗"
+        );
+    }
+
+    // 一時ファイルへ書き出す
+    {
+        PROFILE_ZONE_BEGIN("writePngRow");
+        char path[BATCH_OUTPUT_PATH_SIZE];
+        getBatchOutputPath(path, slot->frame, 1);
+        const VulkanAppOffscreen offscreen = worker->offscreen;
+        const size_t rowSize = (size_t)width * offscreen->readbackPixelSize;
+        writer = createPngWriter(path, width, height, offscreen->readbackChannels);
+        int written = writer != NULL;
+        for (uint32_t y = 0; y < height && written; ++y) {
+            written = writePngRow(writer, slot->mapped + (size_t)y * rowSize, offscreen->readbackLayout);
+        }
+        written = written && finishPngWriter(writer);
+        PROFILE_ZONE_END("writePngRow");
+        CHECK(written, "フレームの書き出しに失敗");
+        deletePngWriter(writer);
+        writer = NULL;
+    }
+
+    // 公開する
+    {
+        CHECK(commitBatchFrame(worker->job, slot->frame), "フレームの公開に失敗");
+    }
+
+    return 1;
+
+#undef CHECK
+}
+
+// ワーカーのスレッドで実行する関数
+//
+// NOTE: 一時バッファを交互に使い、あるフレームを符号化している間に次のフレームをデバイスで描画・読み戻す。
+static void runBatchWorker(void *arg) {
+    BatchWorker *worker = (BatchWorker *)arg;
+    BatchJob *job = worker->job;
+    const VulkanAppCore core = worker->core;
+    const uint32_t width = worker->offscreen->image->extent.width;
+    const uint32_t height = worker->offscreen->image->extent.height;
+
+    uint32_t slotIndex = 0;
+    for (;;) {
+        uint32_t frame = 0;
+        const int taken = takeBatchFrame(worker, &frame);
+
+        // 一時バッファを使い回す前に、前回のフレームを符号化する
+        BatchReadbackSlot *slot = &worker->slots[slotIndex];
+        if (slot->pending && !consumeBatchReadbackSlot(worker, slot)) {
+            failBatchJob(job);
+            break;
+        }
+        if (!taken) {
+            break;
+        }
+
+        // 描画し、一時バッファへのコピーを提出する
+        setRenderingSceneFrame(worker->renderer, frame);
+        if (
+            !render(core, worker->renderer, 0, 0, 0, width, height, 0, NULL, NULL, 0, NULL)
+            || vkResetFences(core->device, 1, &slot->fence) != VK_SUCCESS
+            || !submitReadbackCopy(core, worker->offscreen, slot->buffer->buffer, width, height, slot->fence)
+        ) {
+            printf("[ error ] runBatchWorker(): フレームの描画に失敗: worker=%u frame=%u\n", worker->index, frame);
+            failBatchJob(job);
+            break;
+        }
+        slot->pending = 1;
+        slot->frame = frame;
+        worker->framesCount += 1;
+        slotIndex = (slotIndex + 1) % BATCH_READBACK_SLOTS_COUNT;
+    }
+
+    // 残りの一時バッファを古い順に符号化する
+    for (uint32_t i = 0; i < BATCH_READBACK_SLOTS_COUNT; ++i) {
+        BatchReadbackSlot *slot = &worker->slots[(slotIndex + i) % BATCH_READBACK_SLOTS_COUNT];
+        if (slot->pending && !isBatchJobFailed(job) && !consumeBatchReadbackSlot(worker, slot)) {
+            failBatchJob(job);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void deleteBatchWorker(BatchWorker *worker) {
+    const VulkanAppCore core = worker->core;
+    if (core != NULL) {
+        vkDeviceWaitIdle(core->device);
+        for (uint32_t i = 0; i < BATCH_READBACK_SLOTS_COUNT; ++i) {
+            BatchReadbackSlot *slot = &worker->slots[i];
+            if (slot->mapped != NULL) vkUnmapMemory(core->device, slot->buffer->devMemory);
+            if (slot->buffer != NULL) deleteBuffer(core->device, slot->buffer);
+            if (slot->fence != NULL) vkDestroyFence(core->device, slot->fence, NULL);
+        }
+        if (worker->renderer != NULL) deleteVulkanAppRendering(core, worker->renderer);
+        if (worker->offscreen != NULL) deleteVulkanAppOffscreen(core, worker->offscreen);
+        deleteVulkanAppCore(core);
+    }
+    if (worker->queueMutex != NULL) deleteMutex(worker->queueMutex);
+    memset(worker, 0, sizeof(BatchWorker));
+}
+
+// ワーカーのオブジェクトを作成する関数
+//
+// NOTE: Vulkanのオブジェクトは全てワーカー毎に作るため、ワーカーのスレッド同士で共有するものは無い。
+static int createBatchWorker(BatchWorker *worker, uint32_t physDeviceIndex, int width, int height, const AppOptions *options) {
+#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "createBatchWorker()", (m), (p), {}, 0)
+#define CHECK(p, m)    ERROR_IF     (!(p),              "createBatchWorker()", (m),      {}, 0)
+
+    // 主要オブジェクトを作成する
+    {
+        const uint32_t instLayerNamesCount = 1;
+        const char *instLayerNames[] = { "VK_LAYER_KHRONOS_validation" };
+        worker->core = createVulkanAppCoreOnDevice(physDeviceIndex, instLayerNamesCount, instLayerNames, 0, NULL, 0, NULL, 0, NULL);
+        CHECK(worker->core != NULL, "主要オブジェクトの作成に失敗");
+    }
+
+    // 描画先イメージとレンダリングオブジェクトを作成する
+    {
+        worker->offscreen = createVulkanAppOffscreen(worker->core, width, height, options->readbackRgb);
+        CHECK(worker->offscreen != NULL, "オフスクリーン依存オブジェクトの作成に失敗");
+        worker->renderer = createOffscreenRendering(worker->core, worker->offscreen, options);
+        CHECK(worker->renderer != NULL, "レンダリングオブジェクトの作成に失敗");
+    }
+
+    // 一時バッファとフェンスを作成し、一時バッファをマップする
+    for (uint32_t i = 0; i < BATCH_READBACK_SLOTS_COUNT; ++i) {
+        const VulkanAppCore core = worker->core;
+        BatchReadbackSlot *slot = &worker->slots[i];
+        slot->buffer = createBuffer(
+            core->device,
+            core->allocator,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            MEMORY_USAGE_READBACK,
+            getReadbackBufferSize(worker->offscreen, width, height)
+        );
+        CHECK(slot->buffer != NULL, "一時バッファの作成に失敗");
+        void *mappedData;
+        CHECK_VK(vkMapMemory(core->device, slot->buffer->devMemory, 0, slot->buffer->memReqs.size, 0, &mappedData), "マップに失敗");
+        slot->mapped = (const uint8_t *)mappedData;
+        const VkFenceCreateInfo ci = {
+            VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+            NULL,
+            0,
+        };
+        CHECK_VK(vkCreateFence(core->device, &ci, NULL, &slot->fence), "フェンスの作成に失敗");
+    }
+
+    // キューのミューテックスを作成する
+    {
+        worker->queueMutex = createMutex();
+        CHECK(worker->queueMutex != NULL, "ミューテックスの作成に失敗");
+    }
+
+    return 1;
+
+#undef CHECK
+#undef CHECK_VK
+}
+
+static void deleteBatchJob(BatchJob *job) {
+    for (uint32_t i = 0; i < job->workersCount; ++i) {
+        deleteBatchWorker(&job->workers[i]);
+    }
+    // 公開されなかったフレームの一時ファイルを消す
+    //
+    // NOTE: 書き出しの途中で失敗したものも残らないよう、書き出しの完了を問わず消す。
+    //       ワーカーのスレッドは終了しており、PNGの書き出しオブジェクトも失敗時に閉じられているため、開いたままのものは無い。
+    for (uint32_t i = job->committedCount; i < job->framesCount; ++i) {
+        char temporaryPath[BATCH_OUTPUT_PATH_SIZE];
+        getBatchOutputPath(temporaryPath, i, 1);
+        remove(temporaryPath);
+    }
+    if (job->written != NULL) free((void *)job->written);
+    if (job->commitMutex != NULL) deleteMutex(job->commitMutex);
+}
+
+int runOffscreenBatch(int width, int height, const AppOptions *options) {
+#define CHECK(p, m) ERROR_IF(!(p), "runOffscreenBatch()", (m), deleteBatchJob(&job), 1)
+
+    BatchJob job;
+    memset(&job, 0, sizeof(BatchJob));
+    job.framesCount = options->batchFrames;
+
+    // 共有する状態を作成する
+    {
+        job.commitMutex = createMutex();
+        CHECK(job.commitMutex != NULL, "ミューテックスの作成に失敗");
+        job.written = (uint8_t *)calloc(job.framesCount, sizeof(uint8_t));
+        CHECK(job.written != NULL, "フレーム毎の書き出しの状態の確保に失敗");
+    }
+
+    // ワーカーを作成する
+    //
+    // NOTE: 物理デバイスの数は最初のワーカーの主要オブジェクトを作成するまで分からない。
+    {
+        PROFILE_ZONE_BEGIN("createBatchWorker");
+        job.workersCount = 1;
+        job.workers[0].job = &job;
+        const int created = createBatchWorker(&job.workers[0], 0, width, height, options);
+        PROFILE_ZONE_END("createBatchWorker");
+        CHECK(created, "ワーカーの作成に失敗");
+
+        const uint32_t physDevicesCount = job.workers[0].core->physDevicesCount;
+        uint32_t workersCount = options->batchDevices > 0 ? options->batchDevices : physDevicesCount;
+        workersCount = workersCount < BATCH_MAX_WORKERS ? workersCount : BATCH_MAX_WORKERS;
+        workersCount = workersCount < job.framesCount ? workersCount : job.framesCount;
+        for (uint32_t i = 1; i < workersCount; ++i) {
+            PROFILE_ZONE_BEGIN("createBatchWorker");
+            job.workersCount = i + 1;
+            job.workers[i].job = &job;
+            job.workers[i].index = i;
+            const int workerCreated = createBatchWorker(&job.workers[i], i % physDevicesCount, width, height, options);
+            PROFILE_ZONE_END("createBatchWorker");
+            CHECK(workerCreated, "ワーカーの作成に失敗");
+        }
+        for (uint32_t i = 0; i < job.workersCount; ++i) {
+            BatchWorker *worker = &job.workers[i];
+            worker->queueFirst = i;
+            worker->queueCount = (job.framesCount - i + job.workersCount - 1) / job.workersCount;
+            worker->queueStride = job.workersCount;
+            printf(
+                "[ info ] runOffscreenBatch(): worker=%u device=%u:%s\n",
+                i,
+                worker->core->physDeviceIndex,
+                worker->core->physDevProps.deviceName
+            );
+        }
+    }
+
+    // ワーカーのスレッドを開始し、全て終わるまで待機する
+    //
+    // NOTE: スレッドの作成に失敗した場合も、作成済みのスレッドは最後まで実行させてから待機する。
+    const uint64_t startNs = getTimeNs();
+    {
+        int started = 1;
+        for (uint32_t i = 0; i < job.workersCount && started; ++i) {
+            job.workers[i].thread = createThread(runBatchWorker, (void *)&job.workers[i]);
+            started = job.workers[i].thread != NULL;
+        }
+        if (!started) failBatchJob(&job);
+        for (uint32_t i = 0; i < job.workersCount; ++i) {
+            if (job.workers[i].thread != NULL) joinThread(job.workers[i].thread);
+            job.workers[i].thread = NULL;
+        }
+        CHECK(started, "ワーカーのスレッドの作成に失敗");
+        CHECK(!job.failed && job.committedCount == job.framesCount, "バッチ処理に失敗");
+    }
+    const double elapsedMs = (double)(getTimeNs() - startNs) / 1000000.0;
+
+    // 結果を出力する
+    {
+        for (uint32_t i = 0; i < job.workersCount; ++i) {
+            const BatchWorker *worker = &job.workers[i];
+            printf("[ info ] runOffscreenBatch(): worker=%u frames=%u steals=%u\n", i, worker->framesCount, worker->stealsCount);
+        }
+        printf(
+            "[ info ] runOffscreenBatch(): frames=%u workers=%u elapsed=%.1fms throughput=%.2fframes/s\n",
+            job.framesCount,
+            job.workersCount,
+            elapsedMs,
+            elapsedMs > 0.0 ? (double)job.framesCount * 1000.0 / elapsedMs : 0.0
+        );
+    }
+
+    deleteBatchJob(&job);
+    return 0;
+
+#undef CHECK
+}
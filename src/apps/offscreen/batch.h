@@ -0,0 +1,34 @@
+/// @file batch.h
+/// @brief 複数の物理デバイスでフレームを分担して描画するオフスクリーンのバッチ処理を定義するモジュール
+
+#pragma once
+
+#include "../options.h"
+
+/// @brief バッチ処理で同時に使うワーカーの最大数
+#define BATCH_MAX_WORKERS 16
+
+/// @brief ワーカー毎の読み戻し用の一時バッファの数
+///
+/// NOTE: 一つを符号化している間に、次のフレームの描画と読み戻しを進められる。
+#define BATCH_READBACK_SLOTS_COUNT 2
+
+/// @brief 複数のフレームをオフスクリーンで描画し、フレーム毎のPNGとして書き出す関数
+///
+/// ワーカー毎に主要オブジェクト・描画先イメージ・レンダリングオブジェクト・読み戻し用の一時バッファを作り、
+/// ワーカー毎のスレッドで次を繰り返す。
+/// 1. 自身のキューからフレームを取り出す。空なら、残りが最も多いワーカーのキューの後ろ半分を盗む
+/// 2. シーンの時刻をそのフレームに固定して描画し、一時バッファへのコピーを提出する
+/// 3. 前に提出したフレームのコピーを待ち、一時バッファから一行ずつPNGへ符号化する
+///
+/// フレームは一時ファイルへ書き出し、それより前のフレームが全て書き出されてからAPP_BATCH_OUTPUT_FORMATの名前に変える。
+/// そのため、出力はどのワーカーが描画したかに依らずフレームの順に現れる。
+///
+/// ワーカー数はoptions->batchDevicesで与え、0なら物理デバイスの数とする。
+/// ワーカーi番は物理デバイスi % 物理デバイス数番を使うため、物理デバイスが一つでも複数のワーカーを試せる。
+///
+/// @param width スクリーン幅
+/// @param height スクリーン高
+/// @param options コマンドラインオプション (batchFramesが1以上であること)
+/// @returns 正常終了時に0を返す。
+int runOffscreenBatch(int width, int height, const AppOptions *options);
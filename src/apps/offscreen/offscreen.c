@@ -13,54 +13,89 @@
 #include "../../vulkan/util/error.h"
 #include "../../vulkan/util/memory/buffer.h"
 #include "../../vulkan/util/memory/image.h"
+#include "../../vulkan/util/profiler.h"
+#include "batch.h"
+#include "png.h"
 #include "stb_image.h"
 #include "stb_image_write.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <vulkan/vulkan.h>
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-// Vulkanアプリケーションのうちオフスクリーンでのオブジェクトを持つ構造体
-typedef struct VulkanAppOffscreen_t {
-    Image image;
-    VkImageView imageView;
-} *VulkanAppOffscreen;
+// メモリ逼迫時に読み戻しのレンダーグラフを破棄するコールバック関数
+//
+// NOTE: グラフの一時イメージは次の読み戻しで作り直せるため、キャッシュとみなして手放す。
+//       コピーが実行中かもしれないため、デバイスの完了を待ってから破棄する。
+//       逼迫しているヒープにグラフのメモリが無ければ何もしない。
+static VkDeviceSize releaseReadbackGraphUnderPressure(void *userData, uint32_t heapIndex, VkDeviceSize requiredSize) {
+    (void)requiredSize;
+    const VulkanAppOffscreen offscreen = (VulkanAppOffscreen)userData;
+    const RenderGraph graph = offscreen->readbackGraph;
+    if (graph == NULL) {
+        return 0;
+    }
+    VkDeviceSize released = 0;
+    for (uint32_t i = 0; i < graph->blocksCount; ++i) {
+        if (graph->allocator->memProps.memoryTypes[graph->blocks[i].memTypeIndex].heapIndex == heapIndex) {
+            released += graph->blocks[i].size;
+        }
+    }
+    if (released == 0) {
+        return 0;
+    }
+    vkDeviceWaitIdle(offscreen->device);
+    deleteRenderGraph(offscreen->device, graph);
+    offscreen->readbackGraph = NULL;
+    return released;
+}
 
 void deleteVulkanAppOffscreen(const VulkanAppCore core, VulkanAppOffscreen offscreen) {
     if (offscreen == NULL) {
         return;
     }
+    unregisterMemoryPressureCallback(core->allocator, releaseReadbackGraphUnderPressure, (void *)offscreen);
     vkDeviceWaitIdle(core->device);
+    if (offscreen->readbackGraph != NULL) deleteRenderGraph(core->device, offscreen->readbackGraph);
     if (offscreen->imageView != NULL) vkDestroyImageView(core->device, offscreen->imageView, NULL);
     if (offscreen->image != NULL) deleteImage(core->device, offscreen->image);
     free((void *)offscreen);
 }
 
-VulkanAppOffscreen createVulkanAppOffscreen(const VulkanAppCore core, int width, int height) {
+VulkanAppOffscreen createVulkanAppOffscreen(const VulkanAppCore core, int width, int height, int dropAlpha) {
 #define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "createVulkanAppOffscreen()", (m), (p), deleteVulkanAppOffscreen(core, offscreen), NULL)
 #define CHECK(p, m)    ERROR_IF     (!(p),              "createVulkanAppOffscreen()", (m),      deleteVulkanAppOffscreen(core, offscreen), NULL)
 
     const VulkanAppOffscreen offscreen = (VulkanAppOffscreen)malloc(sizeof(struct VulkanAppOffscreen_t));
     CHECK(offscreen != NULL, "VulkanAppOffscreenの確保に失敗");
+    memset(offscreen, 0, sizeof(struct VulkanAppOffscreen_t));
+    offscreen->device = core->device;
+
+    // 描画結果を読み戻すため、レンダーパスの終了時にコピー元のレイアウトとさせる
+    //
+    // NOTE: 読み戻しのレンダーグラフはこのレイアウトから遷移させるため、他のレイアウトとしても読み戻せる。
+    offscreen->layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
 
     // 描画先イメージを作成する
     //
     // NOTE: この描画先イメージは後々画像ファイルに保存するために一時バッファへコピーを行う。
     //       そのため、コピー元としても使えるようUsageにVK_IMAGE_USAGE_TRANSFER_SRC_BITも指定する。
-    //       ただし、描画先イメージはデバイスローカルメモリになければならないため、Memory PropertyにVK_MEMORY_PROPERTY_DEVICE_LOCAL_BITを指定する。
+    //       ただし、描画先イメージはデバイスローカルメモリにあるべきなので、用途にMEMORY_USAGE_GPU_ONLYを指定する。
     {
         const VkExtent3D extent = { (uint32_t)width, (uint32_t)height, 1 };
         offscreen->image = createImage(
             core->device,
-            &core->physDevMemProps,
+            core->allocator,
             VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            MEMORY_USAGE_GPU_ONLY,
             RENDER_TARGET_PIXEL_FORMAT,
-            &extent
+            &extent,
+            VK_SAMPLE_COUNT_1_BIT
         );
         CHECK(offscreen->image != NULL, "描画先イメージの作成に失敗");
     }
@@ -80,6 +115,48 @@ VulkanAppOffscreen createVulkanAppOffscreen(const VulkanAppCore core, int width,
         CHECK_VK(vkCreateImageView(core->device, &ci, NULL, &offscreen->imageView), "描画先イメージビューの作成に失敗");
     }
 
+    // 読み戻す画素の形式を決める
+    //
+    // NOTE: 描画先イメージはBGRAの並びのため、そのまま読み戻すとホストが画素毎に並べ替えることになる。
+    //       デバイスで画像ファイルと同じ並びのイメージへブリットしてから読み戻せば、ホストは圧縮するだけで済む。
+    //       ブリットは同じsRGBの符号化のフォーマット同士で行うため、8ビットの値は変わらない。
+    //       アルファを捨てる場合はR8G8B8を選び、バスを渡るバイト数も3/4とする。
+    //       ただし、R8G8B8へのブリットに対応する物理デバイスは少ないため、その場合はR8G8B8A8へ変換しアルファはホストで捨てる。
+    //       描画先イメージがブリット元にならなければ、そのまま読み戻してホストで並べ替える。
+    {
+        offscreen->readbackFormat = RENDER_TARGET_PIXEL_FORMAT;
+        offscreen->readbackPixelSize = 4;
+        offscreen->readbackLayout = PNG_PIXEL_LAYOUT_BGRA;
+        offscreen->readbackChannels = dropAlpha ? 3 : 4;
+        const VkFormat srcCandidates[] = { RENDER_TARGET_PIXEL_FORMAT };
+        const VkFormat rgbCandidates[] = { VK_FORMAT_R8G8B8_SRGB };
+        const VkFormat rgbaCandidates[] = { VK_FORMAT_R8G8B8A8_SRGB };
+        const int blittable = findSupportedImageFormat(core->physDevice, 1, srcCandidates, VK_FORMAT_FEATURE_BLIT_SRC_BIT) != VK_FORMAT_UNDEFINED;
+        if (blittable && dropAlpha && findSupportedImageFormat(core->physDevice, 1, rgbCandidates, VK_FORMAT_FEATURE_BLIT_DST_BIT) != VK_FORMAT_UNDEFINED) {
+            offscreen->readbackFormat = VK_FORMAT_R8G8B8_SRGB;
+            offscreen->readbackPixelSize = 3;
+            offscreen->readbackLayout = PNG_PIXEL_LAYOUT_PACKED;
+        } else if (blittable && findSupportedImageFormat(core->physDevice, 1, rgbaCandidates, VK_FORMAT_FEATURE_BLIT_DST_BIT) != VK_FORMAT_UNDEFINED) {
+            offscreen->readbackFormat = VK_FORMAT_R8G8B8A8_SRGB;
+            offscreen->readbackLayout = dropAlpha ? PNG_PIXEL_LAYOUT_RGBA : PNG_PIXEL_LAYOUT_PACKED;
+        }
+    }
+    // メモリ逼迫時に読み戻しのレンダーグラフを破棄させる
+    {
+        CHECK(
+            registerMemoryPressureCallback(core->allocator, releaseReadbackGraphUnderPressure, (void *)offscreen),
+            "メモリ逼迫時コールバックの登録に失敗"
+        );
+    }
+
+    printf(
+        "[ info ] readback: デバイスでの変換=%d, 一画素あたり%uバイト, ホストでの並べ替え=%d, channels=%u\n",
+        offscreen->readbackFormat != RENDER_TARGET_PIXEL_FORMAT,
+        offscreen->readbackPixelSize,
+        offscreen->readbackLayout != PNG_PIXEL_LAYOUT_PACKED,
+        offscreen->readbackChannels
+    );
+
     return offscreen;
 
 #undef CHECK
@@ -90,11 +167,20 @@ VulkanAppOffscreen createVulkanAppOffscreen(const VulkanAppCore core, int width,
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void convertBGRAToRGBA(const uint8_t *src, uint8_t *dst, uint32_t pixelsCount) {
+    for (uint32_t i = 0; i < pixelsCount; ++i) {
+        dst[i * 4 + 0] = src[i * 4 + 2];
+        dst[i * 4 + 1] = src[i * 4 + 1];
+        dst[i * 4 + 2] = src[i * 4 + 0];
+        dst[i * 4 + 3] = src[i * 4 + 3];
+    }
+}
+
 // saveRenderingResult()関数の中で一時的に作成されるオブジェクトを持つ構造体
 typedef struct TempObjsSaveRenderingResult_t {
     Buffer buffer;
     int mapped;
-    uint8_t *pixels;
+    PngWriter writer;
 } TempObjsSaveRenderingResult;
 
 void deleteTempObjsSaveRenderingResult(const VulkanAppCore core, TempObjsSaveRenderingResult *temp) {
@@ -102,7 +188,7 @@ void deleteTempObjsSaveRenderingResult(const VulkanAppCore core, TempObjsSaveRen
         return;
     }
     vkDeviceWaitIdle(core->device);
-    if (temp->pixels != NULL) free((void *)temp->pixels);
+    if (temp->writer != NULL) deletePngWriter(temp->writer);
     if (temp->mapped) vkUnmapMemory(core->device, temp->buffer->devMemory);
     if (temp->buffer != NULL) deleteBuffer(core->device, temp->buffer);
 }
@@ -115,28 +201,28 @@ void deleteTempObjsSaveRenderingResult(const VulkanAppCore core, TempObjsSaveRen
 //         1. ホストから見えるメモリを確保する
 //         2. そのメモリをローカルメモリへマップする
 //         3. 描画結果イメージからそのメモリへコピーする
-//       ただし、描画結果イメージのイメージレイアウトがVK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMALであることが前提である。
-//       今回はレンダーパスの最後にそうなるよう設定している。
-//       もし、VK_IMAGE_LAYOUT_PRESENT_SRC_KHR等である場合は、vkCmdPipelineBarrier()関数でイメージレイアウトを変更する必要がある。
+//       コピー元のレイアウトへの遷移とバリアは、submitReadbackCopy()関数のレンダーグラフが導く。
 int saveRenderingResult(const VulkanAppCore core, const VulkanAppOffscreen offscreen) {
 #define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "saveRenderingResult()", (m), (p), deleteTempObjsSaveRenderingResult(core, &temp), 0)
 #define CHECK(p, m)    ERROR_IF     (!(p),              "saveRenderingResult()", (m),      deleteTempObjsSaveRenderingResult(core, &temp), 0)
-#define COMMAND_BUFFERS_COUNT 1
 
     TempObjsSaveRenderingResult temp = {
         NULL,
         0,
-        NULL
+        NULL,
     };
 
     // 一時バッファを作成する
+    //
+    // NOTE: ホストから読み込むため、キャッシュされたメモリが選ばれるよう用途にMEMORY_USAGE_READBACKを指定する。
+    //       キャッシュされていないメモリからの読込みは非常に遅い。
     {
         temp.buffer = createBuffer(
             core->device,
-            &core->physDevMemProps,
+            core->allocator,
             VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-            offscreen->image->memReqs.size
+            MEMORY_USAGE_READBACK,
+            getReadbackBufferSize(offscreen, offscreen->image->extent.width, offscreen->image->extent.height)
         );
         CHECK(temp.buffer != NULL, "一時バッファの作成に失敗");
     }
@@ -148,70 +234,433 @@ int saveRenderingResult(const VulkanAppCore core, const VulkanAppOffscreen offsc
         temp.mapped = 1;
     }
 
-    // コマンドバッファを確保し記録を開始する
-    VkCommandBuffer cmdBuffer;
+    // 一時バッファへのコピーを提出する
     {
-        cmdBuffer = allocateAndStartCommandBuffer(core);
-        CHECK(cmdBuffer != NULL, "コマンドバッファの確保あるいは記録の開始に失敗");
+        CHECK(
+            submitReadbackCopy(core, offscreen, temp.buffer->buffer, offscreen->image->extent.width, offscreen->image->extent.height, NULL),
+            "一時バッファへのコピーの提出に失敗"
+        );
     }
 
-    // コピーコマンドを記録する
+    // 計算終了を待機する
     {
-#define REGIONS_COUNT 1
-        const VkBufferImageCopy regions[REGIONS_COUNT] = {
-            {
-                0,
-                0,
-                0,
-                { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
-                { 0, 0, 0 },
-                offscreen->image->extent,
-            }
-        };
-        vkCmdCopyImageToBuffer(cmdBuffer, offscreen->image->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, temp.buffer->buffer, REGIONS_COUNT, regions);
-#undef REGIONS_COUNT
+        vkDeviceWaitIdle(core->device);
     }
 
-    // コマンドバッファを終了しキューに提出する
+    // デバイスの書き込みをホストから見えるようにする
+    //
+    // NOTE: HOST_COHERENTでないメモリが選ばれた場合に必要となる。
     {
-        CHECK(endAndSubmitCommandBuffer(core, cmdBuffer, 0, NULL, NULL, 0, NULL), "コマンドバッファの終了あるいは提出に失敗");
+        CHECK(
+            invalidateMappedDeviceMemory(core->device, core->allocator, temp.buffer->devMemory, temp.buffer->memTypeIndex),
+            "一時バッファの無効化に失敗"
+        );
     }
 
-    // 計算終了を待機する
+    // 描画結果をpngに保存する
+    //
+    // NOTE: マップした一時バッファから一行ずつ圧縮して書き出すため、描画結果の複製も圧縮後の画像全体も保持しない。
     {
-        vkDeviceWaitIdle(core->device);
+        const uint32_t width = offscreen->image->extent.width;
+        const uint32_t height = offscreen->image->extent.height;
+        const size_t rowSize = (size_t)width * offscreen->readbackPixelSize;
+        temp.writer = createPngWriter("rendering-result.png", width, height, offscreen->readbackChannels);
+        CHECK(temp.writer != NULL, "PNG書き出しオブジェクトの作成に失敗");
+        for (uint32_t y = 0; y < height; ++y) {
+            CHECK(writePngRow(temp.writer, (const uint8_t *)mappedData + (size_t)y * rowSize, offscreen->readbackLayout), "描画結果の保存に失敗");
+        }
+        CHECK(finishPngWriter(temp.writer), "描画結果の保存に失敗");
+    }
+
+    deleteTempObjsSaveRenderingResult(core, &temp);
+    return 1;
+    
+#undef CHECK
+#undef CHECK_VK
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+VkDeviceSize getReadbackBufferSize(const VulkanAppOffscreen offscreen, uint32_t width, uint32_t height) {
+    return (VkDeviceSize)width * height * offscreen->readbackPixelSize;
+}
+
+// 読み戻すイメージ (変換するなら変換先の一時イメージ、しなければ描画先イメージ) を返す関数
+static VkImage getReadbackSourceImage(const VulkanAppOffscreen offscreen) {
+    if (offscreen->readbackConvertResource == RENDER_GRAPH_INVALID_INDEX) {
+        return offscreen->image->image;
     }
+    return offscreen->readbackGraph->resources[offscreen->readbackConvertResource].image;
+}
 
-    // 描画結果を加工して取得する
+// 描画先イメージを読み戻すフォーマットのイメージへブリットするパスの記録関数
+//
+// NOTE: 大きさを変えないため、フィルタは最近傍とする。
+static void recordReadbackConvertPass(VkCommandBuffer cmdBuffer, void *userData) {
+    const VulkanAppOffscreen offscreen = (VulkanAppOffscreen)userData;
+    const VkImageBlit region = {
+        { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+        { { 0, 0, 0 }, { (int32_t)offscreen->readbackWidth, (int32_t)offscreen->readbackHeight, 1 } },
+        { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+        { { 0, 0, 0 }, { (int32_t)offscreen->readbackWidth, (int32_t)offscreen->readbackHeight, 1 } },
+    };
+    vkCmdBlitImage(
+        cmdBuffer,
+        offscreen->image->image,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        getReadbackSourceImage(offscreen),
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        1,
+        &region,
+        VK_FILTER_NEAREST
+    );
+}
+
+// 読み戻すイメージを一時バッファへコピーするパスの記録関数
+static void recordReadbackCopyPass(VkCommandBuffer cmdBuffer, void *userData) {
+    const VulkanAppOffscreen offscreen = (VulkanAppOffscreen)userData;
+    const VkBufferImageCopy region = {
+        0,
+        0,
+        0,
+        { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+        { 0, 0, 0 },
+        { offscreen->readbackWidth, offscreen->readbackHeight, 1 },
+    };
+    vkCmdCopyImageToBuffer(cmdBuffer, getReadbackSourceImage(offscreen), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, offscreen->readbackBuffer, 1, &region);
+}
+
+// 読み戻しのレンダーグラフを作成する関数
+//
+// NOTE: 描画先イメージは、実行前はレンダーパスがoffscreen->layoutで書き込んだもの、実行後は次のレンダーパスがクリアして書き込むものとする。
+//       次のレンダーパスは初期レイアウトVK_IMAGE_LAYOUT_UNDEFINEDで内容を捨てるため、実行後にレイアウトを戻さない。
+//       一時バッファは、実行後にホストが読み込むものとする。
+//       変換する場合、変換先のイメージはグラフの一時イメージとし、ブリット先からコピー元のレイアウトへの遷移もグラフに導かせる。
+static int createReadbackGraph(const VulkanAppCore core, const VulkanAppOffscreen offscreen) {
+#define CHECK(p, m) ERROR_IF(!(p), "createReadbackGraph()", (m), deleteRenderGraph(core->device, graph), 0)
+
+    const RenderGraph graph = createRenderGraph();
+    CHECK(graph != NULL, "レンダーグラフの作成に失敗");
+
+    // リソースを加える
+    uint32_t image;
+    uint32_t converted = RENDER_GRAPH_INVALID_INDEX;
+    uint32_t buffer;
     {
-        const uint32_t wh = offscreen->image->extent.width * offscreen->image->extent.height;
-        temp.pixels = (uint8_t *)malloc(sizeof(uint8_t) * wh * 4);
-        for (uint32_t i = 0; i < wh; ++i) {
-            temp.pixels[i * 4 + 0] = ((uint8_t *)mappedData)[i * 4 + 2];
-            temp.pixels[i * 4 + 1] = ((uint8_t *)mappedData)[i * 4 + 1];
-            temp.pixels[i * 4 + 2] = ((uint8_t *)mappedData)[i * 4 + 0];
-            temp.pixels[i * 4 + 3] = ((uint8_t *)mappedData)[i * 4 + 3];
+        const RenderGraphAccess rendered = {
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            offscreen->layout,
+        };
+        const RenderGraphAccess nextRendering = {
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED,
+        };
+        const RenderGraphAccess hostRead = {
+            VK_PIPELINE_STAGE_HOST_BIT,
+            VK_ACCESS_HOST_READ_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED,
+        };
+        image = addRenderGraphImage(graph, "offscreen-image", offscreen->image->image, VK_IMAGE_ASPECT_COLOR_BIT, &rendered, &nextRendering);
+        buffer = addRenderGraphBuffer(graph, "readback-buffer", VK_NULL_HANDLE, NULL, &hostRead);
+        CHECK(image != RENDER_GRAPH_INVALID_INDEX && buffer != RENDER_GRAPH_INVALID_INDEX, "リソースの追加に失敗");
+        if (offscreen->readbackFormat != RENDER_TARGET_PIXEL_FORMAT) {
+            converted = addRenderGraphTransientImage(
+                graph,
+                "readback-converted",
+                offscreen->readbackFormat,
+                offscreen->image->extent.width,
+                offscreen->image->extent.height,
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                VK_SAMPLE_COUNT_1_BIT,
+                VK_IMAGE_ASPECT_COLOR_BIT
+            );
+            CHECK(converted != RENDER_GRAPH_INVALID_INDEX, "変換先の一時イメージの追加に失敗");
         }
     }
 
-    // 描画結果をpngに保存する
+    // 変換のパスを加える
+    if (converted != RENDER_GRAPH_INVALID_INDEX) {
+        const uint32_t pass = addRenderGraphPass(graph, "readback-convert", recordReadbackConvertPass, (void *)offscreen, 0);
+        CHECK(pass != RENDER_GRAPH_INVALID_INDEX, "変換のパスの追加に失敗");
+        CHECK(
+            addRenderGraphAccess(graph, pass, image, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+                && addRenderGraphAccess(graph, pass, converted, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL),
+            "変換のアクセスの宣言に失敗"
+        );
+    }
+
+    // コピーのパスを加える
     {
+        const uint32_t source = converted != RENDER_GRAPH_INVALID_INDEX ? converted : image;
+        const uint32_t pass = addRenderGraphPass(graph, "readback-copy", recordReadbackCopyPass, (void *)offscreen, 0);
+        CHECK(pass != RENDER_GRAPH_INVALID_INDEX, "コピーのパスの追加に失敗");
         CHECK(
-            stbi_write_png(
-                "rendering-result.png",
-                offscreen->image->extent.width,
-                offscreen->image->extent.height,
-                sizeof(uint8_t) * 4,
-                (const void *)temp.pixels,
-                0
-            ),
-            "描画結果の保存に失敗"
+            addRenderGraphAccess(graph, pass, source, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+                && addRenderGraphAccess(graph, pass, buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED),
+            "コピーのアクセスの宣言に失敗"
         );
     }
 
-    deleteTempObjsSaveRenderingResult(core, &temp);
+    // コンパイルする
+    {
+        CHECK(compileRenderGraph(core->device, core->allocator, graph), "レンダーグラフのコンパイルに失敗");
+    }
+
+    offscreen->readbackGraph = graph;
+    offscreen->readbackConvertResource = converted;
+    offscreen->readbackBufferResource = buffer;
     return 1;
-    
+
+#undef CHECK
+}
+
+int submitReadbackCopy(
+    const VulkanAppCore core,
+    const VulkanAppOffscreen offscreen,
+    VkBuffer buffer,
+    uint32_t width,
+    uint32_t height,
+    VkFence fence
+) {
+#define CHECK(p, m) ERROR_IF(!(p), "submitReadbackCopy()", (m), {}, 0)
+
+    // 読み戻しのレンダーグラフを作成する
+    if (offscreen->readbackGraph == NULL) {
+        CHECK(createReadbackGraph(core, offscreen), "読み戻しのレンダーグラフの作成に失敗");
+    }
+
+    // コピーのパスが参照する値を設定する
+    {
+        offscreen->readbackBuffer = buffer;
+        offscreen->readbackWidth = width;
+        offscreen->readbackHeight = height;
+        setRenderGraphBuffer(offscreen->readbackGraph, offscreen->readbackBufferResource, buffer);
+    }
+
+    // コマンドバッファを確保し記録を開始する
+    VkCommandBuffer cmdBuffer = allocateAndStartCommandBuffer(core);
+    CHECK(cmdBuffer != NULL, "コマンドバッファの確保あるいは記録の開始に失敗");
+
+    // バリアとコピーを記録する
+    {
+        executeRenderGraph(offscreen->readbackGraph, cmdBuffer);
+    }
+
+    // コマンドバッファを終了しキューに提出する
+    {
+        CHECK(endAndSubmitCommandBuffer(core, cmdBuffer, 0, NULL, NULL, 0, NULL, fence), "コマンドバッファの終了あるいは提出に失敗");
+    }
+
+    return 1;
+
+#undef CHECK
+}
+
+// タイルの読み戻しに用いる一時バッファの数
+//
+// NOTE: 一つを読み戻している間に、次のタイルの描画とコピーを進められる。
+#define EXPORT_READBACK_SLOTS_COUNT 2
+
+// 一つのタイルの読み戻し先
+typedef struct ExportReadbackSlot_t {
+    Buffer buffer;
+    const uint8_t *mapped;
+    // コピーが完了したらシグナルされるフェンス
+    VkFence fence;
+    // コピーを提出し、まだ帯へ移していなければ1
+    int pending;
+    // タイルのうち画像に収まる範囲
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+} ExportReadbackSlot;
+
+// exportTiledRenderingResult()関数の中で一時的に作成されるオブジェクトを持つ構造体
+typedef struct TempObjsExportTiledRenderingResult_t {
+    ExportReadbackSlot slots[EXPORT_READBACK_SLOTS_COUNT];
+    // 画像全体の幅 x タイルの高の、読み戻した並びの画素 (タイルの一行分)
+    uint8_t *band;
+    PngWriter writer;
+} TempObjsExportTiledRenderingResult;
+
+void deleteTempObjsExportTiledRenderingResult(const VulkanAppCore core, TempObjsExportTiledRenderingResult *temp) {
+    if (temp == NULL) {
+        return;
+    }
+    vkDeviceWaitIdle(core->device);
+    for (uint32_t i = 0; i < EXPORT_READBACK_SLOTS_COUNT; ++i) {
+        ExportReadbackSlot *slot = &temp->slots[i];
+        if (slot->mapped != NULL) vkUnmapMemory(core->device, slot->buffer->devMemory);
+        if (slot->buffer != NULL) deleteBuffer(core->device, slot->buffer);
+        if (slot->fence != NULL) vkDestroyFence(core->device, slot->fence, NULL);
+    }
+    if (temp->band != NULL) free((void *)temp->band);
+    if (temp->writer != NULL) deletePngWriter(temp->writer);
+}
+
+// タイルのコピーの完了を待ち、帯へ移す関数
+//
+// NOTE: 帯を書き出すのは、その帯の右端のタイルを移した後。並べ替えが必要なら書き出す際に行毎に行う。
+static int consumeExportReadbackSlot(
+    const VulkanAppCore core,
+    ExportReadbackSlot *slot,
+    uint8_t *band,
+    uint32_t fullWidth,
+    uint32_t pixelSize
+) {
+    if (vkWaitForFences(core->device, 1, &slot->fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS) {
+        return 0;
+    }
+    if (!invalidateMappedDeviceMemory(core->device, core->allocator, slot->buffer->devMemory, slot->buffer->memTypeIndex)) {
+        return 0;
+    }
+    for (uint32_t row = 0; row < slot->height; ++row) {
+        memcpy(
+            (void *)(band + ((size_t)row * fullWidth + slot->x) * pixelSize),
+            (const void *)(slot->mapped + (size_t)row * slot->width * pixelSize),
+            (size_t)slot->width * pixelSize
+        );
+    }
+    slot->pending = 0;
+    return 1;
+}
+
+// タイルに分けて描画した画像をPNG形式で書き出す関数
+//
+// NOTE: 画像全体を描画先イメージの大きさのタイルに分け、左上から行毎に次を繰り返す。
+//         1. setRenderingTile()関数でタイルを設定し、render()関数で描画する
+//         2. 描画先イメージから一時バッファへのコピーを、フェンス付きで別に提出する
+//         3. 一時バッファを使い回す前に、前回のコピーの完了を待って帯へ移す
+//       一時バッファを二つ交互に使うため、ホストがタイルを帯へ移している間もデバイスは次のタイルを描画している。
+//       帯の右端のタイルを移したら、帯の行を上から順にPngWriterで圧縮して書き出す。
+//       ホストが保持するのは帯と一時バッファのみであり、画像全体の高さに依らない。
+//
+int exportTiledRenderingResult(
+    const VulkanAppCore core,
+    const VulkanAppOffscreen offscreen,
+    const VulkanAppRendering renderer,
+    uint32_t fullWidth,
+    uint32_t fullHeight,
+    const char *path
+) {
+#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "exportTiledRenderingResult()", (m), (p), deleteTempObjsExportTiledRenderingResult(core, &temp), 0)
+#define CHECK(p, m)    ERROR_IF     (!(p),              "exportTiledRenderingResult()", (m),      deleteTempObjsExportTiledRenderingResult(core, &temp), 0)
+
+    TempObjsExportTiledRenderingResult temp;
+    memset(&temp, 0, sizeof(TempObjsExportTiledRenderingResult));
+
+    const uint32_t tileWidth = offscreen->image->extent.width;
+    const uint32_t tileHeight = offscreen->image->extent.height;
+    const uint32_t tilesCountX = (fullWidth + tileWidth - 1) / tileWidth;
+    const uint32_t tilesCountY = (fullHeight + tileHeight - 1) / tileHeight;
+    const uint32_t tilesCount = tilesCountX * tilesCountY;
+    const uint32_t pixelSize = offscreen->readbackPixelSize;
+
+    // 一時バッファとフェンスを作成し、一時バッファをマップする
+    //
+    // NOTE: 一時バッファの大きさはタイル一つ分。画像の端のタイルは収まる範囲のみを詰めてコピーする。
+    for (uint32_t i = 0; i < EXPORT_READBACK_SLOTS_COUNT; ++i) {
+        ExportReadbackSlot *slot = &temp.slots[i];
+        slot->buffer = createBuffer(
+            core->device,
+            core->allocator,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            MEMORY_USAGE_READBACK,
+            getReadbackBufferSize(offscreen, tileWidth, tileHeight)
+        );
+        CHECK(slot->buffer != NULL, "一時バッファの作成に失敗");
+        void *mappedData;
+        CHECK_VK(vkMapMemory(core->device, slot->buffer->devMemory, 0, slot->buffer->memReqs.size, 0, &mappedData), "マップに失敗");
+        slot->mapped = (const uint8_t *)mappedData;
+        const VkFenceCreateInfo ci = {
+            VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+            NULL,
+            0,
+        };
+        CHECK_VK(vkCreateFence(core->device, &ci, NULL, &slot->fence), "フェンスの作成に失敗");
+    }
+
+    // 帯を確保する
+    {
+        temp.band = (uint8_t *)malloc((size_t)fullWidth * tileHeight * pixelSize);
+        CHECK(temp.band != NULL, "帯の確保に失敗");
+    }
+
+    // PNG書き出しオブジェクトを作成する
+    {
+        temp.writer = createPngWriter(path, fullWidth, fullHeight, offscreen->readbackChannels);
+        CHECK(temp.writer != NULL, "PNG書き出しオブジェクトの作成に失敗");
+    }
+
+    // タイル毎に描画し、読み戻す
+    //
+    // NOTE: 最後に、まだ帯へ移していない一時バッファを古い順に移す。
+    for (uint32_t i = 0; i < tilesCount + EXPORT_READBACK_SLOTS_COUNT; ++i) {
+        ExportReadbackSlot *slot = &temp.slots[i % EXPORT_READBACK_SLOTS_COUNT];
+
+        // 一時バッファを帯へ移し、帯が揃えば書き出す
+        if (slot->pending) {
+            PROFILE_ZONE_BEGIN("consumeExportReadbackSlot");
+            const int consumed = consumeExportReadbackSlot(core, slot, temp.band, fullWidth, pixelSize);
+            PROFILE_ZONE_END("consumeExportReadbackSlot");
+            CHECK(consumed, "タイルの読み戻しに失敗");
+            if (slot->x + slot->width == fullWidth) {
+                PROFILE_ZONE_BEGIN("writeExportBand");
+                int written = 1;
+                for (uint32_t row = 0; row < slot->height && written; ++row) {
+                    written = writePngRow(temp.writer, temp.band + (size_t)row * fullWidth * pixelSize, offscreen->readbackLayout);
+                }
+                PROFILE_ZONE_END("writeExportBand");
+                CHECK(written, "画像ファイルへの書込みに失敗");
+            }
+        }
+        if (i >= tilesCount) {
+            continue;
+        }
+
+        // タイルを描画する
+        const uint32_t x = (i % tilesCountX) * tileWidth;
+        const uint32_t y = (i / tilesCountX) * tileHeight;
+        {
+            setRenderingTile(renderer, fullWidth, fullHeight, (int32_t)x, (int32_t)y);
+            CHECK(render(core, renderer, 0, 0, 0, tileWidth, tileHeight, 0, NULL, NULL, 0, NULL), "タイルの描画に失敗");
+        }
+
+        // 一時バッファへのコピーを提出する
+        {
+            slot->x = x;
+            slot->y = y;
+            slot->width = fullWidth - x < tileWidth ? fullWidth - x : tileWidth;
+            slot->height = fullHeight - y < tileHeight ? fullHeight - y : tileHeight;
+            CHECK_VK(vkResetFences(core->device, 1, &slot->fence), "フェンスのリセットに失敗");
+            CHECK(
+                submitReadbackCopy(core, offscreen, slot->buffer->buffer, slot->width, slot->height, slot->fence),
+                "一時バッファへのコピーの提出に失敗"
+            );
+            slot->pending = 1;
+        }
+    }
+    setRenderingTile(renderer, 0, 0, 0, 0);
+    CHECK(finishPngWriter(temp.writer), "画像ファイルの書き出しの完了に失敗");
+
+    printf(
+        "[ info ] exportTiledRenderingResult(): %ux%uを%ux%uのタイル%u個に分けて書き出しました: %s\n",
+        fullWidth,
+        fullHeight,
+        tileWidth,
+        tileHeight,
+        tilesCount,
+        path
+    );
+
+    deleteTempObjsExportTiledRenderingResult(core, &temp);
+    return 1;
+
 #undef CHECK
 #undef CHECK_VK
 }
@@ -220,6 +669,69 @@ int saveRenderingResult(const VulkanAppCore core, const VulkanAppOffscreen offsc
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+VulkanAppRendering createOffscreenRendering(const VulkanAppCore core, const VulkanAppOffscreen offscreen, const AppOptions *options) {
+#define CHECK(p, m) ERROR_IF(!(p), "createOffscreenRendering()", (m), deleteVulkanAppRendering(core, renderer), NULL)
+
+    // レンダリングオブジェクトを作成する
+    //
+    // NOTE: 描画結果イメージのデータを取得するため、レンダーパスの最後にoffscreen->layout(コピー元のレイアウト)とする。
+    const uint32_t imageViewsCount = 1;
+    const VkImageView imageViews[] = { offscreen->imageView };
+    PROFILE_ZONE_BEGIN("createVulkanAppRendering");
+    const VulkanAppRendering renderer = createVulkanAppRendering(
+        core,
+        imageViews,
+        imageViewsCount,
+        offscreen->image->extent.width,
+        offscreen->image->extent.height,
+        offscreen->layout,
+        selectRenderingSampleCount(core, options->msaaSamples)
+    );
+    PROFILE_ZONE_END("createVulkanAppRendering");
+    CHECK(renderer != NULL, "レンダリングオブジェクトの作成に失敗");
+
+    // メッシュのインスタンス描画を有効にする
+    //
+    // NOTE: 深度プリパスを有効にする前に行い、メッシュの深度プリパスも併せて行わせる。
+    if (options->meshInstances > 0) {
+        CHECK(
+            enableMeshInstances(core, renderer, APP_MESH_MODEL_PATH, options->meshInstances),
+            "メッシュのインスタンス描画の有効化に失敗"
+        );
+    }
+
+    // メッシュレットのカリングを有効にする
+    if (options->meshletCull) {
+        CHECK(options->meshInstances > 0, "--meshlet-cullには--instancesが必要");
+        CHECK(enableMeshletCulling(core, renderer), "メッシュレットのカリングの有効化に失敗");
+    }
+
+    // 深度プリパスを有効にする
+    if (options->depthPrepass) {
+        CHECK(enableDepthPrepass(core, renderer), "深度プリパスの有効化に失敗");
+    }
+
+    // パス毎の描画の仕事量の計測を有効にする
+    if (options->gpuStats) {
+        CHECK(enableDrawStats(core, renderer), "描画の仕事量の計測の有効化に失敗");
+    }
+
+    // パイプラインの作成の完了を待機する
+    //
+    // NOTE: オフスクリーンでは描画したフレームを全て保存するため、代替のパイプラインで描画されては困る。
+    PROFILE_ZONE_BEGIN("waitForPipelines");
+    waitForPipelines(renderer);
+    PROFILE_ZONE_END("waitForPipelines");
+
+    return renderer;
+
+#undef CHECK
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 // オフスクリーン向けVulkanアプリケーションで必要なモジュールを持つ構造体
 typedef struct ModulesForOffscreen_t {
     VulkanAppCore core;
@@ -236,7 +748,7 @@ void deleteModulesForOffscreen(const ModulesForOffscreen *mods) {
     if (mods->core != NULL) deleteVulkanAppCore(mods->core);
 }
 
-int runOnOffscreen(int width, int height) {
+int runOnOffscreen(int width, int height, const AppOptions *options) {
 #define CHECK(p, m) ERROR_IF(!(p), "runOnOffscreen()", (m), deleteModulesForOffscreen(&mods), 1)
 
     ModulesForOffscreen mods = {
@@ -245,39 +757,82 @@ int runOnOffscreen(int width, int height) {
         NULL,
     };
 
+    // 複数のフレームを描画する場合はバッチ処理に任せる
+    //
+    // NOTE: バッチ処理は物理デバイス毎に主要オブジェクトを作成するため、ここでは作成しない。
+    if (options->batchFrames > 0) {
+        return runOffscreenBatch(width, height, options);
+    }
+
     // 主要オブジェクトを作成する
     const uint32_t instLayerNamesCount = 1;
     const char *instLayerNames[] = { "VK_LAYER_KHRONOS_validation" };
+    PROFILE_ZONE_BEGIN("createVulkanAppCore");
     mods.core = createVulkanAppCore(instLayerNamesCount, instLayerNames, 0, NULL, 0, NULL, 0, NULL);
+    PROFILE_ZONE_END("createVulkanAppCore");
     CHECK(mods.core != NULL, "主要オブジェクトの作成に失敗");
 
+    // 描画先イメージの大きさを決める
+    //
+    // NOTE: タイルに分けて書き出す場合はタイルの大きさとする。デバイスが作れるイメージの大きさの上限も超えないようにする。
+    const int exporting = options->exportWidth > 0;
+    if (exporting) {
+        const uint32_t maxDimension = mods.core->physDevProps.limits.maxImageDimension2D;
+        uint32_t tileWidth = options->exportWidth < APP_EXPORT_TILE_WIDTH ? options->exportWidth : APP_EXPORT_TILE_WIDTH;
+        uint32_t tileHeight = options->exportHeight < APP_EXPORT_TILE_HEIGHT ? options->exportHeight : APP_EXPORT_TILE_HEIGHT;
+        tileWidth = tileWidth < maxDimension ? tileWidth : maxDimension;
+        tileHeight = tileHeight < maxDimension ? tileHeight : maxDimension;
+        width = (int)tileWidth;
+        height = (int)tileHeight;
+    }
+
     // オフスクリーン依存オブジェクトを作成する
-    mods.offscreen = createVulkanAppOffscreen(mods.core, width, height);
+    mods.offscreen = createVulkanAppOffscreen(mods.core, width, height, options->readbackRgb);
     CHECK(mods.offscreen != NULL, "オフスクリーン依存オブジェクトの作成に失敗");
 
     // レンダリングオブジェクトを作成する
-    //
-    // NOTE: 描画結果イメージのデータを取得するためにレンダーパスの最後にイメージレイアウトをVK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMALにする。
-    const uint32_t imageViewsCount = 1;
-    const VkImageView imageViews[] = { mods.offscreen->imageView };
-    mods.renderer = createVulkanAppRendering(
-        mods.core,
-        imageViews,
-        imageViewsCount,
-        width,
-        height,
-        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
-    );
+    PROFILE_ZONE_BEGIN("createOffscreenRendering");
+    mods.renderer = createOffscreenRendering(mods.core, mods.offscreen, options);
+    PROFILE_ZONE_END("createOffscreenRendering");
     CHECK(mods.renderer != NULL, "レンダリングオブジェクトの作成に失敗");
 
+    // タイルに分けて描画し、画像ファイルへ書き出す
+    if (exporting) {
+        PROFILE_ZONE_BEGIN("exportTiledRenderingResult");
+        const int exported = exportTiledRenderingResult(
+            mods.core,
+            mods.offscreen,
+            mods.renderer,
+            options->exportWidth,
+            options->exportHeight,
+            APP_EXPORT_OUTPUT_PATH
+        );
+        PROFILE_ZONE_END("exportTiledRenderingResult");
+        CHECK(exported, "タイルに分けた描画結果の書き出しに失敗");
+        printMemoryStats(mods.core->allocator);
+        deleteModulesForOffscreen(&mods);
+        return 0;
+    }
+
     // 描画する
-    CHECK(render(mods.core, mods.renderer, 0, 0, 0, width, height, 0, NULL, NULL, 0, NULL), "描画に失敗");
+    PROFILE_ZONE_BEGIN("render");
+    const int rendered = render(mods.core, mods.renderer, 0, 0, 0, width, height, 0, NULL, NULL, 0, NULL);
+    PROFILE_ZONE_END("render");
+    CHECK(rendered, "描画に失敗");
 
     // 描画の完了を待機する
+    PROFILE_ZONE_BEGIN("vkDeviceWaitIdle");
     vkDeviceWaitIdle(mods.core->device);
+    PROFILE_ZONE_END("vkDeviceWaitIdle");
 
     // 描画結果を画像ファイルに保存する
-    CHECK(saveRenderingResult(mods.core, mods.offscreen), "描画結果の保存に失敗");
+    PROFILE_ZONE_BEGIN("saveRenderingResult");
+    const int saved = saveRenderingResult(mods.core, mods.offscreen);
+    PROFILE_ZONE_END("saveRenderingResult");
+    CHECK(saved, "描画結果の保存に失敗");
+
+    // デバイスメモリの統計情報を出力する
+    printMemoryStats(mods.core->allocator);
 
     deleteModulesForOffscreen(&mods);
     return 0;
@@ -3,11 +3,159 @@
 
 #pragma once
 
+#include "../../vulkan/core.h"
+#include "../../vulkan/rendering.h"
+#include "../../vulkan/util/graph.h"
+#include "../../vulkan/util/memory/image.h"
+#include "../options.h"
+#include "png.h"
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+/// @brief Vulkanアプリケーションのうちオフスクリーンでのオブジェクトを持つ構造体
+typedef struct VulkanAppOffscreen_t {
+    Image image;
+    VkImageView imageView;
+    // レンダーパスの終了時の描画先イメージのレイアウト (レンダリングオブジェクトの作成時に与える)
+    VkImageLayout layout;
+    // 一時バッファに読み戻す画素のフォーマットと一画素あたりのバイト数
+    //
+    // NOTE: 描画先イメージのフォーマットと異なれば、読み戻す前にデバイスで変換する。
+    VkFormat readbackFormat;
+    uint32_t readbackPixelSize;
+    // 一時バッファの画素の並びと、画像ファイルの一画素あたりのバイト数 (3: RGB, 4: RGBA)
+    PngPixelLayout readbackLayout;
+    uint32_t readbackChannels;
+    // 読み戻しの変換とコピーのパスとリソースの依存関係 (最初の読み戻し時に作成する)
+    //
+    // NOTE: 変換先の一時イメージのメモリを持つため、メモリ逼迫時には破棄し、次の読み戻しで作り直す。
+    //       そのため、メモリ逼迫時コールバックから使う論理デバイスも持つ。
+    VkDevice device;
+    RenderGraph readbackGraph;
+    uint32_t readbackConvertResource;
+    uint32_t readbackBufferResource;
+    // 読み戻しのコピーのパスが参照する値
+    VkBuffer readbackBuffer;
+    uint32_t readbackWidth;
+    uint32_t readbackHeight;
+} *VulkanAppOffscreen;
+
+/// @brief VulkanAppOffscreenを破棄する関数
+/// @param core 主要オブジェクトハンドル
+/// @param offscreen オフスクリーン依存オブジェクトハンドル
+void deleteVulkanAppOffscreen(const VulkanAppCore core, VulkanAppOffscreen offscreen);
+
+/// @brief VulkanAppOffscreenを作成する関数
+///
+/// 描画先イメージとそのイメージビューを作成する。
+/// レンダリングオブジェクトは、レンダーパスの終了時のレイアウトにlayoutを与えて作成すること。
+///
+/// 読み戻す画素の形式も決める。
+/// 物理デバイスが対応していれば、読み戻す前に描画先イメージをR8G8B8A8(dropAlphaならR8G8B8)のイメージへブリットし、
+/// 画像ファイルと同じ並びの画素を一時バッファに詰める。
+/// 対応していなければ、描画先イメージの画素をそのまま読み戻し、ホストで並べ替える。
+///
+/// @param core 主要オブジェクトハンドル
+/// @param width 描画先イメージの幅
+/// @param height 描画先イメージの高
+/// @param dropAlpha 0でなければ、読み戻す画素と画像ファイルからアルファを捨てる
+/// @returns 失敗時にNULLを返す。
+VulkanAppOffscreen createVulkanAppOffscreen(const VulkanAppCore core, int width, int height, int dropAlpha);
+
+/// @brief BGRAの画素の並びをRGBAに並べ替える関数
+///
+/// 描画先イメージ(RENDER_TARGET_PIXEL_FORMAT)の画素をRGBAの並びで扱うために用いる。
+/// PNGへの保存では、読み戻す前にデバイスで変換するか、PngWriterが行毎に同じ並べ替えを行う。
+///
+/// @param src BGRAの画素の配列
+/// @param dst RGBAの画素の格納先 (srcと重なってはならない)
+/// @param pixelsCount 画素数
+void convertBGRAToRGBA(const uint8_t *src, uint8_t *dst, uint32_t pixelsCount);
+
+/// @brief 描画結果をrendering-result.pngに保存する関数
+///
+/// マップした一時バッファから一行ずつPngWriterで圧縮して書き出すため、ホストは数行分の画素しか複製しない。
+/// 読み戻しはsubmitReadbackCopy()関数で行う。
+///
+/// @param core 主要オブジェクトハンドル
+/// @param offscreen オフスクリーン依存オブジェクトハンドル
+/// @returns 失敗時に0を返す。
+int saveRenderingResult(const VulkanAppCore core, const VulkanAppOffscreen offscreen);
+
+/// @brief 描画先イメージの左上のwidth x heightを一時バッファへコピーするコマンドを提出する関数
+///
+/// 変換のブリットとコピーをパスとするレンダーグラフを最初の呼出しで作成し、以降は一時バッファを差し替えて使い回す。
+/// グラフは描画先イメージを、レンダーパスの終了時のレイアウト(offscreen->layout)で描画が書き込んだものとして受け取り、
+/// 描画の完了を待つバリア・コピー元のレイアウトへの遷移・次の描画がコピーを追い越さないバリア・ホストの読込みに備えるバリアを導く。
+/// 一時バッファにはwidth x heightの画素をoffscreen->readbackFormatで隙間なく詰める。
+/// 大きさはgetReadbackBufferSize()関数で求められる。
+///
+/// @param core 主要オブジェクトハンドル
+/// @param offscreen オフスクリーン依存オブジェクトハンドル
+/// @param buffer コピー先の一時バッファ (VK_BUFFER_USAGE_TRANSFER_DST_BITを持つこと)
+/// @param width コピーする幅
+/// @param height コピーする高
+/// @param fence コピーが完了したらシグナルされるフェンス (VK_NULL_HANDLEでもよい)
+/// @returns 失敗時に0を返す。
+int submitReadbackCopy(
+    const VulkanAppCore core,
+    const VulkanAppOffscreen offscreen,
+    VkBuffer buffer,
+    uint32_t width,
+    uint32_t height,
+    VkFence fence
+);
+
+/// @brief width x heightの画素を読み戻す一時バッファの大きさを求める関数
+/// @param offscreen オフスクリーン依存オブジェクトハンドル
+/// @param width 読み戻す幅
+/// @param height 読み戻す高
+/// @returns 一時バッファのバイト数を返す。
+VkDeviceSize getReadbackBufferSize(const VulkanAppOffscreen offscreen, uint32_t width, uint32_t height);
+
+/// @brief 描画先イメージより大きな画像をタイルに分けて描画し、PNG形式の画像ファイルに書き出す関数
+///
+/// 描画先イメージの大きさのタイル毎に射影を調整して描画し、読み戻しと書き出しをタイルの描画と並行して行う。
+/// 行は上から順にファイルへ書き出すため、ホストのメモリ使用量は画像全体の幅 x 描画先イメージの高に比例し、画像の高さに依らない。
+/// 描画先イメージのレイアウトがレンダーパスの最後にVK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMALとなること。
+///
+/// @param core 主要オブジェクトハンドル
+/// @param offscreen オフスクリーン依存オブジェクトハンドル
+/// @param renderer レンダリングオブジェクトハンドル (描画先イメージに描画すること)
+/// @param fullWidth 画像全体の幅
+/// @param fullHeight 画像全体の高
+/// @param path 書き出す画像ファイルのパス
+/// @returns 失敗時に0を返す。
+int exportTiledRenderingResult(
+    const VulkanAppCore core,
+    const VulkanAppOffscreen offscreen,
+    const VulkanAppRendering renderer,
+    uint32_t fullWidth,
+    uint32_t fullHeight,
+    const char *path
+);
+
+/// @brief オフスクリーン向けのレンダリングオブジェクトを作成する関数
+///
+/// 描画先イメージに描画し、レンダーパスの最後にそのレイアウトをVK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMALとする。
+/// コマンドラインオプションに応じてメッシュのインスタンス描画・メッシュレットのカリング・深度プリパス・描画の仕事量の計測を有効にし、
+/// パイプラインの作成の完了まで待機する。
+///
+/// @param core 主要オブジェクトハンドル
+/// @param offscreen オフスクリーン依存オブジェクトハンドル
+/// @param options コマンドラインオプション
+/// @returns 失敗時にNULLを返す。
+VulkanAppRendering createOffscreenRendering(const VulkanAppCore core, const VulkanAppOffscreen offscreen, const AppOptions *options);
+
 /// @brief Vulkanアプリケーションをオフスクリーンで実行するための関数
 ///
 /// 1フレームだけレンダリングを行い、その結果をout/rendering-result.pngに保存する。
+/// --export-widthと--export-heightが指定されていれば、代わりにその大きさの画像をタイルに分けて描画し、APP_EXPORT_OUTPUT_PATHへ書き出す。
+/// --batchが指定されていれば、代わりにrunOffscreenBatch()関数で複数のフレームを描画する。
 ///
 /// @param width スクリーン幅
 /// @param height スクリーン高
+/// @param options コマンドラインオプション
 /// @returns 正常終了時に0を返す。
-int runOnOffscreen(int width, int height);
+int runOnOffscreen(int width, int height, const AppOptions *options);
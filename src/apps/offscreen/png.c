@@ -0,0 +1,481 @@
+#include "png.h"
+
+// fopen()関数の使用に対してwarningを出さないためにこのマクロを定義する
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "../../vulkan/util/error.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// deflateの一致の長さの範囲
+#define DEFLATE_MIN_MATCH 3
+#define DEFLATE_MAX_MATCH 258
+
+// Adler-32の法と、32ビットで溢れずに和を取れるバイト数
+#define ADLER_MOD 65521
+#define ADLER_BLOCK 5552
+
+// 長さの符号(257..285)毎の基準値と追加ビット数
+static const uint16_t LENGTH_BASES[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+static const uint8_t LENGTH_EXTRA_BITS[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+
+// 距離の符号(0..29)毎の基準値と追加ビット数
+static const uint16_t DISTANCE_BASES[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577,
+};
+static const uint8_t DISTANCE_EXTRA_BITS[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// チャンクのCRC-32を求める関数
+//
+// NOTE: 表は初回の呼出しで作る。
+static uint32_t updateCrc32(uint32_t crc, const uint8_t *data, size_t size) {
+    static uint32_t table[256];
+    static int tableReady = 0;
+    if (!tableReady) {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (uint32_t k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        tableReady = 1;
+    }
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void storeBigEndian(uint8_t *dst, uint32_t value) {
+    dst[0] = (uint8_t)(value >> 24);
+    dst[1] = (uint8_t)(value >> 16);
+    dst[2] = (uint8_t)(value >> 8);
+    dst[3] = (uint8_t)value;
+}
+
+// チャンクを書き出す関数
+//
+// NOTE: typeAndDataは種類の4バイトとデータを続けて持つ。CRCはその全体に対して求める。
+static void writeChunk(PngWriter writer, const uint8_t *typeAndData, uint32_t dataSize) {
+    uint8_t length[4];
+    uint8_t crc[4];
+    storeBigEndian(length, dataSize);
+    storeBigEndian(crc, updateCrc32(0, typeAndData, 4 + (size_t)dataSize));
+    if (
+        fwrite((const void *)length, 1, 4, writer->file) != 4
+        || fwrite((const void *)typeAndData, 1, 4 + (size_t)dataSize, writer->file) != 4 + (size_t)dataSize
+        || fwrite((const void *)crc, 1, 4, writer->file) != 4
+    ) {
+        writer->failed = 1;
+    }
+}
+
+static void flushIdatChunk(PngWriter writer) {
+    if (writer->chunkSize == 0) {
+        return;
+    }
+    writeChunk(writer, writer->chunk, writer->chunkSize);
+    writer->chunkSize = 0;
+}
+
+// 圧縮後のデータを一バイト出力する関数
+static void putByte(PngWriter writer, uint8_t value) {
+    writer->chunk[4 + writer->chunkSize] = value;
+    writer->chunkSize += 1;
+    if (writer->chunkSize == PNG_WRITER_CHUNK_SIZE) {
+        flushIdatChunk(writer);
+    }
+}
+
+// 下位のビットから順に出力する関数
+static void putBits(PngWriter writer, uint32_t value, uint32_t count) {
+    writer->bits |= value << writer->bitsCount;
+    writer->bitsCount += count;
+    while (writer->bitsCount >= 8) {
+        putByte(writer, (uint8_t)writer->bits);
+        writer->bits >>= 8;
+        writer->bitsCount -= 8;
+    }
+}
+
+// ハフマン符号を出力する関数
+//
+// NOTE: ハフマン符号のみは上位のビットから順に詰めるため、反転してから出力する。
+static void putHuffman(PngWriter writer, uint32_t code, uint32_t length) {
+    uint32_t reversed = 0;
+    for (uint32_t i = 0; i < length; ++i) {
+        reversed = (reversed << 1) | ((code >> i) & 1);
+    }
+    putBits(writer, reversed, length);
+}
+
+// 固定ハフマン符号でリテラル・長さの符号を出力する関数
+static void putSymbol(PngWriter writer, uint32_t symbol) {
+    if (symbol <= 143) putHuffman(writer, 0x30 + symbol, 8);
+    else if (symbol <= 255) putHuffman(writer, 0x190 + symbol - 144, 9);
+    else if (symbol <= 279) putHuffman(writer, symbol - 256, 7);
+    else putHuffman(writer, 0xc0 + symbol - 280, 8);
+}
+
+static void putMatch(PngWriter writer, uint32_t length, uint32_t distance) {
+    uint32_t l = 28;
+    while (LENGTH_BASES[l] > length) {
+        l -= 1;
+    }
+    putSymbol(writer, 257 + l);
+    putBits(writer, length - LENGTH_BASES[l], LENGTH_EXTRA_BITS[l]);
+    uint32_t d = 29;
+    while (DISTANCE_BASES[d] > distance) {
+        d -= 1;
+    }
+    putHuffman(writer, d, 5);
+    putBits(writer, distance - DISTANCE_BASES[d], DISTANCE_EXTRA_BITS[d]);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t hashAt(const PngWriter writer, uint32_t pos) {
+    const uint8_t *p = &writer->buffer[pos];
+    return (((uint32_t)p[0] << 10) ^ ((uint32_t)p[1] << 5) ^ (uint32_t)p[2]) & (PNG_WRITER_HASH_SIZE - 1);
+}
+
+// 位置をハッシュ連鎖に加える関数
+static void insertHash(PngWriter writer, uint32_t pos) {
+    if (pos + DEFLATE_MIN_MATCH > writer->filled) {
+        return;
+    }
+    const uint32_t hash = hashAt(writer, pos);
+    writer->prev[pos & (PNG_WRITER_WINDOW_SIZE - 1)] = writer->head[hash];
+    writer->head[hash] = (int32_t)pos;
+}
+
+// bufferのうちendの手前までを圧縮する関数
+//
+// NOTE: 各位置で参照窓の中の最も長い一致を探し、3バイト以上ならば長さと距離を、でなければリテラルを出力する。
+//       一致はendを超えて延びてもよいため、endはfilledから最大の一致の長さだけ手前にしておけば、一致を取りこぼさない。
+static void compressBuffer(PngWriter writer, uint32_t end) {
+    while (writer->cursor < end) {
+        const uint32_t cursor = writer->cursor;
+        const uint32_t available = writer->filled - cursor;
+        const uint32_t maxLength = available < DEFLATE_MAX_MATCH ? available : DEFLATE_MAX_MATCH;
+        uint32_t bestLength = 0;
+        uint32_t bestDistance = 0;
+        if (maxLength >= DEFLATE_MIN_MATCH) {
+            int32_t candidate = writer->head[hashAt(writer, cursor)];
+            for (uint32_t chain = 0; chain < PNG_WRITER_MAX_CHAIN && candidate >= 0; ++chain) {
+                const uint32_t distance = cursor - (uint32_t)candidate;
+                if (distance > PNG_WRITER_WINDOW_SIZE) {
+                    break;
+                }
+                const uint8_t *a = &writer->buffer[candidate];
+                const uint8_t *b = &writer->buffer[cursor];
+                uint32_t length = 0;
+                while (length < maxLength && a[length] == b[length]) {
+                    length += 1;
+                }
+                if (length > bestLength) {
+                    bestLength = length;
+                    bestDistance = distance;
+                    if (length == maxLength) {
+                        break;
+                    }
+                }
+                const int32_t next = writer->prev[(uint32_t)candidate & (PNG_WRITER_WINDOW_SIZE - 1)];
+                if (next >= candidate) {
+                    break;
+                }
+                candidate = next;
+            }
+        }
+        if (bestLength >= DEFLATE_MIN_MATCH) {
+            putMatch(writer, bestLength, bestDistance);
+            for (uint32_t i = 0; i < bestLength; ++i) {
+                insertHash(writer, cursor + i);
+            }
+            writer->cursor += bestLength;
+        } else {
+            putSymbol(writer, writer->buffer[cursor]);
+            insertHash(writer, cursor);
+            writer->cursor += 1;
+        }
+    }
+}
+
+// bufferを参照窓の大きさだけ前へずらす関数
+//
+// NOTE: 参照窓の大きさだけずらすため、prevの添字(位置の下位ビット)は変わらない。位置の値のみを引き直す。
+static void slideBuffer(PngWriter writer) {
+    const uint32_t shift = PNG_WRITER_WINDOW_SIZE;
+    memmove((void *)writer->buffer, (const void *)&writer->buffer[shift], writer->filled - shift);
+    writer->filled -= shift;
+    writer->cursor -= shift;
+    for (uint32_t i = 0; i < PNG_WRITER_HASH_SIZE; ++i) {
+        writer->head[i] = writer->head[i] >= (int32_t)shift ? writer->head[i] - (int32_t)shift : -1;
+    }
+    for (uint32_t i = 0; i < PNG_WRITER_WINDOW_SIZE; ++i) {
+        writer->prev[i] = writer->prev[i] >= (int32_t)shift ? writer->prev[i] - (int32_t)shift : -1;
+    }
+}
+
+// 圧縮前のデータを加える関数
+//
+// NOTE: bufferが一杯になったら、最大の一致の長さを残して圧縮し、参照窓の分だけを残してずらす。
+static void feedData(PngWriter writer, const uint8_t *data, uint32_t size) {
+    // Adler-32を更新する
+    {
+        uint32_t a = writer->adlerA;
+        uint32_t b = writer->adlerB;
+        uint32_t i = 0;
+        while (i < size) {
+            const uint32_t end = size - i < ADLER_BLOCK ? size : i + ADLER_BLOCK;
+            for (; i < end; ++i) {
+                a += data[i];
+                b += a;
+            }
+            a %= ADLER_MOD;
+            b %= ADLER_MOD;
+        }
+        writer->adlerA = a;
+        writer->adlerB = b;
+    }
+
+    while (size > 0) {
+        const uint32_t space = PNG_WRITER_BUFFER_SIZE - writer->filled;
+        const uint32_t n = size < space ? size : space;
+        memcpy((void *)&writer->buffer[writer->filled], (const void *)data, n);
+        writer->filled += n;
+        data += n;
+        size -= n;
+        if (writer->filled == PNG_WRITER_BUFFER_SIZE) {
+            compressBuffer(writer, PNG_WRITER_BUFFER_SIZE - DEFLATE_MAX_MATCH);
+            slideBuffer(writer);
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void deletePngWriter(PngWriter writer) {
+    if (writer == NULL) {
+        return;
+    }
+    if (writer->file != NULL) fclose(writer->file);
+    if (writer->prevRow != NULL) free((void *)writer->prevRow);
+    if (writer->row != NULL) free((void *)writer->row);
+    if (writer->candidateRow != NULL) free((void *)writer->candidateRow);
+    if (writer->bestRow != NULL) free((void *)writer->bestRow);
+    free((void *)writer);
+}
+
+PngWriter createPngWriter(const char *path, uint32_t width, uint32_t height, uint32_t channels) {
+#define CHECK(p, m) ERROR_IF(!(p), "createPngWriter()", (m), deletePngWriter(writer), NULL)
+
+    const PngWriter writer = (PngWriter)malloc(sizeof(struct PngWriter_t));
+    CHECK(writer != NULL, "PngWriterの確保に失敗");
+    memset(writer, 0, sizeof(struct PngWriter_t));
+    CHECK(width > 0 && height > 0, "画像の大きさが0");
+    CHECK(channels == 3 || channels == 4, "一画素あたりのバイト数が不正");
+    writer->width = width;
+    writer->height = height;
+    writer->channels = channels;
+    writer->adlerA = 1;
+    writer->adlerB = 0;
+    memset((void *)writer->head, 0xff, sizeof(writer->head));
+    memset((void *)writer->prev, 0xff, sizeof(writer->prev));
+    memcpy((void *)writer->chunk, (const void *)"IDAT", 4);
+
+    // 行を確保する
+    //
+    // NOTE: 最初の行の一つ前の行は全て0とみなすため、prevRowは0で埋めておく。
+    {
+        const size_t rowSize = (size_t)width * channels;
+        writer->prevRow = (uint8_t *)calloc(rowSize, 1);
+        writer->row = (uint8_t *)malloc(rowSize);
+        writer->candidateRow = (uint8_t *)malloc(rowSize + 1);
+        writer->bestRow = (uint8_t *)malloc(rowSize + 1);
+        CHECK(
+            writer->prevRow != NULL && writer->row != NULL && writer->candidateRow != NULL && writer->bestRow != NULL,
+            "行の確保に失敗"
+        );
+    }
+
+    // ファイルを開き、シグネチャとIHDRチャンクを書き出す
+    {
+        writer->file = fopen(path, "wb");
+        CHECK(writer->file != NULL, "ファイルのオープンに失敗");
+        const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        CHECK(fwrite((const void *)signature, 1, 8, writer->file) == 8, "シグネチャの書込みに失敗");
+        // NOTE: ビット深度8、カラータイプ6(RGBA)あるいは2(RGB)、圧縮・フィルタ・インターレースの方式は0。
+        uint8_t ihdr[4 + 13] = { 'I', 'H', 'D', 'R' };
+        storeBigEndian(&ihdr[4], width);
+        storeBigEndian(&ihdr[8], height);
+        ihdr[12] = 8;
+        ihdr[13] = channels == 4 ? 6 : 2;
+        writeChunk(writer, ihdr, 13);
+        CHECK(!writer->failed, "IHDRチャンクの書込みに失敗");
+    }
+
+    // zlibのヘッダと、deflateの最初のブロックのヘッダを出力する
+    //
+    // NOTE: 全ての行を固定ハフマン符号の一つのブロックに続けて詰める。最後のブロックはfinishPngWriter()関数で空のものを加える。
+    {
+        putByte(writer, 0x78);
+        putByte(writer, 0x01);
+        putBits(writer, 0, 1);
+        putBits(writer, 1, 2);
+    }
+
+    return writer;
+
+#undef CHECK
+}
+
+int writePngRow(PngWriter writer, const uint8_t *pixels, PngPixelLayout layout) {
+#define CHECK(p, m) ERROR_IF(!(p), "writePngRow()", (m), {}, 0)
+
+    CHECK(writer->rowsCount < writer->height, "画像の高さを超えて書き込もうとした");
+    const uint32_t channels = writer->channels;
+    const uint32_t rowSize = writer->width * channels;
+
+    // 画素を並べ替える
+    //
+    // NOTE: 同じ並びであれば写すだけで済む。読み戻す前にデバイスで変換しておけば、ホストの画素毎の処理は無くなる。
+    if (layout == PNG_PIXEL_LAYOUT_BGRA) {
+        for (uint32_t i = 0; i < writer->width; ++i) {
+            writer->row[i * channels + 0] = pixels[i * 4 + 2];
+            writer->row[i * channels + 1] = pixels[i * 4 + 1];
+            writer->row[i * channels + 2] = pixels[i * 4 + 0];
+            if (channels == 4) writer->row[i * channels + 3] = pixels[i * 4 + 3];
+        }
+    } else if (layout == PNG_PIXEL_LAYOUT_RGBA && channels == 3) {
+        for (uint32_t i = 0; i < writer->width; ++i) {
+            writer->row[i * 3 + 0] = pixels[i * 4 + 0];
+            writer->row[i * 3 + 1] = pixels[i * 4 + 1];
+            writer->row[i * 3 + 2] = pixels[i * 4 + 2];
+        }
+    } else {
+        memcpy((void *)writer->row, (const void *)pixels, rowSize);
+    }
+
+    // フィルタを選ぶ
+    //
+    // NOTE: 差分を符号付きとみなした絶対値の和が最も小さいものを選ぶ。
+    {
+        const uint8_t *row = writer->row;
+        const uint8_t *up = writer->prevRow;
+        uint32_t bestCost = UINT32_MAX;
+        for (uint32_t filter = 0; filter < 5; ++filter) {
+            uint8_t *dst = writer->candidateRow;
+            uint32_t cost = 0;
+            dst[0] = (uint8_t)filter;
+            for (uint32_t i = 0; i < rowSize; ++i) {
+                const int a = i >= channels ? row[i - channels] : 0;
+                const int b = up[i];
+                const int c = i >= channels ? up[i - channels] : 0;
+                int predictor = 0;
+                switch (filter) {
+                    case 1: predictor = a; break;
+                    case 2: predictor = b; break;
+                    case 3: predictor = (a + b) >> 1; break;
+                    case 4: {
+                        const int p = a + b - c;
+                        const int pa = abs(p - a);
+                        const int pb = abs(p - b);
+                        const int pc = abs(p - c);
+                        predictor = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+                        break;
+                    }
+                    default: break;
+                }
+                const uint8_t value = (uint8_t)(row[i] - predictor);
+                dst[1 + i] = value;
+                cost += (uint32_t)abs((int)(int8_t)value);
+            }
+            if (cost < bestCost) {
+                bestCost = cost;
+                writer->candidateRow = writer->bestRow;
+                writer->bestRow = dst;
+            }
+        }
+    }
+
+    // 圧縮する
+    {
+        feedData(writer, writer->bestRow, rowSize + 1);
+        CHECK(!writer->failed, "IDATチャンクの書込みに失敗");
+    }
+
+    // 現在の行を一つ前の行とする
+    {
+        uint8_t *swap = writer->prevRow;
+        writer->prevRow = writer->row;
+        writer->row = swap;
+        writer->rowsCount += 1;
+    }
+
+    return 1;
+
+#undef CHECK
+}
+
+int finishPngWriter(PngWriter writer) {
+#define CHECK(p, m) ERROR_IF(!(p), "finishPngWriter()", (m), {}, 0)
+
+    CHECK(writer->rowsCount == writer->height, "書き込んだ行数が画像の高さに満たない");
+
+    // 残りを圧縮し、ブロックを閉じる
+    //
+    // NOTE: 最後に空の固定ハフマン符号のブロックを加え、BFINALを立てる。
+    {
+        compressBuffer(writer, writer->filled);
+        putSymbol(writer, 256);
+        putBits(writer, 1, 1);
+        putBits(writer, 1, 2);
+        putSymbol(writer, 256);
+        if (writer->bitsCount > 0) {
+            putBits(writer, 0, 8 - writer->bitsCount);
+        }
+    }
+
+    // Adler-32を出力し、IDATチャンクとIENDチャンクを書き出す
+    {
+        const uint32_t adler = (writer->adlerB << 16) | writer->adlerA;
+        putByte(writer, (uint8_t)(adler >> 24));
+        putByte(writer, (uint8_t)(adler >> 16));
+        putByte(writer, (uint8_t)(adler >> 8));
+        putByte(writer, (uint8_t)adler);
+        flushIdatChunk(writer);
+        const uint8_t iend[4] = { 'I', 'E', 'N', 'D' };
+        writeChunk(writer, iend, 0);
+        CHECK(!writer->failed, "チャンクの書込みに失敗");
+    }
+
+    // ファイルを閉じる
+    {
+        const int closed = fclose(writer->file) == 0;
+        writer->file = NULL;
+        CHECK(closed, "ファイルのクローズに失敗");
+    }
+
+    return 1;
+
+#undef CHECK
+}
@@ -0,0 +1,115 @@
+/// @file png.h
+/// @brief PNG画像ファイルを一行ずつ書き出すモジュール
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+/// @brief 圧縮前のデータを溜めるバッファのサイズ
+///
+/// NOTE: 前半の32KBはdeflateの参照窓、後半は次に圧縮するデータの格納先となる。
+#define PNG_WRITER_BUFFER_SIZE (64 * 1024)
+
+/// @brief deflateの参照窓のサイズ
+#define PNG_WRITER_WINDOW_SIZE (32 * 1024)
+
+/// @brief 一致を探す際にハッシュ連鎖を辿る最大数
+///
+/// NOTE: 大きいほど圧縮率は上がるが、遅くなる。
+#define PNG_WRITER_MAX_CHAIN 32
+
+/// @brief 一つのIDATチャンクに詰める圧縮後のデータの最大サイズ
+#define PNG_WRITER_CHUNK_SIZE (64 * 1024)
+
+/// @brief 3バイトのハッシュの表の大きさ
+#define PNG_WRITER_HASH_SIZE (1 << 15)
+
+/// @brief writePngRow()関数に与える画素の並び
+typedef enum PngPixelLayout_t {
+    // 書き出す並びと同じ (一画素あたりPngWriter.channelsバイト)
+    PNG_PIXEL_LAYOUT_PACKED = 0,
+    // 一画素4バイトのBGRA (並べ替え、書き出しがRGBならアルファを捨てる)
+    PNG_PIXEL_LAYOUT_BGRA,
+    // 一画素4バイトのRGBA (書き出しがRGBならアルファを捨てる)
+    PNG_PIXEL_LAYOUT_RGBA,
+} PngPixelLayout;
+
+/// @brief PNG画像ファイルを一行ずつ書き出すオブジェクトを持つ構造体
+///
+/// 画素の並べ替え・フィルタ・deflateによる圧縮を行単位で行い、IDATチャンクが溜まる毎にファイルへ書き出す。
+/// 保持するのは数行分の画素と、deflateの参照窓・ハッシュの表・一つのIDATチャンク分の出力のみであり、
+/// メモリ使用量は画像の高さに依らない。
+///
+/// deflateは固定ハフマン符号のブロックとし、LZ77の一致は参照窓の中からハッシュ連鎖で探す。
+typedef struct PngWriter_t {
+    FILE *file;
+    // ファイルへの書込みに失敗していれば1
+    int failed;
+    uint32_t width;
+    uint32_t height;
+    // 一画素あたりのバイト数 (3: RGB, 4: RGBA)
+    uint32_t channels;
+    // 書き込んだ行数
+    uint32_t rowsCount;
+    // 一つ前の行と現在の行の画素 (フィルタ前)
+    uint8_t *prevRow;
+    uint8_t *row;
+    // フィルタを試した結果と、それまでで最良の結果 (先頭はフィルタの種類)
+    uint8_t *candidateRow;
+    uint8_t *bestRow;
+    // 圧縮前のデータ
+    uint8_t buffer[PNG_WRITER_BUFFER_SIZE];
+    // bufferに溜まっているバイト数と、次に圧縮する位置
+    uint32_t filled;
+    uint32_t cursor;
+    // 3バイトのハッシュ毎の最も新しい位置と、位置毎の同じハッシュを持つ一つ前の位置 (無ければ-1)
+    int32_t head[PNG_WRITER_HASH_SIZE];
+    int32_t prev[PNG_WRITER_WINDOW_SIZE];
+    // ビット単位の出力のうち、まだバイトに揃っていない部分
+    uint32_t bits;
+    uint32_t bitsCount;
+    // 圧縮後のデータ (IDATチャンクの種類の4バイトを先頭に持つ)
+    uint8_t chunk[4 + PNG_WRITER_CHUNK_SIZE];
+    uint32_t chunkSize;
+    // 圧縮前のデータのAdler-32
+    uint32_t adlerA;
+    uint32_t adlerB;
+} *PngWriter;
+
+/// @brief PngWriterを破棄する関数
+///
+/// finishPngWriter()関数を呼ぶ前に破棄すると、書き出し途中のファイルが残る。
+///
+/// @param writer PNG書き出しオブジェクトハンドル
+void deletePngWriter(PngWriter writer);
+
+/// @brief PngWriterを作成する関数
+///
+/// ファイルを開き、シグネチャとIHDRチャンクを書き出す。
+///
+/// @param path ファイルパス
+/// @param width 画像の幅
+/// @param height 画像の高
+/// @param channels 一画素あたりのバイト数 (3: RGB, 4: RGBA)
+/// @returns 失敗時にNULLを返す。
+PngWriter createPngWriter(const char *path, uint32_t width, uint32_t height, uint32_t channels);
+
+/// @brief 一行分の画素を書き込む関数
+///
+/// 行毎に5種類のフィルタを試し、差分の絶対値の和が最も小さいものを選ぶ。
+/// 圧縮したデータがIDATチャンク一つ分溜まればファイルへ書き出す。
+///
+/// @param writer PNG書き出しオブジェクトハンドル
+/// @param pixels 一行分の画素
+/// @param layout pixelsの画素の並び (PNG_PIXEL_LAYOUT_PACKEDなら並べ替えずにそのまま写す)
+/// @returns 失敗時に0を返す。
+int writePngRow(PngWriter writer, const uint8_t *pixels, PngPixelLayout layout);
+
+/// @brief 残りのデータを圧縮し、IENDチャンクまで書き出してファイルを閉じる関数
+///
+/// 全ての行を書き込んでから呼ぶこと。
+///
+/// @param writer PNG書き出しオブジェクトハンドル
+/// @returns 失敗時に0を返す。
+int finishPngWriter(PngWriter writer);
@@ -0,0 +1,168 @@
+#include "options.h"
+
+#include "../vulkan/presentation.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 値を取るオプションの値を取得する関数
+static const char *getOptionValue(int argc, char *argv[], int *i) {
+    if (*i + 1 >= argc) {
+        printf("[ error ] parseAppOptions(): オプションに値がありません: %s\n", argv[*i]);
+        return NULL;
+    }
+    *i += 1;
+    return argv[*i];
+}
+
+// 値を取るオプションの値を正の整数として取得する関数
+static int getOptionUInt(int argc, char *argv[], int *i, unsigned int *value) {
+    const char *option = argv[*i];
+    const char *text = getOptionValue(argc, argv, i);
+    if (text == NULL) {
+        return 0;
+    }
+    char *end = NULL;
+    const long parsed = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || parsed < 0) {
+        printf("[ error ] parseAppOptions(): オプションの値が無効です: %s %s\n", option, text);
+        return 0;
+    }
+    *value = (unsigned int)parsed;
+    return 1;
+}
+
+int parseAppOptions(int argc, char *argv[], AppOptions *options) {
+    memset(options, 0, sizeof(AppOptions));
+    options->benchWarmup = APP_BENCH_DEFAULT_WARMUP;
+    options->benchRepetitions = APP_BENCH_DEFAULT_REPETITIONS;
+    options->benchOutputPath = APP_BENCH_DEFAULT_OUTPUT_PATH;
+    options->benchThreshold = APP_BENCH_DEFAULT_THRESHOLD;
+    options->presentPreference = PRESENT_PREFERENCE_NO_TEARING;
+
+    for (int i = 0; i < argc; ++i) {
+        if (strcmp(argv[i], "--hot-reload") == 0) {
+            options->hotReload = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "--profile") == 0) {
+            options->profile = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "--depth-prepass") == 0) {
+            options->depthPrepass = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "--gpu-stats") == 0) {
+            options->gpuStats = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "--instances") == 0) {
+            if (!getOptionUInt(argc, argv, &i, &options->meshInstances)) return 0;
+            continue;
+        }
+        if (strcmp(argv[i], "--meshlet-cull") == 0) {
+            options->meshletCull = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "--msaa") == 0) {
+            if (!getOptionUInt(argc, argv, &i, &options->msaaSamples)) return 0;
+            if (options->msaaSamples > 64 || (options->msaaSamples & (options->msaaSamples - 1)) != 0) {
+                printf("[ error ] parseAppOptions(): --msaaは64以下の2の冪でなければなりません\n");
+                return 0;
+            }
+            continue;
+        }
+        if (strcmp(argv[i], "--present-mode") == 0) {
+            const char *value = getOptionValue(argc, argv, &i);
+            if (value == NULL) return 0;
+            if (strcmp(value, "no-tearing") == 0) {
+                options->presentPreference = PRESENT_PREFERENCE_NO_TEARING;
+            } else if (strcmp(value, "low-latency") == 0) {
+                options->presentPreference = PRESENT_PREFERENCE_LOW_LATENCY;
+            } else if (strcmp(value, "uncapped") == 0) {
+                options->presentPreference = PRESENT_PREFERENCE_UNCAPPED;
+            } else {
+                printf("[ error ] parseAppOptions(): オプションの値が無効です: --present-mode %s\n", value);
+                return 0;
+            }
+            continue;
+        }
+        if (strcmp(argv[i], "--swapchain-images") == 0) {
+            if (!getOptionUInt(argc, argv, &i, &options->swapchainImages)) return 0;
+            continue;
+        }
+        if (strcmp(argv[i], "--fps-limit") == 0) {
+            if (!getOptionUInt(argc, argv, &i, &options->fpsLimit)) return 0;
+            continue;
+        }
+        if (strcmp(argv[i], "--frames") == 0) {
+            if (!getOptionUInt(argc, argv, &i, &options->frames)) return 0;
+            continue;
+        }
+        if (strcmp(argv[i], "--export-width") == 0) {
+            if (!getOptionUInt(argc, argv, &i, &options->exportWidth)) return 0;
+            continue;
+        }
+        if (strcmp(argv[i], "--export-height") == 0) {
+            if (!getOptionUInt(argc, argv, &i, &options->exportHeight)) return 0;
+            continue;
+        }
+        if (strcmp(argv[i], "--batch") == 0) {
+            if (!getOptionUInt(argc, argv, &i, &options->batchFrames)) return 0;
+            continue;
+        }
+        if (strcmp(argv[i], "--devices") == 0) {
+            if (!getOptionUInt(argc, argv, &i, &options->batchDevices)) return 0;
+            continue;
+        }
+        if (strcmp(argv[i], "--readback-rgb") == 0) {
+            options->readbackRgb = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "--bench-warmup") == 0) {
+            if (!getOptionUInt(argc, argv, &i, &options->benchWarmup)) return 0;
+            continue;
+        }
+        if (strcmp(argv[i], "--bench-reps") == 0) {
+            if (!getOptionUInt(argc, argv, &i, &options->benchRepetitions)) return 0;
+            if (options->benchRepetitions == 0) {
+                printf("[ error ] parseAppOptions(): --bench-repsは1以上でなければなりません\n");
+                return 0;
+            }
+            continue;
+        }
+        if (strcmp(argv[i], "--bench-out") == 0) {
+            options->benchOutputPath = getOptionValue(argc, argv, &i);
+            if (options->benchOutputPath == NULL) return 0;
+            continue;
+        }
+        if (strcmp(argv[i], "--bench-filter") == 0) {
+            options->benchFilter = getOptionValue(argc, argv, &i);
+            if (options->benchFilter == NULL) return 0;
+            continue;
+        }
+        if (strcmp(argv[i], "--bench-baseline") == 0) {
+            options->benchBaselinePath = getOptionValue(argc, argv, &i);
+            if (options->benchBaselinePath == NULL) return 0;
+            continue;
+        }
+        if (strcmp(argv[i], "--bench-threshold") == 0) {
+            if (!getOptionUInt(argc, argv, &i, &options->benchThreshold)) return 0;
+            continue;
+        }
+        printf("[ error ] parseAppOptions(): 無効なオプションです: %s\n", argv[i]);
+        return 0;
+    }
+    if ((options->exportWidth == 0) != (options->exportHeight == 0)) {
+        printf("[ error ] parseAppOptions(): --export-widthと--export-heightは併せて指定しなければなりません\n");
+        return 0;
+    }
+    if (options->batchFrames > 0 && options->exportWidth > 0) {
+        printf("[ error ] parseAppOptions(): --batchと--export-widthは併せて指定できません\n");
+        return 0;
+    }
+
+    return 1;
+}
@@ -0,0 +1,106 @@
+/// @file options.h
+/// @brief アプリケーションのコマンドラインオプションを定義するモジュール
+
+#pragma once
+
+/// @brief --profileオプションで書き出すJSONファイルのパス
+#define APP_PROFILE_OUTPUT_PATH "./profile.json"
+
+/// @brief --instancesオプションで描画するモデルデータファイルのパス
+#define APP_MESH_MODEL_PATH "./model/utah.raw"
+
+/// @brief --export-widthオプションで書き出す画像ファイルのパス
+#define APP_EXPORT_OUTPUT_PATH "./rendering-export.png"
+
+/// @brief --export-widthオプションで一度に描画するタイルの幅の上限
+#define APP_EXPORT_TILE_WIDTH 2048
+
+/// @brief --export-widthオプションで一度に描画するタイルの高の上限
+///
+/// NOTE: ホストはタイルの高さ分の行(画像全体の幅 x タイルの高 x 4バイト)のみを保持するため、メモリ使用量はこれで決まる。
+#define APP_EXPORT_TILE_HEIGHT 256
+
+/// @brief --batchオプションで書き出すフレーム毎の画像ファイルのパスの書式 (フレームの番号を与える)
+#define APP_BATCH_OUTPUT_FORMAT "./rendering-batch-%05u.png"
+
+/// @brief headlessで--framesオプションが与えられない場合に表示するフレーム数
+#define APP_HEADLESS_DEFAULT_FRAMES 300
+
+/// @brief --bench-warmupオプションの既定値
+#define APP_BENCH_DEFAULT_WARMUP 3
+
+/// @brief --bench-repsオプションの既定値
+#define APP_BENCH_DEFAULT_REPETITIONS 20
+
+/// @brief --bench-outオプションの既定値
+#define APP_BENCH_DEFAULT_OUTPUT_PATH "./bench-result.json"
+
+/// @brief --bench-thresholdオプションの既定値(%)
+#define APP_BENCH_DEFAULT_THRESHOLD 10
+
+/// @brief コマンドラインオプションを持つ構造体
+typedef struct AppOptions_t {
+    // --hot-reload: シェーダの変更を監視し、再コンパイルしてパイプラインを差し替える
+    int hotReload;
+    // --profile: CPU側の処理時間を計測し、APP_PROFILE_OUTPUT_PATHへChrome Trace形式で書き出す
+    //
+    // NOTE: ENABLE_PROFILERマクロを定義してビルドした場合のみ有効となる。
+    int profile;
+    // --depth-prepass: 深度のみを先に描画し、本描画では最も手前のフラグメントのみをシェーディングする
+    int depthPrepass;
+    // --gpu-stats: パス毎の描画の仕事量をクエリで計測し、終了時に出力する
+    int gpuStats;
+    // --instances <N>: APP_MESH_MODEL_PATHのモデルを陰影付きでN個インスタンス描画する (0なら描画しない)
+    unsigned int meshInstances;
+    // --meshlet-cull: LOD0のインスタンスをメッシュレット毎にコンピュートシェーダでカリングしてから描画する (--instancesと併せて使う)
+    int meshletCull;
+    // --msaa <N>: N倍のマルチサンプルで描画し、レンダーパスの中でリゾルブする (0か1ならマルチサンプルしない)
+    //
+    // NOTE: 物理デバイスが対応していなければ、対応しているN以下の最大のサンプル数を用いる。
+    unsigned int msaaSamples;
+    // --present-mode <no-tearing|low-latency|uncapped>: ウィンドウへの表示に使うプレゼンテーションモードの選び方 (既定値no-tearing)
+    //
+    // NOTE: PresentPreferenceの値を持つ。
+    //       ウィンドウシステム毎のマクロより先に<vulkan/vulkan.h>を含めないよう、ここではpresentation.hを含めない。
+    int presentPreference;
+    // --swapchain-images <N>: スワップチェーンの描画先イメージの個数 (0なら自動で決める。サーフェスの範囲に収める)
+    unsigned int swapchainImages;
+    // --fps-limit <N>: CPU側でフレームの開始を一秒あたりN回に抑える (0なら制限しない)
+    unsigned int fpsLimit;
+    // --frames <N>: サーフェスへ表示する実行形式で、Nフレームを表示したら終了する (0ならウィンドウが閉じられるまで)
+    //
+    // NOTE: headlessでは閉じるウィンドウが無いため、0ならAPP_HEADLESS_DEFAULT_FRAMESとする。
+    unsigned int frames;
+    // --export-width <N>, --export-height <N>: オフスクリーンで描画先イメージの上限を超える大きさの画像をタイルに分けて描画し、
+    //                                           APP_EXPORT_OUTPUT_PATHへ行毎に書き出す (0なら通常通り1フレームだけ描画する)
+    unsigned int exportWidth;
+    unsigned int exportHeight;
+    // --batch <N>: オフスクリーンでN個のフレームを描画し、APP_BATCH_OUTPUT_FORMATへフレームの順に書き出す (0なら1フレームだけ描画する)
+    unsigned int batchFrames;
+    // --devices <N>: --batchでフレームを分担するワーカー数 (0なら物理デバイスの数。物理デバイスの数を超えれば順に割り当てる)
+    unsigned int batchDevices;
+    // --readback-rgb: オフスクリーンで読み戻す画素と書き出すPNGからアルファを捨て、RGBとする
+    int readbackRgb;
+    // --bench-warmup <N>: ベンチマークで計測せずに捨てる回数
+    unsigned int benchWarmup;
+    // --bench-reps <N>: ベンチマークで計測する回数
+    unsigned int benchRepetitions;
+    // --bench-out <path>: ベンチマークの結果を書き出すJSONファイルのパス
+    const char *benchOutputPath;
+    // --bench-filter <text>: 名前にtextを含む計測のみを行う
+    const char *benchFilter;
+    // --bench-baseline <path>: 結果をベースラインのJSONファイルと比べ、悪化があれば異常終了する
+    const char *benchBaselinePath;
+    // --bench-threshold <N>: ベースラインよりN%を超えて遅くなったら悪化とみなす
+    unsigned int benchThreshold;
+} AppOptions;
+
+/// @brief コマンドラインオプションを解釈する関数
+///
+/// 解釈できないオプションがあればエラーとする。
+///
+/// @param argc 解釈するコマンドライン引数の個数
+/// @param argv 解釈するコマンドライン引数の配列
+/// @param options 解釈結果の格納先
+/// @returns 失敗時に0を返す。
+int parseAppOptions(int argc, char *argv[], AppOptions *options);
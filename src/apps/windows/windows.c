@@ -9,11 +9,17 @@
 # include "../../vulkan/presentation.h"
 # include "../../vulkan/rendering.h"
 # include "../../vulkan/util/error.h"
+# include "../../vulkan/util/profiler.h"
+# include "../../vulkan/util/timer.h"
+# include "../frameloop.h"
 
 # include <stdio.h>
 # include <vulkan/vulkan.h>
 # include <Windows.h>
 
+// デバイスメモリの統計情報を出力する間隔(ms)
+# define MEMORY_STATS_DUMP_INTERVAL_MS 10000
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -145,7 +151,7 @@ void deleteModulesForWindows(const ModulesForWindows *mods) {
     if (mods->core != NULL) deleteVulkanAppCore(mods->core);
 }
 
-int runOnWindows(int width, int height) {
+int runOnWindows(int width, int height, const AppOptions *options) {
 # define CHECK(p, m) ERROR_IF(!(p), "runOnWindows()", (m), deleteModulesForWindows(&mods), 1)
 
     ModulesForWindows mods = {
@@ -163,6 +169,7 @@ int runOnWindows(int width, int height) {
     const char *devLayerNames[] = { "" };
     const uint32_t devExtNamesCount = 1;
     const char *devExtNames[] = { "VK_KHR_swapchain" };
+    PROFILE_ZONE_BEGIN("createVulkanAppCore");
     mods.core = createVulkanAppCore(
         instLayerNamesCount,
         instLayerNames,
@@ -173,6 +180,7 @@ int runOnWindows(int width, int height) {
         devExtNamesCount,
         devExtNames
     );
+    PROFILE_ZONE_END("createVulkanAppCore");
     CHECK(mods.core != NULL, "主要オブジェクトの作成に失敗");
 
     // Windows依存オブジェクトを作成する
@@ -180,23 +188,24 @@ int runOnWindows(int width, int height) {
     CHECK(mods.windows != NULL, "Windows依存オブジェクトの作成に失敗");
 
     // プレゼンテーションオブジェクトの作成に失敗
-    mods.presenter = createVulkanAppPresentation(mods.core, mods.windows->surface);
+    mods.presenter = createSurfacePresentation(mods.core, mods.windows->surface, (uint32_t)width, (uint32_t)height, options);
     CHECK(mods.presenter != NULL, "プレゼンテーションオブジェクトの作成に失敗");
 
     // レンダリングオブジェクトを作成する
-    mods.renderer = createVulkanAppRendering(
-        mods.core,
-        mods.presenter->imageViews,
-        mods.presenter->imagesCount,
-        mods.presenter->width,
-        mods.presenter->height,
-        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
-    );
+    mods.renderer = createSurfaceRendering(mods.core, mods.presenter, options);
     CHECK(mods.renderer != NULL, "レンダリングオブジェクトの作成に失敗");
 
+    // フレームリミッタを初期化する
+    FramePacer pacer;
+    initFramePacer(&pacer, options->fpsLimit);
+
     // メインループ
+    //
+    // NOTE: --framesが与えられれば、その数のフレームを表示したら終了する。
     MSG message;
-    while (1) {
+    uint64_t framesCount = 0;
+    int paced = 0;
+    while (options->frames == 0 || framesCount < options->frames) {
         // ウィンドウメッセージを処理する
         if (PeekMessageW(&message, NULL, 0, 0, PM_REMOVE) != 0) {
             if (message.message == WM_QUIT) {
@@ -207,38 +216,23 @@ int runOnWindows(int width, int height) {
             continue;
         }
         // 以降デッドタイム
-        // 描画可能な次のイメージのインデックスを取得する
-        if (!acquireNextImageIndex(mods.core, mods.presenter)) {
-            continue;
-        }
-        // 描画する
-        const uint32_t waitSemaphoresCount = 1;
-        const VkSemaphore waitSemaphores[] = { mods.presenter->waitForImageEnabledSemaphore };
-        const VkPipelineStageFlags waitDstStageMasks[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-        const uint32_t signalSemaphoresCount = 1;
-        const VkSemaphore signalSemaphores[] = { mods.presenter->waitForRenderingSemaphore };
-        if (!render(
-            mods.core,
-            mods.renderer,
-            mods.presenter->imageIndex,
-            0,
-            0,
-            mods.presenter->width,
-            mods.presenter->height,
-            waitSemaphoresCount,
-            waitSemaphores,
-            waitDstStageMasks,
-            signalSemaphoresCount,
-            signalSemaphores
-        )) {
-            continue;
-        }
-        // プレゼンテーションを行う
-        if (!present(mods.core, mods.presenter)) {
+        // 描画して表示する
+        //
+        // NOTE: スワップチェーンが使えなくなったら、作り直しには対応しないため終了する。
+        if (!renderAndPresentFrame(mods.core, mods.presenter, mods.renderer, &pacer, &paced)) {
+            if (mods.presenter->outOfDate) {
+                printf("[ info ] スワップチェーンがサーフェスと合わなくなったため終了\n");
+                break;
+            }
             continue;
         }
+        framesCount += 1;
+        // デバイスメモリの統計情報を定期的に出力する
+        dumpMemoryStatsPeriodically(mods.core->allocator, MEMORY_STATS_DUMP_INTERVAL_MS);
     }
 
+    printFramePacerStats(&pacer);
+
     deleteModulesForWindows(&mods);
     return 0;
 
@@ -247,7 +241,9 @@ int runOnWindows(int width, int height) {
 
 #else
 
-int runOnWindows(void) {
+# include <stdio.h>
+
+int runOnWindows(int width, int height, const AppOptions *options) {
     printf("[ info ] runOnWindows(): Windows向けに対応していません\n");
     return 1;
 }
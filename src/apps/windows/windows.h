@@ -3,6 +3,8 @@
 
 #pragma once
 
+#include "../options.h"
+
 /// @brief VulkanアプリケーションをWindowsウィンドウで実行するための関数
 ///
 /// @details
@@ -11,5 +13,6 @@
 ///
 /// @param width スクリーン幅
 /// @param height スクリーン高
+/// @param options コマンドラインオプション
 /// @returns 正常終了時に0を返す。
-int runOnWindows(int width, int height);
+int runOnWindows(int width, int height, const AppOptions *options);
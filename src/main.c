@@ -1,8 +1,14 @@
 /// @file main.c
 /// @brief エントリーモジュール
 
+#include "apps/bench/bench.h"
+#include "apps/bench/microbench.h"
+#include "apps/headless/headless.h"
+#include "apps/linux/linux.h"
 #include "apps/offscreen/offscreen.h"
+#include "apps/options.h"
 #include "apps/windows/windows.h"
+#include "vulkan/util/profiler.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -14,6 +20,13 @@
 /// 有効なコマンドライン引数は次の通り。
 /// - offscreen: オフスクリーンレンダリング
 /// - windows: Win32ウィンドウへのレンダリング
+/// - linux: X11ウィンドウ(xcb)へのレンダリング
+/// - headless: ディスプレイを必要としないサーフェス(VK_EXT_headless_surface)へのレンダリング
+/// - bench: オフスクリーンレンダリングのベンチマーク
+/// - microbench: デバイスを必要としないCPU側の処理のマイクロベンチマーク
+///
+/// プラットフォームの後にオプションを続けられる。
+/// 有効なオプションはAppOptionsを参照。
 ///
 /// @param argc コマンドライン引数の個数
 /// @param argv コマンドライン引数の配列
@@ -22,10 +35,23 @@ int main(int argc, char *argv[]) {
     const int width = 640;
     const int height = 480;
 
-    if (argc < 2)  return runOnOffscreen(width, height);
-    if (strcmp(argv[1], "offscreen") == 0) return runOnOffscreen(width, height);
-    if (strcmp(argv[1], "windows") == 0) return runOnWindows(width, height);
-    
-    printf("[ error ] main(): 無効な実行形式の指定です: %s\n", argv[1]);
-    return 1;
+    AppOptions options;
+    const int optionsBegin = argc < 2 ? argc : 2;
+    if (!parseAppOptions(argc - optionsBegin, argv + optionsBegin, &options)) return 1;
+
+    // NOTE: プロファイラの開始に失敗しても、計測せずに実行を続ける。
+    if (options.profile) startProfiler(APP_PROFILE_OUTPUT_PATH);
+
+    int result = 1;
+    if (argc < 2) result = runOnOffscreen(width, height, &options);
+    else if (strcmp(argv[1], "offscreen") == 0) result = runOnOffscreen(width, height, &options);
+    else if (strcmp(argv[1], "windows") == 0) result = runOnWindows(width, height, &options);
+    else if (strcmp(argv[1], "linux") == 0) result = runOnLinux(width, height, &options);
+    else if (strcmp(argv[1], "headless") == 0) result = runOnHeadless(width, height, &options);
+    else if (strcmp(argv[1], "bench") == 0) result = runBenchmark(width, height, &options);
+    else if (strcmp(argv[1], "microbench") == 0) result = runMicroBenchmark(&options);
+    else printf("[ error ] main(): 無効な実行形式の指定です: %s\n", argv[1]);
+
+    if (options.profile) stopProfiler();
+    return result;
 }
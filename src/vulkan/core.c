@@ -15,6 +15,7 @@ void deleteVulkanAppCore(VulkanAppCore core) {
         return;
     }
     if (core->device != NULL) vkDeviceWaitIdle(core->device);
+    if (core->allocator != NULL) deleteMemoryAllocator(core->allocator);
     if (core->cmdPool != NULL) vkDestroyCommandPool(core->device, core->cmdPool, NULL);
     if (core->device != NULL) vkDestroyDevice(core->device, NULL);
     if (core->instance != NULL) vkDestroyInstance(core->instance, NULL);
@@ -31,8 +32,32 @@ VulkanAppCore createVulkanAppCore(
     uint32_t devExtNamesCount,
     const char *const *devExtNames
 ) {
-#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "createVulkanAppCore()", (m), (p), deleteVulkanAppCore(core), NULL)
-#define CHECK(p, m)    ERROR_IF     (!(p),              "createVulkanAppCore()", (m),      deleteVulkanAppCore(core), NULL)
+    return createVulkanAppCoreOnDevice(
+        0,
+        instLayerNamesCount,
+        instLayerNames,
+        instExtNamesCount,
+        instExtNames,
+        devLayerNamesCount,
+        devLayerNames,
+        devExtNamesCount,
+        devExtNames
+    );
+}
+
+VulkanAppCore createVulkanAppCoreOnDevice(
+    uint32_t physDeviceIndex,
+    uint32_t instLayerNamesCount,
+    const char *const *instLayerNames,
+    uint32_t instExtNamesCount,
+    const char *const *instExtNames,
+    uint32_t devLayerNamesCount,
+    const char *const *devLayerNames,
+    uint32_t devExtNamesCount,
+    const char *const *devExtNames
+) {
+#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "createVulkanAppCoreOnDevice()", (m), (p), deleteVulkanAppCore(core), NULL)
+#define CHECK(p, m)    ERROR_IF     (!(p),              "createVulkanAppCoreOnDevice()", (m),      deleteVulkanAppCore(core), NULL)
 
     const VulkanAppCore core = (VulkanAppCore)malloc(sizeof(struct VulkanAppCore_t));
     CHECK(core != NULL, "VulkanAppCoreのメモリ確保に失敗");
@@ -73,16 +98,21 @@ VulkanAppCore createVulkanAppCore(
     //       そもそもVulkanはこれらを扱うためのAPIであるので、これらを選択する必要がある。
     //       今回はグラフィックス目的であるため、グラフィックスカードを選択する。
     //       そのため、本来は、検出された物理デバイスの中から適切に選択しなければならない。
-    //       が、今回は初めに発見されたものを選択する。
+    //       が、今回は呼び出し側が指定した番号のもの(既定では初めに発見されたもの)を選択する。
     {
         uint32_t count = 0;
         CHECK_VK(vkEnumeratePhysicalDevices(core->instance, &count, NULL), "物理デバイス数の取得に失敗");
+        CHECK(physDeviceIndex < count, "指定された番号の物理デバイスが無い");
         VkPhysicalDevice *physDevices = (VkPhysicalDevice *)malloc(sizeof(VkPhysicalDevice) * count);
-        CHECK_VK(vkEnumeratePhysicalDevices(core->instance, &count, physDevices), "物理デバイスの列挙に失敗");
-
-        core->physDevice = physDevices[0];
+        CHECK(physDevices != NULL, "物理デバイスの配列の確保に失敗");
+        const VkResult res = vkEnumeratePhysicalDevices(core->instance, &count, physDevices);
+        if (res == VK_SUCCESS) core->physDevice = physDevices[physDeviceIndex];
         free(physDevices);
+        CHECK_VK(res, "物理デバイスの列挙に失敗");
+        core->physDevicesCount = count;
+        core->physDeviceIndex = physDeviceIndex;
 
+        vkGetPhysicalDeviceProperties(core->physDevice, &core->physDevProps);
         vkGetPhysicalDeviceMemoryProperties(core->physDevice, &core->physDevMemProps);
     }
 
@@ -107,6 +137,82 @@ VulkanAppCore createVulkanAppCore(
         }
         free(props);
         CHECK(queueFamIndex >= 0, "キューファミリーインデックスの取得に失敗");
+        core->queueFamIndex = (uint32_t)queueFamIndex;
+    }
+
+    // 物理デバイスが対応している任意の拡張機能を確認する
+    //
+    // NOTE: VK_EXT_memory_budgetはヒープ毎の予算と使用量を取得するための拡張機能。
+    //       無くても動作はするが、あればメモリ不足を事前に察知できる。
+    //       予算はVulkan 1.1のvkGetPhysicalDeviceMemoryProperties2()関数で取得するため、それ以前の物理デバイスでは使わない。
+    //       引数で既に指定されていれば重複して追加しない。
+    //
+    // NOTE: バッファデバイスアドレスはVulkan 1.2でコアに昇格した機能であり、それ以前はVK_KHR_buffer_device_addressで提供される。
+    //       シェーダからバッファをポインタで参照でき、巨大なバッファをディスクリプタの更新無しに扱えるようになる。
+    int memoryBudgetSupported = 0;
+    int memoryBudgetRequested = 0;
+    int bufferDeviceAddressExtSupported = 0;
+    int bufferDeviceAddressExtRequested = 0;
+    {
+        uint32_t count = 0;
+        CHECK_VK(vkEnumerateDeviceExtensionProperties(core->physDevice, NULL, &count, NULL), "デバイス拡張機能数の取得に失敗");
+        VkExtensionProperties *props = (VkExtensionProperties *)malloc(sizeof(VkExtensionProperties) * count);
+        CHECK(props != NULL, "デバイス拡張機能の列挙のためのメモリ確保に失敗");
+        const VkResult res = vkEnumerateDeviceExtensionProperties(core->physDevice, NULL, &count, props);
+        for (uint32_t i = 0; i < count && res == VK_SUCCESS; ++i) {
+            if (strcmp(props[i].extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+                memoryBudgetSupported = core->physDevProps.apiVersion >= VK_API_VERSION_1_1;
+            }
+            if (strcmp(props[i].extensionName, VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME) == 0) {
+                bufferDeviceAddressExtSupported = 1;
+            }
+        }
+        free(props);
+        CHECK_VK(res, "デバイス拡張機能の列挙に失敗");
+
+        for (uint32_t i = 0; i < devExtNamesCount; ++i) {
+            if (strcmp(devExtNames[i], VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+                memoryBudgetRequested = 1;
+            }
+            if (strcmp(devExtNames[i], VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME) == 0) {
+                bufferDeviceAddressExtRequested = 1;
+            }
+        }
+    }
+
+    // 物理デバイスが対応している任意の機能を確認する
+    //
+    // NOTE: vkGetPhysicalDeviceFeatures2()関数はVulkan 1.1の関数であるため、それ以前の物理デバイスでは確認しない。
+    int bufferDeviceAddressSupported = 0;
+    int bufferDeviceAddressNeedsExt = 0;
+    {
+        const uint32_t apiVersion = core->physDevProps.apiVersion;
+        bufferDeviceAddressNeedsExt = apiVersion < VK_API_VERSION_1_2;
+        if (apiVersion >= VK_API_VERSION_1_1 && (!bufferDeviceAddressNeedsExt || bufferDeviceAddressExtSupported)) {
+            VkPhysicalDeviceBufferDeviceAddressFeatures bdaFeatures;
+            memset(&bdaFeatures, 0, sizeof(VkPhysicalDeviceBufferDeviceAddressFeatures));
+            bdaFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+            VkPhysicalDeviceFeatures2 features2;
+            memset(&features2, 0, sizeof(VkPhysicalDeviceFeatures2));
+            features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features2.pNext = (void *)&bdaFeatures;
+            vkGetPhysicalDeviceFeatures2(core->physDevice, &features2);
+            bufferDeviceAddressSupported = bdaFeatures.bufferDeviceAddress == VK_TRUE;
+        }
+    }
+
+    // 有効にする機能を決める
+    //
+    // NOTE: 計測のためのクエリに関する機能は、描画の結果に影響しないため対応していれば常に有効にする。
+    //       間接描画に関する機能も同様で、メッシュレットのカリングで用いる。
+    {
+        VkPhysicalDeviceFeatures supported;
+        vkGetPhysicalDeviceFeatures(core->physDevice, &supported);
+        memset(&core->enabledFeatures, 0, sizeof(VkPhysicalDeviceFeatures));
+        core->enabledFeatures.pipelineStatisticsQuery = supported.pipelineStatisticsQuery;
+        core->enabledFeatures.occlusionQueryPrecise = supported.occlusionQueryPrecise;
+        core->enabledFeatures.multiDrawIndirect = supported.multiDrawIndirect;
+        core->enabledFeatures.drawIndirectFirstInstance = supported.drawIndirectFirstInstance;
     }
 
     // 論理デバイスを作成する
@@ -130,19 +236,37 @@ VulkanAppCore createVulkanAppCore(
                 queuePriors,
             },
         };
+        const char **extNames = (const char **)malloc(sizeof(const char *) * (devExtNamesCount + 2));
+        CHECK(extNames != NULL, "デバイス拡張機能名の配列の確保に失敗");
+        uint32_t extNamesCount = 0;
+        for (uint32_t i = 0; i < devExtNamesCount; ++i) {
+            extNames[extNamesCount++] = devExtNames[i];
+        }
+        if (memoryBudgetSupported && !memoryBudgetRequested) {
+            extNames[extNamesCount++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+        }
+        if (bufferDeviceAddressSupported && bufferDeviceAddressNeedsExt && !bufferDeviceAddressExtRequested) {
+            extNames[extNamesCount++] = VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME;
+        }
+        VkPhysicalDeviceBufferDeviceAddressFeatures bdaFeatures;
+        memset(&bdaFeatures, 0, sizeof(VkPhysicalDeviceBufferDeviceAddressFeatures));
+        bdaFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+        bdaFeatures.bufferDeviceAddress = VK_TRUE;
         const VkDeviceCreateInfo ci = {
             VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-            NULL,
+            bufferDeviceAddressSupported ? (const void *)&bdaFeatures : NULL,
             0,
             QUEUE_FAMILIES_COUNT,
             queueCIs,
             devLayerNamesCount,
             devLayerNames,
-            devExtNamesCount,
-            devExtNames,
-            NULL,
+            extNamesCount,
+            extNames,
+            &core->enabledFeatures,
         };
-        CHECK_VK(vkCreateDevice(core->physDevice, &ci, NULL, &core->device), "論理デバイスの作成に失敗しました");
+        const VkResult res = vkCreateDevice(core->physDevice, &ci, NULL, &core->device);
+        free((void *)extNames);
+        CHECK_VK(res, "論理デバイスの作成に失敗しました");
 #undef QUEUES_COUNT
 #undef QUEUE_FAMILIES_COUNT
     }
@@ -176,6 +300,30 @@ VulkanAppCore createVulkanAppCore(
         CHECK_VK(vkCreateCommandPool(core->device, &ci, NULL, &core->cmdPool), "コマンドプールの作成に失敗");
     }
 
+    // デバイスメモリの集計オブジェクトを作成する
+    //
+    // NOTE: 以降、デバイスメモリはこのオブジェクトを介して確保・解放する。
+    //       詳しくはallocator.hを参照。
+    //
+    // NOTE: バッファデバイスアドレスを取得する関数は、拡張機能で有効化した場合は名前が異なる。
+    {
+        PFN_vkGetBufferDeviceAddress getBufferDeviceAddress = NULL;
+        if (bufferDeviceAddressSupported) {
+            getBufferDeviceAddress = (PFN_vkGetBufferDeviceAddress)vkGetDeviceProcAddr(
+                core->device,
+                bufferDeviceAddressNeedsExt ? "vkGetBufferDeviceAddressKHR" : "vkGetBufferDeviceAddress"
+            );
+        }
+        core->allocator = createMemoryAllocator(
+            core->physDevice,
+            &core->physDevMemProps,
+            memoryBudgetSupported,
+            core->physDevProps.apiVersion >= VK_API_VERSION_1_1,
+            getBufferDeviceAddress
+        );
+        CHECK(core->allocator != NULL, "デバイスメモリの集計オブジェクトの作成に失敗");
+    }
+
     return core;
 
 #undef CHECK
@@ -232,7 +380,8 @@ int endAndSubmitCommandBuffer(
     const VkSemaphore *waitSemaphores,
     const VkPipelineStageFlags *waitDstStageMasks,
     uint32_t signalSemaphoresCount,
-    const VkSemaphore *signalSemaphores
+    const VkSemaphore *signalSemaphores,
+    VkFence fence
 ) {
 #define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "submitCommandBuffer()", (m), (p), {}, 0)
 
@@ -242,7 +391,8 @@ int endAndSubmitCommandBuffer(
     // コマンドバッファをキューに提出する
     //
     // NOTE: このコマンドバッファが実行されるまでwaitSemaphoresのシグナルを待機する。
-    //       このコマンドバッファが実行されたらsignalSemaphoresをシグナルする。
+    //       このコマンドバッファが実行されたらsignalSemaphoresとfenceをシグナルする。
+    //       セマフォはデバイス内での待機に、フェンスはホストでの待機に使う。
     {
 #define SUBMITS_COUNT 1
         const VkSubmitInfo sis[SUBMITS_COUNT] = {
@@ -258,7 +408,7 @@ int endAndSubmitCommandBuffer(
                 signalSemaphores,
             },
         };
-        CHECK_VK(vkQueueSubmit(core->queue, SUBMITS_COUNT, sis, NULL), "コマンドバッファのエンキューに失敗");
+        CHECK_VK(vkQueueSubmit(core->queue, SUBMITS_COUNT, sis, fence), "コマンドバッファのエンキューに失敗");
 #undef SUBMITS_COUNT
     }
 
@@ -3,17 +3,28 @@
 
 #pragma once
 
+#include "util/memory/allocator.h"
+
 #include <stdint.h>
 #include <vulkan/vulkan.h>
 
 /// @brief Vulkanアプリケーションの主要オブジェクトを持つ構造体
 typedef struct VulkanAppCore_t {
     VkInstance instance;
+    // インスタンスが列挙した物理デバイスの数と、そのうち選んだものの番号
+    uint32_t physDevicesCount;
+    uint32_t physDeviceIndex;
     VkPhysicalDevice physDevice;
+    VkPhysicalDeviceProperties physDevProps;
     VkPhysicalDeviceMemoryProperties physDevMemProps;
+    // 論理デバイスで有効にした機能
+    VkPhysicalDeviceFeatures enabledFeatures;
     VkDevice device;
+    // キューのキューファミリーインデックス (サーフェスへの表示に対応しているかの確認に用いる)
+    uint32_t queueFamIndex;
     VkQueue queue;
     VkCommandPool cmdPool;
+    MemoryAllocator allocator;
 } *VulkanAppCore;
 
 /// @brief VulkanAppCoreを破棄する関数
@@ -29,6 +40,8 @@ void deleteVulkanAppCore(VulkanAppCore core);
 /// 3. コマンドバッファをキューへ提出
 ///
 /// 要件に依って必要な機能が異なるため、その部分は引数に与えるようにしてある。
+/// ただし、VK_EXT_memory_budgetとバッファデバイスアドレスは物理デバイスが対応していれば自動で有効化する。
+/// 計測のためのパイプライン統計クエリと正確なオクルージョンクエリも同様に、対応していれば有効化する。
 ///
 /// @param instLayerNamesCount instLayerNamesの要素数
 /// @param instLayerNames Vulkanインスタンスに適応したいレイヤー名の配列
@@ -50,6 +63,34 @@ VulkanAppCore createVulkanAppCore(
     const char *const *devExtNames
 );
 
+/// @brief 物理デバイスを番号で選んでVulkanAppCoreを作成する関数
+///
+/// createVulkanAppCore()関数と同じだが、列挙された物理デバイスのうちphysDeviceIndex番目を選ぶ。
+/// 一つのプロセスで複数の物理デバイスを使う場合は、物理デバイス毎にこれで作成する。
+/// インスタンスも物理デバイス毎に作成するため、作成したVulkanAppCoreは互いに独立しており、別々のスレッドで使える。
+///
+/// @param physDeviceIndex 物理デバイスの番号 (列挙された数以上ならばエラーとする)
+/// @param instLayerNamesCount instLayerNamesの要素数
+/// @param instLayerNames Vulkanインスタンスに適応したいレイヤー名の配列
+/// @param instExtNamesCount instExtNamesの要素数
+/// @param instExtNames Vulkanインスタンスに適応したい拡張機能名の配列
+/// @param devLayerNamesCount devLayerNamesの要素数
+/// @param devLayerNames 論理デバイスに適応したいレイヤー名の配列
+/// @param devExtNamesCount devExtNamesの要素数
+/// @param devExtNames 論理デバイスに適応したい拡張機能名の配列
+/// @returns 失敗時にNULLを返す。
+VulkanAppCore createVulkanAppCoreOnDevice(
+    uint32_t physDeviceIndex,
+    uint32_t instLayerNamesCount,
+    const char *const *instLayerNames,
+    uint32_t instExtNamesCount,
+    const char *const *instExtNames,
+    uint32_t devLayerNamesCount,
+    const char *const *devLayerNames,
+    uint32_t devExtNamesCount,
+    const char *const *devExtNames
+);
+
 /// @brief コマンドバッファを確保し記録を開始する関数
 ///
 /// コマンドバッファを一つだけ確保し、コマンドの記録を開始する。
@@ -74,6 +115,7 @@ VkCommandBuffer allocateAndStartCommandBuffer(VulkanAppCore core);
 /// @param waitDstStageMasks waitForImageEnabledSemaphoresのそれぞれのセマフォがどのパイプラインステージを待機するかの配列
 /// @param signalSemaphoresCount waitForRenderingSemaphoresの要素数
 /// @param signalSemaphores 描画終了を待機するセマフォの配列
+/// @param fence このコマンドバッファが実行されたらシグナルするフェンス (不要ならNULL)
 /// @returns 失敗時に0を返す。
 int endAndSubmitCommandBuffer(
     VulkanAppCore core,
@@ -82,5 +124,6 @@ int endAndSubmitCommandBuffer(
     const VkSemaphore *waitSemaphores,
     const VkPipelineStageFlags *waitDstStageMasks,
     uint32_t signalSemaphoresCount,
-    const VkSemaphore *signalSemaphores
+    const VkSemaphore *signalSemaphores,
+    VkFence fence
 );
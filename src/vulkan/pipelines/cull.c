@@ -0,0 +1,88 @@
+#include "cull.h"
+
+#include "../util/error.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void deletePipelineForCull(const VkDevice device, PipelineForCull pipeline) {
+    if (pipeline == NULL) {
+        return;
+    }
+    if (pipeline->pipeline != NULL) vkDestroyPipeline(device, pipeline->pipeline, NULL);
+    releaseShader(device, pipeline->shaderLibrary, pipeline->compShader);
+    free((void *)pipeline);
+}
+
+PipelineForCull createPipelineForCull(const VkDevice device, ShaderLibrary shaderLibrary, const VkPipelineCache pipelineCache) {
+#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "createPipelineForCull()", (m), (p), deletePipelineForCull(device, pipeline), NULL)
+#define CHECK(p, m)    ERROR_IF     (!(p),              "createPipelineForCull()", (m),      deletePipelineForCull(device, pipeline), NULL)
+
+    const PipelineForCull pipeline = (PipelineForCull)malloc(sizeof(struct PipelineForCull_t));
+    CHECK(pipeline != NULL, "PipelineForCullの確保に失敗");
+    memset(pipeline, 0, sizeof(struct PipelineForCull_t));
+    pipeline->shaderLibrary = shaderLibrary;
+
+    // シェーダを読み込む
+    {
+        pipeline->compShader = loadShader(device, shaderLibrary, "./shader/cull.comp.spv");
+        CHECK(pipeline->compShader != NULL, "カリング用のコンピュートシェーダの読込みに失敗: ./shader/cull.comp.spv");
+    }
+
+    // パイプラインレイアウトを取得する
+    //
+    // NOTE: インスタンス毎の変換はメッシュ用のパイプラインと同じリングバッファを参照するため、ダイナミックストレージバッファとする。
+    {
+#define SHADERS_COUNT 1
+#define OVERRIDES_COUNT 1
+        const Shader shaders[SHADERS_COUNT] = { pipeline->compShader };
+        const ShaderReflectionBinding overrides[OVERRIDES_COUNT] = {
+            { 0, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1 },
+        };
+        const ShaderLibraryLayout *layout = getPipelineLayoutForShaders(
+            device,
+            shaderLibrary,
+            SHADERS_COUNT,
+            shaders,
+            OVERRIDES_COUNT,
+            overrides
+        );
+        CHECK(layout != NULL, "カリング用のパイプラインレイアウトの取得に失敗");
+        CHECK(layout->setLayoutsCount == 1, "カリング用のシェーダのディスクリプタセット数が不正");
+        CHECK(layout->pushConstantRange.size == sizeof(PushConstantForCull), "カリング用のシェーダのプッシュ定数のサイズが不正");
+        pipeline->descSetLayout = layout->setLayouts[0];
+        pipeline->pipelineLayout = layout->layout;
+#undef OVERRIDES_COUNT
+#undef SHADERS_COUNT
+    }
+
+    // コンピュートパイプラインを作成する
+    //
+    // NOTE: 状態を持たないためバリアントは作らず、ここで一つだけ作成する。
+    {
+        const VkComputePipelineCreateInfo ci = {
+            VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            NULL,
+            0,
+            {
+                VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                NULL,
+                0,
+                VK_SHADER_STAGE_COMPUTE_BIT,
+                pipeline->compShader->module,
+                "main",
+                NULL,
+            },
+            pipeline->pipelineLayout,
+            NULL,
+            0,
+        };
+        CHECK_VK(vkCreateComputePipelines(device, pipelineCache, 1, &ci, NULL, &pipeline->pipeline), "カリング用のパイプラインの作成に失敗");
+    }
+
+    return pipeline;
+
+#undef CHECK
+#undef CHECK_VK
+}
@@ -0,0 +1,69 @@
+/// @file cull.h
+/// @brief メッシュレットのカリング用のコンピュートパイプラインを定義するモジュール
+
+#pragma once
+
+#include "../util/shader.h"
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+/// @brief カリング用のコンピュートシェーダのワークグループ一つあたりの実行単位の数 (cull.compのlocal_size_x)
+#define CULL_WORKGROUP_SIZE 64
+
+/// @brief カリング用のコンピュートシェーダに渡すプッシュ定数
+typedef struct PushConstantForCull_t {
+    // ワールド空間の視錐台の6平面 (法線xyzは内向き, w)
+    float planes[6][4];
+    float eye[4];
+    uint32_t meshletsCount;
+    uint32_t instancesCount;
+    // インスタンス一つあたりのインデックスの領域の大きさ
+    uint32_t indicesCapacity;
+    uint32_t padding;
+} PushConstantForCull;
+
+/// @brief カリング用のパイプラインにおけるオブジェクトを持つ構造体
+///
+/// pipeline以外はShaderLibraryが所有する。
+/// シェーダはShaderLibraryから借りており、破棄時に返す。
+typedef struct PipelineForCull_t {
+    // シェーダの返却先 (所有しない)
+    ShaderLibrary shaderLibrary;
+    VkDescriptorSetLayout descSetLayout;
+    VkPipelineLayout pipelineLayout;
+    Shader compShader;
+    VkPipeline pipeline;
+} *PipelineForCull;
+
+/// @brief カリング用のパイプラインを破棄する関数
+///
+/// デバイスがパイプラインを使い終わってから呼ぶこと。
+///
+/// @param device 論理デバイス
+/// @param pipeline カリング用のパイプライン
+void deletePipelineForCull(const VkDevice device, PipelineForCull pipeline);
+
+/// @brief カリング用のパイプラインを作成する関数
+///
+/// インスタンスとメッシュレットの組毎に、境界球の視錐台カリングと法線の円錐の裏面カリングを行う。
+/// 残ったメッシュレットの三角形をインスタンス毎の領域に詰めてインデックスバッファへ書き出し、
+/// インスタンス毎の間接描画コマンド(VkDrawIndexedIndirectCommand)を作る。
+///
+/// - シェーダ
+///   - cull.comp.spv
+/// - バインディング
+///   - ObjectForMeshの配列 (binding=0, ダイナミックストレージバッファ)
+///   - ModelMeshletの配列 (binding=1, ストレージバッファ)
+///   - メッシュレットの頂点 (binding=2, ストレージバッファ)
+///   - メッシュレットの三角形 (binding=3, ストレージバッファ)
+///   - 間接描画コマンドの配列 (binding=4, ストレージバッファ。インデックス数を0に初期化しておくこと)
+///   - インデックス (binding=5, ストレージバッファ)
+/// - プッシュ定数
+///   - PushConstantForCull
+///
+/// @param device 論理デバイス
+/// @param shaderLibrary シェーダ共有オブジェクトハンドル
+/// @param pipelineCache パイプラインキャッシュ (VK_NULL_HANDLEでもよい)
+/// @returns 失敗時にNULLを返す。
+PipelineForCull createPipelineForCull(const VkDevice device, ShaderLibrary shaderLibrary, const VkPipelineCache pipelineCache);
@@ -0,0 +1,117 @@
+#include "depth.h"
+
+#include "ui.h"
+
+#include "../util/error.h"
+#include "../util/shader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+void deletePipelineForDepth(const VkDevice device, PipelineForDepth pipeline) {
+    if (pipeline == NULL) {
+        return;
+    }
+    if (pipeline->variants != NULL) deletePipelineVariants(device, pipeline->variants);
+    releaseShader(device, pipeline->shaderLibrary, pipeline->vertShader);
+    free((void *)pipeline);
+}
+
+PipelineForDepth createPipelineForDepth(
+    const VkDevice device,
+    ShaderLibrary shaderLibrary,
+    const VkPipelineCache pipelineCache,
+    PipelineCompiler compiler,
+    const VkRenderPass renderPass,
+    VkSampleCountFlagBits samples,
+    uint32_t width,
+    uint32_t height
+) {
+#define CHECK(p, m) ERROR_IF(!(p), "createPipelineForDepth()", (m), deletePipelineForDepth(device, pipeline), NULL)
+
+    const PipelineForDepth pipeline = (PipelineForDepth)malloc(sizeof(struct PipelineForDepth_t));
+    CHECK(pipeline != NULL, "PipelineForDepthの確保に失敗");
+    pipeline->shaderLibrary = shaderLibrary;
+    pipeline->descSetLayout = NULL;
+    pipeline->pipelineLayout = NULL;
+    pipeline->vertShader = NULL;
+    pipeline->variants = NULL;
+
+    // シェーダを読み込む
+    {
+        pipeline->vertShader = loadShader(device, shaderLibrary, "./shader/depth.vert.spv");
+        CHECK(pipeline->vertShader != NULL, "深度プリパス用のヴァーテックスシェーダの読込みに失敗: ./shader/depth.vert.spv");
+    }
+
+    // パイプラインレイアウトを取得する
+    //
+    // NOTE: UI用のパイプラインと同じく、カメラはダイナミックユニフォームバッファとする。
+    //       レイアウトが同じになるため、UI用のカメラのディスクリプタセットをそのまま使える。
+    {
+#define SHADERS_COUNT 1
+#define OVERRIDES_COUNT 1
+        const Shader shaders[SHADERS_COUNT] = { pipeline->vertShader };
+        const ShaderReflectionBinding overrides[OVERRIDES_COUNT] = {
+            { 0, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 },
+        };
+        const ShaderLibraryLayout *layout = getPipelineLayoutForShaders(
+            device,
+            shaderLibrary,
+            SHADERS_COUNT,
+            shaders,
+            OVERRIDES_COUNT,
+            overrides
+        );
+        CHECK(layout != NULL, "深度プリパス用のパイプラインレイアウトの取得に失敗");
+        CHECK(layout->setLayoutsCount == 1, "深度プリパス用のシェーダのディスクリプタセット数が不正");
+        CHECK(layout->pushConstantRange.size == sizeof(PushConstantForUI), "深度プリパス用のシェーダのプッシュ定数のサイズが不正");
+        pipeline->descSetLayout = layout->setLayouts[0];
+        pipeline->pipelineLayout = layout->layout;
+#undef OVERRIDES_COUNT
+#undef SHADERS_COUNT
+    }
+
+    // バリアント管理オブジェクトを作成する
+    //
+    // NOTE: 頂点データはローカル座標(float * 3)のみを詰めて並べたものとする。
+    {
+        VkVertexInputAttributeDescription vertInpAttrDescs[SHADER_REFLECTION_MAX_INPUTS];
+        uint32_t vertInpStride = 0;
+        buildVertexInputAttributes(pipeline->vertShader, 0, vertInpAttrDescs, &vertInpStride);
+        CHECK(vertInpStride == sizeof(float) * 3, "深度プリパス用のヴァーテックスシェーダの頂点入力がローカル座標のみでない");
+
+        const PipelineVariantsBase base = {
+            pipeline->vertShader,
+            NULL,
+            pipeline->pipelineLayout,
+            renderPass,
+            0,
+            samples,
+            width,
+            height,
+        };
+        pipeline->variants = createPipelineVariants(device, pipelineCache, compiler, &base);
+        CHECK(pipeline->variants != NULL, "深度プリパス用のパイプラインのバリアント管理オブジェクトの作成に失敗");
+    }
+
+    // 既定のバリアントを代替のバリアントとして設定する
+    {
+        const PipelineVariantKey defaultKey = {
+            PIPELINE_BLEND_MODE_OPAQUE,
+            VK_CULL_MODE_NONE,
+            VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+            0,
+            0,
+            PIPELINE_DEPTH_MODE_TEST_WRITE,
+        };
+        pipeline->defaultKey = defaultKey;
+        CHECK(setPipelineVariantFallback(pipeline->variants, &pipeline->defaultKey), "深度プリパス用のパイプラインの代替のバリアントの設定に失敗");
+        if (compiler == NULL) {
+            CHECK(getPipelineVariant(pipeline->variants, &pipeline->defaultKey) != NULL, "深度プリパス用のパイプラインの作成に失敗");
+        }
+    }
+
+    return pipeline;
+
+#undef CHECK
+}
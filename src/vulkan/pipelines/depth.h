@@ -0,0 +1,74 @@
+/// @file depth.h
+/// @brief 深度プリパス用のパイプラインを定義するモジュール
+
+#pragma once
+
+#include "../util/pipeline.h"
+#include "../util/shader.h"
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+/// @brief 深度プリパス用のパイプラインにおけるオブジェクトを持つ構造体
+///
+/// variants以外はShaderLibraryが所有する。
+/// シェーダはShaderLibraryから借りており、破棄時に返す。
+typedef struct PipelineForDepth_t {
+    // シェーダの返却先 (所有しない)
+    ShaderLibrary shaderLibrary;
+    VkDescriptorSetLayout descSetLayout;
+    VkPipelineLayout pipelineLayout;
+    Shader vertShader;
+    PipelineVariants variants;
+    // 既定のバリアント
+    PipelineVariantKey defaultKey;
+} *PipelineForDepth;
+
+/// @brief 深度プリパス用のパイプラインを破棄する関数
+///
+/// デバイスがパイプラインを使い終わってから呼ぶこと。
+///
+/// @param device 論理デバイス
+/// @param pipeline 深度プリパス用のパイプライン
+void deletePipelineForDepth(const VkDevice device, PipelineForDepth pipeline);
+
+/// @brief 深度プリパス用のパイプラインを作成する関数
+///
+/// 深度のみを書き込み、フラグメントシェーダを持たない。
+/// 本描画をPIPELINE_DEPTH_MODE_EQUALで行えば、重いフラグメントシェーダは画素毎に一回しか実行されない。
+///
+/// 本描画と同じ深度を出すために、UI用のパイプラインと同じカメラとプッシュ定数で同じ変換を行う。
+/// ヴァーテックスシェーダではgl_Positionをinvariantとし、最適化による誤差で深度がずれないようにしている。
+///
+/// - シェーダ
+///   - depth.vert.spv
+/// - バインディング
+///   - CameraForUI (binding=0, ダイナミックユニフォームバッファ)
+/// - プッシュ定数
+///   - PushConstantForUI
+/// - 頂点データ
+///   - ローカル座標のみ (location=0, float * 3)
+///   - Model::posBufferのように、ローカル座標のみを詰めた頂点ストリームを与えること
+/// - 既定のバリアント
+///   - カリング無し
+///   - 深度テスト: PIPELINE_DEPTH_MODE_TEST_WRITE
+///
+/// @param device 論理デバイス
+/// @param shaderLibrary シェーダ共有オブジェクトハンドル
+/// @param pipelineCache パイプラインキャッシュ (VK_NULL_HANDLEでもよい)
+/// @param compiler パイプライン作成オブジェクトハンドル (NULLなら既定のバリアントをここで作成する)
+/// @param renderPass レンダーパス (深度アタッチメントを持つこと)
+/// @param samples レンダーパスのアタッチメントのサンプル数
+/// @param width ビューポート幅
+/// @param height ビューポート高
+/// @returns 失敗時にNULLを返す。
+PipelineForDepth createPipelineForDepth(
+    const VkDevice device,
+    ShaderLibrary shaderLibrary,
+    const VkPipelineCache pipelineCache,
+    PipelineCompiler compiler,
+    const VkRenderPass renderPass,
+    VkSampleCountFlagBits samples,
+    uint32_t width,
+    uint32_t height
+);
@@ -0,0 +1,167 @@
+#include "mesh.h"
+
+#include "../util/error.h"
+#include "../util/shader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void deletePipelineForMesh(const VkDevice device, PipelineForMesh pipeline) {
+    if (pipeline == NULL) {
+        return;
+    }
+    if (pipeline->depthVariants != NULL) deletePipelineVariants(device, pipeline->depthVariants);
+    if (pipeline->variants != NULL) deletePipelineVariants(device, pipeline->variants);
+    releaseShader(device, pipeline->shaderLibrary, pipeline->depthVertShader);
+    releaseShader(device, pipeline->shaderLibrary, pipeline->fragShader);
+    releaseShader(device, pipeline->shaderLibrary, pipeline->vertShader);
+    free((void *)pipeline);
+}
+
+PipelineForMesh createPipelineForMesh(
+    const VkDevice device,
+    ShaderLibrary shaderLibrary,
+    const VkPipelineCache pipelineCache,
+    PipelineCompiler compiler,
+    const VkRenderPass renderPass,
+    VkSampleCountFlagBits samples,
+    uint32_t width,
+    uint32_t height,
+    uint32_t vertexStride
+) {
+#define CHECK(p, m) ERROR_IF(!(p), "createPipelineForMesh()", (m), deletePipelineForMesh(device, pipeline), NULL)
+#define OVERRIDES_COUNT 2
+
+    const PipelineForMesh pipeline = (PipelineForMesh)malloc(sizeof(struct PipelineForMesh_t));
+    CHECK(pipeline != NULL, "PipelineForMeshの確保に失敗");
+    memset(pipeline, 0, sizeof(struct PipelineForMesh_t));
+    pipeline->shaderLibrary = shaderLibrary;
+
+    // シェーダを読み込む
+    {
+        pipeline->vertShader = loadShader(device, shaderLibrary, "./shader/mesh.vert.spv");
+        CHECK(pipeline->vertShader != NULL, "メッシュ用のヴァーテックスシェーダの読込みに失敗: ./shader/mesh.vert.spv");
+        pipeline->fragShader = loadShader(device, shaderLibrary, "./shader/mesh.frag.spv");
+        CHECK(pipeline->fragShader != NULL, "メッシュ用のフラグメントシェーダの読込みに失敗: ./shader/mesh.frag.spv");
+        pipeline->depthVertShader = loadShader(device, shaderLibrary, "./shader/mesh_depth.vert.spv");
+        CHECK(pipeline->depthVertShader != NULL, "メッシュの深度プリパス用のヴァーテックスシェーダの読込みに失敗: ./shader/mesh_depth.vert.spv");
+    }
+
+    // パイプラインレイアウトを取得する
+    //
+    // NOTE: カメラはダイナミックユニフォームバッファ、インスタンス毎の変換はダイナミックストレージバッファとする。
+    //       いずれもフレーム毎にリングバッファへ詰め、描画時にオフセットを与えて参照先を切り替える。
+    //       SPIR-Vからはダイナミックか否かを判別できないため、ここで上書きする。
+    const ShaderReflectionBinding overrides[OVERRIDES_COUNT] = {
+        { 0, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 },
+        { 0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1 },
+    };
+    {
+#define SHADERS_COUNT 2
+        const Shader shaders[SHADERS_COUNT] = { pipeline->vertShader, pipeline->fragShader };
+        const ShaderLibraryLayout *layout = getPipelineLayoutForShaders(
+            device,
+            shaderLibrary,
+            SHADERS_COUNT,
+            shaders,
+            OVERRIDES_COUNT,
+            overrides
+        );
+        CHECK(layout != NULL, "メッシュ用のパイプラインレイアウトの取得に失敗");
+        CHECK(layout->setLayoutsCount == 1, "メッシュ用のシェーダのディスクリプタセット数が不正");
+        pipeline->descSetLayout = layout->setLayouts[0];
+        pipeline->pipelineLayout = layout->layout;
+#undef SHADERS_COUNT
+    }
+    {
+#define SHADERS_COUNT 1
+        const Shader shaders[SHADERS_COUNT] = { pipeline->depthVertShader };
+        const ShaderLibraryLayout *layout = getPipelineLayoutForShaders(
+            device,
+            shaderLibrary,
+            SHADERS_COUNT,
+            shaders,
+            OVERRIDES_COUNT,
+            overrides
+        );
+        CHECK(layout != NULL, "メッシュの深度プリパス用のパイプラインレイアウトの取得に失敗");
+        CHECK(layout->setLayoutsCount == 1, "メッシュの深度プリパス用のシェーダのディスクリプタセット数が不正");
+        pipeline->depthDescSetLayout = layout->setLayouts[0];
+        pipeline->depthPipelineLayout = layout->layout;
+#undef SHADERS_COUNT
+    }
+
+    // バリアント管理オブジェクトを作成する
+    //
+    // NOTE: 本描画の頂点データは position(float * 3), normal(float * 3) の順に詰めて並んでいる。
+    //       深度プリパスの頂点データは position(float * 3) のみとする。
+    {
+        VkVertexInputAttributeDescription vertInpAttrDescs[SHADER_REFLECTION_MAX_INPUTS];
+        uint32_t vertInpStride = 0;
+        buildVertexInputAttributes(pipeline->vertShader, 0, vertInpAttrDescs, &vertInpStride);
+        CHECK(vertInpStride == sizeof(float) * 6, "メッシュ用のヴァーテックスシェーダの頂点入力が頂点データと一致しない");
+        buildVertexInputAttributes(pipeline->depthVertShader, 0, vertInpAttrDescs, &vertInpStride);
+        CHECK(vertInpStride == sizeof(float) * 3, "メッシュの深度プリパス用のヴァーテックスシェーダの頂点入力がローカル座標のみでない");
+
+        const PipelineVariantsBase base = {
+            pipeline->vertShader,
+            pipeline->fragShader,
+            pipeline->pipelineLayout,
+            renderPass,
+            0,
+            samples,
+            width,
+            height,
+        };
+        pipeline->variants = createPipelineVariants(device, pipelineCache, compiler, &base);
+        CHECK(pipeline->variants != NULL, "メッシュ用のパイプラインのバリアント管理オブジェクトの作成に失敗");
+
+        const PipelineVariantsBase depthBase = {
+            pipeline->depthVertShader,
+            NULL,
+            pipeline->depthPipelineLayout,
+            renderPass,
+            0,
+            samples,
+            width,
+            height,
+        };
+        pipeline->depthVariants = createPipelineVariants(device, pipelineCache, compiler, &depthBase);
+        CHECK(pipeline->depthVariants != NULL, "メッシュの深度プリパス用のパイプラインのバリアント管理オブジェクトの作成に失敗");
+    }
+
+    // 既定のバリアントを代替のバリアントとして設定する
+    //
+    // NOTE: 深度テストはLESS_OR_EQUALで行うため、既定のバリアントは深度プリパスの後でも正しく描画できる。
+    //       深度プリパス用のバリアントは代替を持たず、作成が完了するまでは深度プリパスを省く。
+    {
+        const PipelineVariantKey defaultKey = {
+            PIPELINE_BLEND_MODE_OPAQUE,
+            VK_CULL_MODE_BACK_BIT,
+            VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+            vertexStride,
+            0,
+            PIPELINE_DEPTH_MODE_TEST_WRITE,
+        };
+        pipeline->defaultKey = defaultKey;
+        const PipelineVariantKey depthKey = {
+            PIPELINE_BLEND_MODE_OPAQUE,
+            VK_CULL_MODE_BACK_BIT,
+            VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+            0,
+            0,
+            PIPELINE_DEPTH_MODE_TEST_WRITE,
+        };
+        pipeline->depthKey = depthKey;
+        CHECK(setPipelineVariantFallback(pipeline->variants, &pipeline->defaultKey), "メッシュ用のパイプラインの代替のバリアントの設定に失敗");
+        if (compiler == NULL) {
+            CHECK(getPipelineVariant(pipeline->variants, &pipeline->defaultKey) != NULL, "メッシュ用のパイプラインの作成に失敗");
+        }
+    }
+
+    return pipeline;
+
+#undef OVERRIDES_COUNT
+#undef CHECK
+}
@@ -0,0 +1,109 @@
+/// @file mesh.h
+/// @brief 法線を持つ3Dメッシュをライティングして描画するパイプラインを定義するモジュール
+
+#pragma once
+
+#include "../util/pipeline.h"
+#include "../util/shader.h"
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+/// @brief メッシュ用のシェーダにおけるユニフォームバッファ(binding=0)のレイアウト
+typedef struct CameraForMesh_t {
+    float view[16];
+    float proj[16];
+    // 平行光源の向き (ワールド空間。wは未使用)
+    float lightDir[4];
+} CameraForMesh;
+
+/// @brief メッシュ用のシェーダにおけるストレージバッファ(binding=1)の要素のレイアウト
+///
+/// NOTE: std430でmat4とvec4を並べたものと一致する。
+typedef struct ObjectForMesh_t {
+    // モデル行列 (一様な拡大・回転・平行移動のみ)
+    float model[16];
+    float color[4];
+} ObjectForMesh;
+
+/// @brief メッシュ用のフラグメントシェーダの機能フラグ: 法線を色として出力する (constant_id=0)
+#define MESH_FEATURE_NORMAL_AS_COLOR 0x1
+
+/// @brief メッシュ用のパイプラインにおけるオブジェクトを持つ構造体
+///
+/// variantsとdepthVariants以外はShaderLibraryが所有する。
+/// シェーダはShaderLibraryから借りており、破棄時に返す。
+typedef struct PipelineForMesh_t {
+    // シェーダの返却先 (所有しない)
+    ShaderLibrary shaderLibrary;
+    VkDescriptorSetLayout descSetLayout;
+    VkPipelineLayout pipelineLayout;
+    Shader vertShader;
+    Shader fragShader;
+    PipelineVariants variants;
+    // 既定のバリアント (代替のバリアントでもある)
+    PipelineVariantKey defaultKey;
+    // 深度プリパス用
+    //
+    // NOTE: ヴァーテックスシェーダのみで、ローカル座標のみの頂点ストリームを読む。
+    //       カメラを使うステージが異なるため、ディスクリプタセットレイアウトは本描画と別になる。
+    VkDescriptorSetLayout depthDescSetLayout;
+    VkPipelineLayout depthPipelineLayout;
+    Shader depthVertShader;
+    PipelineVariants depthVariants;
+    PipelineVariantKey depthKey;
+} *PipelineForMesh;
+
+/// @brief メッシュ用のパイプラインを破棄する関数
+///
+/// デバイスがパイプラインを使い終わってから呼ぶこと。
+///
+/// @param device 論理デバイス
+/// @param pipeline メッシュ用のパイプライン
+void deletePipelineForMesh(const VkDevice device, PipelineForMesh pipeline);
+
+/// @brief メッシュ用のパイプラインを作成する関数
+///
+/// 既定のバリアントの作成を要求する。
+/// 深度プリパス用のバリアントは、初めて要求されたときに作成する。
+///
+/// - シェーダ
+///   - mesh.vert.spv
+///   - mesh.frag.spv
+///   - mesh_depth.vert.spv (深度プリパス)
+/// - バインディング
+///   - CameraForMesh (binding=0, ダイナミックユニフォームバッファ)
+///     - フレーム毎にリングバッファへ詰め、描画時にオフセットを与える
+///   - ObjectForMeshの配列 (binding=1, ダイナミックストレージバッファ)
+///     - gl_InstanceIndexで引く
+/// - 頂点データ
+///   - ローカル座標 (location=0, float * 3)
+///   - 法線ベクトル (location=1, float * 3)
+///   - UV座標等が続く場合は、バリアントのvertexStrideで頂点一つあたりのサイズを与えること
+/// - 既定のバリアント
+///   - 裏面カリング
+///   - カラーブレンド: PIPELINE_BLEND_MODE_OPAQUE
+///   - 深度テスト: PIPELINE_DEPTH_MODE_TEST_WRITE
+///   - 機能フラグ無し
+///
+/// @param device 論理デバイス
+/// @param shaderLibrary シェーダ共有オブジェクトハンドル
+/// @param pipelineCache パイプラインキャッシュ (VK_NULL_HANDLEでもよい)
+/// @param compiler パイプライン作成オブジェクトハンドル (NULLなら既定のバリアントをここで作成する)
+/// @param renderPass レンダーパス (深度アタッチメントを持つこと)
+/// @param samples レンダーパスのアタッチメントのサンプル数
+/// @param width ビューポート幅
+/// @param height ビューポート高
+/// @param vertexStride 頂点一つあたりのサイズ (0ならローカル座標と法線ベクトルのみ)
+/// @returns 失敗時にNULLを返す。
+PipelineForMesh createPipelineForMesh(
+    const VkDevice device,
+    ShaderLibrary shaderLibrary,
+    const VkPipelineCache pipelineCache,
+    PipelineCompiler compiler,
+    const VkRenderPass renderPass,
+    VkSampleCountFlagBits samples,
+    uint32_t width,
+    uint32_t height,
+    uint32_t vertexStride
+);
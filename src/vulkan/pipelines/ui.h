@@ -3,6 +3,9 @@
 
 #pragma once
 
+#include "../util/pipeline.h"
+#include "../util/shader.h"
+
 #include <stdint.h>
 #include <vulkan/vulkan.h>
 
@@ -18,28 +21,46 @@ typedef struct PushConstantForUI_t {
     float uv[4];
 } PushConstantForUI;
 
+/// @brief UI用のフラグメントシェーダの機能フラグ: UV座標を色として出力する (constant_id=0)
+#define UI_FEATURE_UV_AS_COLOR 0x1
+
 /// @brief UI用のパイプラインにおけるオブジェクトを持つ構造体
+///
+/// variants以外はShaderLibraryが所有する。
+/// シェーダはShaderLibraryから借りており、破棄時に返す。
 typedef struct PipelineForUI_t {
+    // シェーダの返却先 (所有しない)
+    ShaderLibrary shaderLibrary;
     VkDescriptorSetLayout descSetLayout;
     VkPipelineLayout pipelineLayout;
-    VkShaderModule vertShader;
-    VkShaderModule fragShader;
-    VkPipeline pipeline;
+    Shader vertShader;
+    Shader fragShader;
+    PipelineVariants variants;
+    // 既定のバリアント (代替のバリアントでもある)
+    PipelineVariantKey defaultKey;
 } *PipelineForUI;
 
 /// @brief UI用のパイプラインを破棄する関数
+///
+/// デバイスがパイプラインを使い終わってから呼ぶこと。
+/// ホットリロードで描画を止めずに破棄できるよう、ここでは待機しない。
+///
 /// @param device 論理デバイス
 /// @param pipeline UI用のパイプライン
 void deletePipelineForUI(const VkDevice device, PipelineForUI pipeline);
 
 /// @brief UI用のパイプラインを作成する関数
 ///
+/// バインディング・プッシュ定数・頂点入力はシェーダから読み取る。
+/// パイプライン自体はここでは作成せず、PipelineCompilerに既定のバリアントの作成を要求するのみとする。
+/// 描画時にはvariantsから取得し、作成が完了していなければ既定のバリアントで代替する。
+///
 /// - シェーダ
 ///   - ui.vert.spv
 ///   - ui.frag.spv
 /// - バインディング
-///   - CameraForUI (binding=0)
-/// - プッシュ手数
+///   - CameraForUI (binding=0, ダイナミックユニフォームバッファ)
+/// - プッシュ定数
 ///   - PushConstantForUI
 /// - 頂点データ
 ///   - ローカル座標 (location=0, float * 3)
@@ -48,16 +69,30 @@ void deletePipelineForUI(const VkDevice device, PipelineForUI pipeline);
 /// - ビューポート
 ///   - 幅width
 ///   - 高height
-/// - カリング無し
 /// - マルチサンプリング無し
-/// - 深度・ステンシルテスト無し
-/// - カラーブレンド
-///   - color: src.alpha * src.color + (1 - src.alpha) * dst.color
-///   - alpha: ?
+/// - ステンシルテスト無し
+/// - 既定のバリアント
+///   - カリング無し
+///   - カラーブレンド: PIPELINE_BLEND_MODE_ALPHA
+///   - 深度テスト無し
+///   - 機能フラグ無し
 ///
 /// @param device 論理デバイス
+/// @param shaderLibrary シェーダ共有オブジェクトハンドル
+/// @param pipelineCache パイプラインキャッシュ (VK_NULL_HANDLEでもよい)
+/// @param compiler パイプライン作成オブジェクトハンドル (NULLなら既定のバリアントをここで作成する)
 /// @param renderPass レンダーパス
+/// @param samples レンダーパスのアタッチメントのサンプル数
 /// @param width ビューポート幅
 /// @param height ビューポート高
 /// @returns 失敗時にNULLを返す。
-PipelineForUI createPipelineForUI(const VkDevice device, const VkRenderPass renderPass, uint32_t width, uint32_t height);
+PipelineForUI createPipelineForUI(
+    const VkDevice device,
+    ShaderLibrary shaderLibrary,
+    const VkPipelineCache pipelineCache,
+    PipelineCompiler compiler,
+    const VkRenderPass renderPass,
+    VkSampleCountFlagBits samples,
+    uint32_t width,
+    uint32_t height
+);
@@ -28,7 +28,25 @@ void deleteVulkanAppPresentation(const VulkanAppCore core, VulkanAppPresentation
     free((void *)presenter);
 }
 
-VulkanAppPresentation createVulkanAppPresentation(const VulkanAppCore core, const VkSurfaceKHR surface) {
+// プレゼンテーションモードの名前を取得する関数
+static const char *getPresentModeName(VkPresentModeKHR mode) {
+    switch (mode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:    return "IMMEDIATE";
+        case VK_PRESENT_MODE_MAILBOX_KHR:      return "MAILBOX";
+        case VK_PRESENT_MODE_FIFO_KHR:         return "FIFO";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "FIFO_RELAXED";
+        default:                               return "UNKNOWN";
+    }
+}
+
+VulkanAppPresentation createVulkanAppPresentation(
+    const VulkanAppCore core,
+    const VkSurfaceKHR surface,
+    uint32_t width,
+    uint32_t height,
+    PresentPreference preference,
+    uint32_t imagesCount
+) {
 #define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "createVulkanAppPresentation()", (m), (p), deleteVulkanAppPresentation(core, presenter), NULL)
 #define CHECK(p, m)    ERROR_IF     (!(p),              "createVulkanAppPresentation()", (m),      deleteVulkanAppPresentation(core, presenter), NULL)
 
@@ -36,6 +54,18 @@ VulkanAppPresentation createVulkanAppPresentation(const VulkanAppCore core, cons
     CHECK(presenter != NULL, "VulkanAppPresentationのメモリ確保に失敗");
     memset(presenter, 0, sizeof(struct VulkanAppPresentation_t));
 
+    // キューがサーフェスへの表示に対応しているか確認する
+    //
+    // NOTE: キューはグラフィックスに対応していることのみを条件に選んでいるため、表示に対応しているとは限らない。
+    {
+        VkBool32 supported = VK_FALSE;
+        CHECK_VK(
+            vkGetPhysicalDeviceSurfaceSupportKHR(core->physDevice, core->queueFamIndex, surface, &supported),
+            "サーフェスへの表示への対応の確認に失敗"
+        );
+        CHECK(supported == VK_TRUE, "キューがサーフェスへの表示に対応していない");
+    }
+
     // サーフェスが条件を満たしているか確認する
     //
     // NOTE: サーフェスフォーマットは次の二つの情報を持つ。
@@ -60,26 +90,86 @@ VulkanAppPresentation createVulkanAppPresentation(const VulkanAppCore core, cons
         CHECK(found, "サーフェスフォーマットの取得に失敗");
     }
 
+    // プレゼンテーションモードを選ぶ
+    //
+    // NOTE: 詳しくはPresentPreferenceのコメントを参照。
+    {
+#define CANDIDATES_COUNT 4
+        const VkPresentModeKHR candidatesList[][CANDIDATES_COUNT] = {
+            // PRESENT_PREFERENCE_NO_TEARING
+            { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_KHR },
+            // PRESENT_PREFERENCE_LOW_LATENCY
+            { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR },
+            // PRESENT_PREFERENCE_UNCAPPED
+            { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR },
+        };
+        const VkPresentModeKHR *candidates = candidatesList[preference];
+
+        uint32_t count = 0;
+        CHECK_VK(vkGetPhysicalDeviceSurfacePresentModesKHR(core->physDevice, surface, &count, NULL), "プレゼンテーションモードの数の取得に失敗");
+        VkPresentModeKHR *modes = (VkPresentModeKHR *)malloc(sizeof(VkPresentModeKHR) * count);
+        CHECK(modes != NULL, "プレゼンテーションモードの配列の確保に失敗");
+        const VkResult res = vkGetPhysicalDeviceSurfacePresentModesKHR(core->physDevice, surface, &count, modes);
+        if (res != VK_SUCCESS) free(modes);
+        CHECK_VK(res, "プレゼンテーションモードの列挙に失敗");
+
+        presenter->presentMode = VK_PRESENT_MODE_FIFO_KHR;
+        int found = 0;
+        for (uint32_t i = 0; i < CANDIDATES_COUNT && !found; ++i) {
+            for (uint32_t j = 0; j < count; ++j) {
+                if (modes[j] == candidates[i]) {
+                    presenter->presentMode = candidates[i];
+                    found = 1;
+                    break;
+                }
+            }
+        }
+
+        free(modes);
+#undef CANDIDATES_COUNT
+    }
+
     // サーフェスのサイズを取得する & イメージの個数を決定する
     //
     // NOTE: サーフェスのサイズはスクリーンのサイズと同じになるはず。
+    //       ただし、currentExtentが0xFFFFFFFFならサーフェスは大きさを決めず、スワップチェーンの大きさに従う。
     //
     // NOTE: サーフェスによって描画先イメージの最小個数が変わる。
-    //       ダブルバッファリングのために、最小個数が1個でも2個使うようにする。
+    //       指定が無ければ、ダブルバッファリングのために最小個数が1個でも2個使うようにする。
+    //       MAILBOXは表示中・表示待ち・描画中のイメージを同時に持つため、3個使うようにする。
+    //       maxImageCountが0なら最大個数に制限は無い。
     {
         VkSurfaceCapabilitiesKHR capas;
         CHECK_VK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(core->physDevice, surface, &capas), "サーフェスキャパビリティの取得に失敗");
 
-        presenter->width = capas.currentExtent.width;
-        presenter->height = capas.currentExtent.height;
-
-        if (capas.minImageCount > 2) {
-            presenter->imagesCount = capas.minImageCount;
+        if (capas.currentExtent.width != UINT32_MAX) {
+            presenter->width = capas.currentExtent.width;
+            presenter->height = capas.currentExtent.height;
         } else {
-            presenter->imagesCount = 2;
+            presenter->width = width < capas.minImageExtent.width ? capas.minImageExtent.width : width;
+            presenter->width = presenter->width > capas.maxImageExtent.width ? capas.maxImageExtent.width : presenter->width;
+            presenter->height = height < capas.minImageExtent.height ? capas.minImageExtent.height : height;
+            presenter->height = presenter->height > capas.maxImageExtent.height ? capas.maxImageExtent.height : presenter->height;
+        }
+
+        if (imagesCount == 0) {
+            imagesCount = presenter->presentMode == VK_PRESENT_MODE_MAILBOX_KHR ? 3 : 2;
+        }
+        if (imagesCount < capas.minImageCount) {
+            imagesCount = capas.minImageCount;
+        }
+        if (capas.maxImageCount > 0 && imagesCount > capas.maxImageCount) {
+            imagesCount = capas.maxImageCount;
         }
+        presenter->imagesCount = imagesCount;
     }
 
+    printf(
+        "[ info ] presentation: プレゼンテーションモード=%s, 描画先イメージ数=%u\n",
+        getPresentModeName(presenter->presentMode),
+        presenter->imagesCount
+    );
+
     // スワップチェーンを作成する
     //
     // NOTE: スワップチェーンとは、表示を制御するオブジェクト。
@@ -104,7 +194,7 @@ VulkanAppPresentation createVulkanAppPresentation(const VulkanAppCore core, cons
             NULL,
             VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,
             VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
-            VK_PRESENT_MODE_FIFO_KHR,
+            presenter->presentMode,
             VK_TRUE,
             NULL,
         };
@@ -166,29 +256,34 @@ VulkanAppPresentation createVulkanAppPresentation(const VulkanAppCore core, cons
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 int acquireNextImageIndex(const VulkanAppCore core, const VulkanAppPresentation presenter) {
-#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "acquireNextImageIndex()", (m), (p), "", 0)
+#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "acquireNextImageIndex()", (m), (p), {}, 0)
     // 利用可能な次のイメージのインデックスを取得する
     //
     // NOTE: ダブルバッファリングを行う場合どうせ1枚目2枚目1枚目...と続くので手動でもいいように思えるが必須の処理。
     //       真にイメージが利用可能になるのを同期するために、セマフォを指定する。
     //       フェンスもセマフォもNULLにするとvalidationに怒られる。
-    CHECK_VK(
-        vkAcquireNextImageKHR(
-            core->device,
-            presenter->swapchain,
-            UINT64_MAX,
-            presenter->waitForImageEnabledSemaphore,
-            NULL,
-            &presenter->imageIndex
-        ),
-        "次のフレームバッファのインデックスの取得に失敗"
+    //
+    // NOTE: ウィンドウの大きさが変わる等でスワップチェーンが使えなくなっても、作り直しには対応しないため呼び出し側に知らせる。
+    //       VK_SUBOPTIMAL_KHRではイメージを取得しセマフォもシグナルされるため、そのまま描画する。
+    const VkResult result = vkAcquireNextImageKHR(
+        core->device,
+        presenter->swapchain,
+        UINT64_MAX,
+        presenter->waitForImageEnabledSemaphore,
+        NULL,
+        &presenter->imageIndex
     );
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        presenter->outOfDate = 1;
+        return 0;
+    }
+    CHECK_VK(result == VK_SUBOPTIMAL_KHR ? VK_SUCCESS : result, "次のフレームバッファのインデックスの取得に失敗");
     return 1;
 #undef CHECK_VK
 }
 
 int present(const VulkanAppCore core, const VulkanAppPresentation presenter) {
-#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "present()", (m), (p), "", 0)
+#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "present()", (m), (p), {}, 0)
 #define SEMAPHORES_COUNT 1
 #define SWAPCHAINS_COUNT 1
     // プレゼンテーションコマンドをエンキューする
@@ -217,8 +312,13 @@ int present(const VulkanAppCore core, const VulkanAppPresentation presenter) {
         imageIndices,
         results,
     };
-    CHECK_VK(vkQueuePresentKHR(core->queue, &pi), "プレゼンテーションコマンドのエンキューに失敗");
-    CHECK_VK(results[0], "プレゼンテーションに失敗");
+    const VkResult result = vkQueuePresentKHR(core->queue, &pi);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || results[0] == VK_ERROR_OUT_OF_DATE_KHR) {
+        presenter->outOfDate = 1;
+        return 0;
+    }
+    CHECK_VK(result == VK_SUBOPTIMAL_KHR ? VK_SUCCESS : result, "プレゼンテーションコマンドのエンキューに失敗");
+    CHECK_VK(results[0] == VK_SUBOPTIMAL_KHR ? VK_SUCCESS : results[0], "プレゼンテーションに失敗");
     return 1;
 #undef SWAPCHAINS_COUNT
 #undef SEMAPHORES_COUNT
@@ -8,16 +8,43 @@
 #include <stdint.h>
 #include <vulkan/vulkan.h>
 
+/// @brief プレゼンテーションモードの選び方
+///
+/// 物理デバイスがサーフェスに対して対応しているものから、次の優先順で選ぶ。
+/// FIFOは全ての実装が対応しているため、最後の候補として必ず選べる。
+/// - PRESENT_PREFERENCE_NO_TEARING
+///   - FIFO (垂直同期を待ち、ティアリングしない。描画がリフレッシュレートに制限される)
+/// - PRESENT_PREFERENCE_LOW_LATENCY
+///   - MAILBOX (ティアリングせず、待っている古いイメージを新しいものに差し替える)
+///   - IMMEDIATE (垂直同期を待たない。ティアリングしうる)
+///   - FIFO_RELAXED (間に合わなかったフレームのみ垂直同期を待たない)
+///   - FIFO
+/// - PRESENT_PREFERENCE_UNCAPPED
+///   - IMMEDIATE (描画のスループットを測る場合等)
+///   - MAILBOX
+///   - FIFO_RELAXED
+///   - FIFO
+typedef enum PresentPreference_t {
+    PRESENT_PREFERENCE_NO_TEARING,
+    PRESENT_PREFERENCE_LOW_LATENCY,
+    PRESENT_PREFERENCE_UNCAPPED,
+} PresentPreference;
+
 /// @brief Vulkanアプリケーションのプレゼンテーションオブジェクトを持つ構造体
 typedef struct VulkanAppPresentation_t {
     uint32_t width;
     uint32_t height;
     VkSwapchainKHR swapchain;
+    VkPresentModeKHR presentMode;
     uint32_t imagesCount;
     VkImageView *imageViews;
     uint32_t imageIndex;
     VkSemaphore waitForImageEnabledSemaphore;
     VkSemaphore waitForRenderingSemaphore;
+    // スワップチェーンがサーフェスと合わなくなり、使えなくなったか (VK_ERROR_OUT_OF_DATE_KHR)
+    //
+    // NOTE: スワップチェーンの作り直しには対応しないため、一度立てば下ろさない。
+    int outOfDate;
 } *VulkanAppPresentation;
 
 /// @brief VulkanAppPresentationを破棄する関数
@@ -32,18 +59,44 @@ void deleteVulkanAppPresentation(const VulkanAppCore core, VulkanAppPresentation
 ///
 /// プラットフォームの差異を吸収するため、サーフェスはプラットフォーム依存のコードで生成し、引数に与える。
 ///
+/// 描画先イメージの大きさはサーフェスの大きさとする。
+/// ただし、サーフェスが大きさを決めない場合(Wayland・VK_EXT_headless_surface等)は、width x heightをサーフェスの範囲に収めたものとする。
+///
+/// プレゼンテーションモードはpreferenceに従って選ぶ(PresentPreferenceのコメントを参照)。
+/// 描画先イメージの個数はimagesCountとし、サーフェスの最小個数と最大個数の範囲に収める。
+/// imagesCountが0なら、ダブルバッファリング(MAILBOXならトリプルバッファリング)に必要な個数とする。
+///
 /// @param core 主要オブジェクトハンドル
 /// @param surface サーフェス
+/// @param width サーフェスが大きさを決めない場合の描画先イメージの幅
+/// @param height サーフェスが大きさを決めない場合の描画先イメージの高
+/// @param preference プレゼンテーションモードの選び方
+/// @param imagesCount 描画先イメージの個数 (0なら自動で決める)
 /// @returns 失敗時にNULLを返す。
-VulkanAppPresentation createVulkanAppPresentation(const VulkanAppCore core, const VkSurfaceKHR surface);
+VulkanAppPresentation createVulkanAppPresentation(
+    const VulkanAppCore core,
+    const VkSurfaceKHR surface,
+    uint32_t width,
+    uint32_t height,
+    PresentPreference preference,
+    uint32_t imagesCount
+);
 
 /// @brief 次のフレームバッファのインデックスを取得する関数
+///
+/// VK_SUBOPTIMAL_KHRはイメージを取得できているため成功とみなす。
+/// VK_ERROR_OUT_OF_DATE_KHRならoutOfDateを1にして0を返す。
+///
 /// @param core 主要オブジェクトハンドル
 /// @param presenter プレゼンテーションオブジェクトハンドル
 /// @returns 失敗時に0を返す。
 int acquireNextImageIndex(const VulkanAppCore core, const VulkanAppPresentation presenter);
 
 /// @brief プレゼンテーションを行う関数
+///
+/// VK_SUBOPTIMAL_KHRは表示できているため成功とみなす。
+/// VK_ERROR_OUT_OF_DATE_KHRならoutOfDateを1にして0を返す。
+///
 /// @param core 主要オブジェクトハンドル
 /// @param presenter プレゼンテーションオブジェクトハンドル
 /// @returns 失敗時に0を返す。
@@ -2,8 +2,12 @@
 
 #include "util/constant.h"
 #include "util/error.h"
+#include "util/matrix.h"
 #include "util/memory/memory.h"
+#include "util/profiler.h"
+#include "util/timer.h"
 
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -12,41 +16,202 @@
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// ホットリロードで差し替えられたパイプラインを破棄する関数
+static void deleteRetiredPipeline(const VkDevice device, const RetiredPipeline *retired) {
+    if (retired->cull != NULL) deletePipelineForCull(device, retired->cull);
+    if (retired->mesh != NULL) deletePipelineForMesh(device, retired->mesh);
+    if (retired->depth != NULL) deletePipelineForDepth(device, retired->depth);
+    if (retired->ui != NULL) deletePipelineForUI(device, retired->ui);
+}
+
 void deleteVulkanAppRendering(const VulkanAppCore core, VulkanAppRendering renderer) {
     if (renderer == NULL) {
         return;
     }
+    // NOTE: 描画の計測の結果を回収するためにも、クエリを使うコマンドの実行完了を待機しておく。
     vkDeviceWaitIdle(core->device);
+    if (renderer->drawStats != NULL) {
+        flushDrawStats(core->device, renderer->drawStats);
+        printDrawStats(renderer->drawStats);
+        deleteDrawStats(core->device, renderer->drawStats);
+    }
+    if (renderer->meshFramesCount > 0) {
+        printf(
+            "[ info ] mesh: %.0f triangles/frame over %llu frames\n",
+            (double)renderer->meshTrianglesCount / (double)renderer->meshFramesCount,
+            (unsigned long long)renderer->meshFramesCount
+        );
+    }
+    if (renderer->mesh != NULL) deleteModel(core->device, renderer->mesh);
     if (renderer->square != NULL) deleteModel(core->device, renderer->square);
+    if (renderer->shaderWatcher != NULL) deleteFileWatcher(renderer->shaderWatcher);
+    if (renderer->glslCompiler != NULL) deleteGlslCompiler(renderer->glslCompiler);
+    if (renderer->pendingCullPipeline != NULL) deletePipelineForCull(core->device, renderer->pendingCullPipeline);
+    if (renderer->pendingMeshPipeline != NULL) deletePipelineForMesh(core->device, renderer->pendingMeshPipeline);
+    if (renderer->pendingDepthPipeline != NULL) deletePipelineForDepth(core->device, renderer->pendingDepthPipeline);
+    if (renderer->pendingUiPipeline != NULL) deletePipelineForUI(core->device, renderer->pendingUiPipeline);
+    for (uint32_t i = 0; i < renderer->retiredPipelinesCount; ++i) {
+        deleteRetiredPipeline(core->device, &renderer->retiredPipelines[i]);
+    }
+    if (renderer->cullPipeline != NULL) deletePipelineForCull(core->device, renderer->cullPipeline);
+    if (renderer->meshPipeline != NULL) deletePipelineForMesh(core->device, renderer->meshPipeline);
+    if (renderer->depthPipeline != NULL) deletePipelineForDepth(core->device, renderer->depthPipeline);
     if (renderer->uiPipeline != NULL) deletePipelineForUI(core->device, renderer->uiPipeline);
-    if (renderer->uniBufferForUI != NULL) deleteBuffer(core->device, renderer->uniBufferForUI);
-    if (renderer->descSetForUI != NULL) vkFreeDescriptorSets(core->device, renderer->descPool, 1, &renderer->descSetForUI);
-    if (renderer->descPool != NULL) vkDestroyDescriptorPool(core->device, renderer->descPool, NULL);
+    if (renderer->pipelineCompiler != NULL) {
+        printPipelineCompilerStats(renderer->pipelineCompiler);
+        deletePipelineCompiler(renderer->pipelineCompiler);
+    }
+    if (renderer->frameGraph != NULL) deleteRenderGraph(core->device, renderer->frameGraph);
+    if (renderer->cullCmdBuffer != NULL) deleteBuffer(core->device, renderer->cullCmdBuffer);
+    if (renderer->cullIdxBuffer != NULL) deleteBuffer(core->device, renderer->cullIdxBuffer);
+    if (renderer->objRing != NULL) deleteRingBuffer(core->device, renderer->objRing);
+    if (renderer->uniRing != NULL) deleteRingBuffer(core->device, renderer->uniRing);
+    for (uint32_t i = 0; i < RENDERING_FRAMES_IN_FLIGHT; ++i) {
+        if (renderer->frameFences[i] != NULL) vkDestroyFence(core->device, renderer->frameFences[i], NULL);
+    }
+    if (renderer->descAllocator != NULL) deleteDescriptorAllocator(core->device, renderer->descAllocator);
+    if (renderer->pipelineCache != NULL) {
+        savePipelineCache(core->device, renderer->pipelineCache, renderer->pipelineCachePath);
+        vkDestroyPipelineCache(core->device, renderer->pipelineCache, NULL);
+    }
+    if (renderer->shaderLibrary != NULL) deleteShaderLibrary(core->device, renderer->shaderLibrary);
+    if (renderer->descSetLayoutCache != NULL) deleteDescriptorSetLayoutCache(core->device, renderer->descSetLayoutCache);
     if (renderer->framebuffers != NULL) {
         for (uint32_t i = 0; i < renderer->framebuffersCount; ++i) {
             if (renderer->framebuffers[i] != NULL) vkDestroyFramebuffer(core->device, renderer->framebuffers[i], NULL);
         }
         free((void *)renderer->framebuffers);
     }
+    if (renderer->depthImageView != NULL) vkDestroyImageView(core->device, renderer->depthImageView, NULL);
+    if (renderer->depthImage != NULL) deleteImage(core->device, renderer->depthImage);
+    if (renderer->colorImageView != NULL) vkDestroyImageView(core->device, renderer->colorImageView, NULL);
+    if (renderer->colorImage != NULL) deleteImage(core->device, renderer->colorImage);
     if (renderer->renderPass != NULL) vkDestroyRenderPass(core->device, renderer->renderPass, NULL);
     free((void *)renderer);
 }
 
+VkSampleCountFlagBits selectRenderingSampleCount(const VulkanAppCore core, uint32_t requested) {
+    // NOTE: 深度アタッチメントもカラーアタッチメントと同じサンプル数でなければならない。
+    const VkPhysicalDeviceLimits *limits = &core->physDevProps.limits;
+    const VkSampleCountFlags supported = limits->framebufferColorSampleCounts & limits->framebufferDepthSampleCounts;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    for (uint32_t count = VK_SAMPLE_COUNT_64_BIT; count > VK_SAMPLE_COUNT_1_BIT; count >>= 1) {
+        if (count <= requested && (supported & count) != 0) {
+            samples = (VkSampleCountFlagBits)count;
+            break;
+        }
+    }
+    if (requested > 1 && (uint32_t)samples != requested) {
+        printf("[ info ] msaa: サンプル数%uに対応していないため%dを用いる\n", requested, (int)samples);
+    }
+    return samples;
+}
+
 VulkanAppRendering createVulkanAppRendering(
     const VulkanAppCore core,
     const VkImageView *imageViews,
     uint32_t imageViewsCount,
     uint32_t width,
     uint32_t height,
-    VkImageLayout imageLayout
+    VkImageLayout imageLayout,
+    VkSampleCountFlagBits samples
 ) {
 #define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "createVulkanAppRendering()", (m), (p), deleteVulkanAppRendering(core, renderer), NULL)
 #define CHECK(p, m)    ERROR_IF     (!(p),              "createVulkanAppRendering()", (m),      deleteVulkanAppRendering(core, renderer), NULL)
-#define ATTACHMENTS_COUNT 1
+#define MAX_ATTACHMENTS_COUNT 3
 
     const VulkanAppRendering renderer = (VulkanAppRendering)malloc(sizeof(struct VulkanAppRendering_t));
     CHECK(renderer != NULL, "VulkanAppRenderingの確保に失敗");
     memset(renderer, 0, sizeof(struct VulkanAppRendering_t));
+    renderer->samples = samples;
+    const int multisampled = samples != VK_SAMPLE_COUNT_1_BIT;
+
+    // 深度アタッチメントのフォーマットを選ぶ
+    //
+    // NOTE: 深度アタッチメントとして使えるフォーマットは物理デバイスに依る。
+    //       ステンシルは使わないため、深度のみのフォーマットから精度の高い順に探す。
+    //       VK_FORMAT_D16_UNORMは全ての物理デバイスが対応している。
+    {
+#define DEPTH_FORMATS_COUNT 3
+        const VkFormat candidates[DEPTH_FORMATS_COUNT] = {
+            VK_FORMAT_D32_SFLOAT,
+            VK_FORMAT_X8_D24_UNORM_PACK32,
+            VK_FORMAT_D16_UNORM,
+        };
+        renderer->depthFormat = findSupportedImageFormat(
+            core->physDevice,
+            DEPTH_FORMATS_COUNT,
+            candidates,
+            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+        );
+        CHECK(renderer->depthFormat != VK_FORMAT_UNDEFINED, "深度アタッチメントに使えるフォーマットが無い");
+#undef DEPTH_FORMATS_COUNT
+    }
+
+    // 深度アタッチメントを作成する
+    //
+    // NOTE: 深度はレンダーパスの中でクリアしてから使い、終了後は読まない。
+    //       そのためTRANSIENT_ATTACHMENTとし、遅延確保のメモリがあればそこに置く。
+    //       同時に処理されうるフレーム間で共有するが、レンダーパスの依存関係で前のフレームの書込みを待つ。
+    {
+        const VkExtent3D extent = { width, height, 1 };
+        renderer->depthImage = createImage(
+            core->device,
+            core->allocator,
+            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+            MEMORY_USAGE_TRANSIENT,
+            renderer->depthFormat,
+            &extent,
+            renderer->samples
+        );
+        CHECK(renderer->depthImage != NULL, "深度アタッチメントの作成に失敗");
+        const VkImageViewCreateInfo ci = {
+            VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            NULL,
+            0,
+            renderer->depthImage->image,
+            VK_IMAGE_VIEW_TYPE_2D,
+            renderer->depthFormat,
+            { 0 },
+            { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 },
+        };
+        CHECK_VK(vkCreateImageView(core->device, &ci, NULL, &renderer->depthImageView), "深度アタッチメントのイメージビューの作成に失敗");
+    }
+
+    // マルチサンプルのカラーアタッチメントを作成する
+    //
+    // NOTE: サブパスの終わりに描画先イメージへリゾルブし、自身の内容は捨てる。
+    //       深度アタッチメントと同様にTRANSIENT_ATTACHMENTとし、フレーム間で共有する。
+    if (multisampled) {
+        const VkExtent3D extent = { width, height, 1 };
+        renderer->colorImage = createImage(
+            core->device,
+            core->allocator,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+            MEMORY_USAGE_TRANSIENT,
+            RENDER_TARGET_PIXEL_FORMAT,
+            &extent,
+            renderer->samples
+        );
+        CHECK(renderer->colorImage != NULL, "マルチサンプルのカラーアタッチメントの作成に失敗");
+        const VkImageViewCreateInfo ci = {
+            VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            NULL,
+            0,
+            renderer->colorImage->image,
+            VK_IMAGE_VIEW_TYPE_2D,
+            RENDER_TARGET_PIXEL_FORMAT,
+            { 0 },
+            { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
+        };
+        CHECK_VK(vkCreateImageView(core->device, &ci, NULL, &renderer->colorImageView), "マルチサンプルのカラーアタッチメントのイメージビューの作成に失敗");
+    }
+    printf(
+        "[ info ] attachments: samples=%d, 深度の遅延確保=%d, カラーの遅延確保=%d\n",
+        (int)renderer->samples,
+        renderer->depthImage->lazy,
+        renderer->colorImage != NULL ? renderer->colorImage->lazy : 0
+    );
 
     // レンダーパスを作成する
     //
@@ -63,13 +228,42 @@ VulkanAppRendering createVulkanAppRendering(
     //       最後に撮影(合成)することで一コマが完成する。
     //       並列して行える作業もあれば、前工程に依存する作業もある。
     //       Vulkanにおけるこのようなものをレンダーパスと言う。
+    //
+    // NOTE: マルチサンプルの場合、アタッチメントは次の三つになる。
+    //         0. マルチサンプルのカラーアタッチメント (クリアして描画し、内容は捨てる)
+    //         1. 深度アタッチメント
+    //         2. リゾルブ先の描画先イメージ (サブパスの終わりにリゾルブされる)
+    //       リゾルブもCOLOR_ATTACHMENT_OUTPUTステージのCOLOR_ATTACHMENT_WRITEとして扱われるため、依存関係は変わらない。
+    const uint32_t attachmentsCount = multisampled ? 3 : 2;
     {
-        const VkAttachmentDescription attchDescs[ATTACHMENTS_COUNT] = {
+        const VkAttachmentDescription attchDescs[MAX_ATTACHMENTS_COUNT] = {
             {
                 0,
                 RENDER_TARGET_PIXEL_FORMAT,
-                VK_SAMPLE_COUNT_1_BIT,
+                renderer->samples,
                 VK_ATTACHMENT_LOAD_OP_CLEAR,
+                multisampled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE,
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                VK_IMAGE_LAYOUT_UNDEFINED,
+                multisampled ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : imageLayout,
+            },
+            {
+                0,
+                renderer->depthFormat,
+                renderer->samples,
+                VK_ATTACHMENT_LOAD_OP_CLEAR,
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            },
+            {
+                0,
+                RENDER_TARGET_PIXEL_FORMAT,
+                VK_SAMPLE_COUNT_1_BIT,
+                VK_ATTACHMENT_LOAD_OP_DONT_CARE,
                 VK_ATTACHMENT_STORE_OP_STORE,
                 VK_ATTACHMENT_LOAD_OP_DONT_CARE,
                 VK_ATTACHMENT_STORE_OP_DONT_CARE,
@@ -83,6 +277,16 @@ VulkanAppRendering createVulkanAppRendering(
                 VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
             },
         };
+        const VkAttachmentReference resolveAttchRefs[] = {
+            {
+                2,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            },
+        };
+        const VkAttachmentReference depthAttchRef = {
+            1,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        };
         const VkSubpassDescription subpassDescs[] = {
             {
                 0,
@@ -91,40 +295,71 @@ VulkanAppRendering createVulkanAppRendering(
                 NULL,
                 1,
                 attchRefs,
-                NULL,
-                NULL,
+                multisampled ? resolveAttchRefs : NULL,
+                &depthAttchRef,
                 0,
                 NULL,
             },
         };
+        // NOTE: 深度アタッチメント(とマルチサンプルのカラーアタッチメント)はフレーム間で共有するため、
+        //       前のフレームの書込みが終わるまでこのフレームのクリアと描画を待たせる。
+        //
+        // NOTE: レンダーパスの後の使い方(読み戻し等)はレンダーグラフがCOLOR_ATTACHMENT_OUTPUTを始点とするバリアで待つ。
+        //       暗黙の依存関係の終点はBOTTOM_OF_PIPEでバリアと連鎖しないため、最終レイアウトへの遷移をCOLOR_ATTACHMENT_OUTPUTまでに終えさせる。
+#define DEPENDENCIES_COUNT 2
+        const VkSubpassDependency dependencies[DEPENDENCIES_COUNT] = {
+            {
+                VK_SUBPASS_EXTERNAL,
+                0,
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                0,
+            },
+            {
+                0,
+                VK_SUBPASS_EXTERNAL,
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                0,
+                0,
+            },
+        };
         const VkRenderPassCreateInfo ci = {
             VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
             NULL,
             0,
-            ATTACHMENTS_COUNT,
+            attachmentsCount,
             attchDescs,
             1,
             subpassDescs,
-            0,
-            NULL,
+            DEPENDENCIES_COUNT,
+            dependencies,
         };
         CHECK_VK(vkCreateRenderPass(core->device, &ci, NULL, &renderer->renderPass), "レンダーパスの作成に失敗");
+#undef DEPENDENCIES_COUNT
     }
 
     // フレームバッファを作成する
     //
-    // NOTE: 
+    // NOTE: マルチサンプルの場合、描画先イメージビューはリゾルブ先として最後に置く。
     {
         renderer->framebuffersCount = imageViewsCount;
         renderer->framebuffers = (VkFramebuffer *)malloc(sizeof(VkFramebuffer) * renderer->framebuffersCount);
         for (uint32_t i = 0; i < renderer->framebuffersCount; ++i) {
-            const VkImageView attachments[ATTACHMENTS_COUNT] = { imageViews[i] };
+            const VkImageView attachments[MAX_ATTACHMENTS_COUNT] = {
+                multisampled ? renderer->colorImageView : imageViews[i],
+                renderer->depthImageView,
+                imageViews[i],
+            };
             const VkFramebufferCreateInfo ci = {
                 VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
                 NULL,
                 0,
                 renderer->renderPass,
-                ATTACHMENTS_COUNT,
+                attachmentsCount,
                 attachments,
                 width,
                 height,
@@ -134,75 +369,105 @@ VulkanAppRendering createVulkanAppRendering(
         }
     }
 
-    // ディスクリプタプールを作成する
+    // ディスクリプタセットの確保に必要なオブジェクトを作成する
+    //
+    // NOTE: ディスクリプタセットレイアウトは複数のパイプラインで共有する。
+    //       シェーダモジュールとパイプラインレイアウトも同様に共有する。
+    //       ディスクリプタセットは作成時に一度だけ確保し、フレーム毎のデータはダイナミックオフセットで切り替える。
     {
-#define SIZES_COUNT 1
-        const VkDescriptorPoolSize sizes[SIZES_COUNT] = {
-            {
-                VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                1,
-            },
-        };
-        const VkDescriptorPoolCreateInfo ci = {
-            VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-            NULL,
-            VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
-            1,
-            SIZES_COUNT,
-            sizes,
-        };
-        CHECK_VK(vkCreateDescriptorPool(core->device, &ci, NULL, &renderer->descPool), "ディスクリプタプールの作成に失敗");
-#undef SIZES_COUNT
+        renderer->descSetLayoutCache = createDescriptorSetLayoutCache();
+        CHECK(renderer->descSetLayoutCache != NULL, "ディスクリプタセットレイアウト共有オブジェクトの作成に失敗");
+        renderer->shaderLibrary = createShaderLibrary(renderer->descSetLayoutCache);
+        CHECK(renderer->shaderLibrary != NULL, "シェーダ共有オブジェクトの作成に失敗");
+        renderer->descAllocator = createDescriptorAllocator(4);
+        CHECK(renderer->descAllocator != NULL, "ディスクリプタ確保オブジェクトの作成に失敗");
     }
 
-    // パイプラインを作成する
-    renderer->uiPipeline = createPipelineForUI(core->device, renderer->renderPass, width, height);
-    CHECK(renderer->uiPipeline != NULL, "UI用のパイプラインの作成に失敗");
-
-    // UI用シェーダのカメラのためのディスクリプタセットを確保する
+    // フレーム毎のフェンスを作成する
+    //
+    // NOTE: 最初のフレームで待機しないように、シグナルされた状態で作成する。
     {
-#define DESC_SETS_COUNT 1
-        const VkDescriptorSetLayout descSetLayouts[DESC_SETS_COUNT] = { renderer->uiPipeline->descSetLayout };
-        const VkDescriptorSetAllocateInfo ai = {
-            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        const VkFenceCreateInfo ci = {
+            VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
             NULL,
-            renderer->descPool,
-            DESC_SETS_COUNT,
-            descSetLayouts,
+            VK_FENCE_CREATE_SIGNALED_BIT,
         };
-        CHECK_VK(vkAllocateDescriptorSets(core->device, &ai, &renderer->descSetForUI), "UI用シェーダのカメラのためのディスクリプタセットの確保に失敗");
-#undef DESC_SETS_COUNT
+        for (uint32_t i = 0; i < RENDERING_FRAMES_IN_FLIGHT; ++i) {
+            CHECK_VK(vkCreateFence(core->device, &ci, NULL, &renderer->frameFences[i]), "フレーム毎のフェンスの作成に失敗");
+        }
     }
 
-    // UI用シェーダのカメラのためのユニフォームバッファを作成し設定する
+    // ユニフォームバッファ用のリングバッファを作成する
+    //
+    // NOTE: ダイナミックユニフォームバッファのオフセットはminUniformBufferOffsetAlignmentの倍数でなければならない。
     {
-        renderer->uniBufferForUI = createBuffer(
+        renderer->uniRing = createRingBuffer(
             core->device,
-            &core->physDevMemProps,
+            core->allocator,
             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            sizeof(CameraForUI)
+            RENDERING_UNIFORM_RING_FRAME_SIZE,
+            RENDERING_FRAMES_IN_FLIGHT,
+            core->physDevProps.limits.minUniformBufferOffsetAlignment
         );
-        CHECK(renderer->uniBufferForUI != NULL, "UI用シェーダのカメラのためのユニフォームバッファの作成に失敗");
+        CHECK(renderer->uniRing != NULL, "ユニフォームバッファ用のリングバッファの作成に失敗");
+    }
 
-        const float source[16] = {
-            1.0f, 0.0f, 0.0f, 0.0f,
-            0.0f, 1.0f, 0.0f, 0.0f,
-            0.0f, 0.0f, 1.0f, 0.0f,
-            0.0f, 0.0f, 0.0f, 1.0f,
-        };
-        CHECK(
-            uploadToDeviceMemory(core->device, renderer->uniBufferForUI->devMemory, (const void *)source, sizeof(float) * 16),
-            "UI用シェーダのカメラのためのユニフォームバッファへのデータのアップロードに失敗"
-        );
+    // パイプラインキャッシュを作成する
+    //
+    // NOTE: 前回終了時に書き出したファイルがあれば読み込む。
+    //       ドライバによるシェーダのコンパイル結果が再利用されるため、二回目以降の起動ではパイプラインの作成が速くなる。
+    //
+    // NOTE: ファイル名はpipelineCacheUUIDで分ける。
+    //       キャッシュの互換性はデバイスとドライバの組で決まり、それを表すのがpipelineCacheUUIDであるため。
+    {
+        char uuid[VK_UUID_SIZE * 2 + 1];
+        for (uint32_t i = 0; i < VK_UUID_SIZE; ++i) {
+            snprintf(uuid + i * 2, 3, "%02x", (unsigned int)core->physDevProps.pipelineCacheUUID[i]);
+        }
+        snprintf(renderer->pipelineCachePath, RENDERING_PIPELINE_CACHE_PATH_SIZE, RENDERING_PIPELINE_CACHE_PATH_FORMAT, uuid);
+        renderer->pipelineCache = loadPipelineCache(core->device, renderer->pipelineCachePath);
+        CHECK(renderer->pipelineCache != NULL, "パイプラインキャッシュの作成に失敗");
     }
 
-    // UI用シェーダのカメラのためのユニフォームバッファをディスクリプタセットにアップロードする
+    // パイプライン作成オブジェクトを作成する
+    //
+    // NOTE: ドライバによるシェーダのコンパイルは重いため、ワーカースレッドで行い起動を妨げないようにする。
+    {
+        renderer->pipelineCompiler = createPipelineCompiler(0);
+        CHECK(renderer->pipelineCompiler != NULL, "パイプライン作成オブジェクトの作成に失敗");
+    }
+
+    // パイプラインを作成する
+    renderer->uiPipeline = createPipelineForUI(
+        core->device,
+        renderer->shaderLibrary,
+        renderer->pipelineCache,
+        renderer->pipelineCompiler,
+        renderer->renderPass,
+        renderer->samples,
+        width,
+        height
+    );
+    CHECK(renderer->uiPipeline != NULL, "UI用のパイプラインの作成に失敗");
+    renderer->uiPipelineKey = renderer->uiPipeline->defaultKey;
+
+    // UI用シェーダのカメラのためのディスクリプタセットを確保する
+    //
+    // NOTE: カメラのデータ自体はフレーム毎にリングバッファへ詰め、描画時にオフセットで指定する。
+    //       そのため、ディスクリプタセットは一度確保して書き込めば、以降は更新する必要がない。
+    {
+        renderer->descSetForUI = allocateDescriptorSet(core->device, renderer->descAllocator, renderer->uiPipeline->descSetLayout);
+        CHECK(renderer->descSetForUI != NULL, "UI用シェーダのカメラのためのディスクリプタセットの確保に失敗");
+    }
+
+    // UI用シェーダのカメラのためのリングバッファをディスクリプタセットに書き込む
+    //
+    // NOTE: ダイナミックユニフォームバッファでは、ここで指定したオフセットに描画時のオフセットが加算される。
     {
         const VkDescriptorBufferInfo bi = {
-            renderer->uniBufferForUI->buffer,
+            renderer->uniRing->buffer->buffer,
             0,
-            VK_WHOLE_SIZE,
+            sizeof(CameraForUI),
         };
         const VkWriteDescriptorSet wi[] = {
             {
@@ -212,7 +477,7 @@ VulkanAppRendering createVulkanAppRendering(
                 0,
                 0,
                 1,
-                VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
                 NULL,
                 &bi,
                 NULL,
@@ -222,12 +487,14 @@ VulkanAppRendering createVulkanAppRendering(
     }
 
     // モデルを作成する
-    renderer->square = createModelFromFile(core->device, &core->physDevMemProps, "./model/square.raw");
+    PROFILE_ZONE_BEGIN("createModelFromFile");
+    renderer->square = createModelFromFile(core->device, core->allocator, core->queue, core->cmdPool, "./model/square.raw");
+    PROFILE_ZONE_END("createModelFromFile");
     CHECK(renderer->square != NULL, "モデルの作成に失敗: ./model/square.raw");
 
     return renderer;
 
-#undef ATTACHMENTS_COUNT
+#undef MAX_ATTACHMENTS_COUNT
 #undef CHECK
 #undef CHECK_VK
 }
@@ -236,54 +503,946 @@ VulkanAppRendering createVulkanAppRendering(
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-int render(
-    const VulkanAppCore core,
+int enableShaderHotReload(const VulkanAppRendering renderer, const char *shaderDir) {
+#define CHECK(p, m) ERROR_IF(!(p), "enableShaderHotReload()", (m), {}, 0)
+
+    renderer->glslCompiler = createGlslCompiler(shaderDir);
+    CHECK(renderer->glslCompiler != NULL, "GLSLのコンパイルのワーカースレッドの開始に失敗");
+    renderer->shaderWatcher = createFileWatcher(shaderDir);
+    CHECK(renderer->shaderWatcher != NULL, "シェーダのディレクトリの監視の開始に失敗");
+    printf("[ info ] hot-reload: %sを監視\n", shaderDir);
+
+    return 1;
+
+#undef CHECK
+}
+
+int enableDepthPrepass(const VulkanAppCore core, const VulkanAppRendering renderer) {
+#define CHECK(p, m) ERROR_IF(!(p), "enableDepthPrepass()", (m), {}, 0)
+
+    renderer->depthPipeline = createPipelineForDepth(
+        core->device,
+        renderer->shaderLibrary,
+        renderer->pipelineCache,
+        renderer->pipelineCompiler,
+        renderer->renderPass,
+        renderer->samples,
+        renderer->uiPipeline->variants->base.width,
+        renderer->uiPipeline->variants->base.height
+    );
+    CHECK(renderer->depthPipeline != NULL, "深度プリパス用のパイプラインの作成に失敗");
+    // NOTE: UI用のカメラのディスクリプタセットを深度プリパスでも使うため、レイアウトが共有されていなければならない。
+    CHECK(renderer->depthPipeline->descSetLayout == renderer->uiPipeline->descSetLayout, "深度プリパス用とUI用とでディスクリプタセットレイアウトが異なる");
+
+    // 本描画を深度EQUALのバリアントにし、作成を要求しておく
+    renderer->uiPipelineKey.depthMode = PIPELINE_DEPTH_MODE_EQUAL;
+    requestPipelineVariant(renderer->uiPipeline->variants, &renderer->uiPipelineKey);
+    printf("[ info ] depth-prepass: 深度アタッチメントのフォーマット=%d\n", (int)renderer->depthFormat);
+
+    return 1;
+
+#undef CHECK
+}
+
+// メッシュ用のパイプラインに与える頂点データのストライドを求める関数
+//
+// NOTE: ローカル座標と法線ベクトルのみなら、シェーダの頂点入力から求まるため0とする。
+static uint32_t getMeshVertexStride(const VulkanAppRendering renderer) {
+    const uint32_t vertexStride = (uint32_t)sizeof(float) * renderer->mesh->sizePerVertex;
+    return vertexStride == sizeof(float) * 6 ? 0 : vertexStride;
+}
+
+int enableMeshInstances(const VulkanAppCore core, const VulkanAppRendering renderer, const char *path, uint32_t instancesCount) {
+#define CHECK(p, m) ERROR_IF(!(p), "enableMeshInstances()", (m), {}, 0)
+
+    CHECK(instancesCount > 0, "インスタンス数が0");
+    CHECK(renderer->meshPipeline == NULL, "既に有効");
+
+    // モデルを作成する
+    //
+    // NOTE: UV座標等が続く頂点データでも、先頭のローカル座標と法線ベクトルのみを読むバリアントで描画できる。
+    {
+        PROFILE_ZONE_BEGIN("createModelFromFile");
+        renderer->mesh = createModelFromFile(core->device, core->allocator, core->queue, core->cmdPool, path);
+        PROFILE_ZONE_END("createModelFromFile");
+        CHECK(renderer->mesh != NULL, "モデルの作成に失敗");
+        CHECK(renderer->mesh->flags & MODEL_FLAG_NORMAL, "モデルが法線ベクトルを持たない");
+    }
+
+    // パイプラインを作成する
+    {
+        renderer->meshPipeline = createPipelineForMesh(
+            core->device,
+            renderer->shaderLibrary,
+            renderer->pipelineCache,
+            renderer->pipelineCompiler,
+            renderer->renderPass,
+            renderer->samples,
+            renderer->uiPipeline->variants->base.width,
+            renderer->uiPipeline->variants->base.height,
+            getMeshVertexStride(renderer)
+        );
+        CHECK(renderer->meshPipeline != NULL, "メッシュ用のパイプラインの作成に失敗");
+        renderer->meshPipelineKey = renderer->meshPipeline->defaultKey;
+    }
+
+    // インスタンス毎の変換のためのリングバッファを作成する
+    //
+    // NOTE: ダイナミックストレージバッファのディスクリプタの範囲は固定であるため、全インスタンス分を一度に切り出す。
+    //       区画のサイズをちょうどその範囲にしておけば、オフセットに範囲を足してもバッファを越えない。
+    const VkDeviceSize objectsSize = sizeof(ObjectForMesh) * (VkDeviceSize)instancesCount;
+    {
+        CHECK(objectsSize <= core->physDevProps.limits.maxStorageBufferRange, "インスタンス数が多すぎる");
+        const VkDeviceSize alignment = core->physDevProps.limits.minStorageBufferOffsetAlignment;
+        renderer->objRing = createRingBuffer(
+            core->device,
+            core->allocator,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            (objectsSize + alignment - 1) / alignment * alignment,
+            RENDERING_FRAMES_IN_FLIGHT,
+            alignment
+        );
+        CHECK(renderer->objRing != NULL, "インスタンス毎の変換のためのリングバッファの作成に失敗");
+    }
+
+    // ディスクリプタセットを確保し、リングバッファを書き込む
+    //
+    // NOTE: 本描画と深度プリパスとではディスクリプタセットレイアウトが異なるため、それぞれに確保する。
+    //       参照先はいずれも同じリングバッファであり、描画時のオフセットで切り替える。
+    {
+        renderer->descSetForMesh = allocateDescriptorSet(core->device, renderer->descAllocator, renderer->meshPipeline->descSetLayout);
+        CHECK(renderer->descSetForMesh != NULL, "メッシュ用のディスクリプタセットの確保に失敗");
+        renderer->descSetForMeshDepth = allocateDescriptorSet(core->device, renderer->descAllocator, renderer->meshPipeline->depthDescSetLayout);
+        CHECK(renderer->descSetForMeshDepth != NULL, "メッシュの深度プリパス用のディスクリプタセットの確保に失敗");
+#define WRITES_COUNT 4
+        const VkDescriptorBufferInfo cameraBI = {
+            renderer->uniRing->buffer->buffer,
+            0,
+            sizeof(CameraForMesh),
+        };
+        const VkDescriptorBufferInfo objectsBI = {
+            renderer->objRing->buffer->buffer,
+            0,
+            objectsSize,
+        };
+        const VkDescriptorSet descSets[2] = { renderer->descSetForMesh, renderer->descSetForMeshDepth };
+        VkWriteDescriptorSet wi[WRITES_COUNT];
+        for (uint32_t i = 0; i < 2; ++i) {
+            const VkWriteDescriptorSet cameraWI = {
+                VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                NULL,
+                descSets[i],
+                0,
+                0,
+                1,
+                VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                NULL,
+                &cameraBI,
+                NULL,
+            };
+            const VkWriteDescriptorSet objectsWI = {
+                VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                NULL,
+                descSets[i],
+                1,
+                0,
+                1,
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+                NULL,
+                &objectsBI,
+                NULL,
+            };
+            wi[i * 2 + 0] = cameraWI;
+            wi[i * 2 + 1] = objectsWI;
+        }
+        vkUpdateDescriptorSets(core->device, WRITES_COUNT, wi, 0, NULL);
+#undef WRITES_COUNT
+    }
+
+    renderer->meshInstancesCount = instancesCount;
+    printf("[ info ] mesh: %s x %u (%d indices)\n", path, instancesCount, renderer->mesh->indicesCount);
+    for (uint32_t i = 0; i < renderer->mesh->lodsCount; ++i) {
+        const ModelLod *lod = &renderer->mesh->lods[i];
+        printf("[ info ] mesh: lod%u: %u triangles, error %f\n", i, lod->indicesCount / 3, (double)lod->error);
+    }
+
+    return 1;
+
+#undef CHECK
+}
+
+// メッシュのインスタンスの格子上の位置を求める関数
+static void getMeshInstanceTranslation(uint32_t index, uint32_t side, float translation[3]) {
+    const float extent = (float)side * RENDERING_MESH_GRID_SPACING;
+    translation[0] = ((float)(index % side) + 0.5f) * RENDERING_MESH_GRID_SPACING - extent * 0.5f;
+    translation[1] = ((float)(index / side) + 0.5f) * RENDERING_MESH_GRID_SPACING - extent * 0.5f;
+    translation[2] = 0.0f;
+}
+
+// メッシュのインスタンスのLODを選ぶ関数
+//
+// NOTE: LODの誤差をインスタンスの中心の距離で画面へ投影し、許す誤差以下となる最も粗いLODを選ぶ。
+//       LODは詳細な順に並び、誤差は単調に増える。
+static uint32_t selectMeshLod(const Model mesh, const float eye[3], const float translation[3], float pixelsPerUnit) {
+    const float dx = translation[0] - eye[0];
+    const float dy = translation[1] - eye[1];
+    const float dz = translation[2] - eye[2];
+    const float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+    uint32_t selected = 0;
+    for (uint32_t i = 1; i < mesh->lodsCount; ++i) {
+        const float pixels = mesh->lods[i].error * RENDERING_MESH_SCALE * pixelsPerUnit / distance;
+        if (pixels > RENDERING_MESH_LOD_ERROR_PIXELS) {
+            break;
+        }
+        selected = i;
+    }
+    return selected;
+}
+
+// タイルの範囲をクリップ空間全体へ拡大する行列を求める関数
+//
+// NOTE: 画像全体の幅W、タイルの左端ox、タイルの幅wのとき、画像全体のクリップ空間のxをx' = (W / w) x + (W - 2 ox - w) / wへ移す。
+//       ビューポートの変換(x' + 1) w / 2の後で、ちょうど画像全体での画素の位置からoxを引いたものになる。yも同様。
+//       行列は列優先であり、平行移動は第4列に入る。
+static void getRenderingTileMatrix(const VulkanAppRendering renderer, float m[16]) {
+    const float fullWidth = (float)renderer->tileFullWidth;
+    const float fullHeight = (float)renderer->tileFullHeight;
+    const float width = (float)renderer->uiPipeline->variants->base.width;
+    const float height = (float)renderer->uiPipeline->variants->base.height;
+    memset((void *)m, 0, sizeof(float) * 16);
+    m[0] = fullWidth / width;
+    m[5] = fullHeight / height;
+    m[10] = 1.0f;
+    m[12] = (fullWidth - 2.0f * (float)renderer->tileX - width) / width;
+    m[13] = (fullHeight - 2.0f * (float)renderer->tileY - height) / height;
+    m[15] = 1.0f;
+}
+
+// メッシュのカメラとインスタンス毎の変換を求める関数
+//
+// NOTE: インスタンスはz=0の平面に格子状に並べ、フレーム毎に少しずつ回す。
+//       カメラは格子全体が収まるよう、斜め上から見下ろす。
+//
+// NOTE: インスタンス毎にLODを選び、変換をLODの順に並べて詰める。
+//       LOD毎のインスタンス数はmeshLodInstancesCountsに格納する。
+//
+// NOTE: 書込み先はマップしたままのリングバッファであるため、読み返さずに順に書き込む。
+static void updateMeshScene(const VulkanAppRendering renderer, CameraForMesh *camera, ObjectForMesh *objects) {
+    const uint32_t count = renderer->meshInstancesCount;
+    const uint32_t side = (uint32_t)ceilf(sqrtf((float)count));
+    const float extent = (float)side * RENDERING_MESH_GRID_SPACING;
+    const float distance = extent + 4.0f;
+    const float eye[3] = { 0.0f, -distance, distance * 0.6f };
+    //
+    // NOTE: タイル描画ではアスペクト比とLODの選択を画像全体の大きさで行い、タイルの継ぎ目でLODが変わらないようにする。
+    const int tiled = renderer->tileFullWidth > 0;
+    const float height = (float)(tiled ? renderer->tileFullHeight : renderer->uiPipeline->variants->base.height);
+
+    // カメラ
+    //
+    // NOTE: タイル描画では射影行列にタイルの変換を掛ける。視錐台の平面もタイルの範囲に狭まる。
+    {
+        const float target[3] = { 0.0f, 0.0f, 0.0f };
+        const float up[3] = { 0.0f, 0.0f, 1.0f };
+        const float width = (float)(tiled ? renderer->tileFullWidth : renderer->uiPipeline->variants->base.width);
+        CameraForMesh source;
+        setLookAtMatrix(source.view, eye, target, up);
+        setPerspectiveMatrix(source.proj, RENDERING_MESH_FOV_Y, width / height, 0.1f, distance * 4.0f);
+        if (tiled) {
+            float tile[16];
+            float proj[16];
+            getRenderingTileMatrix(renderer, tile);
+            multiplyMatrix(proj, tile, source.proj);
+            memcpy((void *)source.proj, (const void *)proj, sizeof(proj));
+        }
+        source.lightDir[0] = -0.4f;
+        source.lightDir[1] = 0.6f;
+        source.lightDir[2] = -0.7f;
+        source.lightDir[3] = 0.0f;
+        memcpy((void *)camera, (const void *)&source, sizeof(CameraForMesh));
+
+        // メッシュレットのカリングのために、ワールド空間の視錐台の平面を求める
+        //
+        // NOTE: ビュー射影行列の行の和と差から求める(Gribb-Hartmann)。深度の範囲が0..1であるため、近平面は第3行のみとなる。
+        //       行列は列優先であり、第i行は(m[i], m[4 + i], m[8 + i], m[12 + i])となる。
+        if (renderer->cullPipeline != NULL) {
+            float viewProj[16];
+            multiplyMatrix(viewProj, source.proj, source.view);
+            const float signs[6] = { 1.0f, -1.0f, 1.0f, -1.0f, 0.0f, -1.0f };
+            const uint32_t rows[6] = { 0, 0, 1, 1, 2, 2 };
+            PushConstantForCull *cull = &renderer->cullPushConstant;
+            for (uint32_t i = 0; i < 6; ++i) {
+                float *plane = cull->planes[i];
+                for (uint32_t k = 0; k < 4; ++k) {
+                    const float w = viewProj[k * 4 + 3];
+                    const float r = viewProj[k * 4 + rows[i]];
+                    plane[k] = i == 4 ? r : w + signs[i] * r;
+                }
+                const float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+                for (uint32_t k = 0; k < 4; ++k) {
+                    plane[k] /= length;
+                }
+            }
+            cull->eye[0] = eye[0];
+            cull->eye[1] = eye[1];
+            cull->eye[2] = eye[2];
+            cull->eye[3] = 1.0f;
+        }
+    }
+
+    // インスタンス毎にLODを選び、LOD毎の詰め始める位置を求める
+    //
+    // NOTE: 距離1にある長さ1が画面上で何ピクセルになるか。
+    const float pixelsPerUnit = height / (2.0f * tanf(RENDERING_MESH_FOV_Y * 0.5f));
+    uint32_t cursors[MODEL_MAX_LODS];
+    {
+        memset(renderer->meshLodInstancesCounts, 0, sizeof(renderer->meshLodInstancesCounts));
+        for (uint32_t i = 0; i < count; ++i) {
+            float translation[3];
+            getMeshInstanceTranslation(i, side, translation);
+            renderer->meshLodInstancesCounts[selectMeshLod(renderer->mesh, eye, translation, pixelsPerUnit)] += 1;
+        }
+        uint32_t first = 0;
+        for (uint32_t i = 0; i < MODEL_MAX_LODS; ++i) {
+            cursors[i] = first;
+            first += renderer->meshLodInstancesCounts[i];
+            renderer->meshTrianglesCount += (uint64_t)renderer->meshLodInstancesCounts[i] * (renderer->mesh->lods[i].indicesCount / 3);
+        }
+        renderer->meshFramesCount += 1;
+        if (renderer->cullPipeline != NULL) {
+            renderer->cullPushConstant.instancesCount = renderer->meshLodInstancesCounts[0];
+        }
+    }
+
+    // インスタンス毎の変換
+    const uint64_t sceneFrame = renderer->sceneFrameFixed ? renderer->sceneFrame : renderer->framesCount;
+    const float angle = (float)(sceneFrame % 3600) * 0.01f;
+    for (uint32_t i = 0; i < count; ++i) {
+        float translation[3];
+        getMeshInstanceTranslation(i, side, translation);
+        const uint32_t lod = selectMeshLod(renderer->mesh, eye, translation, pixelsPerUnit);
+        ObjectForMesh source;
+        setTransformMatrix(source.model, translation, angle + (float)i * 0.37f, RENDERING_MESH_SCALE);
+        source.color[0] = 0.55f + 0.45f * sinf((float)i * 0.61f);
+        source.color[1] = 0.55f + 0.45f * sinf((float)i * 0.61f + 2.09f);
+        source.color[2] = 0.55f + 0.45f * sinf((float)i * 0.61f + 4.19f);
+        source.color[3] = 1.0f;
+        memcpy((void *)&objects[cursors[lod]], (const void *)&source, sizeof(ObjectForMesh));
+        cursors[lod] += 1;
+    }
+}
+
+// メッシュの全インスタンスを描画するコマンドを記録する関数
+//
+// NOTE: 深度プリパスと本描画とで、パイプライン・ディスクリプタセット・頂点バッファのみが異なる。
+//
+// NOTE: LOD毎に、そのLODのインデックスの範囲でインスタンス描画する。
+//       シェーダはgl_InstanceIndexで変換を引くため、firstInstanceにLODの詰め始めの位置を与える。
+static void recordMeshInstances(
+    VkCommandBuffer cmdBuffer,
     const VulkanAppRendering renderer,
-    uint32_t framebufferIndex,
-    int32_t offsetX,
-    int32_t offsetY,
-    uint32_t width,
-    uint32_t height,
-    uint32_t waitSemaphoresCount,
-    const VkSemaphore *waitSemaphores,
-    const VkPipelineStageFlags *waitDstStageMasks,
-    uint32_t signalSemaphoresCount,
-    const VkSemaphore *signalSemaphores
+    VkPipeline pipeline,
+    VkPipelineLayout pipelineLayout,
+    VkDescriptorSet descSet,
+    VkBuffer vtxBuffer,
+    VkDeviceSize cameraOffset,
+    VkDeviceSize objectsOffset
 ) {
-#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "render()", (m), (p), {}, 0)
-#define CHECK(p, m)    ERROR_IF     (!(p),              "render()", (m),      {}, 0)
-#define COMMAND_BUFFERS_COUNT 1
+#define DYNAMIC_OFFSETS_COUNT 2
+    const uint32_t dynamicOffsets[DYNAMIC_OFFSETS_COUNT] = { (uint32_t)cameraOffset, (uint32_t)objectsOffset };
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descSet, DYNAMIC_OFFSETS_COUNT, dynamicOffsets);
+    const VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vtxBuffer, &offset);
+    uint32_t firstInstance = 0;
 
-    // コマンドバッファを確保し記録を開始する
+    // LOD0は、メッシュレットのカリングが有効ならカリングの結果を間接描画する
     //
-    // NOTE: 詳しくはallocateAndStartCommandBuffer()関数のコメントを参照。
-    VkCommandBuffer cmdBuffer = allocateAndStartCommandBuffer(core);
-    CHECK(cmdBuffer != NULL, "コマンドバッファの確保あるいは記録の開始に失敗");
+    // NOTE: 間接描画コマンドはインスタンス毎に一つ。複数描画が使えなければ一つずつ描画する。
+    if (renderer->cullPipeline != NULL && renderer->meshLodInstancesCounts[0] > 0) {
+        const uint32_t drawsCount = renderer->meshLodInstancesCounts[0];
+        const uint32_t stride = (uint32_t)sizeof(VkDrawIndexedIndirectCommand);
+        vkCmdBindIndexBuffer(cmdBuffer, renderer->cullIdxBuffer->buffer, offset, VK_INDEX_TYPE_UINT32);
+        if (renderer->cullMultiDraw) {
+            vkCmdDrawIndexedIndirect(cmdBuffer, renderer->cullCmdBuffer->buffer, 0, drawsCount, stride);
+        } else {
+            for (uint32_t i = 0; i < drawsCount; ++i) {
+                vkCmdDrawIndexedIndirect(cmdBuffer, renderer->cullCmdBuffer->buffer, (VkDeviceSize)stride * i, 1, stride);
+            }
+        }
+        firstInstance = drawsCount;
+    }
+
+    vkCmdBindIndexBuffer(cmdBuffer, renderer->mesh->idxBuffer->buffer, offset, VK_INDEX_TYPE_UINT32);
+    for (uint32_t i = firstInstance > 0 ? 1 : 0; i < renderer->mesh->lodsCount; ++i) {
+        const uint32_t instancesCount = renderer->meshLodInstancesCounts[i];
+        if (instancesCount == 0) {
+            continue;
+        }
+        const ModelLod *lod = &renderer->mesh->lods[i];
+        vkCmdDrawIndexed(cmdBuffer, lod->indicesCount, instancesCount, lod->firstIndex, 0, firstInstance);
+        firstInstance += instancesCount;
+    }
+#undef DYNAMIC_OFFSETS_COUNT
+}
+
+// メッシュレットのカリングの前に、間接描画コマンドを0で初期化するパスの記録関数
+//
+// NOTE: 前のフレームの描画の読込みを待つバリアはレンダーグラフが張る。
+static void recordMeshletCullResetPass(VkCommandBuffer cmdBuffer, void *userData) {
+    const VulkanAppRendering renderer = (VulkanAppRendering)userData;
+    const uint32_t instancesCount = renderer->cullPushConstant.instancesCount;
+    if (instancesCount == 0) {
+        return;
+    }
+    vkCmdFillBuffer(cmdBuffer, renderer->cullCmdBuffer->buffer, 0, sizeof(VkDrawIndexedIndirectCommand) * (VkDeviceSize)instancesCount, 0);
+}
+
+// メッシュレットをカリングし、インデックスと間接描画コマンドを書き込むパスの記録関数
+//
+// NOTE: インスタンス毎の変換はホストが書き込んだものであり、提出によって見えるためバリアは要らない。
+static void recordMeshletCullPass(VkCommandBuffer cmdBuffer, void *userData) {
+    const VulkanAppRendering renderer = (VulkanAppRendering)userData;
+    const uint32_t instancesCount = renderer->cullPushConstant.instancesCount;
+    if (instancesCount == 0) {
+        return;
+    }
+    const uint32_t dynamicOffset = (uint32_t)renderer->frameParams.objectsOffset;
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->cullPipeline->pipeline);
+    vkCmdBindDescriptorSets(
+        cmdBuffer,
+        VK_PIPELINE_BIND_POINT_COMPUTE,
+        renderer->cullPipeline->pipelineLayout,
+        0,
+        1,
+        &renderer->descSetForCull,
+        1,
+        &dynamicOffset
+    );
+    vkCmdPushConstants(
+        cmdBuffer,
+        renderer->cullPipeline->pipelineLayout,
+        VK_SHADER_STAGE_COMPUTE_BIT,
+        0,
+        sizeof(PushConstantForCull),
+        (const void *)&renderer->cullPushConstant
+    );
+    const uint32_t groupsCount = (renderer->cullPushConstant.meshletsCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE;
+    vkCmdDispatch(cmdBuffer, groupsCount, instancesCount, 1);
+}
+
+int enableMeshletCulling(const VulkanAppCore core, const VulkanAppRendering renderer) {
+#define CHECK(p, m) ERROR_IF(!(p), "enableMeshletCulling()", (m), {}, 0)
 
-    // TODO: レンダーパスを開始する
+    CHECK(renderer->meshPipeline != NULL, "メッシュのインスタンス描画が有効でない");
+    CHECK(renderer->cullPipeline == NULL, "既に有効");
+    CHECK(renderer->mesh->meshletsCount > 0, "モデルがメッシュレットを持たない");
+    // NOTE: 間接描画コマンドのfirstInstanceでインスタンス毎の変換を引くため必須。
+    CHECK(core->enabledFeatures.drawIndirectFirstInstance == VK_TRUE, "drawIndirectFirstInstanceに対応していない");
+
+    const uint32_t instancesCount = renderer->meshInstancesCount;
+    const uint32_t indicesCapacity = renderer->mesh->lods[0].indicesCount;
+    const VkDeviceSize indicesSize = sizeof(uint32_t) * (VkDeviceSize)indicesCapacity * (VkDeviceSize)instancesCount;
+    const VkDeviceSize commandsSize = sizeof(VkDrawIndexedIndirectCommand) * (VkDeviceSize)instancesCount;
+    CHECK(indicesSize <= core->physDevProps.limits.maxStorageBufferRange, "インスタンス数が多すぎる");
+
+    // カリングのパスを加えるため、フレームのレンダーグラフを次の描画で作り直させる
+    if (renderer->frameGraph != NULL) {
+        vkDeviceWaitIdle(core->device);
+        deleteRenderGraph(core->device, renderer->frameGraph);
+        renderer->frameGraph = NULL;
+    }
+
+    // パイプラインを作成する
+    {
+        renderer->cullPipeline = createPipelineForCull(core->device, renderer->shaderLibrary, renderer->pipelineCache);
+        CHECK(renderer->cullPipeline != NULL, "カリング用のパイプラインの作成に失敗");
+    }
+
+    // インデックスバッファと間接描画コマンドのバッファを作成する
+    //
+    // NOTE: いずれもデバイスのみが読み書きする。
+    {
+        renderer->cullIdxBuffer = createBuffer(
+            core->device,
+            core->allocator,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+            MEMORY_USAGE_GPU_ONLY,
+            indicesSize
+        );
+        CHECK(renderer->cullIdxBuffer != NULL, "カリングの結果のインデックスバッファの作成に失敗");
+        renderer->cullCmdBuffer = createBuffer(
+            core->device,
+            core->allocator,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            MEMORY_USAGE_GPU_ONLY,
+            commandsSize
+        );
+        CHECK(renderer->cullCmdBuffer != NULL, "カリングの結果の間接描画コマンドのバッファの作成に失敗");
+    }
+
+    // ディスクリプタセットを確保し、バッファを書き込む
     {
-        const VkClearValue clearValues[] = {
-            {{ 0.5f, 0.0f, 0.0f, 1.0f }},
+        renderer->descSetForCull = allocateDescriptorSet(core->device, renderer->descAllocator, renderer->cullPipeline->descSetLayout);
+        CHECK(renderer->descSetForCull != NULL, "カリング用のディスクリプタセットの確保に失敗");
+#define WRITES_COUNT 6
+        const Model mesh = renderer->mesh;
+        const VkDescriptorBufferInfo bis[WRITES_COUNT] = {
+            { renderer->objRing->buffer->buffer, 0, sizeof(ObjectForMesh) * (VkDeviceSize)instancesCount },
+            { mesh->meshletBuffer->buffer, 0, VK_WHOLE_SIZE },
+            { mesh->meshletVtxBuffer->buffer, 0, VK_WHOLE_SIZE },
+            { mesh->meshletTriBuffer->buffer, 0, VK_WHOLE_SIZE },
+            { renderer->cullCmdBuffer->buffer, 0, VK_WHOLE_SIZE },
+            { renderer->cullIdxBuffer->buffer, 0, VK_WHOLE_SIZE },
         };
+        VkWriteDescriptorSet wi[WRITES_COUNT];
+        for (uint32_t i = 0; i < WRITES_COUNT; ++i) {
+            const VkWriteDescriptorSet w = {
+                VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                NULL,
+                renderer->descSetForCull,
+                i,
+                0,
+                1,
+                i == 0 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                NULL,
+                &bis[i],
+                NULL,
+            };
+            wi[i] = w;
+        }
+        vkUpdateDescriptorSets(core->device, WRITES_COUNT, wi, 0, NULL);
+#undef WRITES_COUNT
+    }
+
+    // フレーム毎に変わらないプッシュ定数を設定する
+    {
+        memset(&renderer->cullPushConstant, 0, sizeof(PushConstantForCull));
+        renderer->cullPushConstant.meshletsCount = renderer->mesh->meshletsCount;
+        renderer->cullPushConstant.indicesCapacity = indicesCapacity;
+    }
+
+    renderer->cullMultiDraw = core->enabledFeatures.multiDrawIndirect == VK_TRUE
+        && instancesCount <= core->physDevProps.limits.maxDrawIndirectCount;
+    printf(
+        "[ info ] meshlet-culling: %u meshlets, multi-draw-indirect=%s\n",
+        renderer->mesh->meshletsCount,
+        renderer->cullMultiDraw ? "yes" : "no"
+    );
+
+    return 1;
+
+#undef CHECK
+}
+
+int enableDrawStats(const VulkanAppCore core, const VulkanAppRendering renderer) {
+#define CHECK(p, m) ERROR_IF(!(p), "enableDrawStats()", (m), {}, 0)
+
+    renderer->drawStats = createDrawStats(core->device, &core->enabledFeatures, RENDERING_FRAMES_IN_FLIGHT);
+    CHECK(renderer->drawStats != NULL, "描画の仕事量の計測オブジェクトの作成に失敗");
+
+    return 1;
+
+#undef CHECK
+}
+
+// GLSLソースと、それを使うパイプラインの対応
+typedef struct HotReloadSource_t {
+    const char *name;
+    uint32_t pipelines;
+} HotReloadSource;
+
+static const HotReloadSource HOT_RELOAD_SOURCES[] = {
+    { "ui.vert",         RENDERING_RELOAD_UI },
+    { "ui.frag",         RENDERING_RELOAD_UI },
+    { "depth.vert",      RENDERING_RELOAD_DEPTH },
+    { "mesh.vert",       RENDERING_RELOAD_MESH },
+    { "mesh.frag",       RENDERING_RELOAD_MESH },
+    { "mesh_depth.vert", RENDERING_RELOAD_MESH },
+    { "cull.comp",       RENDERING_RELOAD_CULL },
+};
+
+// GLSLソースを使うパイプラインを求める関数
+//
+// NOTE: 表に無いファイル(glslcが書き出すSPIR-Vバイナリを含む)は0となり、無視される。
+static uint32_t getHotReloadPipelines(const char *name) {
+    for (size_t i = 0; i < sizeof(HOT_RELOAD_SOURCES) / sizeof(HOT_RELOAD_SOURCES[0]); ++i) {
+        if (strcmp(name, HOT_RELOAD_SOURCES[i].name) == 0) {
+            return HOT_RELOAD_SOURCES[i].pipelines;
+        }
+    }
+    return 0;
+}
+
+// 変更されたGLSLソースを使うパイプラインを作り直す関数
+//
+// NOTE: 作成中のものがあれば、まだ一度も使っていないため即座に破棄できる。
+//       パイプラインレイアウトが変わるとディスクリプタセットが使えなくなるため、差し替えない。
+//       ShaderLibraryとDescriptorSetLayoutCacheが同じインターフェースを一つにまとめるため、ポインタの比較で足りる。
+static void rebuildHotReloadPipelines(const VulkanAppCore core, const VulkanAppRendering renderer, uint32_t pipelines) {
+    const uint32_t width = renderer->uiPipeline->variants->base.width;
+    const uint32_t height = renderer->uiPipeline->variants->base.height;
+
+    // UI用のパイプライン
+    if (pipelines & RENDERING_RELOAD_UI) {
+        if (renderer->pendingUiPipeline != NULL) {
+            deletePipelineForUI(core->device, renderer->pendingUiPipeline);
+            renderer->pendingUiPipeline = NULL;
+        }
+        PipelineForUI pipeline = createPipelineForUI(
+            core->device,
+            renderer->shaderLibrary,
+            renderer->pipelineCache,
+            renderer->pipelineCompiler,
+            renderer->renderPass,
+            renderer->samples,
+            width,
+            height
+        );
+        if (pipeline != NULL && pipeline->pipelineLayout != renderer->uiPipeline->pipelineLayout) {
+            printf("[ error ] hot-reload: UI用のシェーダのインターフェースが変わったため差し替えられない\n");
+            deletePipelineForUI(core->device, pipeline);
+            pipeline = NULL;
+        }
+        renderer->pendingUiPipeline = pipeline;
+    }
+
+    // 深度プリパス用のパイプライン
+    if ((pipelines & RENDERING_RELOAD_DEPTH) && renderer->depthPipeline != NULL) {
+        if (renderer->pendingDepthPipeline != NULL) {
+            deletePipelineForDepth(core->device, renderer->pendingDepthPipeline);
+            renderer->pendingDepthPipeline = NULL;
+        }
+        PipelineForDepth pipeline = createPipelineForDepth(
+            core->device,
+            renderer->shaderLibrary,
+            renderer->pipelineCache,
+            renderer->pipelineCompiler,
+            renderer->renderPass,
+            renderer->samples,
+            width,
+            height
+        );
+        if (pipeline != NULL && pipeline->pipelineLayout != renderer->depthPipeline->pipelineLayout) {
+            printf("[ error ] hot-reload: 深度プリパス用のシェーダのインターフェースが変わったため差し替えられない\n");
+            deletePipelineForDepth(core->device, pipeline);
+            pipeline = NULL;
+        }
+        renderer->pendingDepthPipeline = pipeline;
+    }
+
+    // メッシュ用のパイプライン
+    if ((pipelines & RENDERING_RELOAD_MESH) && renderer->meshPipeline != NULL) {
+        if (renderer->pendingMeshPipeline != NULL) {
+            deletePipelineForMesh(core->device, renderer->pendingMeshPipeline);
+            renderer->pendingMeshPipeline = NULL;
+        }
+        PipelineForMesh pipeline = createPipelineForMesh(
+            core->device,
+            renderer->shaderLibrary,
+            renderer->pipelineCache,
+            renderer->pipelineCompiler,
+            renderer->renderPass,
+            renderer->samples,
+            width,
+            height,
+            getMeshVertexStride(renderer)
+        );
+        if (pipeline != NULL
+            && (pipeline->pipelineLayout != renderer->meshPipeline->pipelineLayout
+                || pipeline->depthPipelineLayout != renderer->meshPipeline->depthPipelineLayout)
+        ) {
+            printf("[ error ] hot-reload: メッシュ用のシェーダのインターフェースが変わったため差し替えられない\n");
+            deletePipelineForMesh(core->device, pipeline);
+            pipeline = NULL;
+        }
+        renderer->pendingMeshPipeline = pipeline;
+    }
+
+    // カリング用のパイプライン
+    //
+    // NOTE: PipelineCompilerを使わないため、描画スレッドで作成する。
+    //       コンピュートパイプラインは一つのみであり、パイプラインキャッシュも効くため短く済む。
+    if ((pipelines & RENDERING_RELOAD_CULL) && renderer->cullPipeline != NULL) {
+        if (renderer->pendingCullPipeline != NULL) {
+            deletePipelineForCull(core->device, renderer->pendingCullPipeline);
+            renderer->pendingCullPipeline = NULL;
+        }
+        PipelineForCull pipeline = createPipelineForCull(core->device, renderer->shaderLibrary, renderer->pipelineCache);
+        if (pipeline != NULL && pipeline->pipelineLayout != renderer->cullPipeline->pipelineLayout) {
+            printf("[ error ] hot-reload: カリング用のシェーダのインターフェースが変わったため差し替えられない\n");
+            deletePipelineForCull(core->device, pipeline);
+            pipeline = NULL;
+        }
+        renderer->pendingCullPipeline = pipeline;
+    }
+}
+
+// 差し替えたパイプラインを破棄を待つものに加え、かかった時間を出力する関数
+//
+// NOTE: 呼ぶ前に、破棄を待つパイプラインが満杯でないことを確認すること。
+static void retireHotReloadPipeline(const VulkanAppRendering renderer, const RetiredPipeline *retired, const char *label) {
+#define MS(ns) ((double)(ns) / 1000000.0)
+
+    renderer->retiredPipelines[renderer->retiredPipelinesCount] = *retired;
+    renderer->retiredPipelines[renderer->retiredPipelinesCount].frame = renderer->framesCount;
+    renderer->retiredPipelinesCount += 1;
+
+    const uint64_t now = getTimeNs();
+    printf(
+        "[ info ] hot-reload: %sのパイプラインを差し替え total=%.2fms glslc=%.2fms pipeline=%.2fms\n",
+        label,
+        MS(now - renderer->reloadStartNs),
+        MS(renderer->reloadCompiledNs - renderer->reloadStartNs),
+        MS(now - renderer->reloadCompiledNs)
+    );
+
+#undef MS
+}
+
+// シェーダのホットリロードを進める関数
+//
+// NOTE: フレームのフェンスを待機した後に呼ぶこと。
+static void updateShaderHotReload(const VulkanAppCore core, const VulkanAppRendering renderer) {
+    // デバイスが使い終わったパイプラインを破棄する
+    //
+    // NOTE: フレームNの開始時には、フレームN-RENDERING_FRAMES_IN_FLIGHT以前のコマンドバッファの実行が完了している。
+    //       フレームRの開始時に差し替えたパイプラインが最後に使われたのはフレームR-1であるから、
+    //       N >= R - 1 + RENDERING_FRAMES_IN_FLIGHT となれば破棄できる。
+    {
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < renderer->retiredPipelinesCount; ++i) {
+            const RetiredPipeline retired = renderer->retiredPipelines[i];
+            if (renderer->framesCount + 1 >= retired.frame + RENDERING_FRAMES_IN_FLIGHT) {
+                deleteRetiredPipeline(core->device, &retired);
+                continue;
+            }
+            renderer->retiredPipelines[kept] = retired;
+            kept += 1;
+        }
+        renderer->retiredPipelinesCount = kept;
+    }
+
+    // 変更されたGLSLソースのコンパイルをワーカースレッドに要求する
+    //
+    // NOTE: glslcの完了を待たないため、コンパイル中も描画を止めない。
+    {
+        char name[FILE_WATCHER_MAX_NAME];
+        while (pollFileWatcher(renderer->shaderWatcher, name)) {
+            if (getHotReloadPipelines(name) == 0) {
+                continue;
+            }
+            if (renderer->reloadPipelines == 0 && isGlslCompilerIdle(renderer->glslCompiler)) {
+                renderer->reloadStartNs = getTimeNs();
+            }
+            printf("[ info ] hot-reload: %sの変更を検知\n", name);
+            requestGlslCompile(renderer->glslCompiler, name);
+        }
+    }
+
+    // コンパイルを終えたGLSLソースを回収する
+    {
+        char name[FILE_WATCHER_MAX_NAME];
+        int succeeded = 0;
+        while (pollGlslCompiler(renderer->glslCompiler, name, &succeeded)) {
+            if (!succeeded) {
+                printf("[ error ] hot-reload: %sのコンパイルに失敗\n", name);
+                continue;
+            }
+            renderer->reloadPipelines |= getHotReloadPipelines(name);
+        }
+    }
+
+    // パイプラインを作り直す
+    //
+    // NOTE: 続けて保存された複数のGLSLソースを一度に反映するため、全てのコンパイルを終えてから作り直す。
+    if (renderer->reloadPipelines != 0 && isGlslCompilerIdle(renderer->glslCompiler)) {
+        renderer->reloadCompiledNs = getTimeNs();
+        rebuildHotReloadPipelines(core, renderer, renderer->reloadPipelines);
+        renderer->reloadPipelines = 0;
+    }
+
+    // 作成が完了したものから差し替える
+    //
+    // NOTE: 破棄を待つパイプラインが満杯ならば、空くまで差し替えを遅らせる。
+    //
+    // NOTE: メッシュ用は、描画時と同じく深度プリパスの有無に応じたバリアントが揃うまで待つ。
+    if (renderer->pendingUiPipeline != NULL && renderer->retiredPipelinesCount < RENDERING_MAX_RETIRED_PIPELINES) {
+        if (requestPipelineVariant(renderer->pendingUiPipeline->variants, &renderer->uiPipelineKey) != NULL) {
+            const RetiredPipeline retired = { renderer->uiPipeline, NULL, NULL, NULL, 0 };
+            renderer->uiPipeline = renderer->pendingUiPipeline;
+            renderer->pendingUiPipeline = NULL;
+            retireHotReloadPipeline(renderer, &retired, "UI用");
+        }
+    }
+    if (renderer->pendingDepthPipeline != NULL && renderer->retiredPipelinesCount < RENDERING_MAX_RETIRED_PIPELINES) {
+        const PipelineForDepth pending = renderer->pendingDepthPipeline;
+        if (requestPipelineVariant(pending->variants, &pending->defaultKey) != NULL) {
+            const RetiredPipeline retired = { NULL, renderer->depthPipeline, NULL, NULL, 0 };
+            renderer->depthPipeline = pending;
+            renderer->pendingDepthPipeline = NULL;
+            retireHotReloadPipeline(renderer, &retired, "深度プリパス用");
+        }
+    }
+    if (renderer->pendingMeshPipeline != NULL && renderer->retiredPipelinesCount < RENDERING_MAX_RETIRED_PIPELINES) {
+        const PipelineForMesh pending = renderer->pendingMeshPipeline;
+        PipelineVariantKey meshPipelineKey = renderer->meshPipelineKey;
+        int ready = 1;
+        if (renderer->depthPipeline != NULL) {
+            ready = requestPipelineVariant(pending->depthVariants, &pending->depthKey) != NULL;
+            meshPipelineKey.depthMode = PIPELINE_DEPTH_MODE_EQUAL;
+        }
+        ready = requestPipelineVariant(pending->variants, &meshPipelineKey) != NULL && ready;
+        if (ready) {
+            const RetiredPipeline retired = { NULL, NULL, renderer->meshPipeline, NULL, 0 };
+            renderer->meshPipeline = pending;
+            renderer->pendingMeshPipeline = NULL;
+            retireHotReloadPipeline(renderer, &retired, "メッシュ用");
+        }
+    }
+    if (renderer->pendingCullPipeline != NULL && renderer->retiredPipelinesCount < RENDERING_MAX_RETIRED_PIPELINES) {
+        const RetiredPipeline retired = { NULL, NULL, NULL, renderer->cullPipeline, 0 };
+        renderer->cullPipeline = renderer->pendingCullPipeline;
+        renderer->pendingCullPipeline = NULL;
+        retireHotReloadPipeline(renderer, &retired, "カリング用");
+    }
+}
+
+void setRenderingTile(const VulkanAppRendering renderer, uint32_t fullWidth, uint32_t fullHeight, int32_t tileX, int32_t tileY) {
+    if (fullWidth > 0 && !renderer->sceneFrameFixed) {
+        setRenderingSceneFrame(renderer, renderer->framesCount);
+    }
+    renderer->tileFullWidth = fullWidth;
+    renderer->tileFullHeight = fullHeight;
+    renderer->tileX = tileX;
+    renderer->tileY = tileY;
+}
+
+void setRenderingSceneFrame(const VulkanAppRendering renderer, uint64_t sceneFrame) {
+    renderer->sceneFrame = sceneFrame;
+    renderer->sceneFrameFixed = 1;
+}
+
+void waitForPipelines(const VulkanAppRendering renderer) {
+    waitPipelineCompilerIdle(renderer->pipelineCompiler);
+}
+
+// レンダーパスで描画先イメージへ描画するパスの記録関数
+//
+// NOTE: 深度プリパス・メッシュの本描画・UIの本描画を一つのサブパスで行う。
+static void recordScenePass(VkCommandBuffer cmdBuffer, void *userData) {
+#define ATTACHMENTS_COUNT 2
+
+    const VulkanAppRendering renderer = (VulkanAppRendering)userData;
+    const RenderingFrameParams *params = &renderer->frameParams;
+
+    // レンダーパスを開始する
+    {
+        VkClearValue clearValues[ATTACHMENTS_COUNT];
+        clearValues[0].color.float32[0] = 0.5f;
+        clearValues[0].color.float32[1] = 0.0f;
+        clearValues[0].color.float32[2] = 0.0f;
+        clearValues[0].color.float32[3] = 1.0f;
+        clearValues[1].depthStencil.depth = 1.0f;
+        clearValues[1].depthStencil.stencil = 0;
         const VkRenderPassBeginInfo bi = {
             VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
             NULL,
             renderer->renderPass,
-            renderer->framebuffers[framebufferIndex],
-            { {offsetX, offsetY}, {width, height} },
-            1,
+            renderer->framebuffers[params->framebufferIndex],
+            params->renderArea,
+            ATTACHMENTS_COUNT,
             clearValues,
         };
         vkCmdBeginRenderPass(cmdBuffer, &bi, VK_SUBPASS_CONTENTS_INLINE);
     }
 
-    // TODO:
-    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->uiPipeline->pipeline);
-
-    // TODO:
-    {
 #define DESC_SET_INDEX 0
-#define DYNAMIC_OFFSETS_COUNT 0
+#define DYNAMIC_OFFSETS_COUNT 1
+    const uint32_t dynamicOffsets[DYNAMIC_OFFSETS_COUNT] = { (uint32_t)params->cameraOffset };
+    // NOTE: メッシュを描画する場合、正方形はメッシュを隠さないよう左上に小さく描画する。
+    PushConstantForUI pushConstant = {
+        {1.0f, 1.0f, 1.0f, 1.0f},
+        {0.0f, 0.0f, 0.0f, 1.0f},
+        {0.0f, 0.0f, 1.0f, 1.0f},
+    };
+    if (renderer->meshPipeline != NULL) {
+        pushConstant.scl[0] = 0.2f;
+        pushConstant.scl[1] = 0.2f;
+        pushConstant.trs[0] = -0.85f;
+        pushConstant.trs[1] = -0.85f;
+    }
+
+    // 深度プリパス
+    //
+    // NOTE: ローカル座標のみの頂点バッファを用い、深度のみを書き込む。
+    //       本描画と同じプッシュ定数とカメラを与え、同じ深度を出す。
+    const int prepassMeasured = (params->depthPipeline != NULL || params->meshDepthPipeline != NULL)
+        && renderer->drawStats != NULL
+        && beginDrawStatsPass(cmdBuffer, renderer->drawStats, "depth-prepass");
+    if (params->meshDepthPipeline != NULL) {
+        recordMeshInstances(
+            cmdBuffer,
+            renderer,
+            params->meshDepthPipeline,
+            renderer->meshPipeline->depthPipelineLayout,
+            renderer->descSetForMeshDepth,
+            renderer->mesh->posBuffer->buffer,
+            params->meshCameraOffset,
+            params->objectsOffset
+        );
+    }
+    if (params->depthPipeline != NULL && params->uiPipeline != NULL) {
+        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, params->depthPipeline);
+        vkCmdBindDescriptorSets(
+            cmdBuffer,
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            renderer->depthPipeline->pipelineLayout,
+            0,
+            1,
+            &renderer->descSetForUI,
+            DYNAMIC_OFFSETS_COUNT,
+            dynamicOffsets
+        );
+        const VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &renderer->square->posBuffer->buffer, &offset);
+        vkCmdBindIndexBuffer(cmdBuffer, renderer->square->idxBuffer->buffer, offset, VK_INDEX_TYPE_UINT32);
+        vkCmdPushConstants(
+            cmdBuffer,
+            renderer->depthPipeline->pipelineLayout,
+            VK_SHADER_STAGE_VERTEX_BIT,
+            0,
+            sizeof(PushConstantForUI),
+            (const void *)&pushConstant
+        );
+        vkCmdDrawIndexed(cmdBuffer, renderer->square->indicesCount, 1, 0, 0, 0);
+    }
+    if (prepassMeasured) endDrawStatsPass(cmdBuffer, renderer->drawStats);
+
+    // メッシュの本描画
+    //
+    // NOTE: 全インスタンスを一回のインスタンス描画で描画する。
+    if (params->meshPipeline != NULL) {
+        const int measured = renderer->drawStats != NULL && beginDrawStatsPass(cmdBuffer, renderer->drawStats, "mesh");
+        recordMeshInstances(
+            cmdBuffer,
+            renderer,
+            params->meshPipeline,
+            renderer->meshPipeline->pipelineLayout,
+            renderer->descSetForMesh,
+            renderer->mesh->vtxBuffer->buffer,
+            params->meshCameraOffset,
+            params->objectsOffset
+        );
+        if (measured) endDrawStatsPass(cmdBuffer, renderer->drawStats);
+    }
+
+    // UIの本描画
+    //
+    // NOTE: パイプラインも代替のパイプラインも作成中であれば、描画を省いてクリアのみ行う。
+    if (params->uiPipeline != NULL) {
+        const int measured = renderer->drawStats != NULL && beginDrawStatsPass(cmdBuffer, renderer->drawStats, "ui");
+        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, params->uiPipeline);
         vkCmdBindDescriptorSets(
             cmdBuffer,
             VK_PIPELINE_BIND_POINT_GRAPHICS,
@@ -292,17 +1451,12 @@ int render(
             1,
             &renderer->descSetForUI,
             DYNAMIC_OFFSETS_COUNT,
-            NULL
+            dynamicOffsets
         );
 
         const VkDeviceSize offset = 0;
         vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &renderer->square->vtxBuffer->buffer, &offset);
         vkCmdBindIndexBuffer(cmdBuffer, renderer->square->idxBuffer->buffer, offset, VK_INDEX_TYPE_UINT32);
-        const PushConstantForUI pushConstant = {
-            {1.0f, 1.0f, 1.0f, 1.0f},
-            {0.0f, 0.0f, 0.0f, 1.0f},
-            {0.0f, 0.0f, 1.0f, 1.0f},
-        };
         vkCmdPushConstants(
             cmdBuffer,
             renderer->uiPipeline->pipelineLayout,
@@ -312,16 +1466,261 @@ int render(
             (const void *)&pushConstant
         );
         vkCmdDrawIndexed(cmdBuffer, renderer->square->indicesCount, 1, 0, 0, 0);
+        if (measured) endDrawStatsPass(cmdBuffer, renderer->drawStats);
+    }
 #undef DYNAMIC_OFFSETS_COUNT
 #undef DESC_SET_INDEX
-    }
 
     // レンダーパスを終了する
     vkCmdEndRenderPass(cmdBuffer);
 
+#undef ATTACHMENTS_COUNT
+}
+
+// フレームのパスとリソースの依存関係を表すレンダーグラフを作成する関数
+//
+// NOTE: パスは次の順に実行する。
+//         1. meshlet-cull-reset: 間接描画コマンドを0で初期化する (メッシュレットのカリングが有効な場合)
+//         2. meshlet-cull: メッシュレットをカリングし、インデックスと間接描画コマンドを書き込む (同上)
+//         3. scene: レンダーパスで描画先イメージへ描画する
+//       カリングの結果のバッファは同時に処理されうるフレーム間で共有するため、実行前の使い方を前のフレームの描画の読込みとする。
+//       描画先イメージと深度アタッチメントはレンダーパスの依存関係で前のフレームを待つため、グラフには加えない。
+static int createRenderingFrameGraph(const VulkanAppCore core, const VulkanAppRendering renderer) {
+#define CHECK(p, m) ERROR_IF(!(p), "createRenderingFrameGraph()", (m), deleteRenderGraph(core->device, graph), 0)
+
+    const RenderGraph graph = createRenderGraph();
+    CHECK(graph != NULL, "レンダーグラフの作成に失敗");
+
+    // メッシュレットのカリングのパスを加える
+    uint32_t cmdResource = RENDER_GRAPH_INVALID_INDEX;
+    uint32_t idxResource = RENDER_GRAPH_INVALID_INDEX;
+    if (renderer->cullPipeline != NULL) {
+        const RenderGraphAccess prevCommandsRead = {
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+            VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED,
+        };
+        const RenderGraphAccess prevIndicesRead = {
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+            VK_ACCESS_INDEX_READ_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED,
+        };
+        cmdResource = addRenderGraphBuffer(graph, "meshlet-cull-commands", renderer->cullCmdBuffer->buffer, &prevCommandsRead, NULL);
+        idxResource = addRenderGraphBuffer(graph, "meshlet-cull-indices", renderer->cullIdxBuffer->buffer, &prevIndicesRead, NULL);
+        CHECK(cmdResource != RENDER_GRAPH_INVALID_INDEX && idxResource != RENDER_GRAPH_INVALID_INDEX, "カリングの結果のバッファの追加に失敗");
+
+        const uint32_t reset = addRenderGraphPass(graph, "meshlet-cull-reset", recordMeshletCullResetPass, (void *)renderer, 0);
+        CHECK(reset != RENDER_GRAPH_INVALID_INDEX, "間接描画コマンドの初期化のパスの追加に失敗");
+        CHECK(
+            addRenderGraphAccess(graph, reset, cmdResource, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED),
+            "間接描画コマンドの初期化のアクセスの宣言に失敗"
+        );
+
+        const uint32_t cull = addRenderGraphPass(graph, "meshlet-cull", recordMeshletCullPass, (void *)renderer, 0);
+        CHECK(cull != RENDER_GRAPH_INVALID_INDEX, "カリングのパスの追加に失敗");
+        CHECK(
+            addRenderGraphAccess(
+                graph,
+                cull,
+                cmdResource,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                VK_IMAGE_LAYOUT_UNDEFINED
+            ) && addRenderGraphAccess(graph, cull, idxResource, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED),
+            "カリングのアクセスの宣言に失敗"
+        );
+    }
+
+    // 描画のパスを加える
+    //
+    // NOTE: 描画先イメージへの描画はグラフの外に結果を残すため、省かれないようにする。
+    {
+        const uint32_t scene = addRenderGraphPass(graph, "scene", recordScenePass, (void *)renderer, 1);
+        CHECK(scene != RENDER_GRAPH_INVALID_INDEX, "描画のパスの追加に失敗");
+        if (renderer->cullPipeline != NULL) {
+            CHECK(
+                addRenderGraphAccess(graph, scene, cmdResource, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED)
+                    && addRenderGraphAccess(graph, scene, idxResource, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED),
+                "描画のアクセスの宣言に失敗"
+            );
+        }
+    }
+
+    // コンパイルする
+    {
+        CHECK(compileRenderGraph(core->device, core->allocator, graph), "レンダーグラフのコンパイルに失敗");
+    }
+
+    renderer->frameGraph = graph;
+    return 1;
+
+#undef CHECK
+}
+
+int render(
+    const VulkanAppCore core,
+    const VulkanAppRendering renderer,
+    uint32_t framebufferIndex,
+    int32_t offsetX,
+    int32_t offsetY,
+    uint32_t width,
+    uint32_t height,
+    uint32_t waitSemaphoresCount,
+    const VkSemaphore *waitSemaphores,
+    const VkPipelineStageFlags *waitDstStageMasks,
+    uint32_t signalSemaphoresCount,
+    const VkSemaphore *signalSemaphores
+) {
+#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "render()", (m), (p), {}, 0)
+#define CHECK(p, m)    ERROR_IF     (!(p),              "render()", (m),      {}, 0)
+#define COMMAND_BUFFERS_COUNT 1
+
+    const uint32_t frame = renderer->frameIndex;
+
+    // フレームのリソースを再利用できるようになるまで待機する
+    //
+    // NOTE: RENDERING_FRAMES_IN_FLIGHTフレーム前に提出したコマンドバッファの実行完了を待つ。
+    //       完了していれば、そのフレームで使ったリングバッファの区画を再利用できる。
+    {
+        PROFILE_ZONE_BEGIN("vkWaitForFences");
+        const VkResult waited = vkWaitForFences(core->device, 1, &renderer->frameFences[frame], VK_TRUE, UINT64_MAX);
+        PROFILE_ZONE_END("vkWaitForFences");
+        CHECK_VK(waited, "フレーム毎のフェンスの待機に失敗");
+        beginRingBufferFrame(renderer->uniRing, frame);
+        if (renderer->objRing != NULL) beginRingBufferFrame(renderer->objRing, frame);
+    }
+
+    // シェーダのホットリロードを進める
+    //
+    // NOTE: パイプラインを取得する前に行い、差し替えをフレームの境界に揃える。
+    if (renderer->shaderWatcher != NULL) {
+        PROFILE_ZONE_BEGIN("updateShaderHotReload");
+        updateShaderHotReload(core, renderer);
+        PROFILE_ZONE_END("updateShaderHotReload");
+    }
+
+    // パイプラインを取得する
+    //
+    // NOTE: フレームの開始時に一度だけ取得し、フレーム内では同じパイプラインを使う。
+    //       ワーカースレッドがフレームの途中で作成を終えても、差し替えは次のフレームとなる。
+    //
+    // NOTE: 深度プリパス用のパイプラインの作成が完了していなければ深度プリパスを省く。
+    //       そのとき深度EQUALで描画すると何も描かれないため、本描画も深度テスト無しのバリアントで代える。
+    VkPipeline depthPipeline = NULL;
+    PipelineVariantKey uiPipelineKey = renderer->uiPipelineKey;
+    if (renderer->depthPipeline != NULL) {
+        depthPipeline = requestPipelineVariant(renderer->depthPipeline->variants, &renderer->depthPipeline->defaultKey);
+        if (depthPipeline == NULL) {
+            uiPipelineKey.depthMode = PIPELINE_DEPTH_MODE_NONE;
+        }
+    }
+    const VkPipeline uiPipeline = requestPipelineVariant(renderer->uiPipeline->variants, &uiPipelineKey);
+    //
+    // NOTE: メッシュの既定のバリアントは深度テストがLESS_OR_EQUALであるため、
+    //       深度EQUALのバリアントの作成中に代替として使っても正しく描画できる。
+    VkPipeline meshDepthPipeline = NULL;
+    VkPipeline meshPipeline = NULL;
+    if (renderer->meshPipeline != NULL) {
+        PipelineVariantKey meshPipelineKey = renderer->meshPipelineKey;
+        if (renderer->depthPipeline != NULL) {
+            meshDepthPipeline = requestPipelineVariant(renderer->meshPipeline->depthVariants, &renderer->meshPipeline->depthKey);
+            if (meshDepthPipeline != NULL) {
+                meshPipelineKey.depthMode = PIPELINE_DEPTH_MODE_EQUAL;
+            }
+        }
+        meshPipeline = requestPipelineVariant(renderer->meshPipeline->variants, &meshPipelineKey);
+    }
+
+    // UI用シェーダのカメラをリングバッファに詰める
+    VkDeviceSize cameraOffset = 0;
+    {
+        CameraForUI *camera = (CameraForUI *)allocateFromRingBuffer(renderer->uniRing, sizeof(CameraForUI), &cameraOffset);
+        CHECK(camera != NULL, "UI用シェーダのカメラのための領域の確保に失敗");
+        CameraForUI source = {
+            {
+                1.0f, 0.0f, 0.0f, 0.0f,
+                0.0f, 1.0f, 0.0f, 0.0f,
+                0.0f, 0.0f, 1.0f, 0.0f,
+                0.0f, 0.0f, 0.0f, 1.0f,
+            },
+        };
+        //
+        // NOTE: ui.vertは位置ベクトルに右から行列を掛けるため、タイルの変換は転置して与える。
+        if (renderer->tileFullWidth > 0) {
+            float tile[16];
+            getRenderingTileMatrix(renderer, tile);
+            for (uint32_t r = 0; r < 4; ++r) {
+                for (uint32_t c = 0; c < 4; ++c) {
+                    source.proj[r * 4 + c] = tile[c * 4 + r];
+                }
+            }
+        }
+        memcpy((void *)camera, (const void *)&source, sizeof(CameraForUI));
+    }
+
+    // メッシュのカメラとインスタンス毎の変換をリングバッファに詰める
+    VkDeviceSize meshCameraOffset = 0;
+    VkDeviceSize objectsOffset = 0;
+    if (renderer->meshPipeline != NULL) {
+        CameraForMesh *camera = (CameraForMesh *)allocateFromRingBuffer(renderer->uniRing, sizeof(CameraForMesh), &meshCameraOffset);
+        CHECK(camera != NULL, "メッシュ用シェーダのカメラのための領域の確保に失敗");
+        ObjectForMesh *objects = (ObjectForMesh *)allocateFromRingBuffer(
+            renderer->objRing,
+            sizeof(ObjectForMesh) * renderer->meshInstancesCount,
+            &objectsOffset
+        );
+        CHECK(objects != NULL, "インスタンス毎の変換のための領域の確保に失敗");
+        updateMeshScene(renderer, camera, objects);
+    }
+
+    // フレームのレンダーグラフを作成する
+    //
+    // NOTE: 最初の描画時に作成し、以降のフレームで使い回す。
+    if (renderer->frameGraph == NULL) {
+        CHECK(createRenderingFrameGraph(core, renderer), "フレームのレンダーグラフの作成に失敗");
+    }
+
+    // コマンドバッファを確保し記録を開始する
+    //
+    // NOTE: 詳しくはallocateAndStartCommandBuffer()関数のコメントを参照。
+    VkCommandBuffer cmdBuffer = allocateAndStartCommandBuffer(core);
+    CHECK(cmdBuffer != NULL, "コマンドバッファの確保あるいは記録の開始に失敗");
+
+    // 前回このフレームで記録したクエリの結果を回収し、クエリをリセットする
+    //
+    // NOTE: クエリのリセットはレンダーパスの外で行う必要がある。
+    if (renderer->drawStats != NULL) {
+        beginDrawStatsFrame(core->device, renderer->drawStats, cmdBuffer, frame);
+    }
+
+    // フレームのパスを記録する
+    //
+    // NOTE: パス間のバリアはレンダーグラフが張る。
+    //       本描画のパイプラインが作成中で描画しない場合も、カリングは行っておく。
+    {
+        RenderingFrameParams *params = &renderer->frameParams;
+        params->framebufferIndex = framebufferIndex;
+        params->renderArea.offset.x = offsetX;
+        params->renderArea.offset.y = offsetY;
+        params->renderArea.extent.width = width;
+        params->renderArea.extent.height = height;
+        params->depthPipeline = depthPipeline;
+        params->uiPipeline = uiPipeline;
+        params->meshDepthPipeline = meshDepthPipeline;
+        params->meshPipeline = meshPipeline;
+        params->cameraOffset = cameraOffset;
+        params->meshCameraOffset = meshCameraOffset;
+        params->objectsOffset = objectsOffset;
+        executeRenderGraph(renderer->frameGraph, cmdBuffer);
+    }
+
     // コマンドバッファを終了しキューに提出する
     //
     // NOTE: 詳しくはendAndSubmitCommandBuffer()関数のコメントを参照。
+    //
+    // NOTE: フェンスは提出の直前にリセットする。
+    //       途中で失敗して提出しなかった場合に、次に同じフレームを待機して永久に待たないようにするため。
+    CHECK_VK(vkResetFences(core->device, 1, &renderer->frameFences[frame]), "フレーム毎のフェンスのリセットに失敗");
     CHECK(
         endAndSubmitCommandBuffer(
             core,
@@ -330,11 +1729,16 @@ int render(
             waitSemaphores,
             waitDstStageMasks,
             signalSemaphoresCount,
-            signalSemaphores
+            signalSemaphores,
+            renderer->frameFences[frame]
         ),
         "コマンドバッファの終了あるいは提出に失敗"
     );
 
+    // 次のフレームへ進む
+    renderer->frameIndex = (frame + 1) % RENDERING_FRAMES_IN_FLIGHT;
+    renderer->framesCount += 1;
+
     return 1;
 
 #undef COMMAND_BUFFERS_COUNT
@@ -4,23 +4,197 @@
 #pragma once
 
 #include "core.h"
+#include "pipelines/cull.h"
+#include "pipelines/depth.h"
+#include "pipelines/mesh.h"
 #include "pipelines/ui.h"
-#include "util/memory/buffer.h"
+#include "util/descriptor.h"
+#include "util/glslc.h"
+#include "util/graph.h"
+#include "util/memory/image.h"
+#include "util/memory/ring.h"
 #include "util/model.h"
+#include "util/pipeline.h"
+#include "util/query.h"
+#include "util/shader.h"
+#include "util/watcher.h"
 
 #include <stdint.h>
 #include <vulkan/vulkan.h>
 
+/// @brief 同時に処理されうるフレーム数
+///
+/// ホストがあるフレームのコマンドを記録している間に、デバイスは前のフレームを実行できる。
+/// フレーム毎に使い捨てるリソースは、この数だけ用意して順に使い回す。
+#define RENDERING_FRAMES_IN_FLIGHT 2
+
+/// @brief ユニフォームバッファ用のリングバッファのフレーム一つあたりのサイズ
+#define RENDERING_UNIFORM_RING_FRAME_SIZE (64 * 1024)
+
+/// @brief ホットリロードで差し替えられ、破棄を待つパイプラインの最大数
+#define RENDERING_MAX_RETIRED_PIPELINES 8
+
+/// @brief メッシュのインスタンスを並べる格子の間隔
+#define RENDERING_MESH_GRID_SPACING 2.5f
+
+/// @brief メッシュのインスタンスの拡大率
+///
+/// NOTE: utah.jsonのティーポットは幅が約18であるため、格子の間隔に収まるよう縮める。
+#define RENDERING_MESH_SCALE 0.1f
+
+/// @brief メッシュのカメラの縦の視野角(ラジアン)
+#define RENDERING_MESH_FOV_Y 0.8f
+
+/// @brief メッシュのLODを選ぶ際に許す、画面上の誤差(ピクセル)
+///
+/// NOTE: 各インスタンスについて、LODの誤差を画面へ投影した大きさがこれ以下となる最も粗いLODを選ぶ。
+#define RENDERING_MESH_LOD_ERROR_PIXELS 1.0f
+
+/// @brief パイプラインキャッシュファイルのパスの書式 (物理デバイスのpipelineCacheUUIDを16進数で埋め込む)
+///
+/// NOTE: 複数のデバイスで描画するバッチ処理では、デバイス毎にパイプラインキャッシュを読み書きする。
+///       一つのファイルを共有すると、最後に書き出したデバイス以外では毎回ヘッダが一致せず空のキャッシュとなってしまう。
+#define RENDERING_PIPELINE_CACHE_PATH_FORMAT "./pipeline-cache-%s.bin"
+
+/// @brief パイプラインキャッシュファイルのパスの最大長 (終端文字を含む)
+#define RENDERING_PIPELINE_CACHE_PATH_SIZE 64
+
+/// @brief ホットリロードで作り直すパイプラインを表すビット
+#define RENDERING_RELOAD_UI    0x1
+#define RENDERING_RELOAD_DEPTH 0x2
+#define RENDERING_RELOAD_MESH  0x4
+#define RENDERING_RELOAD_CULL  0x8
+
+/// @brief ホットリロードで差し替えられ、デバイスが使い終わるのを待っているパイプライン
+///
+/// 差し替えたパイプラインの種類のもののみが非NULLとなる。
+typedef struct RetiredPipeline_t {
+    PipelineForUI ui;
+    PipelineForDepth depth;
+    PipelineForMesh mesh;
+    PipelineForCull cull;
+    // 差し替えたフレームの通し番号
+    uint64_t frame;
+} RetiredPipeline;
+
+/// @brief 現在のフレームでパスの記録関数が参照する値
+///
+/// NOTE: render()関数がフレーム毎に設定してから、フレームのレンダーグラフを実行する。
+typedef struct RenderingFrameParams_t {
+    uint32_t framebufferIndex;
+    VkRect2D renderArea;
+    // フレームの開始時に取得したパイプライン (作成中で代替も無ければNULL)
+    VkPipeline depthPipeline;
+    VkPipeline uiPipeline;
+    VkPipeline meshDepthPipeline;
+    VkPipeline meshPipeline;
+    // リングバッファに詰めたカメラとインスタンス毎の変換のオフセット
+    VkDeviceSize cameraOffset;
+    VkDeviceSize meshCameraOffset;
+    VkDeviceSize objectsOffset;
+} RenderingFrameParams;
+
 /// @brief Vulkanアプリケーションのレンダリングオブジェクトを持つ構造体
 typedef struct VulkanAppRendering_t {
+    // カラーアタッチメントと深度アタッチメントのサンプル数
+    VkSampleCountFlagBits samples;
+    // マルチサンプルのカラーアタッチメント (全てのフレームバッファで共有する、samplesが1ならNULL)
+    //
+    // NOTE: レンダーパスの中で描画先イメージへリゾルブし、自身はメモリへ書き出さない。
+    Image colorImage;
+    VkImageView colorImageView;
+    // 深度アタッチメント (全てのフレームバッファで共有する)
+    VkFormat depthFormat;
+    Image depthImage;
+    VkImageView depthImageView;
     VkRenderPass renderPass;
     VkFramebuffer *framebuffers;
     uint32_t framebuffersCount;
-    VkDescriptorPool descPool;
+    DescriptorSetLayoutCache descSetLayoutCache;
+    ShaderLibrary shaderLibrary;
+    // 全てのパイプラインで共有するパイプラインキャッシュ
+    VkPipelineCache pipelineCache;
+    char pipelineCachePath[RENDERING_PIPELINE_CACHE_PATH_SIZE];
+    // 全てのパイプラインを作成するワーカースレッド
+    PipelineCompiler pipelineCompiler;
+    // 作成時に一度だけ確保するディスクリプタセットのためのディスクリプタ確保オブジェクト
+    DescriptorAllocator descAllocator;
+    // フレーム毎のコマンドバッファが実行されたらシグナルされるフェンス
+    VkFence frameFences[RENDERING_FRAMES_IN_FLIGHT];
+    uint32_t frameIndex;
+    // フレームの通し番号
+    uint64_t framesCount;
+    RingBuffer uniRing;
     PipelineForUI uiPipeline;
+    // 描画に使うUI用のパイプラインのバリアント
+    PipelineVariantKey uiPipelineKey;
+    // 深度プリパス用のパイプライン (深度プリパスが無効ならNULL)
+    PipelineForDepth depthPipeline;
+    // 法線を持つ3Dメッシュのインスタンス描画 (無効ならmeshPipelineがNULL)
+    PipelineForMesh meshPipeline;
+    PipelineVariantKey meshPipelineKey;
+    Model mesh;
+    uint32_t meshInstancesCount;
+    // 現在のフレームでLOD毎に選ばれたインスタンス数
+    //
+    // NOTE: インスタンス毎の変換はLODの順に並べて詰めるため、LOD毎に一回のインスタンス描画で描画できる。
+    uint32_t meshLodInstancesCounts[MODEL_MAX_LODS];
+    // 描画したメッシュの三角形数の累計とフレーム数 (終了時に平均を出力する)
+    uint64_t meshTrianglesCount;
+    uint64_t meshFramesCount;
+    // メッシュレットのカリング (無効ならcullPipelineがNULL)
+    //
+    // NOTE: LOD0を選んだインスタンスのみが対象。
+    //       インデックスバッファはインスタンス毎にLOD0のインデックス数の領域を持ち、間接描画コマンドはインスタンス毎に一つ。
+    PipelineForCull cullPipeline;
+    Buffer cullIdxBuffer;
+    Buffer cullCmdBuffer;
+    VkDescriptorSet descSetForCull;
+    // 現在のフレームのカリングのプッシュ定数
+    PushConstantForCull cullPushConstant;
+    // 間接描画コマンドを一回の複数描画で描画できるか
+    int cullMultiDraw;
+    // インスタンス毎の変換(ObjectForMesh)を詰めるリングバッファ
+    RingBuffer objRing;
+    VkDescriptorSet descSetForMesh;
+    VkDescriptorSet descSetForMeshDepth;
     VkDescriptorSet descSetForUI;
-    Buffer uniBufferForUI;
     Model square;
+    // シェーダのホットリロード (無効ならshaderWatcherがNULL)
+    FileWatcher shaderWatcher;
+    GlslCompiler glslCompiler;
+    // コンパイルを終え、作り直すのを待っているパイプライン (RENDERING_RELOAD_*の組合せ)
+    uint32_t reloadPipelines;
+    // 作成中のパイプライン (作成が完了したフレームの開始時に差し替える)
+    //
+    // NOTE: カリング用のパイプラインはバリアントを持たず作り直した時点で完成しているため、同じフレームで差し替わる。
+    PipelineForUI pendingUiPipeline;
+    PipelineForDepth pendingDepthPipeline;
+    PipelineForMesh pendingMeshPipeline;
+    PipelineForCull pendingCullPipeline;
+    // 変更を検知した時刻とGLSLのコンパイルを終えた時刻(ns)
+    uint64_t reloadStartNs;
+    uint64_t reloadCompiledNs;
+    uint32_t retiredPipelinesCount;
+    RetiredPipeline retiredPipelines[RENDERING_MAX_RETIRED_PIPELINES];
+    // パス毎の描画の仕事量の計測 (無効ならNULL)
+    DrawStats drawStats;
+    // タイルに分けて描画する際の画像全体の大きさと、描画するタイルの左上の位置 (タイル描画が無効ならtileFullWidthが0)
+    uint32_t tileFullWidth;
+    uint32_t tileFullHeight;
+    int32_t tileX;
+    int32_t tileY;
+    // シーンの時刻として用いるフレームの番号 (sceneFrameFixedが0ならframesCountを用いる)
+    //
+    // NOTE: タイル描画では全てのタイルで時刻を止め、タイルの継ぎ目でインスタンスの向きがずれないようにする。
+    //       複数のデバイスでフレームを分担する場合は、どのデバイスが描画しても同じフレームが得られるようにする。
+    uint64_t sceneFrame;
+    int sceneFrameFixed;
+    // フレームのパスとリソースの依存関係 (最初の描画時に作成する)
+    //
+    // NOTE: メッシュレットのカリングとレンダーパスの間のバリアを導く。
+    RenderGraph frameGraph;
+    RenderingFrameParams frameParams;
 } *VulkanAppRendering;
 
 /// @brief Vulkanアプリケーションのレンダリングオブジェクトを破棄する関数
@@ -28,14 +202,32 @@ typedef struct VulkanAppRendering_t {
 /// @param renderer レンダリングオブジェクトハンドル
 void deleteVulkanAppRendering(const VulkanAppCore core, VulkanAppRendering renderer);
 
+/// @brief マルチサンプルのサンプル数を物理デバイスと折り合わせる関数
+///
+/// カラーと深度のフレームバッファの両方が対応しているサンプル数のうち、requested以下で最大のものを選ぶ。
+/// requestedに対応していなければ、その旨を出力する。
+///
+/// @param core 主要オブジェクトハンドル
+/// @param requested 求めるサンプル数 (0か1ならマルチサンプルしない)
+/// @returns 選んだサンプル数を返す。
+VkSampleCountFlagBits selectRenderingSampleCount(const VulkanAppCore core, uint32_t requested);
+
 /// @brief Vulkanアプリケーションのレンダリングオブジェクトを作成する関数
 ///
+/// 描画先イメージビューの他に、深度アタッチメントを作成してレンダーパスに加える。
+/// 深度アタッチメントのフォーマットは、物理デバイスが対応しているものから精度の高い順に選ぶ。
+///
+/// samplesが2以上なら、マルチサンプルのカラーアタッチメントを作成してそこへ描画し、サブパスの終わりに描画先イメージへリゾルブする。
+/// マルチサンプルのカラーアタッチメントと深度アタッチメントはレンダーパスの外で読まないため、TRANSIENT_ATTACHMENTとして
+/// 遅延確保のメモリに置く。タイルベースのGPUでは、これらに実際のメモリや帯域がほとんど要らない。
+///
 /// @param core 主要オブジェクトハンドル
 /// @param imageViews 描画先イメージビューの配列
 /// @param imageViewsCount imageViewsの要素数
 /// @param width 描画先イメージビューの幅
 /// @param height 描画先イメージビューの高
 /// @param imageLayout 描画先イメージのレイアウト
+/// @param samples サンプル数 (物理デバイスのカラー・深度のフレームバッファが対応していること)
 /// @returns 失敗時にNULLを返す。
 VulkanAppRendering createVulkanAppRendering(
     const VulkanAppCore core,
@@ -43,10 +235,132 @@ VulkanAppRendering createVulkanAppRendering(
     uint32_t imageViewsCount,
     uint32_t width,
     uint32_t height,
-    VkImageLayout imageLayout
+    VkImageLayout imageLayout,
+    VkSampleCountFlagBits samples
 );
 
+/// @brief シェーダのホットリロードを有効にする関数
+///
+/// shaderDir直下のGLSLソースの変更を監視する。
+/// 変更されたら描画のたびに次を進める。
+/// 1. ワーカースレッドでglslcを呼び出し、SPIR-Vバイナリにコンパイルする
+/// 2. 変更されたGLSLソースを使うパイプラインのみを、ワーカースレッドで作り直す
+/// 3. 作成が完了したら、フレームの開始時に差し替える
+/// 4. 差し替えられたパイプラインは、デバイスが使い終わったフレームで破棄する
+///
+/// 対象のGLSLソースと作り直すパイプラインは次の通り。有効でないパイプラインは作り直さない。
+/// - ui.vert, ui.frag: UI用
+/// - depth.vert: 深度プリパス用
+/// - mesh.vert, mesh.frag, mesh_depth.vert: メッシュ用
+/// - cull.comp: カリング用 (描画スレッドで作り直す)
+///
+/// いずれもvkDeviceWaitIdle()関数を呼ばないため、描画を止めない。
+/// ただし、シェーダのインターフェース(パイプラインレイアウト)が変わる変更には対応しない。
+/// ファイル名に英数字と"._-"以外を含むGLSLソースは無視する。
+///
+/// @param renderer レンダリングオブジェクトハンドル
+/// @param shaderDir GLSLソースとSPIR-Vバイナリがあるディレクトリのパス
+/// @returns 失敗時に0を返す。
+int enableShaderHotReload(const VulkanAppRendering renderer, const char *shaderDir);
+
+/// @brief 深度プリパスを有効にする関数
+///
+/// 本描画の前に、ローカル座標のみの頂点ストリームで深度のみを描画する。
+/// 本描画は深度テストをEQUAL・深度の書込み無しで行うため、フラグメントシェーダは画素毎に一回しか実行されない。
+/// フラグメントシェーダが重く、オーバードローが多いほど効果がある。
+///
+/// 深度プリパス用のパイプラインの作成が完了するまでは、深度プリパスを省いて本描画を深度テスト無しで行う。
+///
+/// @param core 主要オブジェクトハンドル
+/// @param renderer レンダリングオブジェクトハンドル
+/// @returns 失敗時に0を返す。
+int enableDepthPrepass(const VulkanAppCore core, const VulkanAppRendering renderer);
+
+/// @brief 法線を持つ3Dメッシュのインスタンス描画を有効にする関数
+///
+/// モデルを格子状に並べたinstancesCount個のインスタンスとして、一回のインスタンス描画で描画する。
+/// - カメラ(CameraForMesh)はフレーム毎にユニフォームバッファ用のリングバッファへ詰める
+/// - インスタンス毎の変換(ObjectForMesh)はフレーム毎にストレージバッファ用のリングバッファへ詰め、gl_InstanceIndexで引く
+///
+/// いずれもダイナミックディスクリプタのオフセットで参照先を切り替えるため、ディスクリプタセットは作成時に一度だけ書き込む。
+/// 深度プリパスが有効なら、メッシュも深度プリパスで描画する。
+///
+/// @param core 主要オブジェクトハンドル
+/// @param renderer レンダリングオブジェクトハンドル
+/// @param path モデルデータファイルのパス (法線ベクトルを含むこと)
+/// @param instancesCount インスタンス数
+/// @returns 失敗時に0を返す。
+int enableMeshInstances(const VulkanAppCore core, const VulkanAppRendering renderer, const char *path, uint32_t instancesCount);
+
+/// @brief メッシュレットのカリングを有効にする関数
+///
+/// LOD0を選んだインスタンスについて、描画の前にコンピュートシェーダでメッシュレット毎に視錐台カリングと裏面カリングを行い、
+/// 残ったメッシュレットの三角形のみを間接描画する。
+/// 殆どが画面外にある、あるいは裏を向いているメッシュほど、描画する三角形が減る。
+///
+/// メッシュのインスタンス描画を有効にした後で呼ぶこと。
+/// モデルがメッシュレットを持ち、drawIndirectFirstInstanceが有効でなければならない。
+///
+/// @param core 主要オブジェクトハンドル
+/// @param renderer レンダリングオブジェクトハンドル
+/// @returns 失敗時に0を返す。
+int enableMeshletCulling(const VulkanAppCore core, const VulkanAppRendering renderer);
+
+/// @brief パス毎の描画の仕事量の計測を有効にする関数
+///
+/// パイプライン統計クエリとオクルージョンクエリで、パス毎に次を計測する。
+/// - 入力頂点数・プリミティブ数と頂点シェーダの実行回数 (頂点の再利用率)
+/// - クリッピングの入出力プリミティブ数
+/// - フラグメントシェーダの実行回数と深度・ステンシルテストを通過したサンプル数 (オーバードロー)
+///
+/// 結果はフェンスを待機したフレームで回収するため、描画を止めない。
+/// レンダリングオブジェクトの破棄時に、一フレームあたりの平均を標準出力に出力する。
+///
+/// @param core 主要オブジェクトハンドル
+/// @param renderer レンダリングオブジェクトハンドル
+/// @returns 失敗時に0を返す。
+int enableDrawStats(const VulkanAppCore core, const VulkanAppRendering renderer);
+
+/// @brief 描画するタイルを設定する関数
+///
+/// 描画先イメージより大きなfullWidth x fullHeightの画像を、描画先イメージの大きさのタイルに分けて描画するために用いる。
+/// 以降のrender()関数は、画像全体のうち(tileX, tileY)を左上とするタイルの部分のみを描画先イメージへ描画する。
+/// 射影行列にタイルの範囲をクリップ空間全体へ拡大する変換を掛けるため、パイプラインのビューポートは描画先イメージのままでよい。
+/// メッシュのアスペクト比とLODの選択は画像全体の大きさで行う。
+/// シーンの時刻が固定されていなければ、タイル描画を有効にしたフレームに固定する。
+///
+/// @param renderer レンダリングオブジェクトハンドル
+/// @param fullWidth 画像全体の幅 (0ならタイル描画を無効にする)
+/// @param fullHeight 画像全体の高
+/// @param tileX タイルの左端の、画像全体での位置
+/// @param tileY タイルの上端の、画像全体での位置
+void setRenderingTile(const VulkanAppRendering renderer, uint32_t fullWidth, uint32_t fullHeight, int32_t tileX, int32_t tileY);
+
+/// @brief シーンの時刻を固定する関数
+///
+/// 以降のrender()関数は、描画したフレーム数に依らずsceneFrame番目のフレームのシーンを描画する。
+/// 複数のレンダリングオブジェクトでフレームを分担して描画する場合に、同じフレームから同じ結果を得るために用いる。
+///
+/// @param renderer レンダリングオブジェクトハンドル
+/// @param sceneFrame シーンの時刻として用いるフレームの番号
+void setRenderingSceneFrame(const VulkanAppRendering renderer, uint64_t sceneFrame);
+
+/// @brief 要求済みの全てのパイプラインの作成が完了するまで待機する関数
+///
+/// 一度しか描画しない場合等、代替のパイプラインで描画されては困るときに用いる。
+///
+/// @param renderer レンダリングオブジェクトハンドル
+void waitForPipelines(const VulkanAppRendering renderer);
+
 /// @brief 描画関数
+///
+/// RENDERING_FRAMES_IN_FLIGHTフレーム前の描画が完了するまで待機してから、そのフレームのリソースを再利用して描画する。
+/// パスとその間のバリアは、最初の描画時に作成するフレームのレンダーグラフに従って記録する。
+///
+/// パイプラインはフレームの開始時に一度だけ取得する。
+/// 作成が完了していなければ代替のパイプラインで描画し、それも無ければ描画を省く。
+/// フレームの途中で作成が完了したパイプラインは、次のフレームから使われる。
+///
 /// @param core 主要オブジェクトハンドル
 /// @param renderer レンダリングオブジェクトハンドル
 /// @param framebufferIndex 描画先フレームバッファのインデックス
@@ -0,0 +1,260 @@
+#include "descriptor.h"
+
+#include "error.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void deleteDescriptorAllocator(const VkDevice device, DescriptorAllocator descAllocator) {
+    if (descAllocator == NULL) {
+        return;
+    }
+    if (descAllocator->pools != NULL) {
+        for (uint32_t i = 0; i < descAllocator->poolsCount; ++i) {
+            vkDestroyDescriptorPool(device, descAllocator->pools[i], NULL);
+        }
+        free((void *)descAllocator->pools);
+    }
+    free((void *)descAllocator);
+}
+
+DescriptorAllocator createDescriptorAllocator(uint32_t setsPerPool) {
+#define CHECK(p, m) ERROR_IF(!(p), "createDescriptorAllocator()", (m), deleteDescriptorAllocator(NULL, descAllocator), NULL)
+
+    const DescriptorAllocator descAllocator = (DescriptorAllocator)malloc(sizeof(struct DescriptorAllocator_t));
+    CHECK(descAllocator != NULL, "DescriptorAllocatorの確保に失敗");
+    memset(descAllocator, 0, sizeof(struct DescriptorAllocator_t));
+
+    descAllocator->setsPerPool = setsPerPool > 0 ? setsPerPool : 1;
+
+    return descAllocator;
+
+#undef CHECK
+}
+
+// ディスクリプタプールを追加する関数
+//
+// NOTE: どのようなレイアウトのディスクリプタセットが確保されるかは分からないため、
+//       よく使われるディスクリプタの種類をディスクリプタセット数に比例して用意しておく。
+static VkDescriptorPool addDescriptorPool(const VkDevice device, DescriptorAllocator descAllocator) {
+#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "addDescriptorPool()", (m), (p), {}, NULL)
+#define CHECK(p, m)    ERROR_IF     (!(p),              "addDescriptorPool()", (m),      {}, NULL)
+#define SIZES_COUNT 6
+
+    // ディスクリプタプールの配列を拡張する
+    if (descAllocator->poolsCount >= descAllocator->poolsCapacity) {
+        const uint32_t capacity = descAllocator->poolsCapacity > 0 ? descAllocator->poolsCapacity * 2 : 4;
+        VkDescriptorPool *pools = (VkDescriptorPool *)realloc((void *)descAllocator->pools, sizeof(VkDescriptorPool) * capacity);
+        CHECK(pools != NULL, "ディスクリプタプールの配列の拡張に失敗");
+        descAllocator->pools = pools;
+        descAllocator->poolsCapacity = capacity;
+    }
+
+    // ディスクリプタプールを作成する
+    //
+    // NOTE: 個別に解放することはないため、VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BITは指定しない。
+    //       指定しなければ、ドライバはディスクリプタセットを線形に切り出すだけでよくなる。
+    VkDescriptorPool pool = NULL;
+    {
+        const uint32_t n = descAllocator->setsPerPool;
+        const VkDescriptorPoolSize sizes[SIZES_COUNT] = {
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, n * 2 },
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, n },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, n * 2 },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, n },
+            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, n * 2 },
+            { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, n },
+        };
+        const VkDescriptorPoolCreateInfo ci = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            NULL,
+            0,
+            n,
+            SIZES_COUNT,
+            sizes,
+        };
+        CHECK_VK(vkCreateDescriptorPool(device, &ci, NULL, &pool), "ディスクリプタプールの作成に失敗");
+    }
+
+    descAllocator->pools[descAllocator->poolsCount] = pool;
+    descAllocator->poolsCount += 1;
+    if (descAllocator->setsPerPool < DESCRIPTOR_ALLOCATOR_MAX_SETS_PER_POOL) {
+        descAllocator->setsPerPool *= 2;
+    }
+
+    return pool;
+
+#undef SIZES_COUNT
+#undef CHECK
+#undef CHECK_VK
+}
+
+VkDescriptorSet allocateDescriptorSet(const VkDevice device, DescriptorAllocator descAllocator, const VkDescriptorSetLayout layout) {
+#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "allocateDescriptorSet()", (m), (p), {}, NULL)
+#define CHECK(p, m)    ERROR_IF     (!(p),              "allocateDescriptorSet()", (m),      {}, NULL)
+
+    // 現在のディスクリプタプールから確保を試み、枯渇していれば次のディスクリプタプールへ移る
+    //
+    // NOTE: リセット後は既存のディスクリプタプールを先頭から再利用する。
+    //       全て枯渇していれば、新たにディスクリプタプールを追加する。
+    VkResult res = VK_ERROR_OUT_OF_POOL_MEMORY;
+    VkDescriptorSet descSet = NULL;
+    while (1) {
+        uint32_t addedSets = 0;
+        if (descAllocator->currentPool >= descAllocator->poolsCount) {
+            addedSets = descAllocator->setsPerPool;
+            CHECK(addDescriptorPool(device, descAllocator) != NULL, "ディスクリプタプールの追加に失敗");
+        }
+        const VkDescriptorSetAllocateInfo ai = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            NULL,
+            descAllocator->pools[descAllocator->currentPool],
+            1,
+            &layout,
+        };
+        res = vkAllocateDescriptorSets(device, &ai, &descSet);
+        if (res != VK_ERROR_OUT_OF_POOL_MEMORY && res != VK_ERROR_FRAGMENTED_POOL) {
+            break;
+        }
+        // NOTE: 最大の大きさのディスクリプタプールを追加しても確保できなければ、それ以上追加しても確保できない。
+        if (addedSets >= DESCRIPTOR_ALLOCATOR_MAX_SETS_PER_POOL) {
+            break;
+        }
+        descAllocator->currentPool += 1;
+    }
+    CHECK_VK(res, "ディスクリプタセットの確保に失敗");
+
+    return descSet;
+
+#undef CHECK
+#undef CHECK_VK
+}
+
+void resetDescriptorAllocator(const VkDevice device, DescriptorAllocator descAllocator) {
+    for (uint32_t i = 0; i < descAllocator->poolsCount; ++i) {
+        vkResetDescriptorPool(device, descAllocator->pools[i], 0);
+    }
+    descAllocator->currentPool = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void deleteDescriptorSetLayoutCache(const VkDevice device, DescriptorSetLayoutCache cache) {
+    if (cache == NULL) {
+        return;
+    }
+    if (cache->entries != NULL) {
+        for (uint32_t i = 0; i < cache->entriesCount; ++i) {
+            vkDestroyDescriptorSetLayout(device, cache->entries[i].layout, NULL);
+            free((void *)cache->entries[i].bindings);
+        }
+        free((void *)cache->entries);
+    }
+    free((void *)cache);
+}
+
+DescriptorSetLayoutCache createDescriptorSetLayoutCache(void) {
+#define CHECK(p, m) ERROR_IF(!(p), "createDescriptorSetLayoutCache()", (m), deleteDescriptorSetLayoutCache(NULL, cache), NULL)
+
+    const DescriptorSetLayoutCache cache = (DescriptorSetLayoutCache)malloc(sizeof(struct DescriptorSetLayoutCache_t));
+    CHECK(cache != NULL, "DescriptorSetLayoutCacheの確保に失敗");
+    memset(cache, 0, sizeof(struct DescriptorSetLayoutCache_t));
+
+    return cache;
+
+#undef CHECK
+}
+
+// バインディングをバインディング番号の昇順に並べるための比較関数
+static int compareBindings(const void *a, const void *b) {
+    const uint32_t ba = ((const VkDescriptorSetLayoutBinding *)a)->binding;
+    const uint32_t bb = ((const VkDescriptorSetLayoutBinding *)b)->binding;
+    return (ba > bb) - (ba < bb);
+}
+
+VkDescriptorSetLayout getDescriptorSetLayout(
+    const VkDevice device,
+    DescriptorSetLayoutCache cache,
+    uint32_t bindingsCount,
+    const VkDescriptorSetLayoutBinding *bindings
+) {
+#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "getDescriptorSetLayout()", (m), (p), free((void *)sorted), NULL)
+#define CHECK(p, m)    ERROR_IF     (!(p),              "getDescriptorSetLayout()", (m),      free((void *)sorted), NULL)
+
+    // バインディングをバインディング番号の昇順に並べる
+    //
+    // NOTE: 順番が異なるだけのバインディングを同一視するため。
+    VkDescriptorSetLayoutBinding *sorted = (VkDescriptorSetLayoutBinding *)malloc(sizeof(VkDescriptorSetLayoutBinding) * (bindingsCount + 1));
+    CHECK(sorted != NULL, "バインディングの配列の確保に失敗");
+    for (uint32_t i = 0; i < bindingsCount; ++i) {
+        CHECK(bindings[i].pImmutableSamplers == NULL, "イミュータブルサンプラには未対応");
+        sorted[i] = bindings[i];
+    }
+    qsort((void *)sorted, bindingsCount, sizeof(VkDescriptorSetLayoutBinding), compareBindings);
+
+    // 同じバインディングを持つディスクリプタセットレイアウトを探す
+    for (uint32_t i = 0; i < cache->entriesCount; ++i) {
+        const DescriptorSetLayoutCacheEntry *entry = &cache->entries[i];
+        if (entry->bindingsCount != bindingsCount) {
+            continue;
+        }
+        uint32_t j = 0;
+        for (; j < bindingsCount; ++j) {
+            const VkDescriptorSetLayoutBinding *x = &entry->bindings[j];
+            const VkDescriptorSetLayoutBinding *y = &sorted[j];
+            if (x->binding != y->binding
+                || x->descriptorType != y->descriptorType
+                || x->descriptorCount != y->descriptorCount
+                || x->stageFlags != y->stageFlags
+            ) {
+                break;
+            }
+        }
+        if (j == bindingsCount) {
+            free((void *)sorted);
+            return entry->layout;
+        }
+    }
+
+    // 要素の配列を拡張する
+    if (cache->entriesCount >= cache->entriesCapacity) {
+        const uint32_t capacity = cache->entriesCapacity > 0 ? cache->entriesCapacity * 2 : 8;
+        DescriptorSetLayoutCacheEntry *entries = (DescriptorSetLayoutCacheEntry *)realloc(
+            (void *)cache->entries,
+            sizeof(DescriptorSetLayoutCacheEntry) * capacity
+        );
+        CHECK(entries != NULL, "要素の配列の拡張に失敗");
+        cache->entries = entries;
+        cache->entriesCapacity = capacity;
+    }
+
+    // ディスクリプタセットレイアウトを作成する
+    VkDescriptorSetLayout layout = NULL;
+    {
+        const VkDescriptorSetLayoutCreateInfo ci = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            NULL,
+            0,
+            bindingsCount,
+            sorted,
+        };
+        CHECK_VK(vkCreateDescriptorSetLayout(device, &ci, NULL, &layout), "ディスクリプタセットレイアウトの作成に失敗");
+    }
+
+    cache->entries[cache->entriesCount].bindingsCount = bindingsCount;
+    cache->entries[cache->entriesCount].bindings = sorted;
+    cache->entries[cache->entriesCount].layout = layout;
+    cache->entriesCount += 1;
+
+    return layout;
+
+#undef CHECK
+#undef CHECK_VK
+}
@@ -0,0 +1,108 @@
+/// @file descriptor.h
+/// @brief ディスクリプタセットの確保とディスクリプタセットレイアウトの共有に関するモジュール
+///
+/// - DescriptorAllocator
+///   - ディスクリプタプールを必要に応じて増やしながらディスクリプタセットを確保する
+///   - フレーム毎に一つ作成し、フレームの開始時にまとめてリセットする使い方を想定している
+/// - DescriptorSetLayoutCache
+///   - 同じバインディングを持つディスクリプタセットレイアウトを一つにまとめる
+
+#pragma once
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+/// @brief ディスクリプタプール一つあたりのディスクリプタセット数の上限
+#define DESCRIPTOR_ALLOCATOR_MAX_SETS_PER_POOL 4096
+
+/// @brief ディスクリプタセットの確保に必要なオブジェクトを持つ構造体
+typedef struct DescriptorAllocator_t {
+    uint32_t poolsCount;
+    uint32_t poolsCapacity;
+    VkDescriptorPool *pools;
+    // 現在確保に使っているディスクリプタプールのインデックス
+    uint32_t currentPool;
+    // 次に作成するディスクリプタプールのディスクリプタセット数
+    uint32_t setsPerPool;
+} *DescriptorAllocator;
+
+/// @brief DescriptorAllocatorを破棄する関数
+/// @param device 論理デバイス
+/// @param descAllocator ディスクリプタ確保オブジェクトハンドル
+void deleteDescriptorAllocator(const VkDevice device, DescriptorAllocator descAllocator);
+
+/// @brief DescriptorAllocatorを作成する関数
+///
+/// ディスクリプタプールは最初に確保を行う時に作成する。
+/// ディスクリプタプールが枯渇するたびに、ディスクリプタセット数を倍にしたディスクリプタプールを追加する。
+///
+/// @param setsPerPool 最初のディスクリプタプールのディスクリプタセット数
+/// @returns 失敗時にNULLを返す。
+DescriptorAllocator createDescriptorAllocator(uint32_t setsPerPool);
+
+/// @brief ディスクリプタセットを確保する関数
+///
+/// 確保したディスクリプタセットは個別に解放できない。
+/// resetDescriptorAllocator()関数でまとめて解放すること。
+///
+/// @param device 論理デバイス
+/// @param descAllocator ディスクリプタ確保オブジェクトハンドル
+/// @param layout ディスクリプタセットレイアウト
+/// @returns 失敗時にNULLを返す。
+VkDescriptorSet allocateDescriptorSet(const VkDevice device, DescriptorAllocator descAllocator, const VkDescriptorSetLayout layout);
+
+/// @brief 確保した全てのディスクリプタセットを解放する関数
+///
+/// ディスクリプタプール自体は破棄せず、次回以降の確保に再利用する。
+/// デバイスが解放するディスクリプタセットを使い終わってから呼ぶこと。
+///
+/// @param device 論理デバイス
+/// @param descAllocator ディスクリプタ確保オブジェクトハンドル
+void resetDescriptorAllocator(const VkDevice device, DescriptorAllocator descAllocator);
+
+/// @brief DescriptorSetLayoutCacheの要素
+typedef struct DescriptorSetLayoutCacheEntry_t {
+    // バインディング番号の昇順に並べたバインディングの配列
+    uint32_t bindingsCount;
+    VkDescriptorSetLayoutBinding *bindings;
+    VkDescriptorSetLayout layout;
+} DescriptorSetLayoutCacheEntry;
+
+/// @brief ディスクリプタセットレイアウトの共有に必要なオブジェクトを持つ構造体
+typedef struct DescriptorSetLayoutCache_t {
+    uint32_t entriesCount;
+    uint32_t entriesCapacity;
+    DescriptorSetLayoutCacheEntry *entries;
+} *DescriptorSetLayoutCache;
+
+/// @brief DescriptorSetLayoutCacheを破棄する関数
+///
+/// 作成した全てのディスクリプタセットレイアウトも破棄する。
+///
+/// @param device 論理デバイス
+/// @param cache ディスクリプタセットレイアウト共有オブジェクトハンドル
+void deleteDescriptorSetLayoutCache(const VkDevice device, DescriptorSetLayoutCache cache);
+
+/// @brief DescriptorSetLayoutCacheを作成する関数
+/// @returns 失敗時にNULLを返す。
+DescriptorSetLayoutCache createDescriptorSetLayoutCache(void);
+
+/// @brief バインディングに合うディスクリプタセットレイアウトを取得する関数
+///
+/// 同じバインディングを持つディスクリプタセットレイアウトが既にあればそれを返し、無ければ作成する。
+/// バインディングの順番は問わない。
+/// 返したディスクリプタセットレイアウトはDescriptorSetLayoutCacheが所有するため、破棄してはならない。
+///
+/// @note イミュータブルサンプラには対応していない。
+///
+/// @param device 論理デバイス
+/// @param cache ディスクリプタセットレイアウト共有オブジェクトハンドル
+/// @param bindingsCount bindingsの要素数
+/// @param bindings バインディングの配列
+/// @returns 失敗時にNULLを返す。
+VkDescriptorSetLayout getDescriptorSetLayout(
+    const VkDevice device,
+    DescriptorSetLayoutCache cache,
+    uint32_t bindingsCount,
+    const VkDescriptorSetLayoutBinding *bindings
+);
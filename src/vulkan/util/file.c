@@ -19,21 +19,24 @@ const char *readBinaryFile(const char *path, long int *size) {
     }
 
     // ファイルサイズを取得する
-    fpos_t pos = 0;
+    //
+    // NOTE: fpos_tは整数型とは限らない(glibcでは構造体)ため、ftell()関数で取得する。
+    long int pos = 0;
     {
         CHECK(fseek(file, 0L, SEEK_END) == 0, "ファイルの後尾へのシークに失敗", fclose(file));
-        CHECK(fgetpos(file, &pos) == 0, "ファイルサイズの取得に失敗", fclose(file));
+        pos = ftell(file);
+        CHECK(pos >= 0, "ファイルサイズの取得に失敗", fclose(file));
         CHECK(fseek(file, 0L, SEEK_SET) == 0, "ファイルの先頭へのシークに失敗", fclose(file));
     }
 
     // 内容を読み込む
     const char *binary;
     {
-        binary = (const char *)malloc(sizeof(const char) * pos);
+        binary = (const char *)malloc(sizeof(const char) * (size_t)(pos > 0 ? pos : 1));
         CHECK(binary != NULL, "メモリの確保に失敗", fclose(file));
 
         CHECK(
-            fread((void *)binary, sizeof(const char), pos, file) == (size_t)pos,
+            fread((void *)binary, sizeof(const char), (size_t)pos, file) == (size_t)pos,
             "ファイルの読込みに失敗",
             { free((void *)binary); fclose(file); }
         );
@@ -46,10 +49,44 @@ const char *readBinaryFile(const char *path, long int *size) {
 
     // サイズを格納する
     if (size != NULL) {
-        *size = (long int)pos;
+        *size = pos;
     }
     
     return binary;
 
 #undef CHECK
 }
+
+int existsFile(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+    fclose(file);
+    return 1;
+}
+
+int writeBinaryFile(const char *path, const void *data, size_t size) {
+#define CHECK(p, m, d) ERROR_IF(!(p), "writeBinaryFile()", (m), d, 0)
+
+    // ファイルを開く
+    FILE *file;
+    {
+        file = fopen(path, "wb");
+        CHECK(file != NULL, "ファイルのオープンに失敗", {});
+    }
+
+    // 内容を書き出す
+    {
+        CHECK(fwrite(data, sizeof(const char), size, file) == size, "ファイルへの書出しに失敗", fclose(file));
+    }
+
+    // ファイルを閉じる
+    {
+        CHECK(fclose(file) == 0, "ファイルのクローズに失敗", {});
+    }
+
+    return 1;
+
+#undef CHECK
+}
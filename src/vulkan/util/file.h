@@ -3,8 +3,25 @@
 
 #pragma once
 
+#include <stddef.h>
+
 /// @brief バイナリファイルの内容を取得する関数
 /// @param path ファイルパス
 /// @param size バイナリサイズの格納先。不要ならばNULLを与える
 /// @returns 失敗時にNULLを返す。
 const char *readBinaryFile(const char *path, long int *size);
+
+/// @brief ファイルが読込み可能か確認する関数
+/// @param path ファイルパス
+/// @returns 読込み可能ならば1を返す。
+int existsFile(const char *path);
+
+/// @brief バイナリファイルへ内容を書き出す関数
+///
+/// ファイルが既にあれば上書きする。
+///
+/// @param path ファイルパス
+/// @param data 書き出す内容
+/// @param size 書き出す内容のサイズ
+/// @returns 失敗時に0を返す。
+int writeBinaryFile(const char *path, const void *data, size_t size);
@@ -0,0 +1,203 @@
+#include "glslc.h"
+
+// strcpy()関数の使用に対してwarningを出さないためにこのマクロを定義する
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "error.h"
+#include "profiler.h"
+#include "thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// GLSLソースのコンパイルの結果
+typedef struct GlslCompileResult_t {
+    char name[FILE_WATCHER_MAX_NAME];
+    int succeeded;
+} GlslCompileResult;
+
+struct GlslCompiler_t {
+    char dirPath[FILE_WATCHER_MAX_NAME];
+    // 以降の全てのメンバを保護するミューテックス
+    Mutex mutex;
+    // 待ち行列に要求が入ったことを通知する条件変数
+    CondVar queued;
+    Thread worker;
+    // 待ち行列 (リングバッファ)
+    char jobs[GLSL_COMPILER_MAX_JOBS][FILE_WATCHER_MAX_NAME];
+    uint32_t jobsHead;
+    uint32_t jobsCount;
+    // ワーカースレッドが処理中の要求の数
+    uint32_t runningCount;
+    // 取り出されていない結果 (リングバッファ)
+    //
+    // NOTE: 要求・処理中・結果の合計をGLSL_COMPILER_MAX_JOBS以下に抑えるため、溢れない。
+    GlslCompileResult results[GLSL_COMPILER_MAX_JOBS];
+    uint32_t resultsHead;
+    uint32_t resultsCount;
+    int quit;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// コマンドラインにそのまま渡せるファイル名か確認する関数
+//
+// NOTE: 引用符やシェルのメタ文字を含む名前でコマンドを組み立てないよう、[A-Za-z0-9._-]のみを許す。
+//       "."や".."のみの名前も、ディレクトリを指すため拒否する。
+static int isSafeGlslName(const char *name) {
+    const size_t length = strlen(name);
+    if (length == 0 || length >= FILE_WATCHER_MAX_NAME || strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+        return 0;
+    }
+    for (size_t i = 0; i < length; ++i) {
+        const char c = name[i];
+        const int valid = (c >= 'A' && c <= 'Z')
+            || (c >= 'a' && c <= 'z')
+            || (c >= '0' && c <= '9')
+            || c == '.'
+            || c == '_'
+            || c == '-';
+        if (!valid) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// glslcでGLSLソースをコンパイルする関数
+//
+// NOTE: コンパイルエラーはglslcが標準エラー出力に出す。
+static int compileGlslSource(const char *dirPath, const char *name) {
+    char command[FILE_WATCHER_MAX_NAME * 4 + 32];
+    snprintf(command, sizeof(command), "glslc -o \"%s/%s.spv\" \"%s/%s\"", dirPath, name, dirPath, name);
+    return system(command) == 0;
+}
+
+static void runGlslCompilerWorker(void *arg) {
+    const GlslCompiler compiler = (GlslCompiler)arg;
+    PROFILE_THREAD_NAME("glsl-compiler");
+    lockMutex(compiler->mutex);
+    while (1) {
+        while (!compiler->quit && compiler->jobsCount == 0) {
+            waitCondVar(compiler->queued, compiler->mutex);
+        }
+        if (compiler->quit) {
+            break;
+        }
+        char name[FILE_WATCHER_MAX_NAME];
+        strcpy(name, compiler->jobs[compiler->jobsHead]);
+        compiler->jobsHead = (compiler->jobsHead + 1) % GLSL_COMPILER_MAX_JOBS;
+        compiler->jobsCount -= 1;
+        compiler->runningCount += 1;
+        unlockMutex(compiler->mutex);
+
+        PROFILE_ZONE_BEGIN("compileGlslSource");
+        const int succeeded = compileGlslSource(compiler->dirPath, name);
+        PROFILE_ZONE_END("compileGlslSource");
+
+        lockMutex(compiler->mutex);
+        GlslCompileResult *result = &compiler->results[(compiler->resultsHead + compiler->resultsCount) % GLSL_COMPILER_MAX_JOBS];
+        strcpy(result->name, name);
+        result->succeeded = succeeded;
+        compiler->resultsCount += 1;
+        compiler->runningCount -= 1;
+    }
+    unlockMutex(compiler->mutex);
+}
+
+void deleteGlslCompiler(GlslCompiler compiler) {
+    if (compiler == NULL) {
+        return;
+    }
+    if (compiler->mutex != NULL) {
+        lockMutex(compiler->mutex);
+        compiler->quit = 1;
+        if (compiler->queued != NULL) broadcastCondVar(compiler->queued);
+        unlockMutex(compiler->mutex);
+    }
+    if (compiler->worker != NULL) joinThread(compiler->worker);
+    if (compiler->queued != NULL) deleteCondVar(compiler->queued);
+    if (compiler->mutex != NULL) deleteMutex(compiler->mutex);
+    free((void *)compiler);
+}
+
+GlslCompiler createGlslCompiler(const char *dirPath) {
+#define CHECK(p, m) ERROR_IF(!(p), "createGlslCompiler()", (m), deleteGlslCompiler(compiler), NULL)
+
+    const GlslCompiler compiler = (GlslCompiler)malloc(sizeof(struct GlslCompiler_t));
+    CHECK(compiler != NULL, "GlslCompilerの確保に失敗");
+    memset(compiler, 0, sizeof(struct GlslCompiler_t));
+
+    CHECK(strlen(dirPath) < FILE_WATCHER_MAX_NAME, "ディレクトリのパスが長すぎる");
+    strcpy(compiler->dirPath, dirPath);
+
+    // 同期プリミティブを作成する
+    {
+        compiler->mutex = createMutex();
+        CHECK(compiler->mutex != NULL, "ミューテックスの作成に失敗");
+        compiler->queued = createCondVar();
+        CHECK(compiler->queued != NULL, "条件変数の作成に失敗");
+    }
+
+    // ワーカースレッドを開始する
+    //
+    // NOTE: glslcはプロセスの起動を含めて数百msかかるため、一つのスレッドで順に処理すれば足りる。
+    {
+        compiler->worker = createThread(runGlslCompilerWorker, (void *)compiler);
+        CHECK(compiler->worker != NULL, "ワーカースレッドの作成に失敗");
+    }
+
+    return compiler;
+
+#undef CHECK
+}
+
+int requestGlslCompile(GlslCompiler compiler, const char *name) {
+    if (!isSafeGlslName(name)) {
+        printf("[ error ] requestGlslCompile(): 使えない文字を含むファイル名: %s\n", name);
+        return 0;
+    }
+
+    lockMutex(compiler->mutex);
+    for (uint32_t i = 0; i < compiler->jobsCount; ++i) {
+        if (strcmp(compiler->jobs[(compiler->jobsHead + i) % GLSL_COMPILER_MAX_JOBS], name) == 0) {
+            unlockMutex(compiler->mutex);
+            return 1;
+        }
+    }
+    if (compiler->jobsCount + compiler->runningCount + compiler->resultsCount >= GLSL_COMPILER_MAX_JOBS) {
+        unlockMutex(compiler->mutex);
+        printf("[ error ] requestGlslCompile(): 待ち行列が満杯: %s\n", name);
+        return 0;
+    }
+    strcpy(compiler->jobs[(compiler->jobsHead + compiler->jobsCount) % GLSL_COMPILER_MAX_JOBS], name);
+    compiler->jobsCount += 1;
+    signalCondVar(compiler->queued);
+    unlockMutex(compiler->mutex);
+    return 1;
+}
+
+int pollGlslCompiler(GlslCompiler compiler, char *name, int *succeeded) {
+    lockMutex(compiler->mutex);
+    if (compiler->resultsCount == 0) {
+        unlockMutex(compiler->mutex);
+        return 0;
+    }
+    const GlslCompileResult *result = &compiler->results[compiler->resultsHead];
+    strcpy(name, result->name);
+    *succeeded = result->succeeded;
+    compiler->resultsHead = (compiler->resultsHead + 1) % GLSL_COMPILER_MAX_JOBS;
+    compiler->resultsCount -= 1;
+    unlockMutex(compiler->mutex);
+    return 1;
+}
+
+int isGlslCompilerIdle(GlslCompiler compiler) {
+    lockMutex(compiler->mutex);
+    const int idle = compiler->jobsCount == 0 && compiler->runningCount == 0 && compiler->resultsCount == 0;
+    unlockMutex(compiler->mutex);
+    return idle;
+}
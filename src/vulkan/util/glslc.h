@@ -0,0 +1,57 @@
+/// @file glslc.h
+/// @brief GLSLソースをワーカースレッドでSPIR-Vバイナリにコンパイルするモジュール
+///
+/// - 一つのワーカースレッドがglslcを呼び出し、name.spvに出力する (build.batと同じ)
+/// - 呼び出し側は要求と結果の取り出しのみを行い、コンパイルの完了を待たない
+/// - ファイル名はコマンドラインにそのまま渡すため、英数字と"._-"以外を含むものは拒否する
+
+#pragma once
+
+#include "watcher.h"
+
+#include <stdint.h>
+
+/// @brief 待ち行列に入れられる要求の最大数
+#define GLSL_COMPILER_MAX_JOBS 16
+
+/// @brief GLSLコンパイルオブジェクトハンドル
+typedef struct GlslCompiler_t *GlslCompiler;
+
+/// @brief GlslCompilerを破棄する関数
+///
+/// 処理中の要求があれば完了を待つ。
+/// 待ち行列に残る要求は処理せずに捨てる。
+///
+/// @param compiler GLSLコンパイルオブジェクトハンドル
+void deleteGlslCompiler(GlslCompiler compiler);
+
+/// @brief GlslCompilerを作成しワーカースレッドを開始する関数
+/// @param dirPath GLSLソースがあるディレクトリのパス (FILE_WATCHER_MAX_NAMEバイト未満)
+/// @returns 失敗時にNULLを返す。
+GlslCompiler createGlslCompiler(const char *dirPath);
+
+/// @brief GLSLソースのコンパイルを要求する関数
+///
+/// 待機しない。
+/// 同じファイルの要求が既に待ち行列にあれば、新たには加えない。
+///
+/// @param compiler GLSLコンパイルオブジェクトハンドル
+/// @param name GLSLソースのファイル名(ディレクトリを含まない)
+/// @returns ファイル名が不正か、待ち行列が満杯なら0を返す。
+int requestGlslCompile(GlslCompiler compiler, const char *name);
+
+/// @brief コンパイルを終えたGLSLソースを一つ取り出す関数
+///
+/// 待機しない。
+/// 終えたものが無くなるまで繰り返し呼ぶこと。
+///
+/// @param compiler GLSLコンパイルオブジェクトハンドル
+/// @param name ファイル名の格納先 (FILE_WATCHER_MAX_NAMEバイト以上)
+/// @param succeeded コンパイルに成功したか否かの格納先
+/// @returns 終えたものが無ければ0を返す。
+int pollGlslCompiler(GlslCompiler compiler, char *name, int *succeeded);
+
+/// @brief 要求を全て処理し終え、結果も全て取り出されたか確認する関数
+/// @param compiler GLSLコンパイルオブジェクトハンドル
+/// @returns 処理中・未処理・未回収のものがあれば0を返す。
+int isGlslCompilerIdle(GlslCompiler compiler);
@@ -0,0 +1,730 @@
+#include "graph.h"
+
+#include "error.h"
+#include "memory/memory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 書込みとみなすアクセス
+#define RENDER_GRAPH_WRITE_ACCESS_MASK (           \
+    VK_ACCESS_SHADER_WRITE_BIT                     \
+    | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT         \
+    | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT \
+    | VK_ACCESS_TRANSFER_WRITE_BIT                 \
+    | VK_ACCESS_HOST_WRITE_BIT                     \
+    | VK_ACCESS_MEMORY_WRITE_BIT                   \
+)
+
+void deleteRenderGraph(const VkDevice device, RenderGraph graph) {
+    if (graph == NULL) {
+        return;
+    }
+    for (uint32_t i = 0; i < graph->resourcesCount; ++i) {
+        const RenderGraphResource *resource = &graph->resources[i];
+        if (!resource->transient) {
+            continue;
+        }
+        if (resource->buffer != NULL) vkDestroyBuffer(device, resource->buffer, NULL);
+        if (resource->image != NULL) vkDestroyImage(device, resource->image, NULL);
+    }
+    for (uint32_t i = 0; i < graph->blocksCount; ++i) {
+        const RenderGraphMemoryBlock *block = &graph->blocks[i];
+        if (block->devMemory != NULL) freeDeviceMemory(device, graph->allocator, block->devMemory, block->memTypeIndex, block->size);
+    }
+    free((void *)graph);
+}
+
+RenderGraph createRenderGraph(void) {
+#define CHECK(p, m) ERROR_IF(!(p), "createRenderGraph()", (m), {}, NULL)
+
+    const RenderGraph graph = (RenderGraph)malloc(sizeof(struct RenderGraph_t));
+    CHECK(graph != NULL, "RenderGraphの確保に失敗");
+    memset(graph, 0, sizeof(struct RenderGraph_t));
+
+    return graph;
+
+#undef CHECK
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// リソースを一つ確保する関数
+//
+// NOTE: コンパイル済みか、リソースの数が上限に達していればNULLを返す。
+static RenderGraphResource *allocateRenderGraphResource(RenderGraph graph, const char *name, int isImage, int transient) {
+    if (graph->compiled || graph->resourcesCount >= RENDER_GRAPH_MAX_RESOURCES) {
+        return NULL;
+    }
+    RenderGraphResource *resource = &graph->resources[graph->resourcesCount];
+    memset(resource, 0, sizeof(RenderGraphResource));
+    resource->name = name;
+    resource->isImage = isImage;
+    resource->transient = transient;
+    resource->blockIndex = RENDER_GRAPH_INVALID_INDEX;
+    resource->firstPass = RENDER_GRAPH_INVALID_INDEX;
+    resource->lastPass = RENDER_GRAPH_INVALID_INDEX;
+    graph->resourcesCount += 1;
+    return resource;
+}
+
+uint32_t addRenderGraphBuffer(
+    RenderGraph graph,
+    const char *name,
+    VkBuffer buffer,
+    const RenderGraphAccess *initialAccess,
+    const RenderGraphAccess *finalAccess
+) {
+#define CHECK(p, m) ERROR_IF(!(p), "addRenderGraphBuffer()", (m), {}, RENDER_GRAPH_INVALID_INDEX)
+
+    RenderGraphResource *resource = allocateRenderGraphResource(graph, name, 0, 0);
+    CHECK(resource != NULL, "コンパイル済みか、リソースが多すぎる");
+    resource->buffer = buffer;
+    if (initialAccess != NULL) resource->initialAccess = *initialAccess;
+    if (finalAccess != NULL) resource->finalAccess = *finalAccess;
+
+    return graph->resourcesCount - 1;
+
+#undef CHECK
+}
+
+uint32_t addRenderGraphImage(
+    RenderGraph graph,
+    const char *name,
+    VkImage image,
+    VkImageAspectFlags aspectMask,
+    const RenderGraphAccess *initialAccess,
+    const RenderGraphAccess *finalAccess
+) {
+#define CHECK(p, m) ERROR_IF(!(p), "addRenderGraphImage()", (m), {}, RENDER_GRAPH_INVALID_INDEX)
+
+    RenderGraphResource *resource = allocateRenderGraphResource(graph, name, 1, 0);
+    CHECK(resource != NULL, "コンパイル済みか、リソースが多すぎる");
+    resource->image = image;
+    resource->aspectMask = aspectMask;
+    if (initialAccess != NULL) resource->initialAccess = *initialAccess;
+    if (finalAccess != NULL) resource->finalAccess = *finalAccess;
+
+    return graph->resourcesCount - 1;
+
+#undef CHECK
+}
+
+uint32_t addRenderGraphTransientBuffer(RenderGraph graph, const char *name, VkDeviceSize size, VkBufferUsageFlags usage) {
+#define CHECK(p, m) ERROR_IF(!(p), "addRenderGraphTransientBuffer()", (m), {}, RENDER_GRAPH_INVALID_INDEX)
+
+    RenderGraphResource *resource = allocateRenderGraphResource(graph, name, 0, 1);
+    CHECK(resource != NULL, "コンパイル済みか、リソースが多すぎる");
+    resource->size = size;
+    resource->bufferUsage = usage;
+
+    return graph->resourcesCount - 1;
+
+#undef CHECK
+}
+
+uint32_t addRenderGraphTransientImage(
+    RenderGraph graph,
+    const char *name,
+    VkFormat format,
+    uint32_t width,
+    uint32_t height,
+    VkImageUsageFlags usage,
+    VkSampleCountFlagBits samples,
+    VkImageAspectFlags aspectMask
+) {
+#define CHECK(p, m) ERROR_IF(!(p), "addRenderGraphTransientImage()", (m), {}, RENDER_GRAPH_INVALID_INDEX)
+
+    RenderGraphResource *resource = allocateRenderGraphResource(graph, name, 1, 1);
+    CHECK(resource != NULL, "コンパイル済みか、リソースが多すぎる");
+    resource->format = format;
+    resource->extent.width = width;
+    resource->extent.height = height;
+    resource->extent.depth = 1;
+    resource->imageUsage = usage;
+    resource->samples = samples;
+    resource->aspectMask = aspectMask;
+
+    return graph->resourcesCount - 1;
+
+#undef CHECK
+}
+
+uint32_t addRenderGraphPass(RenderGraph graph, const char *name, RenderGraphRecordCallback record, void *userData, int sideEffects) {
+#define CHECK(p, m) ERROR_IF(!(p), "addRenderGraphPass()", (m), {}, RENDER_GRAPH_INVALID_INDEX)
+
+    CHECK(!graph->compiled && graph->passesCount < RENDER_GRAPH_MAX_PASSES, "コンパイル済みか、パスが多すぎる");
+    RenderGraphPass *pass = &graph->passes[graph->passesCount];
+    memset(pass, 0, sizeof(RenderGraphPass));
+    pass->name = name;
+    pass->record = record;
+    pass->userData = userData;
+    pass->sideEffects = sideEffects;
+    graph->passesCount += 1;
+
+    return graph->passesCount - 1;
+
+#undef CHECK
+}
+
+// パスにアクセスを一つ加える関数
+static int addRenderGraphPassAccess(
+    RenderGraph graph,
+    uint32_t pass,
+    uint32_t resource,
+    VkPipelineStageFlags stageMask,
+    VkAccessFlags accessMask,
+    VkImageLayout layout,
+    int attachment
+) {
+    if (graph->compiled || pass >= graph->passesCount || resource >= graph->resourcesCount) {
+        return 0;
+    }
+    RenderGraphPass *p = &graph->passes[pass];
+    if (p->accessesCount >= RENDER_GRAPH_MAX_PASS_ACCESSES) {
+        return 0;
+    }
+    RenderGraphPassAccess *a = &p->accesses[p->accessesCount];
+    a->resource = resource;
+    a->access.stageMask = stageMask;
+    a->access.accessMask = accessMask;
+    a->access.layout = layout;
+    a->attachment = attachment;
+    p->accessesCount += 1;
+    return 1;
+}
+
+int addRenderGraphAccess(
+    RenderGraph graph,
+    uint32_t pass,
+    uint32_t resource,
+    VkPipelineStageFlags stageMask,
+    VkAccessFlags accessMask,
+    VkImageLayout layout
+) {
+#define CHECK(p, m) ERROR_IF(!(p), "addRenderGraphAccess()", (m), {}, 0)
+
+    CHECK(addRenderGraphPassAccess(graph, pass, resource, stageMask, accessMask, layout, 0), "アクセスの宣言に失敗");
+    return 1;
+
+#undef CHECK
+}
+
+int addRenderGraphAttachment(
+    RenderGraph graph,
+    uint32_t pass,
+    uint32_t resource,
+    VkPipelineStageFlags stageMask,
+    VkAccessFlags accessMask,
+    VkImageLayout finalLayout
+) {
+#define CHECK(p, m) ERROR_IF(!(p), "addRenderGraphAttachment()", (m), {}, 0)
+
+    CHECK(resource < graph->resourcesCount && graph->resources[resource].isImage, "イメージでないリソースはアタッチメントにできない");
+    CHECK(addRenderGraphPassAccess(graph, pass, resource, stageMask, accessMask, finalLayout, 1), "アタッチメントの宣言に失敗");
+    return 1;
+
+#undef CHECK
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// 使い方からリソースの状態を作る関数
+//
+// NOTE: accessがNULLなら、デバイスが使っておらず、内容を捨ててよいリソースとする。
+static void initRenderGraphResourceState(RenderGraphResourceState *state, const RenderGraphAccess *access) {
+    memset(state, 0, sizeof(RenderGraphResourceState));
+    state->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (access == NULL || access->stageMask == 0) {
+        return;
+    }
+    if ((access->accessMask & RENDER_GRAPH_WRITE_ACCESS_MASK) != 0) {
+        state->writeStageMask = access->stageMask;
+        state->writeAccessMask = access->accessMask & RENDER_GRAPH_WRITE_ACCESS_MASK;
+    } else {
+        state->readStageMask = access->stageMask;
+    }
+    state->layout = access->layout;
+}
+
+// 最後の書込みが既にそのステージ・アクセスから見えるか判定する関数
+static int isRenderGraphAccessVisible(const RenderGraphResourceState *state, VkPipelineStageFlags stageMask, VkAccessFlags accessMask) {
+    for (uint32_t i = 0; i < state->visibleScopesCount; ++i) {
+        if ((stageMask & ~state->visibleStageMasks[i]) == 0 && (accessMask & ~state->visibleAccessMasks[i]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 最後の書込みをそのステージ・アクセスから見えるようにしたことを覚える関数
+static void markRenderGraphAccessVisible(RenderGraphResourceState *state, VkPipelineStageFlags stageMask, VkAccessFlags accessMask) {
+    if (state->visibleScopesCount >= RENDER_GRAPH_MAX_VISIBLE_SCOPES) {
+        return;
+    }
+    state->visibleStageMasks[state->visibleScopesCount] = stageMask;
+    state->visibleAccessMasks[state->visibleScopesCount] = accessMask;
+    state->visibleScopesCount += 1;
+}
+
+// リソースへのアクセスに必要なバリアをbarriersに加え、リソースの状態を進める関数
+//
+// NOTE: 危険毎に必要な依存関係は次の通り。
+//         - 書込み後の読込み: 書込みを待ち、書込みを利用可能にして読込みから見えるようにする
+//         - 読込み後の書込み: 読込みを待つ (実行の依存関係のみ)
+//         - 書込み後の書込み: 書込みを待ち、書込みを利用可能にする
+//         - 読込み後の読込み: 不要
+//       書込み後の読込みの後で書き込む場合、読込みは既に書込みを待っているため、読込みのみを待てばよい。
+//       レイアウトの遷移は書込みとみなし、前の全てのアクセスを待ってから行う。
+static void applyRenderGraphAccess(
+    const RenderGraph graph,
+    uint32_t resource,
+    RenderGraphResourceState *state,
+    const RenderGraphAccess *access,
+    int attachment,
+    RenderGraphBarriers *barriers
+) {
+    const RenderGraphResource *res = &graph->resources[resource];
+    const VkAccessFlags writeAccessMask = access->accessMask & RENDER_GRAPH_WRITE_ACCESS_MASK;
+    const VkAccessFlags readAccessMask = access->accessMask & ~RENDER_GRAPH_WRITE_ACCESS_MASK;
+    const int isWrite = attachment || writeAccessMask != 0;
+
+    // レイアウトを遷移させる
+    //
+    // NOTE: 別の一時リソースの書込みはこのイメージのバリアの範囲外であるため、グローバルなメモリバリアで利用可能にする。
+    if (res->isImage && !attachment && access->layout != VK_IMAGE_LAYOUT_UNDEFINED && access->layout != state->layout) {
+        if (barriers->imageBarriersCount < RENDER_GRAPH_MAX_RESOURCES) {
+            RenderGraphImageBarrier *b = &barriers->imageBarriers[barriers->imageBarriersCount];
+            b->resource = resource;
+            b->srcAccessMask = state->aliased ? 0 : state->writeAccessMask;
+            b->dstAccessMask = access->accessMask;
+            b->oldLayout = state->layout;
+            b->newLayout = access->layout;
+            barriers->imageBarriersCount += 1;
+        }
+        if (state->aliased && state->writeAccessMask != 0) {
+            barriers->srcAccessMask |= state->writeAccessMask;
+            barriers->dstAccessMask |= access->accessMask;
+        }
+        barriers->srcStageMask |= state->writeStageMask | state->readStageMask;
+        barriers->dstStageMask |= access->stageMask;
+        state->writeStageMask = access->stageMask;
+        state->writeAccessMask = writeAccessMask;
+        state->readStageMask = isWrite ? 0 : access->stageMask;
+        state->visibleScopesCount = 0;
+        if (!isWrite) markRenderGraphAccessVisible(state, access->stageMask, readAccessMask);
+        state->layout = access->layout;
+        state->aliased = 0;
+        return;
+    }
+
+    // 読み込む
+    if (!isWrite) {
+        if (state->writeStageMask != 0 && !isRenderGraphAccessVisible(state, access->stageMask, readAccessMask)) {
+            barriers->srcStageMask |= state->writeStageMask;
+            barriers->dstStageMask |= access->stageMask;
+            barriers->srcAccessMask |= state->writeAccessMask;
+            barriers->dstAccessMask |= readAccessMask;
+            markRenderGraphAccessVisible(state, access->stageMask, readAccessMask);
+        }
+        state->readStageMask |= access->stageMask;
+        return;
+    }
+
+    // 書き込む
+    //
+    // NOTE: 読込みと書込みを兼ねるアクセスが、まだ書込みを見ていないステージ・アクセスであれば、見えるようにする。
+    if (state->readStageMask != 0) {
+        barriers->srcStageMask |= state->readStageMask;
+        barriers->dstStageMask |= access->stageMask;
+        if (readAccessMask != 0 && state->writeStageMask != 0 && !isRenderGraphAccessVisible(state, access->stageMask, readAccessMask)) {
+            barriers->srcStageMask |= state->writeStageMask;
+            barriers->srcAccessMask |= state->writeAccessMask;
+            barriers->dstAccessMask |= readAccessMask;
+        }
+    } else if (state->writeStageMask != 0) {
+        barriers->srcStageMask |= state->writeStageMask;
+        barriers->dstStageMask |= access->stageMask;
+        barriers->srcAccessMask |= state->writeAccessMask;
+        barriers->dstAccessMask |= access->accessMask;
+    }
+    state->writeStageMask = access->stageMask;
+    state->writeAccessMask = writeAccessMask;
+    state->readStageMask = 0;
+    state->visibleScopesCount = 0;
+    if (attachment) state->layout = access->layout;
+    state->aliased = 0;
+}
+
+// 出力が使われないパスを省く関数
+//
+// NOTE: 後ろのパスから順に、内容が使われるリソースへ書き込むパスを残し、そのパスが読むリソースの内容を使われるものとする。
+//       内容が使われるのは、残したパスが読むリソースと、実行後の使い方に読込みを含む外部のリソースである。
+static void cullRenderGraphPasses(RenderGraph graph) {
+    int needed[RENDER_GRAPH_MAX_RESOURCES];
+    for (uint32_t i = 0; i < graph->resourcesCount; ++i) {
+        const RenderGraphResource *resource = &graph->resources[i];
+        needed[i] = !resource->transient && (resource->finalAccess.accessMask & ~RENDER_GRAPH_WRITE_ACCESS_MASK) != 0;
+    }
+    graph->culledPassesCount = 0;
+    for (uint32_t i = graph->passesCount; i > 0; --i) {
+        RenderGraphPass *pass = &graph->passes[i - 1];
+        int alive = pass->sideEffects;
+        for (uint32_t j = 0; j < pass->accessesCount; ++j) {
+            const RenderGraphPassAccess *a = &pass->accesses[j];
+            const int isWrite = a->attachment || (a->access.accessMask & RENDER_GRAPH_WRITE_ACCESS_MASK) != 0;
+            if (isWrite && needed[a->resource]) {
+                alive = 1;
+            }
+        }
+        pass->culled = !alive;
+        if (!alive) {
+            graph->culledPassesCount += 1;
+            continue;
+        }
+        for (uint32_t j = 0; j < pass->accessesCount; ++j) {
+            const RenderGraphPassAccess *a = &pass->accesses[j];
+            if ((a->access.accessMask & ~RENDER_GRAPH_WRITE_ACCESS_MASK) != 0) {
+                needed[a->resource] = 1;
+            }
+        }
+    }
+}
+
+// 省かれなかったパスのうち、リソース毎に最初と最後に使うパスを求める関数
+static void computeRenderGraphLifetimes(RenderGraph graph) {
+    for (uint32_t i = 0; i < graph->passesCount; ++i) {
+        const RenderGraphPass *pass = &graph->passes[i];
+        if (pass->culled) {
+            continue;
+        }
+        for (uint32_t j = 0; j < pass->accessesCount; ++j) {
+            RenderGraphResource *resource = &graph->resources[pass->accesses[j].resource];
+            if (resource->firstPass == RENDER_GRAPH_INVALID_INDEX) {
+                resource->firstPass = i;
+            }
+            resource->lastPass = i;
+        }
+    }
+}
+
+// 一時リソースを作成し、使われる期間が重ならないもの同士でデバイスメモリを共有させる関数
+//
+// NOTE: 大きい順に、メモリタイプが合い、期間が重なるリソースを持たない最初のブロックへ割り当てる。
+//       同じブロックのリソースはオフセット0で重ねるため、ブロックのサイズはその最大となる。
+static int allocateRenderGraphTransients(const VkDevice device, RenderGraph graph) {
+#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "allocateRenderGraphTransients()", (m), (p), {}, 0)
+#define CHECK(p, m)    ERROR_IF     (!(p),              "allocateRenderGraphTransients()", (m),      {}, 0)
+
+    // 使われる一時リソースを作成し、メモリ要件を取得する
+    uint32_t order[RENDER_GRAPH_MAX_RESOURCES];
+    uint32_t transientsCount = 0;
+    for (uint32_t i = 0; i < graph->resourcesCount; ++i) {
+        RenderGraphResource *resource = &graph->resources[i];
+        if (!resource->transient || resource->firstPass == RENDER_GRAPH_INVALID_INDEX) {
+            continue;
+        }
+        if (resource->isImage) {
+            const VkImageCreateInfo ci = {
+                VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                NULL,
+                0,
+                VK_IMAGE_TYPE_2D,
+                resource->format,
+                resource->extent,
+                1,
+                1,
+                resource->samples,
+                VK_IMAGE_TILING_OPTIMAL,
+                resource->imageUsage,
+                VK_SHARING_MODE_EXCLUSIVE,
+                0,
+                NULL,
+                VK_IMAGE_LAYOUT_UNDEFINED,
+            };
+            CHECK_VK(vkCreateImage(device, &ci, NULL, &resource->image), "一時イメージの作成に失敗");
+            vkGetImageMemoryRequirements(device, resource->image, &resource->memReqs);
+        } else {
+            const VkBufferCreateInfo ci = {
+                VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                NULL,
+                0,
+                resource->size,
+                resource->bufferUsage,
+                VK_SHARING_MODE_EXCLUSIVE,
+                0,
+                NULL,
+            };
+            CHECK_VK(vkCreateBuffer(device, &ci, NULL, &resource->buffer), "一時バッファの作成に失敗");
+            vkGetBufferMemoryRequirements(device, resource->buffer, &resource->memReqs);
+        }
+        graph->unaliasedTransientSize += resource->memReqs.size;
+        order[transientsCount] = i;
+        transientsCount += 1;
+    }
+
+    // 大きい順に並べる
+    for (uint32_t i = 1; i < transientsCount; ++i) {
+        const uint32_t index = order[i];
+        uint32_t j = i;
+        for (; j > 0 && graph->resources[order[j - 1]].memReqs.size < graph->resources[index].memReqs.size; --j) {
+            order[j] = order[j - 1];
+        }
+        order[j] = index;
+    }
+
+    // ブロックへ割り当てる
+    for (uint32_t i = 0; i < transientsCount; ++i) {
+        RenderGraphResource *resource = &graph->resources[order[i]];
+        uint32_t found = RENDER_GRAPH_INVALID_INDEX;
+        for (uint32_t b = 0; b < graph->blocksCount && found == RENDER_GRAPH_INVALID_INDEX; ++b) {
+            if ((graph->blocks[b].memoryTypeBits & resource->memReqs.memoryTypeBits) == 0) {
+                continue;
+            }
+            int overlapped = 0;
+            for (uint32_t j = 0; j < i; ++j) {
+                const RenderGraphResource *other = &graph->resources[order[j]];
+                if (other->blockIndex == b && other->firstPass <= resource->lastPass && resource->firstPass <= other->lastPass) {
+                    overlapped = 1;
+                    break;
+                }
+            }
+            if (!overlapped) {
+                found = b;
+            }
+        }
+        if (found == RENDER_GRAPH_INVALID_INDEX) {
+            found = graph->blocksCount;
+            graph->blocks[found].memoryTypeBits = resource->memReqs.memoryTypeBits;
+            graph->blocks[found].lastResource = order[i];
+            graph->blocksCount += 1;
+        }
+        RenderGraphMemoryBlock *block = &graph->blocks[found];
+        block->memoryTypeBits &= resource->memReqs.memoryTypeBits;
+        if (block->size < resource->memReqs.size) block->size = resource->memReqs.size;
+        if (graph->resources[block->lastResource].lastPass < resource->lastPass) block->lastResource = order[i];
+        resource->blockIndex = found;
+    }
+
+    // ブロック毎にデバイスメモリを確保し、リソースと関連付ける
+    //
+    // NOTE: オフセット0はどのアラインメントも満たす。
+    for (uint32_t b = 0; b < graph->blocksCount; ++b) {
+        RenderGraphMemoryBlock *block = &graph->blocks[b];
+        block->devMemory = allocateDeviceMemory(
+            device,
+            graph->allocator,
+            block->memoryTypeBits,
+            MEMORY_USAGE_GPU_ONLY,
+            block->size,
+            NULL,
+            &block->memTypeIndex
+        );
+        CHECK(block->devMemory != NULL, "一時リソースのためのデバイスメモリの確保に失敗");
+        graph->transientSize += block->size;
+    }
+    for (uint32_t i = 0; i < transientsCount; ++i) {
+        const RenderGraphResource *resource = &graph->resources[order[i]];
+        const VkDeviceMemory devMemory = graph->blocks[resource->blockIndex].devMemory;
+        if (resource->isImage) {
+            CHECK_VK(vkBindImageMemory(device, resource->image, devMemory, 0), "一時イメージとデバイスメモリとの関連付けに失敗");
+        } else {
+            CHECK_VK(vkBindBufferMemory(device, resource->buffer, devMemory, 0), "一時バッファとデバイスメモリとの関連付けに失敗");
+        }
+    }
+
+    return 1;
+
+#undef CHECK
+#undef CHECK_VK
+}
+
+// 一時リソースの実行前の状態を求める関数
+//
+// NOTE: 同じブロックで直前に使われたリソースの最後の状態とし、内容は捨てる。
+//       ブロックで最初に使われるリソースは、前回の実行で最後に使われたリソースの後に使われる。
+static void getRenderGraphTransientState(const RenderGraph graph, uint32_t resource, RenderGraphResourceState *state) {
+    const RenderGraphResource *res = &graph->resources[resource];
+    const RenderGraphMemoryBlock *block = &graph->blocks[res->blockIndex];
+    uint32_t prev = RENDER_GRAPH_INVALID_INDEX;
+    for (uint32_t i = 0; i < graph->resourcesCount; ++i) {
+        const RenderGraphResource *other = &graph->resources[i];
+        if (i == resource || !other->transient || other->blockIndex != res->blockIndex || other->lastPass >= res->firstPass) {
+            continue;
+        }
+        if (prev == RENDER_GRAPH_INVALID_INDEX || graph->resources[prev].lastPass < other->lastPass) {
+            prev = i;
+        }
+    }
+    if (prev == RENDER_GRAPH_INVALID_INDEX) {
+        prev = block->lastResource;
+    }
+    *state = graph->resources[prev].endState;
+    state->visibleScopesCount = 0;
+    state->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    state->aliased = prev != resource;
+}
+
+// パス毎のバリアを求める関数
+//
+// NOTE: 一時リソースの実行前の状態は他のリソースの最後の状態に依るため、一度全てのパスを辿ってから求め直す。
+static void planRenderGraphBarriers(RenderGraph graph) {
+    RenderGraphResourceState states[RENDER_GRAPH_MAX_RESOURCES];
+    for (uint32_t round = 0; round < 2; ++round) {
+        for (uint32_t i = 0; i < graph->resourcesCount; ++i) {
+            const RenderGraphResource *resource = &graph->resources[i];
+            if (!resource->transient) {
+                initRenderGraphResourceState(&states[i], &resource->initialAccess);
+            } else if (round == 0 || resource->firstPass == RENDER_GRAPH_INVALID_INDEX) {
+                initRenderGraphResourceState(&states[i], NULL);
+            } else {
+                getRenderGraphTransientState(graph, i, &states[i]);
+            }
+        }
+        for (uint32_t i = 0; i < graph->passesCount; ++i) {
+            RenderGraphPass *pass = &graph->passes[i];
+            memset(&pass->barriers, 0, sizeof(RenderGraphBarriers));
+            if (pass->culled) {
+                continue;
+            }
+            for (uint32_t j = 0; j < pass->accessesCount; ++j) {
+                const RenderGraphPassAccess *a = &pass->accesses[j];
+                applyRenderGraphAccess(graph, a->resource, &states[a->resource], &a->access, a->attachment, &pass->barriers);
+            }
+        }
+        for (uint32_t i = 0; i < graph->resourcesCount; ++i) {
+            graph->resources[i].endState = states[i];
+        }
+    }
+
+    // 外部のリソースを実行後の使い方に備える
+    memset(&graph->finalBarriers, 0, sizeof(RenderGraphBarriers));
+    for (uint32_t i = 0; i < graph->resourcesCount; ++i) {
+        const RenderGraphResource *resource = &graph->resources[i];
+        if (resource->transient || resource->firstPass == RENDER_GRAPH_INVALID_INDEX || resource->finalAccess.stageMask == 0) {
+            continue;
+        }
+        applyRenderGraphAccess(graph, i, &states[i], &resource->finalAccess, 0, &graph->finalBarriers);
+    }
+}
+
+// バリアが空か判定する関数
+static int isRenderGraphBarriersEmpty(const RenderGraphBarriers *barriers) {
+    return barriers->srcStageMask == 0 && barriers->dstStageMask == 0 && barriers->imageBarriersCount == 0;
+}
+
+int compileRenderGraph(const VkDevice device, MemoryAllocator allocator, RenderGraph graph) {
+#define CHECK(p, m) ERROR_IF(!(p), "compileRenderGraph()", (m), {}, 0)
+
+    CHECK(!graph->compiled, "既にコンパイル済み");
+    graph->compiled = 1;
+    graph->allocator = allocator;
+
+    // 出力が使われないパスを省く
+    cullRenderGraphPasses(graph);
+
+    // 一時リソースを作成し、デバイスメモリを割り当てる
+    computeRenderGraphLifetimes(graph);
+    CHECK(allocateRenderGraphTransients(device, graph), "一時リソースの作成に失敗");
+
+    // バリアを求める
+    planRenderGraphBarriers(graph);
+
+    // 結果を出力する
+    {
+        graph->barriersCount = isRenderGraphBarriersEmpty(&graph->finalBarriers) ? 0 : 1;
+        for (uint32_t i = 0; i < graph->passesCount; ++i) {
+            if (!graph->passes[i].culled && !isRenderGraphBarriersEmpty(&graph->passes[i].barriers)) {
+                graph->barriersCount += 1;
+            }
+        }
+        printf(
+            "[ info ] render-graph: %u passes (%u culled), %u barriers, transient memory %llu bytes (%llu without aliasing)\n",
+            graph->passesCount,
+            graph->culledPassesCount,
+            graph->barriersCount,
+            (unsigned long long)graph->transientSize,
+            (unsigned long long)graph->unaliasedTransientSize
+        );
+        for (uint32_t i = 0; i < graph->passesCount; ++i) {
+            if (graph->passes[i].culled) {
+                printf("[ info ] render-graph: culled pass '%s'\n", graph->passes[i].name);
+            }
+        }
+    }
+
+    return 1;
+
+#undef CHECK
+}
+
+void setRenderGraphBuffer(RenderGraph graph, uint32_t resource, VkBuffer buffer) {
+    graph->resources[resource].buffer = buffer;
+}
+
+void setRenderGraphImage(RenderGraph graph, uint32_t resource, VkImage image) {
+    graph->resources[resource].image = image;
+}
+
+// まとめたバリアを一回のvkCmdPipelineBarrier()関数で張る関数
+//
+// NOTE: 待つステージが無ければTOP_OF_PIPEから、待たせるステージが無ければBOTTOM_OF_PIPEまでとする。
+static void recordRenderGraphBarriers(const RenderGraph graph, const RenderGraphBarriers *barriers, VkCommandBuffer cmdBuffer) {
+    if (isRenderGraphBarriersEmpty(barriers)) {
+        return;
+    }
+    VkImageMemoryBarrier imageBarriers[RENDER_GRAPH_MAX_RESOURCES];
+    for (uint32_t i = 0; i < barriers->imageBarriersCount; ++i) {
+        const RenderGraphImageBarrier *b = &barriers->imageBarriers[i];
+        const RenderGraphResource *resource = &graph->resources[b->resource];
+        const VkImageMemoryBarrier barrier = {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            NULL,
+            b->srcAccessMask,
+            b->dstAccessMask,
+            b->oldLayout,
+            b->newLayout,
+            VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED,
+            resource->image,
+            { resource->aspectMask, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS },
+        };
+        imageBarriers[i] = barrier;
+    }
+    const VkMemoryBarrier memBarrier = {
+        VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        NULL,
+        barriers->srcAccessMask,
+        barriers->dstAccessMask,
+    };
+    const int hasMemBarrier = barriers->srcAccessMask != 0 || barriers->dstAccessMask != 0;
+    vkCmdPipelineBarrier(
+        cmdBuffer,
+        barriers->srcStageMask != 0 ? barriers->srcStageMask : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        barriers->dstStageMask != 0 ? barriers->dstStageMask : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0,
+        hasMemBarrier ? 1 : 0,
+        hasMemBarrier ? &memBarrier : NULL,
+        0,
+        NULL,
+        barriers->imageBarriersCount,
+        imageBarriers
+    );
+}
+
+void executeRenderGraph(const RenderGraph graph, VkCommandBuffer cmdBuffer) {
+    for (uint32_t i = 0; i < graph->passesCount; ++i) {
+        const RenderGraphPass *pass = &graph->passes[i];
+        if (pass->culled) {
+            continue;
+        }
+        recordRenderGraphBarriers(graph, &pass->barriers, cmdBuffer);
+        if (pass->record != NULL) pass->record(cmdBuffer, pass->userData);
+    }
+    recordRenderGraphBarriers(graph, &graph->finalBarriers, cmdBuffer);
+}
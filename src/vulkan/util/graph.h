@@ -0,0 +1,362 @@
+/// @file graph.h
+/// @brief パスが読み書きするリソースを宣言し、バリアとイメージレイアウトの遷移を導くレンダーグラフのモジュール
+///
+/// - パスは、どのリソースをどのステージ・アクセス・レイアウトで使うかを宣言し、コマンドの記録は関数に任せる
+/// - コンパイル時に次を行う
+///   1. 出力がどこからも使われないパスを省く
+///   2. 一時リソースを作成し、使われる期間が重ならないもの同士で同じデバイスメモリを共有させる
+///   3. パス毎に、前のアクセスとの危険(書込み後の読込み・読込み後の書込み・書込み後の書込み)を解消するバリアを求める
+/// - 実行時は、パスを宣言した順に、求めたバリアを一回のvkCmdPipelineBarrier()関数にまとめて張ってから記録関数を呼ぶ
+///
+/// パスは宣言した順に実行するため、依存するパスより後に宣言すること。
+/// コンパイル結果は変わらないため、一度コンパイルしたグラフは毎フレーム実行できる。
+/// 外部のリソースのハンドルは、実行の前に差し替えられる。
+///
+/// 使い方:
+/// ```
+/// RenderGraph graph = createRenderGraph();
+/// uint32_t image = addRenderGraphImage(graph, "color", vkImage, VK_IMAGE_ASPECT_COLOR_BIT, &initial, &final);
+/// uint32_t pass = addRenderGraphPass(graph, "copy", recordCopy, userData, 0);
+/// addRenderGraphAccess(graph, pass, image, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+/// compileRenderGraph(device, allocator, graph);
+/// // コマンドバッファの記録中に
+/// executeRenderGraph(graph, cmdBuffer);
+/// ```
+
+#pragma once
+
+#include "memory/allocator.h"
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+/// @brief 一つのグラフが持てるリソースの最大数
+#define RENDER_GRAPH_MAX_RESOURCES 16
+
+/// @brief 一つのグラフが持てるパスの最大数
+#define RENDER_GRAPH_MAX_PASSES 16
+
+/// @brief 一つのパスが宣言できるアクセスの最大数
+#define RENDER_GRAPH_MAX_PASS_ACCESSES 8
+
+/// @brief 書込み後に、どのステージのどのアクセスから見えるようにしたかを覚えておく最大数
+///
+/// NOTE: これを超えた分は覚えず、同じアクセスでも再びバリアを張る。
+#define RENDER_GRAPH_MAX_VISIBLE_SCOPES 4
+
+/// @brief リソースやパスのインデックスとして無効な値
+#define RENDER_GRAPH_INVALID_INDEX UINT32_MAX
+
+/// @brief パスのコマンドを記録する関数の型
+/// @param cmdBuffer 記録中のコマンドバッファ
+/// @param userData パスの宣言時に与えたデータ
+typedef void (*RenderGraphRecordCallback)(VkCommandBuffer cmdBuffer, void *userData);
+
+/// @brief リソースの使い方
+typedef struct RenderGraphAccess_t {
+    VkPipelineStageFlags stageMask;
+    VkAccessFlags accessMask;
+    // イメージのレイアウト (バッファならVK_IMAGE_LAYOUT_UNDEFINED)
+    VkImageLayout layout;
+} RenderGraphAccess;
+
+/// @brief パスが宣言したアクセス
+typedef struct RenderGraphPassAccess_t {
+    uint32_t resource;
+    RenderGraphAccess access;
+    // レンダーパスのアタッチメントであれば1
+    //
+    // NOTE: レンダーパスが初期レイアウトVK_IMAGE_LAYOUT_UNDEFINEDから遷移させるため、パスの前には遷移させない。
+    //       パスの後のレイアウトはaccess.layoutとなる。
+    int attachment;
+} RenderGraphPassAccess;
+
+/// @brief リソースの状態
+///
+/// NOTE: 最後の書込みと、それ以降の読込みを覚える。
+///       書込み後の読込みは、既にバリアで見えるようにしたステージ・アクセスであれば再びバリアを張らない。
+typedef struct RenderGraphResourceState_t {
+    VkPipelineStageFlags writeStageMask;
+    VkAccessFlags writeAccessMask;
+    VkPipelineStageFlags readStageMask;
+    // 最後の書込みを見えるようにしたステージとアクセスの組
+    uint32_t visibleScopesCount;
+    VkPipelineStageFlags visibleStageMasks[RENDER_GRAPH_MAX_VISIBLE_SCOPES];
+    VkAccessFlags visibleAccessMasks[RENDER_GRAPH_MAX_VISIBLE_SCOPES];
+    VkImageLayout layout;
+    // 書込みがデバイスメモリを共有する別の一時リソースへのものであれば1
+    int aliased;
+} RenderGraphResourceState;
+
+/// @brief レンダーグラフのリソース
+typedef struct RenderGraphResource_t {
+    // 名前 (文字列リテラル)
+    const char *name;
+    // イメージであれば1、バッファであれば0
+    int isImage;
+    // グラフが作成する一時リソースであれば1
+    int transient;
+    VkBuffer buffer;
+    VkImage image;
+    VkImageAspectFlags aspectMask;
+    // 外部のリソースの、グラフの実行前と実行後の使い方
+    //
+    // NOTE: 実行後の使い方のstageMaskが0であれば、実行後のバリアを張らない。
+    RenderGraphAccess initialAccess;
+    RenderGraphAccess finalAccess;
+    // 一時リソースの作成情報
+    VkDeviceSize size;
+    VkBufferUsageFlags bufferUsage;
+    VkFormat format;
+    VkExtent3D extent;
+    VkImageUsageFlags imageUsage;
+    VkSampleCountFlagBits samples;
+    // 一時リソースのメモリ要件と、割り当てたメモリブロックのインデックス
+    VkMemoryRequirements memReqs;
+    uint32_t blockIndex;
+    // 省かれなかったパスのうち、最初と最後に使うパスのインデックス (どのパスも使わなければfirstPassがRENDER_GRAPH_INVALID_INDEX)
+    uint32_t firstPass;
+    uint32_t lastPass;
+    // 最後に使ったパスの後の状態
+    RenderGraphResourceState endState;
+} RenderGraphResource;
+
+/// @brief イメージレイアウトの遷移を伴うバリア
+typedef struct RenderGraphImageBarrier_t {
+    uint32_t resource;
+    VkAccessFlags srcAccessMask;
+    VkAccessFlags dstAccessMask;
+    VkImageLayout oldLayout;
+    VkImageLayout newLayout;
+} RenderGraphImageBarrier;
+
+/// @brief 一回のvkCmdPipelineBarrier()関数にまとめるバリア
+///
+/// NOTE: レイアウトを遷移させないアクセスの依存関係は、一つのグローバルなメモリバリアにまとめる。
+typedef struct RenderGraphBarriers_t {
+    VkPipelineStageFlags srcStageMask;
+    VkPipelineStageFlags dstStageMask;
+    VkAccessFlags srcAccessMask;
+    VkAccessFlags dstAccessMask;
+    uint32_t imageBarriersCount;
+    RenderGraphImageBarrier imageBarriers[RENDER_GRAPH_MAX_RESOURCES];
+} RenderGraphBarriers;
+
+/// @brief レンダーグラフのパス
+typedef struct RenderGraphPass_t {
+    // 名前 (文字列リテラル)
+    const char *name;
+    RenderGraphRecordCallback record;
+    void *userData;
+    // 宣言したリソース以外にも結果を残す(レンダーパスでスワップチェーンに描画する等)ならば1 (省かれない)
+    int sideEffects;
+    uint32_t accessesCount;
+    RenderGraphPassAccess accesses[RENDER_GRAPH_MAX_PASS_ACCESSES];
+    // 出力が使われないため省かれたならば1
+    int culled;
+    // パスの前に張るバリア
+    RenderGraphBarriers barriers;
+} RenderGraphPass;
+
+/// @brief 一時リソースが共有するデバイスメモリ
+typedef struct RenderGraphMemoryBlock_t {
+    VkDeviceMemory devMemory;
+    uint32_t memTypeIndex;
+    VkDeviceSize size;
+    uint32_t memoryTypeBits;
+    // このブロックを使うリソースのうち、最後に使われるもの
+    uint32_t lastResource;
+} RenderGraphMemoryBlock;
+
+/// @brief レンダーグラフのオブジェクトを持つ構造体
+typedef struct RenderGraph_t {
+    uint32_t resourcesCount;
+    RenderGraphResource resources[RENDER_GRAPH_MAX_RESOURCES];
+    uint32_t passesCount;
+    RenderGraphPass passes[RENDER_GRAPH_MAX_PASSES];
+    // 全てのパスの後に張る、外部のリソースを実行後の使い方に備えるバリア
+    RenderGraphBarriers finalBarriers;
+    int compiled;
+    MemoryAllocator allocator;
+    uint32_t blocksCount;
+    RenderGraphMemoryBlock blocks[RENDER_GRAPH_MAX_RESOURCES];
+    // コンパイル結果の統計
+    uint32_t culledPassesCount;
+    uint32_t barriersCount;
+    VkDeviceSize transientSize;
+    VkDeviceSize unaliasedTransientSize;
+} *RenderGraph;
+
+/// @brief RenderGraphを破棄する関数
+///
+/// デバイスが一時リソースを使い終わってから呼ぶこと。
+///
+/// @param device 論理デバイス
+/// @param graph レンダーグラフオブジェクトハンドル
+void deleteRenderGraph(const VkDevice device, RenderGraph graph);
+
+/// @brief RenderGraphを作成する関数
+/// @returns 失敗時にNULLを返す。
+RenderGraph createRenderGraph(void);
+
+/// @brief 外部のバッファをグラフに加える関数
+///
+/// 実行後の使い方のaccessMaskに読込みを含めば、内容が実行後に使われるとみなし、書き込むパスを省かない。
+///
+/// @param graph レンダーグラフオブジェクトハンドル
+/// @param name 名前 (文字列リテラル)
+/// @param buffer バッファ (実行前にsetRenderGraphBuffer()関数で差し替えてもよい)
+/// @param initialAccess グラフの実行前の使い方 (NULLなら、実行前にデバイスは使っていないとみなす)
+/// @param finalAccess グラフの実行後の使い方 (NULLなら、実行後のバリアを張らない)
+/// @returns 失敗時にRENDER_GRAPH_INVALID_INDEXを返す。
+uint32_t addRenderGraphBuffer(
+    RenderGraph graph,
+    const char *name,
+    VkBuffer buffer,
+    const RenderGraphAccess *initialAccess,
+    const RenderGraphAccess *finalAccess
+);
+
+/// @brief 外部のイメージをグラフに加える関数
+///
+/// 全てのミップレベルと配列レイヤーを一つのリソースとして扱う。
+/// 実行後の使い方のaccessMaskに読込みを含めば、内容が実行後に使われるとみなし、書き込むパスを省かない。
+/// 実行後の使い方のレイアウトがVK_IMAGE_LAYOUT_UNDEFINEDであれば、実行後にレイアウトを遷移させない。
+///
+/// @param graph レンダーグラフオブジェクトハンドル
+/// @param name 名前 (文字列リテラル)
+/// @param image イメージ (実行前にsetRenderGraphImage()関数で差し替えてもよい)
+/// @param aspectMask イメージのアスペクト
+/// @param initialAccess グラフの実行前の使い方とレイアウト (NULLなら、内容を捨ててよいとみなす)
+/// @param finalAccess グラフの実行後の使い方とレイアウト (NULLなら、実行後のバリアを張らない)
+/// @returns 失敗時にRENDER_GRAPH_INVALID_INDEXを返す。
+uint32_t addRenderGraphImage(
+    RenderGraph graph,
+    const char *name,
+    VkImage image,
+    VkImageAspectFlags aspectMask,
+    const RenderGraphAccess *initialAccess,
+    const RenderGraphAccess *finalAccess
+);
+
+/// @brief グラフが作成する一時バッファを加える関数
+///
+/// 内容はグラフの実行を跨いで保たれない。
+///
+/// @param graph レンダーグラフオブジェクトハンドル
+/// @param name 名前 (文字列リテラル)
+/// @param size バッファのサイズ
+/// @param usage バッファの使用方法
+/// @returns 失敗時にRENDER_GRAPH_INVALID_INDEXを返す。
+uint32_t addRenderGraphTransientBuffer(RenderGraph graph, const char *name, VkDeviceSize size, VkBufferUsageFlags usage);
+
+/// @brief グラフが作成する一時イメージを加える関数
+///
+/// ミップレベルと配列レイヤーが一つの二次元イメージを作成する。
+/// 内容はグラフの実行を跨いで保たれない。
+///
+/// @param graph レンダーグラフオブジェクトハンドル
+/// @param name 名前 (文字列リテラル)
+/// @param format ピクセルフォーマット
+/// @param width 幅
+/// @param height 高
+/// @param usage イメージの使用方法
+/// @param samples サンプル数
+/// @param aspectMask イメージのアスペクト
+/// @returns 失敗時にRENDER_GRAPH_INVALID_INDEXを返す。
+uint32_t addRenderGraphTransientImage(
+    RenderGraph graph,
+    const char *name,
+    VkFormat format,
+    uint32_t width,
+    uint32_t height,
+    VkImageUsageFlags usage,
+    VkSampleCountFlagBits samples,
+    VkImageAspectFlags aspectMask
+);
+
+/// @brief パスを加える関数
+/// @param graph レンダーグラフオブジェクトハンドル
+/// @param name 名前 (文字列リテラル)
+/// @param record パスのコマンドを記録する関数
+/// @param userData recordに渡されるデータ
+/// @param sideEffects 宣言したリソース以外にも結果を残すならば1 (出力が使われなくても省かない)
+/// @returns 失敗時にRENDER_GRAPH_INVALID_INDEXを返す。
+uint32_t addRenderGraphPass(RenderGraph graph, const char *name, RenderGraphRecordCallback record, void *userData, int sideEffects);
+
+/// @brief パスがリソースを使うことを宣言する関数
+///
+/// accessMaskに書込みのアクセスを含めば書込み、そうでなければ読込みとみなす。
+/// イメージのレイアウトがVK_IMAGE_LAYOUT_UNDEFINEDであれば、レイアウトを遷移させずに依存関係のみを張る。
+/// 同じリソースを一つのパスで複数回宣言する場合は、同じレイアウトとすること。
+///
+/// @param graph レンダーグラフオブジェクトハンドル
+/// @param pass パスのインデックス
+/// @param resource リソースのインデックス
+/// @param stageMask リソースを使うパイプラインステージ
+/// @param accessMask リソースへのアクセス
+/// @param layout イメージのレイアウト (バッファならVK_IMAGE_LAYOUT_UNDEFINED)
+/// @returns 失敗時に0を返す。
+int addRenderGraphAccess(
+    RenderGraph graph,
+    uint32_t pass,
+    uint32_t resource,
+    VkPipelineStageFlags stageMask,
+    VkAccessFlags accessMask,
+    VkImageLayout layout
+);
+
+/// @brief パスがイメージをレンダーパスのアタッチメントとして書き込むことを宣言する関数
+///
+/// レンダーパスはアタッチメントを初期レイアウトVK_IMAGE_LAYOUT_UNDEFINEDでクリアし、最終レイアウトへ遷移させること。
+/// そのため、パスの前にはレイアウトを遷移させず、前のアクセスとの依存関係のみを張る。
+/// レンダーパスのVK_SUBPASS_EXTERNALからの依存関係は、stageMaskを始点に含むこと (レイアウトの遷移をバリアの後に行わせるため)。
+///
+/// @param graph レンダーグラフオブジェクトハンドル
+/// @param pass パスのインデックス
+/// @param resource イメージのリソースのインデックス
+/// @param stageMask アタッチメントを使うパイプラインステージ
+/// @param accessMask アタッチメントへのアクセス
+/// @param finalLayout レンダーパスの最終レイアウト
+/// @returns 失敗時に0を返す。
+int addRenderGraphAttachment(
+    RenderGraph graph,
+    uint32_t pass,
+    uint32_t resource,
+    VkPipelineStageFlags stageMask,
+    VkAccessFlags accessMask,
+    VkImageLayout finalLayout
+);
+
+/// @brief グラフをコンパイルする関数
+///
+/// 出力が使われないパスを省き、一時リソースを作成してデバイスメモリを割り当て、パス毎のバリアを求める。
+/// 結果は標準出力に出力する。
+/// 一度コンパイルしたグラフには、リソースもパスも加えられない。
+///
+/// @param device 論理デバイス
+/// @param allocator メモリ集計オブジェクトハンドル
+/// @param graph レンダーグラフオブジェクトハンドル
+/// @returns 失敗時に0を返す。
+int compileRenderGraph(const VkDevice device, MemoryAllocator allocator, RenderGraph graph);
+
+/// @brief 外部のバッファを差し替える関数
+/// @param graph レンダーグラフオブジェクトハンドル
+/// @param resource バッファのリソースのインデックス
+/// @param buffer バッファ
+void setRenderGraphBuffer(RenderGraph graph, uint32_t resource, VkBuffer buffer);
+
+/// @brief 外部のイメージを差し替える関数
+/// @param graph レンダーグラフオブジェクトハンドル
+/// @param resource イメージのリソースのインデックス
+/// @param image イメージ
+void setRenderGraphImage(RenderGraph graph, uint32_t resource, VkImage image);
+
+/// @brief コンパイルしたグラフのコマンドを記録する関数
+///
+/// 省かれなかったパスを宣言した順に、バリアを張ってから記録関数を呼ぶ。
+/// 最後に、外部のリソースを実行後の使い方に備えるバリアを張る。
+///
+/// @param graph コンパイルしたレンダーグラフオブジェクトハンドル
+/// @param cmdBuffer 記録中のコマンドバッファ (レンダーパスの外であること)
+void executeRenderGraph(const RenderGraph graph, VkCommandBuffer cmdBuffer);
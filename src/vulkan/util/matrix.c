@@ -0,0 +1,88 @@
+#include "matrix.h"
+
+#include <math.h>
+#include <string.h>
+
+void setIdentityMatrix(float m[16]) {
+    memset(m, 0, sizeof(float) * 16);
+    m[0] = 1.0f;
+    m[5] = 1.0f;
+    m[10] = 1.0f;
+    m[15] = 1.0f;
+}
+
+void multiplyMatrix(float out[16], const float a[16], const float b[16]) {
+    float r[16];
+    for (int col = 0; col < 4; ++col) {
+        for (int row = 0; row < 4; ++row) {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; ++k) {
+                sum += a[k * 4 + row] * b[col * 4 + k];
+            }
+            r[col * 4 + row] = sum;
+        }
+    }
+    memcpy(out, r, sizeof(r));
+}
+
+// NOTE: ビュー空間では-z方向を向く。
+//       Vulkanのクリップ空間はyが下向きであるため、y軸を反転させる。
+//       深度は近クリップ面で0、遠クリップ面で1となる。
+void setPerspectiveMatrix(float m[16], float fovY, float aspect, float nearZ, float farZ) {
+    const float f = 1.0f / tanf(fovY * 0.5f);
+    memset(m, 0, sizeof(float) * 16);
+    m[0] = f / aspect;
+    m[5] = -f;
+    m[10] = farZ / (nearZ - farZ);
+    m[11] = -1.0f;
+    m[14] = nearZ * farZ / (nearZ - farZ);
+}
+
+void setLookAtMatrix(float m[16], const float eye[3], const float target[3], const float up[3]) {
+    // 前方向
+    float f[3] = { target[0] - eye[0], target[1] - eye[1], target[2] - eye[2] };
+    const float fl = sqrtf(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+    f[0] /= fl;
+    f[1] /= fl;
+    f[2] /= fl;
+    // 右方向
+    float s[3] = { f[1] * up[2] - f[2] * up[1], f[2] * up[0] - f[0] * up[2], f[0] * up[1] - f[1] * up[0] };
+    const float sl = sqrtf(s[0] * s[0] + s[1] * s[1] + s[2] * s[2]);
+    s[0] /= sl;
+    s[1] /= sl;
+    s[2] /= sl;
+    // 上方向
+    const float u[3] = { s[1] * f[2] - s[2] * f[1], s[2] * f[0] - s[0] * f[2], s[0] * f[1] - s[1] * f[0] };
+
+    m[0] = s[0];
+    m[1] = u[0];
+    m[2] = -f[0];
+    m[3] = 0.0f;
+    m[4] = s[1];
+    m[5] = u[1];
+    m[6] = -f[1];
+    m[7] = 0.0f;
+    m[8] = s[2];
+    m[9] = u[2];
+    m[10] = -f[2];
+    m[11] = 0.0f;
+    m[12] = -(s[0] * eye[0] + s[1] * eye[1] + s[2] * eye[2]);
+    m[13] = -(u[0] * eye[0] + u[1] * eye[1] + u[2] * eye[2]);
+    m[14] = f[0] * eye[0] + f[1] * eye[1] + f[2] * eye[2];
+    m[15] = 1.0f;
+}
+
+void setTransformMatrix(float m[16], const float translation[3], float angleZ, float scale) {
+    const float c = cosf(angleZ) * scale;
+    const float s = sinf(angleZ) * scale;
+    memset(m, 0, sizeof(float) * 16);
+    m[0] = c;
+    m[1] = s;
+    m[4] = -s;
+    m[5] = c;
+    m[10] = scale;
+    m[12] = translation[0];
+    m[13] = translation[1];
+    m[14] = translation[2];
+    m[15] = 1.0f;
+}
@@ -0,0 +1,40 @@
+/// @file matrix.h
+/// @brief 4x4行列の計算に関するユーティリティを定義するモジュール
+///
+/// 行列はGLSLのmat4と同じく列優先でfloat[16]に格納する。
+/// すなわち、i列j行の要素はm[i * 4 + j]にある。
+/// 座標系は右手系とし、クリップ空間はVulkanに合わせてyが下向き・深度が0から1とする。
+
+#pragma once
+
+/// @brief 単位行列を作る関数
+/// @param m 格納先
+void setIdentityMatrix(float m[16]);
+
+/// @brief 行列の積a * bを求める関数
+/// @param out 格納先 (a・bと同じでもよい)
+/// @param a 左の行列
+/// @param b 右の行列
+void multiplyMatrix(float out[16], const float a[16], const float b[16]);
+
+/// @brief 透視投影行列を作る関数
+/// @param m 格納先
+/// @param fovY 垂直方向の視野角(rad)
+/// @param aspect アスペクト比(幅 / 高)
+/// @param nearZ 近クリップ面までの距離
+/// @param farZ 遠クリップ面までの距離
+void setPerspectiveMatrix(float m[16], float fovY, float aspect, float nearZ, float farZ);
+
+/// @brief ビュー行列を作る関数
+/// @param m 格納先
+/// @param eye 視点
+/// @param target 注視点
+/// @param up 上方向
+void setLookAtMatrix(float m[16], const float eye[3], const float target[3], const float up[3]);
+
+/// @brief 拡大・z軸周りの回転・平行移動をこの順に行うモデル行列を作る関数
+/// @param m 格納先
+/// @param translation 平行移動
+/// @param angleZ z軸周りの回転角(rad)
+/// @param scale 一様な拡大率
+void setTransformMatrix(float m[16], const float translation[3], float angleZ, float scale);
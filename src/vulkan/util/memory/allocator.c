@@ -0,0 +1,198 @@
+#include "allocator.h"
+
+#include "../error.h"
+#include "../timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIB(s) ((double)(s) / (1024.0 * 1024.0))
+
+void deleteMemoryAllocator(MemoryAllocator allocator) {
+    if (allocator == NULL) {
+        return;
+    }
+    free((void *)allocator);
+}
+
+MemoryAllocator createMemoryAllocator(
+    const VkPhysicalDevice physDevice,
+    const VkPhysicalDeviceMemoryProperties *physDevMemProps,
+    int budgetSupported,
+    int dedicatedAllocationSupported,
+    PFN_vkGetBufferDeviceAddress getBufferDeviceAddress
+) {
+#define CHECK(p, m) ERROR_IF(!(p), "createMemoryAllocator()", (m), deleteMemoryAllocator(allocator), NULL)
+
+    const MemoryAllocator allocator = (MemoryAllocator)malloc(sizeof(struct MemoryAllocator_t));
+    CHECK(allocator != NULL, "MemoryAllocatorの確保に失敗");
+    memset(allocator, 0, sizeof(struct MemoryAllocator_t));
+
+    allocator->physDevice = physDevice;
+    allocator->memProps = *physDevMemProps;
+    allocator->budgetSupported = budgetSupported;
+    allocator->dedicatedAllocationSupported = dedicatedAllocationSupported;
+    allocator->getBufferDeviceAddress = getBufferDeviceAddress;
+    allocator->lastDumpTime = getTimeNs();
+
+    updateMemoryBudget(allocator);
+
+    return allocator;
+
+#undef CHECK
+}
+
+void updateMemoryBudget(MemoryAllocator allocator) {
+    // VK_EXT_memory_budgetが無効な場合はヒープサイズの8割を予算とみなす
+    //
+    // NOTE: ヒープサイズ全てを使えることはまずない。
+    //       他のプロセスやドライバ自身も同じヒープを使うためである。
+    if (!allocator->budgetSupported) {
+        for (uint32_t i = 0; i < allocator->memProps.memoryHeapCount; ++i) {
+            allocator->heapBudget[i] = allocator->memProps.memoryHeaps[i].size / 10 * 8;
+        }
+        return;
+    }
+
+    // ドライバから予算と使用量を取得する
+    //
+    // NOTE: 予算はシステム全体の状況に応じて変動する。
+    //       そのため、確保の直前に取得し直すのが望ましい。
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProps;
+    memset(&budgetProps, 0, sizeof(VkPhysicalDeviceMemoryBudgetPropertiesEXT));
+    budgetProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2 memProps2;
+    memset(&memProps2, 0, sizeof(VkPhysicalDeviceMemoryProperties2));
+    memProps2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    memProps2.pNext = (void *)&budgetProps;
+    vkGetPhysicalDeviceMemoryProperties2(allocator->physDevice, &memProps2);
+
+    for (uint32_t i = 0; i < allocator->memProps.memoryHeapCount; ++i) {
+        allocator->heapBudget[i] = budgetProps.heapBudget[i];
+        allocator->heapUsageByDriver[i] = budgetProps.heapUsage[i];
+    }
+}
+
+VkDeviceSize getAvailableMemoryInHeap(const MemoryAllocator allocator, uint32_t heapIndex) {
+    // NOTE: ドライバの報告する使用量には、このアプリケーション以外の確保やアラインメントによる余白も含まれうる。
+    //       逆に、最後に予算を取得した後の確保は含まれない。
+    //       そのため、両者のうち大きい方を使用量とみなす。
+    VkDeviceSize usage = allocator->heapUsage[heapIndex];
+    if (allocator->heapUsageByDriver[heapIndex] > usage) {
+        usage = allocator->heapUsageByDriver[heapIndex];
+    }
+    if (usage >= allocator->heapBudget[heapIndex]) {
+        return 0;
+    }
+    return allocator->heapBudget[heapIndex] - usage;
+}
+
+int registerMemoryPressureCallback(MemoryAllocator allocator, MemoryPressureCallback callback, void *userData) {
+    ERROR_IF(
+        allocator->pressureCallbacksCount >= MEMORY_PRESSURE_CALLBACKS_MAX,
+        "registerMemoryPressureCallback()",
+        "登録できるコールバックの数を超過",
+        {},
+        0
+    );
+    allocator->pressureCallbacks[allocator->pressureCallbacksCount] = callback;
+    allocator->pressureUserData[allocator->pressureCallbacksCount] = userData;
+    allocator->pressureCallbacksCount += 1;
+    return 1;
+}
+
+void unregisterMemoryPressureCallback(MemoryAllocator allocator, MemoryPressureCallback callback, void *userData) {
+    for (uint32_t i = 0; i < allocator->pressureCallbacksCount; ++i) {
+        if (allocator->pressureCallbacks[i] != callback || allocator->pressureUserData[i] != userData) {
+            continue;
+        }
+        for (uint32_t j = i + 1; j < allocator->pressureCallbacksCount; ++j) {
+            allocator->pressureCallbacks[j - 1] = allocator->pressureCallbacks[j];
+            allocator->pressureUserData[j - 1] = allocator->pressureUserData[j];
+        }
+        allocator->pressureCallbacksCount -= 1;
+        return;
+    }
+}
+
+VkDeviceSize releaseMemoryUnderPressure(MemoryAllocator allocator, uint32_t heapIndex, VkDeviceSize requiredSize) {
+    VkDeviceSize released = 0;
+    for (uint32_t i = 0; i < allocator->pressureCallbacksCount && released < requiredSize; ++i) {
+        released += allocator->pressureCallbacks[i](allocator->pressureUserData[i], heapIndex, requiredSize - released);
+    }
+    allocator->totalEvictedSize += released;
+    if (released > 0) {
+        printf("[ info ] releaseMemoryUnderPressure(): ヒープ%uから%.2fMiBを解放\n", heapIndex, MIB(released));
+    }
+    return released;
+}
+
+void recordDeviceMemoryAllocation(MemoryAllocator allocator, uint32_t memTypeIndex, VkDeviceSize size) {
+    const uint32_t heapIndex = allocator->memProps.memoryTypes[memTypeIndex].heapIndex;
+    allocator->heapUsage[heapIndex] += size;
+    if (allocator->heapUsage[heapIndex] > allocator->heapPeakUsage[heapIndex]) {
+        allocator->heapPeakUsage[heapIndex] = allocator->heapUsage[heapIndex];
+    }
+    allocator->typeUsage[memTypeIndex] += size;
+    allocator->typeAllocsCount[memTypeIndex] += 1;
+    allocator->totalAllocsCount += 1;
+}
+
+void recordDeviceMemoryFree(MemoryAllocator allocator, uint32_t memTypeIndex, VkDeviceSize size) {
+    const uint32_t heapIndex = allocator->memProps.memoryTypes[memTypeIndex].heapIndex;
+    allocator->heapUsage[heapIndex] -= size;
+    allocator->typeUsage[memTypeIndex] -= size;
+    allocator->typeAllocsCount[memTypeIndex] -= 1;
+    allocator->totalFreesCount += 1;
+}
+
+void printMemoryStats(MemoryAllocator allocator) {
+    updateMemoryBudget(allocator);
+
+    printf(
+        "[ info ] memory: budget=%s allocs=%llu frees=%llu failed=%llu fallback=%llu over-budget=%llu dedicated=%llu evicted=%.2fMiB\n",
+        allocator->budgetSupported ? "VK_EXT_memory_budget" : "estimated",
+        (unsigned long long)allocator->totalAllocsCount,
+        (unsigned long long)allocator->totalFreesCount,
+        (unsigned long long)allocator->failedAllocsCount,
+        (unsigned long long)allocator->fallbackAllocsCount,
+        (unsigned long long)allocator->overBudgetAllocsCount,
+        (unsigned long long)allocator->dedicatedAllocsCount,
+        MIB(allocator->totalEvictedSize)
+    );
+    for (uint32_t i = 0; i < allocator->memProps.memoryHeapCount; ++i) {
+        printf(
+            "[ info ] memory: heap[%u]%s usage=%.2fMiB peak=%.2fMiB driver-usage=%.2fMiB budget=%.2fMiB size=%.2fMiB\n",
+            i,
+            (allocator->memProps.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "(device-local)" : "",
+            MIB(allocator->heapUsage[i]),
+            MIB(allocator->heapPeakUsage[i]),
+            MIB(allocator->heapUsageByDriver[i]),
+            MIB(allocator->heapBudget[i]),
+            MIB(allocator->memProps.memoryHeaps[i].size)
+        );
+    }
+    for (uint32_t i = 0; i < allocator->memProps.memoryTypeCount; ++i) {
+        if (allocator->typeAllocsCount[i] == 0) {
+            continue;
+        }
+        printf(
+            "[ info ] memory: type[%u] heap=%u flags=0x%02x allocs=%u usage=%.2fMiB\n",
+            i,
+            allocator->memProps.memoryTypes[i].heapIndex,
+            (unsigned int)allocator->memProps.memoryTypes[i].propertyFlags,
+            allocator->typeAllocsCount[i],
+            MIB(allocator->typeUsage[i])
+        );
+    }
+}
+
+void dumpMemoryStatsPeriodically(MemoryAllocator allocator, uint32_t intervalMs) {
+    const uint64_t now = getTimeNs();
+    if (now - allocator->lastDumpTime < (uint64_t)intervalMs * 1000000ULL) {
+        return;
+    }
+    allocator->lastDumpTime = now;
+    printMemoryStats(allocator);
+}
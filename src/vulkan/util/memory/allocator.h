@@ -0,0 +1,139 @@
+/// @file allocator.h
+/// @brief デバイスメモリの確保量を追跡し予算を管理するモジュール
+///
+/// 確保されたデバイスメモリをヒープ毎・メモリタイプ毎に集計する。
+/// VK_EXT_memory_budgetが有効であれば、ドライバの報告する予算と使用量も取得する。
+///
+/// @warning スレッドセーフではない。デバイスメモリの確保・解放は一つのスレッドから行うこと。
+
+#pragma once
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+/// @brief 登録できるメモリ逼迫時コールバックの最大数
+#define MEMORY_PRESSURE_CALLBACKS_MAX 8
+
+/// @brief メモリ逼迫時に呼ばれるコールバック関数の型
+///
+/// キャッシュ等を持つモジュールが登録し、不要なデバイスメモリを解放するために用いる。
+///
+/// @param userData 登録時に与えたデータ
+/// @param heapIndex 逼迫しているヒープのインデックス
+/// @param requiredSize 確保しようとしているサイズ
+/// @returns 解放したサイズを返す。何も解放できなかった場合は0を返す。
+typedef VkDeviceSize (*MemoryPressureCallback)(void *userData, uint32_t heapIndex, VkDeviceSize requiredSize);
+
+/// @brief デバイスメモリの集計情報を持つ構造体
+typedef struct MemoryAllocator_t {
+    VkPhysicalDevice physDevice;
+    VkPhysicalDeviceMemoryProperties memProps;
+    int budgetSupported;
+    // 専用のデバイスメモリの要否を問い合わせ、専用に確保できるか (物理デバイスがVulkan 1.1以降ならば1)
+    //
+    // NOTE: vkGet*MemoryRequirements2()関数とVkMemoryDedicatedAllocateInfoはVulkan 1.1でコアに昇格したため、
+    //       それ以前の物理デバイスでは使わず、常に共有の確保とする。
+    int dedicatedAllocationSupported;
+    // バッファデバイスアドレスを取得する関数 (バッファデバイスアドレスが無効ならNULL)
+    PFN_vkGetBufferDeviceAddress getBufferDeviceAddress;
+    // ヒープ毎の予算
+    VkDeviceSize heapBudget[VK_MAX_MEMORY_HEAPS];
+    // ヒープ毎のドライバが報告する使用量 (VK_EXT_memory_budgetが無効なら0)
+    VkDeviceSize heapUsageByDriver[VK_MAX_MEMORY_HEAPS];
+    // ヒープ毎のこのアプリケーションが確保した量
+    VkDeviceSize heapUsage[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize heapPeakUsage[VK_MAX_MEMORY_HEAPS];
+    // メモリタイプ毎のこのアプリケーションが確保した量と個数
+    VkDeviceSize typeUsage[VK_MAX_MEMORY_TYPES];
+    uint32_t typeAllocsCount[VK_MAX_MEMORY_TYPES];
+    // 累計
+    uint64_t totalAllocsCount;
+    uint64_t totalFreesCount;
+    uint64_t failedAllocsCount;
+    uint64_t fallbackAllocsCount;
+    uint64_t overBudgetAllocsCount;
+    uint64_t dedicatedAllocsCount;
+    VkDeviceSize totalEvictedSize;
+    // メモリ逼迫時コールバック
+    uint32_t pressureCallbacksCount;
+    MemoryPressureCallback pressureCallbacks[MEMORY_PRESSURE_CALLBACKS_MAX];
+    void *pressureUserData[MEMORY_PRESSURE_CALLBACKS_MAX];
+    // 最後に統計情報を出力した時刻
+    uint64_t lastDumpTime;
+} *MemoryAllocator;
+
+/// @brief MemoryAllocatorを破棄する関数
+/// @param allocator メモリ集計オブジェクトハンドル
+void deleteMemoryAllocator(MemoryAllocator allocator);
+
+/// @brief MemoryAllocatorを作成する関数
+/// @param physDevice 物理デバイス
+/// @param physDevMemProps 物理デバイス上のメモリプロパティ
+/// @param budgetSupported 論理デバイスでVK_EXT_memory_budgetが有効で、物理デバイスがVulkan 1.1以降ならば1
+/// @param dedicatedAllocationSupported 物理デバイスがVulkan 1.1以降ならば1
+/// @param getBufferDeviceAddress バッファデバイスアドレスを取得する関数 (バッファデバイスアドレスが無効ならNULL)
+/// @returns 失敗時にNULLを返す。
+MemoryAllocator createMemoryAllocator(
+    const VkPhysicalDevice physDevice,
+    const VkPhysicalDeviceMemoryProperties *physDevMemProps,
+    int budgetSupported,
+    int dedicatedAllocationSupported,
+    PFN_vkGetBufferDeviceAddress getBufferDeviceAddress
+);
+
+/// @brief ヒープ毎の予算を最新の状態に更新する関数
+///
+/// VK_EXT_memory_budgetが無効な場合は、ヒープサイズの8割を予算とみなす。
+///
+/// @param allocator メモリ集計オブジェクトハンドル
+void updateMemoryBudget(MemoryAllocator allocator);
+
+/// @brief ヒープにあとどれだけ予算内で確保できるかを取得する関数
+/// @param allocator メモリ集計オブジェクトハンドル
+/// @param heapIndex ヒープのインデックス
+/// @returns 予算の残量を返す。予算を超過している場合は0を返す。
+VkDeviceSize getAvailableMemoryInHeap(const MemoryAllocator allocator, uint32_t heapIndex);
+
+/// @brief メモリ逼迫時コールバックを登録する関数
+/// @param allocator メモリ集計オブジェクトハンドル
+/// @param callback コールバック関数
+/// @param userData コールバック関数に渡されるデータ
+/// @returns 失敗時に0を返す。
+int registerMemoryPressureCallback(MemoryAllocator allocator, MemoryPressureCallback callback, void *userData);
+
+/// @brief メモリ逼迫時コールバックの登録を解除する関数
+/// @param allocator メモリ集計オブジェクトハンドル
+/// @param callback registerMemoryPressureCallback()関数に与えたコールバック関数
+/// @param userData registerMemoryPressureCallback()関数に与えたデータ
+void unregisterMemoryPressureCallback(MemoryAllocator allocator, MemoryPressureCallback callback, void *userData);
+
+/// @brief 登録されたコールバックを呼び、逼迫しているヒープのメモリを解放させる関数
+/// @param allocator メモリ集計オブジェクトハンドル
+/// @param heapIndex 逼迫しているヒープのインデックス
+/// @param requiredSize 確保しようとしているサイズ
+/// @returns 解放されたサイズの合計を返す。
+VkDeviceSize releaseMemoryUnderPressure(MemoryAllocator allocator, uint32_t heapIndex, VkDeviceSize requiredSize);
+
+/// @brief デバイスメモリの確保を記録する関数
+/// @param allocator メモリ集計オブジェクトハンドル
+/// @param memTypeIndex 確保したメモリタイプのインデックス
+/// @param size 確保したサイズ
+void recordDeviceMemoryAllocation(MemoryAllocator allocator, uint32_t memTypeIndex, VkDeviceSize size);
+
+/// @brief デバイスメモリの解放を記録する関数
+/// @param allocator メモリ集計オブジェクトハンドル
+/// @param memTypeIndex 解放したメモリタイプのインデックス
+/// @param size 解放したサイズ
+void recordDeviceMemoryFree(MemoryAllocator allocator, uint32_t memTypeIndex, VkDeviceSize size);
+
+/// @brief デバイスメモリの統計情報を標準出力に出力する関数
+/// @param allocator メモリ集計オブジェクトハンドル
+void printMemoryStats(MemoryAllocator allocator);
+
+/// @brief 前回の出力から一定時間が経過していればデバイスメモリの統計情報を出力する関数
+///
+/// 毎フレーム呼び出すことで、定期的に統計情報を出力できる。
+///
+/// @param allocator メモリ集計オブジェクトハンドル
+/// @param intervalMs 出力間隔(ms)
+void dumpMemoryStatsPeriodically(MemoryAllocator allocator, uint32_t intervalMs);
@@ -12,16 +12,16 @@ void deleteBuffer(const VkDevice device, Buffer buffer) {
         return;
     }
     vkDeviceWaitIdle(device);
-    if (buffer->devMemory != NULL) vkFreeMemory(device, buffer->devMemory, NULL);
+    if (buffer->devMemory != NULL) freeDeviceMemory(device, buffer->allocator, buffer->devMemory, buffer->memTypeIndex, buffer->memReqs.size);
     if (buffer->buffer != NULL) vkDestroyBuffer(device, buffer->buffer, NULL);
     free((void *)buffer);
 }
 
 Buffer createBuffer(
     const VkDevice device,
-    const VkPhysicalDeviceMemoryProperties *physDevMemProps,
+    MemoryAllocator allocator,
     VkBufferUsageFlags usage,
-    VkMemoryPropertyFlags memPropFlags,
+    MemoryUsage memUsage,
     VkDeviceSize size
 ) {
 #define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "createBuffer()", (m), (p), deleteBuffer(device, buffer), NULL)
@@ -30,6 +30,12 @@ Buffer createBuffer(
     const Buffer buffer = (Buffer)malloc(sizeof(struct Buffer_t));
     CHECK(buffer != NULL, "バッファの確保に失敗");
     memset(buffer, 0, sizeof(struct Buffer_t));
+    buffer->allocator = allocator;
+
+    // バッファデバイスアドレスが有効か確認する
+    if ((usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) != 0) {
+        CHECK(allocator->getBufferDeviceAddress != NULL, "バッファデバイスアドレスが無効");
+    }
 
     // バッファを作成する
     {
@@ -47,20 +53,63 @@ Buffer createBuffer(
     }
 
     // バッファの必要条件を取得する
-    {
+    //
+    // NOTE: 巨大なバッファ等では、ドライバが専用のデバイスメモリを確保することを望む(あるいは要求する)場合がある。
+    //       専用にすれば、ドライバがページングや配置をそのリソースに合わせて最適化できる。
+    //
+    // NOTE: Vulkan 1.0の物理デバイスでは問い合わせられないため、必要条件のみを取得して共有の確保とする。
+    if (!allocator->dedicatedAllocationSupported) {
         vkGetBufferMemoryRequirements(device, buffer->buffer, &buffer->memReqs);
+        buffer->dedicated = 0;
+    } else {
+        VkMemoryDedicatedRequirements dedicatedReqs;
+        memset(&dedicatedReqs, 0, sizeof(VkMemoryDedicatedRequirements));
+        dedicatedReqs.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+        VkMemoryRequirements2 memReqs2;
+        memset(&memReqs2, 0, sizeof(VkMemoryRequirements2));
+        memReqs2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+        memReqs2.pNext = (void *)&dedicatedReqs;
+        const VkBufferMemoryRequirementsInfo2 ri = {
+            VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2,
+            NULL,
+            buffer->buffer,
+        };
+        vkGetBufferMemoryRequirements2(device, &ri, &memReqs2);
+        buffer->memReqs = memReqs2.memoryRequirements;
+        buffer->dedicated = dedicatedReqs.prefersDedicatedAllocation || dedicatedReqs.requiresDedicatedAllocation;
     }
 
     // バッファのためのデバイスメモリを確保する
+    //
+    // NOTE: バッファデバイスアドレスを取得するには、デバイスメモリもそれを許可して確保しなければならない。
     {
+        const VkMemoryDedicatedAllocateInfo dedicatedAI = {
+            VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+            NULL,
+            NULL,
+            buffer->buffer,
+        };
+        const void *next = buffer->dedicated ? (const void *)&dedicatedAI : NULL;
+        const VkMemoryAllocateFlagsInfo flagsAI = {
+            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO,
+            next,
+            VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT,
+            0,
+        };
+        if ((usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) != 0) {
+            next = (const void *)&flagsAI;
+        }
         buffer->devMemory = allocateDeviceMemory(
             device,
-            physDevMemProps,
+            allocator,
             buffer->memReqs.memoryTypeBits,
-            memPropFlags,
-            size
+            memUsage,
+            buffer->memReqs.size,
+            next,
+            &buffer->memTypeIndex
         );
         CHECK(buffer->devMemory != NULL, "バッファのためのデバイスメモリの確保に失敗");
+        if (buffer->dedicated) allocator->dedicatedAllocsCount += 1;
     }
 
     // バッファとデバイスメモリとを関連付ける
@@ -68,6 +117,19 @@ Buffer createBuffer(
         CHECK_VK(vkBindBufferMemory(device, buffer->buffer, buffer->devMemory, 0), "バッファとデバイスメモリとの関連付けに失敗");
     }
 
+    // バッファデバイスアドレスを取得する
+    //
+    // NOTE: シェーダはこのアドレスをポインタとして使い、ディスクリプタを介さずにバッファを参照できる。
+    if ((usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) != 0) {
+        const VkBufferDeviceAddressInfo ai = {
+            VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+            NULL,
+            buffer->buffer,
+        };
+        buffer->address = allocator->getBufferDeviceAddress(device, &ai);
+        CHECK(buffer->address != 0, "バッファデバイスアドレスの取得に失敗");
+    }
+
     return buffer;
 
 #undef CHECK
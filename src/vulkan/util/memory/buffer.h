@@ -3,6 +3,10 @@
 
 #pragma once
 
+#include "allocator.h"
+#include "memory.h"
+
+#include <stdint.h>
 #include <vulkan/vulkan.h>
 
 /// @brief バッファに必要なオブジェクトを持つ構造体
@@ -10,6 +14,12 @@ typedef struct Buffer_t {
     VkBuffer buffer;
     VkDeviceMemory devMemory;
     VkMemoryRequirements memReqs;
+    MemoryAllocator allocator;
+    uint32_t memTypeIndex;
+    // 専用のデバイスメモリを確保したならば1
+    int dedicated;
+    // バッファデバイスアドレス (VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BITを指定しなかったなら0)
+    VkDeviceAddress address;
 } *Buffer;
 
 /// @brief Bufferを破棄する関数
@@ -18,16 +28,21 @@ typedef struct Buffer_t {
 void deleteBuffer(const VkDevice device, Buffer buffer);
 
 /// @brief Bufferを作成する関数
+///
+/// ドライバが望む(あるいは要求する)場合は、バッファ専用のデバイスメモリを確保する。
+/// usageにVK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BITを指定した場合は、バッファデバイスアドレスも取得する。
+/// ただし、その場合は論理デバイスでバッファデバイスアドレスが有効でなければならない。
+///
 /// @param device 論理デバイス
-/// @param physDevMemProps 物理デバイス上のメモリプロパティ
+/// @param allocator メモリ集計オブジェクトハンドル
 /// @param usage バッファの使用方法
-/// @param memPropFlags 要求するメモリプロパティ
+/// @param memUsage メモリの用途
 /// @param size 確保するバッファのサイズ
 /// @returns 失敗時にNULLを返す。
 Buffer createBuffer(
     const VkDevice device,
-    const VkPhysicalDeviceMemoryProperties *physDevMemProps,
+    MemoryAllocator allocator,
     VkBufferUsageFlags usage,
-    VkMemoryPropertyFlags memPropFlags,
+    MemoryUsage memUsage,
     VkDeviceSize size
 );
@@ -13,18 +13,19 @@ void deleteImage(const VkDevice device, Image image) {
         return;
     }
     vkDeviceWaitIdle(device);
-    if (image->devMemory != NULL) vkFreeMemory(device, image->devMemory, NULL);
+    if (image->devMemory != NULL) freeDeviceMemory(device, image->allocator, image->devMemory, image->memTypeIndex, image->memReqs.size);
     if (image->image != NULL) vkDestroyImage(device, image->image, NULL);
     free((void *)image);
 }
 
 Image createImage(
     const VkDevice device,
-    const VkPhysicalDeviceMemoryProperties *physDevMemProps,
+    MemoryAllocator allocator,
     VkImageUsageFlags usage,
-    VkMemoryPropertyFlags memPropFlags,
+    MemoryUsage memUsage,
     VkFormat format,
-    const VkExtent3D *extent
+    const VkExtent3D *extent,
+    VkSampleCountFlagBits samples
 ) {
 #define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "createImage()", (m), (p), deleteImage(device, image), NULL)
 #define CHECK(p, m)    ERROR_IF     (!(p),              "createImage()", (m),      deleteImage(device, image), NULL)
@@ -32,10 +33,12 @@ Image createImage(
     const Image image = (Image)malloc(sizeof(struct Image_t));
     CHECK(image != NULL, "バッファの確保に失敗");
     memset(image, 0, sizeof(struct Image_t));
+    image->allocator = allocator;
 
-    // エクステントを格納する
+    // エクステントとサンプル数を格納する
     {
         image->extent = *extent;
+        image->samples = samples;
     }
 
     // イメージを作成する
@@ -49,7 +52,7 @@ Image createImage(
             image->extent,
             1,
             1,
-            VK_SAMPLE_COUNT_1_BIT,
+            image->samples,
             VK_IMAGE_TILING_OPTIMAL,
             usage,
             VK_SHARING_MODE_EXCLUSIVE,
@@ -61,20 +64,51 @@ Image createImage(
     }
 
     // イメージの必要条件を取得する
-    {
+    //
+    // NOTE: 描画先等の大きなイメージでは、ドライバが専用のデバイスメモリを確保することを望む(あるいは要求する)場合がある。
+    //
+    // NOTE: Vulkan 1.0の物理デバイスでは問い合わせられないため、必要条件のみを取得して共有の確保とする。
+    if (!allocator->dedicatedAllocationSupported) {
         vkGetImageMemoryRequirements(device, image->image, &image->memReqs);
+        image->dedicated = 0;
+    } else {
+        VkMemoryDedicatedRequirements dedicatedReqs;
+        memset(&dedicatedReqs, 0, sizeof(VkMemoryDedicatedRequirements));
+        dedicatedReqs.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+        VkMemoryRequirements2 memReqs2;
+        memset(&memReqs2, 0, sizeof(VkMemoryRequirements2));
+        memReqs2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+        memReqs2.pNext = (void *)&dedicatedReqs;
+        const VkImageMemoryRequirementsInfo2 ri = {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2,
+            NULL,
+            image->image,
+        };
+        vkGetImageMemoryRequirements2(device, &ri, &memReqs2);
+        image->memReqs = memReqs2.memoryRequirements;
+        image->dedicated = dedicatedReqs.prefersDedicatedAllocation || dedicatedReqs.requiresDedicatedAllocation;
     }
 
     // イメージのためのデバイスメモリを確保する
     {
+        const VkMemoryDedicatedAllocateInfo dedicatedAI = {
+            VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+            NULL,
+            image->image,
+            NULL,
+        };
         image->devMemory = allocateDeviceMemory(
             device,
-            physDevMemProps,
+            allocator,
             image->memReqs.memoryTypeBits,
-            memPropFlags,
-            image->memReqs.size
+            memUsage,
+            image->memReqs.size,
+            image->dedicated ? (const void *)&dedicatedAI : NULL,
+            &image->memTypeIndex
         );
         CHECK(image->devMemory != NULL, "イメージのためのデバイスメモリの確保に失敗");
+        if (image->dedicated) allocator->dedicatedAllocsCount += 1;
+        image->lazy = (allocator->memProps.memoryTypes[image->memTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0;
     }
 
     // イメージとデバイスメモリとを関連付ける
@@ -87,3 +121,19 @@ Image createImage(
 #undef CHECK
 #undef CHECK_VK
 }
+
+VkFormat findSupportedImageFormat(
+    const VkPhysicalDevice physDevice,
+    uint32_t candidatesCount,
+    const VkFormat *candidates,
+    VkFormatFeatureFlags features
+) {
+    for (uint32_t i = 0; i < candidatesCount; ++i) {
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(physDevice, candidates[i], &props);
+        if ((props.optimalTilingFeatures & features) == features) {
+            return candidates[i];
+        }
+    }
+    return VK_FORMAT_UNDEFINED;
+}
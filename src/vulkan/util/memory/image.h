@@ -3,6 +3,10 @@
 
 #pragma once
 
+#include "allocator.h"
+#include "memory.h"
+
+#include <stdint.h>
 #include <vulkan/vulkan.h>
 
 /// @brief イメージに必要なオブジェクトを持つ構造体
@@ -11,6 +15,13 @@ typedef struct Image_t {
     VkImage image;
     VkDeviceMemory devMemory;
     VkMemoryRequirements memReqs;
+    MemoryAllocator allocator;
+    uint32_t memTypeIndex;
+    VkSampleCountFlagBits samples;
+    // 専用のデバイスメモリを確保したならば1
+    int dedicated;
+    // 遅延確保(LAZILY_ALLOCATED)のメモリタイプから確保したならば1
+    int lazy;
 } *Image;
 
 /// @brief Imageを破棄する関数
@@ -19,18 +30,42 @@ typedef struct Image_t {
 void deleteImage(const VkDevice device, Image image);
 
 /// @brief Imageを作成する関数
+///
+/// ドライバが望む(あるいは要求する)場合は、イメージ専用のデバイスメモリを確保する。
+///
+/// memUsageにMEMORY_USAGE_TRANSIENTを与える場合は、usageにVK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BITを含めること。
+/// 遅延確保のメモリタイプがあればそこから確保し、無ければ通常のデバイスローカルなメモリから確保する。
+///
 /// @param device 論理デバイス
-/// @param physDevMemProps 物理デバイス上のメモリプロパティ
+/// @param allocator メモリ集計オブジェクトハンドル
 /// @param usage バッファの使用方法
-/// @param memPropFlags 要求するメモリプロパティ
+/// @param memUsage メモリの用途
 /// @param format ピクセルフォーマット
 /// @param extent 三次元サイズ
+/// @param samples サンプル数 (マルチサンプルのアタッチメント以外はVK_SAMPLE_COUNT_1_BIT)
 /// @returns 失敗時にNULLを返す。
 Image createImage(
     const VkDevice device,
-    const VkPhysicalDeviceMemoryProperties *physDevMemProps,
+    MemoryAllocator allocator,
     VkImageUsageFlags usage,
-    VkMemoryPropertyFlags memPropFlags,
+    MemoryUsage memUsage,
     VkFormat format,
-    const VkExtent3D *extent
+    const VkExtent3D *extent,
+    VkSampleCountFlagBits samples
+);
+
+/// @brief 候補の中から物理デバイスが対応しているピクセルフォーマットを選ぶ関数
+///
+/// VK_IMAGE_TILING_OPTIMALのイメージで、featuresの全ての機能に対応しているものを候補の先頭から探す。
+///
+/// @param physDevice 物理デバイス
+/// @param candidatesCount candidatesの要素数
+/// @param candidates 優先する順に並べたピクセルフォーマットの候補の配列
+/// @param features 必要なフォーマットの機能
+/// @returns 対応しているものが無ければVK_FORMAT_UNDEFINEDを返す。
+VkFormat findSupportedImageFormat(
+    const VkPhysicalDevice physDevice,
+    uint32_t candidatesCount,
+    const VkFormat *candidates,
+    VkFormatFeatureFlags features
 );
@@ -4,43 +4,174 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+// 立っているビットの数を数える関数
+static uint32_t countBits(uint32_t n) {
+    uint32_t count = 0;
+    for (; n != 0; n &= n - 1) {
+        count += 1;
+    }
+    return count;
+}
+
+uint32_t rankMemoryTypes(const MemoryAllocator allocator, uint32_t type, MemoryUsage memUsage, uint32_t *memTypeIndices) {
+    const VkPhysicalDeviceMemoryProperties *memProps = &allocator->memProps;
+
+    // 用途から必須・望ましい・望ましくないメモリプロパティを決める
+    //
+    // NOTE: 詳しくはMemoryUsageのコメントを参照。
+    VkMemoryPropertyFlags required = 0;
+    VkMemoryPropertyFlags preferred = 0;
+    VkMemoryPropertyFlags notPreferred = 0;
+    switch (memUsage) {
+        case MEMORY_USAGE_GPU_ONLY:
+            preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            notPreferred = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            break;
+        case MEMORY_USAGE_UPLOAD:
+            required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            notPreferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            break;
+        case MEMORY_USAGE_UPLOAD_DYNAMIC:
+            required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            notPreferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+            break;
+        case MEMORY_USAGE_READBACK:
+            required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+            break;
+        case MEMORY_USAGE_TRANSIENT:
+            preferred = VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            notPreferred = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            break;
+    }
+    // NOTE: 保護メモリはこれらの用途には使えない。
+    //       遅延確保メモリはTRANSIENT_ATTACHMENTのイメージにしか結び付けられないため、MEMORY_USAGE_TRANSIENT以外では除く。
+    VkMemoryPropertyFlags excluded = VK_MEMORY_PROPERTY_PROTECTED_BIT;
+    if (memUsage != MEMORY_USAGE_TRANSIENT) excluded |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+
+    // 必須のメモリプロパティを持つメモリタイプを列挙し、コストを計算する
+    //
+    // NOTE: 望ましいメモリプロパティを欠くことは、望ましくないメモリプロパティを持つことよりも重く見る。
+    uint32_t costs[VK_MAX_MEMORY_TYPES];
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < memProps->memoryTypeCount; ++i) {
+        const VkMemoryPropertyFlags flags = memProps->memoryTypes[i].propertyFlags;
+        if (((1u << i) & type) == 0 || (flags & required) != required || (flags & excluded) != 0) {
+            continue;
+        }
+        memTypeIndices[count] = i;
+        costs[i] = countBits(preferred & ~flags) * 2 + countBits(notPreferred & flags);
+        count += 1;
+    }
+
+    // コストの小さい順、ヒープサイズの大きい順に並べる
+    //
+    // NOTE: メモリタイプは高々32個なので挿入ソートで十分。
+    for (uint32_t i = 1; i < count; ++i) {
+        const uint32_t target = memTypeIndices[i];
+        const VkDeviceSize targetHeapSize = memProps->memoryHeaps[memProps->memoryTypes[target].heapIndex].size;
+        uint32_t j = i;
+        for (; j > 0; --j) {
+            const uint32_t prev = memTypeIndices[j - 1];
+            const VkDeviceSize prevHeapSize = memProps->memoryHeaps[memProps->memoryTypes[prev].heapIndex].size;
+            if (costs[prev] < costs[target] || (costs[prev] == costs[target] && prevHeapSize >= targetHeapSize)) {
+                break;
+            }
+            memTypeIndices[j] = prev;
+        }
+        memTypeIndices[j] = target;
+    }
+
+    return count;
+}
 
 VkDeviceMemory allocateDeviceMemory(
     const VkDevice device,
-    const VkPhysicalDeviceMemoryProperties *physDevMemProps,
+    MemoryAllocator allocator,
     uint32_t type,
-    VkMemoryPropertyFlags memPropFlags,
-    VkDeviceSize size
+    MemoryUsage memUsage,
+    VkDeviceSize size,
+    const void *next,
+    uint32_t *memTypeIndex
 ) {
-#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "allocateDeviceMemory()", (m), (p), {}, NULL)
-#define CHECK(p, m)    ERROR_IF     (!(p),              "allocateDeviceMemory()", (m),      {}, NULL)
+#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "allocateDeviceMemory()", (m), (p), allocator->failedAllocsCount += 1, NULL)
+#define CHECK(p, m)    ERROR_IF     (!(p),              "allocateDeviceMemory()", (m),      allocator->failedAllocsCount += 1, NULL)
+
+    const VkPhysicalDeviceMemoryProperties *memProps = &allocator->memProps;
+
+    // 用途に適した物理デバイス上のメモリタイプのインデックスを良い順に列挙する
+    uint32_t candidates[VK_MAX_MEMORY_TYPES];
+    uint32_t candidatesCount = 0;
+    {
+        candidatesCount = rankMemoryTypes(allocator, type, memUsage, candidates);
+        CHECK(candidatesCount > 0, "メモリタイプのインデックスの取得に失敗");
+    }
 
-    // 要求に従った物理デバイス上のメモリタイプのインデックスを取得する
-    uint32_t memTypeIndex = 0;
+    // 予算内に収まるメモリタイプを前に、収まらないものを後ろに並べ替える
+    //
+    // NOTE: それぞれの中では用途に適した順を保つ。
+    //
+    // NOTE: 予算を超えても確保自体は成功することがある。
+    //       が、その場合はドライバによってシステムメモリへ退避される等して性能が大きく落ちうる。
+    //       そのため、他に要求を満たすメモリタイプがあればそちらを優先する。
+    //
+    // NOTE: どのメモリタイプも予算を超過する場合は、キャッシュ等を持つモジュールにメモリを解放させてから判断し直す。
+    uint32_t ordered[VK_MAX_MEMORY_TYPES];
+    uint32_t fitsCount = 0;
     {
-        int found = 0;
-        for (uint32_t i = 0; i < physDevMemProps->memoryTypeCount; ++i) {
-            if ((1 << i) & type) {
-                if ((physDevMemProps->memoryTypes[i].propertyFlags & memPropFlags) == memPropFlags) {
-                    memTypeIndex = i;
-                    found = 1;
-                    break;
+        updateMemoryBudget(allocator);
+        for (int retry = 0; retry < 2; ++retry) {
+            uint32_t count = 0;
+            for (int fits = 1; fits >= 0; --fits) {
+                for (uint32_t i = 0; i < candidatesCount; ++i) {
+                    const uint32_t heapIndex = memProps->memoryTypes[candidates[i]].heapIndex;
+                    if ((getAvailableMemoryInHeap(allocator, heapIndex) >= size) == fits) {
+                        ordered[count] = candidates[i];
+                        count += 1;
+                    }
                 }
+                if (fits) fitsCount = count;
             }
+            if (fitsCount > 0 || retry > 0) {
+                break;
+            }
+            const uint32_t heapIndex = memProps->memoryTypes[candidates[0]].heapIndex;
+            if (releaseMemoryUnderPressure(allocator, heapIndex, size) == 0) {
+                break;
+            }
+            updateMemoryBudget(allocator);
         }
-        CHECK(found, "メモリタイプのインデックスの取得に失敗");
     }
 
     // デバイスメモリを確保する
-    VkDeviceMemory devMemory;
+    //
+    // NOTE: 並べ替えた順に確保を試み、デバイスメモリ不足で失敗した場合は次のメモリタイプを試す。
+    VkDeviceMemory devMemory = NULL;
     {
-        const VkMemoryAllocateInfo ai = {
-            VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-            NULL,
-            size,
-            memTypeIndex,
-        };
-        CHECK_VK(vkAllocateMemory(device, &ai, NULL, &devMemory), "デバイスメモリの確保に失敗");
+        VkResult res = VK_ERROR_OUT_OF_DEVICE_MEMORY;
+        for (uint32_t i = 0; i < candidatesCount; ++i) {
+            const VkMemoryAllocateInfo ai = {
+                VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+                next,
+                size,
+                ordered[i],
+            };
+            res = vkAllocateMemory(device, &ai, NULL, &devMemory);
+            if (res == VK_SUCCESS) {
+                if (ordered[i] != candidates[0]) allocator->fallbackAllocsCount += 1;
+                if (i >= fitsCount) allocator->overBudgetAllocsCount += 1;
+                recordDeviceMemoryAllocation(allocator, ordered[i], size);
+                *memTypeIndex = ordered[i];
+                break;
+            }
+            if (res != VK_ERROR_OUT_OF_DEVICE_MEMORY && res != VK_ERROR_OUT_OF_HOST_MEMORY) {
+                break;
+            }
+        }
+        CHECK_VK(res, "デバイスメモリの確保に失敗");
     }
 
     return devMemory;
@@ -49,6 +180,44 @@ VkDeviceMemory allocateDeviceMemory(
 #undef CHECK_VK
 }
 
+void freeDeviceMemory(
+    const VkDevice device,
+    MemoryAllocator allocator,
+    VkDeviceMemory devMemory,
+    uint32_t memTypeIndex,
+    VkDeviceSize size
+) {
+    if (devMemory == NULL) {
+        return;
+    }
+    vkFreeMemory(device, devMemory, NULL);
+    recordDeviceMemoryFree(allocator, memTypeIndex, size);
+}
+
+int invalidateMappedDeviceMemory(
+    const VkDevice device,
+    const MemoryAllocator allocator,
+    VkDeviceMemory devMemory,
+    uint32_t memTypeIndex
+) {
+#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "invalidateMappedDeviceMemory()", (m), (p), {}, 0)
+
+    if (allocator->memProps.memoryTypes[memTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) {
+        return 1;
+    }
+    const VkMappedMemoryRange range = {
+        VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        NULL,
+        devMemory,
+        0,
+        VK_WHOLE_SIZE,
+    };
+    CHECK_VK(vkInvalidateMappedMemoryRanges(device, 1, &range), "マップしたデバイスメモリの無効化に失敗");
+    return 1;
+
+#undef CHECK_VK
+}
+
 int uploadToDeviceMemory(const VkDevice device, const VkDeviceMemory devMemory, const void *source, uint32_t size) {
 #define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "uploadToDeviceMemory()", (m), (p), {}, 0)
 
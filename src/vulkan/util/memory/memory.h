@@ -3,23 +3,111 @@
 
 #pragma once
 
+#include "allocator.h"
+
 #include <stdint.h>
 #include <vulkan/vulkan.h>
 
+/// @brief デバイスメモリの用途
+///
+/// 用途毎に、必須のメモリプロパティ・望ましいメモリプロパティ・望ましくないメモリプロパティが決まっている。
+/// - MEMORY_USAGE_GPU_ONLY
+///   - デバイスのみが読み書きする (描画先イメージ等)
+///   - 望ましい: DEVICE_LOCAL
+///   - 望ましくない: HOST_VISIBLE (ReBAR等の貴重なメモリを他の用途に残すため)
+/// - MEMORY_USAGE_UPLOAD
+///   - ホストが一度だけ順に書き込み、デバイスが読む (ステージングバッファ等)
+///   - 必須: HOST_VISIBLE, HOST_COHERENT
+///   - 望ましくない: HOST_CACHED (ライトコンバインドの方が書き込みが速い), DEVICE_LOCAL
+/// - MEMORY_USAGE_UPLOAD_DYNAMIC
+///   - ホストが頻繁に書き込み、デバイスが直接読む (ユニフォームバッファ・頂点バッファ等)
+///   - 必須: HOST_VISIBLE, HOST_COHERENT
+///   - 望ましい: DEVICE_LOCAL (ReBAR)
+///   - 望ましくない: HOST_CACHED
+/// - MEMORY_USAGE_READBACK
+///   - デバイスが書き込み、ホストが読む (描画結果の取得等)
+///   - 必須: HOST_VISIBLE
+///   - 望ましい: HOST_CACHED (キャッシュされていないメモリからの読込みは非常に遅い)
+///   - HOST_COHERENTでない場合があるため、読込み前にinvalidateMappedDeviceMemory()関数を呼ぶこと
+/// - MEMORY_USAGE_TRANSIENT
+///   - レンダーパスの中でのみ読み書きし、メモリへ書き出さない (VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BITのイメージ)
+///   - 望ましい: LAZILY_ALLOCATED (タイルベースのGPUでは実際のメモリがほとんど確保されない), DEVICE_LOCAL
+///   - 望ましくない: HOST_VISIBLE
+///   - LAZILY_ALLOCATEDなメモリタイプが無ければ、MEMORY_USAGE_GPU_ONLYと同様に選ばれる
+typedef enum MemoryUsage_t {
+    MEMORY_USAGE_GPU_ONLY,
+    MEMORY_USAGE_UPLOAD,
+    MEMORY_USAGE_UPLOAD_DYNAMIC,
+    MEMORY_USAGE_READBACK,
+    MEMORY_USAGE_TRANSIENT,
+} MemoryUsage;
+
+/// @brief 用途に適したメモリタイプのインデックスを良い順に列挙する関数
+///
+/// 必須のメモリプロパティを持つメモリタイプのみを列挙する。
+/// 望ましいメモリプロパティを多く持ち、望ましくないメモリプロパティを少なく持つものほど前に並ぶ。
+/// 同等のものはヒープサイズの大きい順に並ぶ。
+///
+/// @param allocator メモリ集計オブジェクトハンドル
+/// @param type 要求するメモリタイプ
+/// @param memUsage メモリの用途
+/// @param memTypeIndices 列挙したメモリタイプのインデックスの格納先 (VK_MAX_MEMORY_TYPES個以上)
+/// @returns 列挙したメモリタイプの個数を返す。
+uint32_t rankMemoryTypes(const MemoryAllocator allocator, uint32_t type, MemoryUsage memUsage, uint32_t *memTypeIndices);
+
 /// @brief デバイスメモリを確保する関数
+///
+/// rankMemoryTypes()関数で列挙したメモリタイプのうち、ヒープの予算内に収まるものを優先して確保する。
+/// どのメモリタイプも予算を超過する場合は、メモリ逼迫時コールバックを呼んでから確保を試みる。
+///
 /// @param device 論理デバイス
-/// @param physDevMemProps 物理デバイス上のメモリプロパティ
+/// @param allocator メモリ集計オブジェクトハンドル
 /// @param type 要求するメモリタイプ
-/// @param memPropFlags 要求するメモリプロパティ
+/// @param memUsage メモリの用途
 /// @param size 確保するメモリのサイズ
+/// @param next VkMemoryAllocateInfoに繋げる拡張構造体 (専用確保・デバイスアドレス等、不要ならNULL)
+/// @param memTypeIndex 確保したメモリタイプのインデックスの格納先
+/// @returns 失敗時にNULLを返す。
 VkDeviceMemory allocateDeviceMemory(
     const VkDevice device,
-    const VkPhysicalDeviceMemoryProperties *physDevMemProps,
+    MemoryAllocator allocator,
     uint32_t type,
-    VkMemoryPropertyFlags memPropFlags,
+    MemoryUsage memUsage,
+    VkDeviceSize size,
+    const void *next,
+    uint32_t *memTypeIndex
+);
+
+/// @brief allocateDeviceMemory()関数で確保したデバイスメモリを解放する関数
+/// @param device 論理デバイス
+/// @param allocator メモリ集計オブジェクトハンドル
+/// @param devMemory デバイスメモリ
+/// @param memTypeIndex 確保したメモリタイプのインデックス
+/// @param size 確保したサイズ
+void freeDeviceMemory(
+    const VkDevice device,
+    MemoryAllocator allocator,
+    VkDeviceMemory devMemory,
+    uint32_t memTypeIndex,
     VkDeviceSize size
 );
 
+/// @brief マップしたデバイスメモリへのデバイスの書き込みをホストから見えるようにする関数
+///
+/// HOST_COHERENTなメモリタイプの場合は何もしない。
+///
+/// @param device 論理デバイス
+/// @param allocator メモリ集計オブジェクトハンドル
+/// @param devMemory マップ中のデバイスメモリ
+/// @param memTypeIndex 確保したメモリタイプのインデックス
+/// @returns 失敗時に0を返す。
+int invalidateMappedDeviceMemory(
+    const VkDevice device,
+    const MemoryAllocator allocator,
+    VkDeviceMemory devMemory,
+    uint32_t memTypeIndex
+);
+
 /// @brief デバイスメモリにデータをアップロードする関数
 /// @param device 論理デバイス
 /// @param devMemory アップロード先のデバイスメモリ
@@ -0,0 +1,75 @@
+#include "ring.h"
+
+#include "../error.h"
+#include "memory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void deleteRingBuffer(const VkDevice device, RingBuffer ring) {
+    if (ring == NULL) {
+        return;
+    }
+    vkDeviceWaitIdle(device);
+    if (ring->mapped != NULL) vkUnmapMemory(device, ring->buffer->devMemory);
+    if (ring->buffer != NULL) deleteBuffer(device, ring->buffer);
+    free((void *)ring);
+}
+
+RingBuffer createRingBuffer(
+    const VkDevice device,
+    MemoryAllocator allocator,
+    VkBufferUsageFlags usage,
+    VkDeviceSize frameSize,
+    uint32_t framesCount,
+    VkDeviceSize alignment
+) {
+#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "createRingBuffer()", (m), (p), deleteRingBuffer(device, ring), NULL)
+#define CHECK(p, m)    ERROR_IF     (!(p),              "createRingBuffer()", (m),      deleteRingBuffer(device, ring), NULL)
+
+    const RingBuffer ring = (RingBuffer)malloc(sizeof(struct RingBuffer_t));
+    CHECK(ring != NULL, "RingBufferの確保に失敗");
+    memset(ring, 0, sizeof(struct RingBuffer_t));
+
+    // 区画のサイズをアラインメントの倍数に切り上げる
+    //
+    // NOTE: 各区画の先頭もアラインメントを満たすようにするため。
+    ring->alignment = alignment > 0 ? alignment : 1;
+    ring->frameSize = (frameSize + ring->alignment - 1) / ring->alignment * ring->alignment;
+    ring->framesCount = framesCount;
+
+    // バッファを作成する
+    {
+        ring->buffer = createBuffer(device, allocator, usage, MEMORY_USAGE_UPLOAD_DYNAMIC, ring->frameSize * framesCount);
+        CHECK(ring->buffer != NULL, "バッファの作成に失敗");
+    }
+
+    // バッファをマップする
+    //
+    // NOTE: マップ・アンマップにもコストがかかるため、フレーム毎には行わず、破棄するまでマップしたままにする。
+    //       HOST_COHERENTなメモリであるため、書き込んだ内容はフラッシュせずともデバイスから見える。
+    {
+        void *p;
+        CHECK_VK(vkMapMemory(device, ring->buffer->devMemory, 0, VK_WHOLE_SIZE, 0, &p), "バッファのマップに失敗");
+        ring->mapped = (uint8_t *)p;
+    }
+
+    return ring;
+
+#undef CHECK
+#undef CHECK_VK
+}
+
+void beginRingBufferFrame(RingBuffer ring, uint32_t frameIndex) {
+    ring->frameBegin = ring->frameSize * (frameIndex % ring->framesCount);
+    ring->head = ring->frameBegin;
+}
+
+void *allocateFromRingBuffer(RingBuffer ring, VkDeviceSize size, VkDeviceSize *offset) {
+    const VkDeviceSize begin = (ring->head + ring->alignment - 1) / ring->alignment * ring->alignment;
+    ERROR_IF(begin + size > ring->frameBegin + ring->frameSize, "allocateFromRingBuffer()", "フレームの区画が不足", {}, NULL);
+    ring->head = begin + size;
+    *offset = begin;
+    return (void *)(ring->mapped + begin);
+}
@@ -0,0 +1,69 @@
+/// @file ring.h
+/// @brief フレーム毎に使い捨てるデータを詰めるリングバッファに関するモジュール
+///
+/// バッファをフレーム数だけの区画に分け、各フレームは自身の区画の先頭から順にデータを詰めていく。
+/// 詰めたデータはバッファ先頭からのオフセットで参照する。
+/// ダイナミックユニフォームバッファと組み合わせれば、ディスクリプタセットを作り直さずに描画毎のデータを切り替えられる。
+
+#pragma once
+
+#include "allocator.h"
+#include "buffer.h"
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+/// @brief リングバッファに必要なオブジェクトを持つ構造体
+typedef struct RingBuffer_t {
+    Buffer buffer;
+    // 常にマップしたままのバッファ先頭へのポインタ
+    uint8_t *mapped;
+    // 詰める各データの先頭のアラインメント
+    VkDeviceSize alignment;
+    // フレーム一つあたりの区画のサイズ
+    VkDeviceSize frameSize;
+    uint32_t framesCount;
+    // 現在のフレームの区画の先頭と、次にデータを詰める位置 (いずれもバッファ先頭からのオフセット)
+    VkDeviceSize frameBegin;
+    VkDeviceSize head;
+} *RingBuffer;
+
+/// @brief RingBufferを破棄する関数
+/// @param device 論理デバイス
+/// @param ring リングバッファオブジェクトハンドル
+void deleteRingBuffer(const VkDevice device, RingBuffer ring);
+
+/// @brief RingBufferを作成する関数
+///
+/// バッファはMEMORY_USAGE_UPLOAD_DYNAMICで確保し、常にマップしておく。
+///
+/// @param device 論理デバイス
+/// @param allocator メモリ集計オブジェクトハンドル
+/// @param usage バッファの使用方法
+/// @param frameSize フレーム一つあたりの区画のサイズ
+/// @param framesCount 同時に処理されうるフレーム数
+/// @param alignment 詰める各データの先頭のアラインメント (ユニフォームバッファならminUniformBufferOffsetAlignment)
+/// @returns 失敗時にNULLを返す。
+RingBuffer createRingBuffer(
+    const VkDevice device,
+    MemoryAllocator allocator,
+    VkBufferUsageFlags usage,
+    VkDeviceSize frameSize,
+    uint32_t framesCount,
+    VkDeviceSize alignment
+);
+
+/// @brief フレームの区画の使用を開始する関数
+///
+/// 区画に詰めたデータを以前に使ったフレームが、デバイスで実行し終わってから呼ぶこと。
+///
+/// @param ring リングバッファオブジェクトハンドル
+/// @param frameIndex フレームのインデックス (framesCount未満)
+void beginRingBufferFrame(RingBuffer ring, uint32_t frameIndex);
+
+/// @brief 現在のフレームの区画から領域を切り出す関数
+/// @param ring リングバッファオブジェクトハンドル
+/// @param size 切り出すサイズ
+/// @param offset 切り出した領域のバッファ先頭からのオフセットの格納先
+/// @returns 切り出した領域へ書き込むためのポインタを返す。区画が足りなければNULLを返す。
+void *allocateFromRingBuffer(RingBuffer ring, VkDeviceSize size, VkDeviceSize *offset);
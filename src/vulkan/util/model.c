@@ -9,92 +9,404 @@
 #include <stdio.h>
 #include <string.h>
 
+// モデルが持つバッファの最大数 (頂点・ローカル座標・インデックス・メッシュレットの3つ)
+#define MODEL_BUFFERS_COUNT 6
+
 void deleteModel(const VkDevice device, Model model) {
   if (model == NULL) {
     return;
   }
   vkDeviceWaitIdle(device);
+  if (model->meshletTriBuffer != NULL) deleteBuffer(device, model->meshletTriBuffer);
+  if (model->meshletVtxBuffer != NULL) deleteBuffer(device, model->meshletVtxBuffer);
+  if (model->meshletBuffer != NULL) deleteBuffer(device, model->meshletBuffer);
   if (model->idxBuffer != NULL) deleteBuffer(device, model->idxBuffer);
+  if (model->posBuffer != NULL) deleteBuffer(device, model->posBuffer);
   if (model->vtxBuffer != NULL) deleteBuffer(device, model->vtxBuffer);
   if (model->data != NULL) free((void *)model->data);
   free((void *)model);
 }
 
-Model createModelFromFile(const VkDevice device, const VkPhysicalDeviceMemoryProperties *physDevMemProps, const char *path) {
+int parseModelData(const char *data, long int size, ModelData *modelData) {
+#define CHECK(p, m) ERROR_IF(!(p), "parseModelData()", (m), {}, 0)
+
+    // キャスト済み配列を用意する
+    const uint32_t *dataUInt32 = (const uint32_t *)data;
+    const float *dataFloat = (const float *)data;
+    const uint64_t wordsCount = size > 0 ? (uint64_t)size / sizeof(uint32_t) : 0;
+
+    // ヘッダを読む
+    CHECK(wordsCount >= 2, "ヘッダが不足している");
+
+    // 一頂点におけるサイズを取得する
+    const uint32_t flags = dataUInt32[0];
+    uint32_t sizePerVertex = 3;
+    {
+        if (flags & MODEL_FLAG_NORMAL) sizePerVertex += 3;
+        if (flags & MODEL_FLAG_UV) sizePerVertex += 2;
+    }
+
+    // 頂点数を取得する
+    //
+    // NOTE: 頂点数とインデックス数はファイルの値をそのまま信じず、読み出す前にデータのサイズと比べる。
+    const uint32_t verticesCount = dataUInt32[1];
+    const uint64_t indicesCountAt = 2 + (uint64_t)sizePerVertex * (uint64_t)verticesCount;
+    CHECK(indicesCountAt < wordsCount, "頂点データが不足している");
+    // インデックス数を取得する
+    const uint32_t indicesCount = dataUInt32[indicesCountAt];
+    CHECK(indicesCountAt + 1 + (uint64_t)indicesCount <= wordsCount, "インデックスデータが不足している");
+
+    modelData->flags = flags;
+    modelData->sizePerVertex = sizePerVertex;
+    modelData->verticesCount = verticesCount;
+    modelData->vertices = &dataFloat[2];
+    modelData->indicesCount = indicesCount;
+    modelData->indices = &dataUInt32[indicesCountAt + 1];
+
+    // インデックスデータより後ろの節の位置
+    uint64_t sectionAt = indicesCountAt + 1 + (uint64_t)indicesCount;
+
+    // LODの表を読む
+    //
+    // NOTE: 表が無ければ、インデックスデータ全体を唯一のLODとみなす。
+    if (flags & MODEL_FLAG_LOD) {
+        const uint64_t lodsCountAt = sectionAt;
+        CHECK(lodsCountAt < wordsCount, "LODの表が不足している");
+        const uint32_t lodsCount = dataUInt32[lodsCountAt];
+        CHECK(lodsCount > 0 && lodsCount <= MODEL_MAX_LODS, "LODの数が無効");
+        CHECK(lodsCountAt + 1 + 3 * (uint64_t)lodsCount <= wordsCount, "LODの表が不足している");
+        for (uint32_t i = 0; i < lodsCount; ++i) {
+            const uint64_t at = lodsCountAt + 1 + 3 * (uint64_t)i;
+            ModelLod *lod = &modelData->lods[i];
+            lod->firstIndex = dataUInt32[at + 0];
+            lod->indicesCount = dataUInt32[at + 1];
+            lod->error = dataFloat[at + 2];
+            CHECK((uint64_t)lod->firstIndex + (uint64_t)lod->indicesCount <= (uint64_t)indicesCount, "LODの範囲がインデックスデータを超えている");
+            CHECK(lod->error >= 0.0f, "LODの誤差が無効");
+        }
+        modelData->lodsCount = lodsCount;
+        sectionAt = lodsCountAt + 1 + 3 * (uint64_t)lodsCount;
+    } else {
+        modelData->lodsCount = 1;
+        modelData->lods[0].firstIndex = 0;
+        modelData->lods[0].indicesCount = indicesCount;
+        modelData->lods[0].error = 0.0f;
+    }
+
+    // メッシュレットを読む
+    //
+    // NOTE: メッシュ・頂点・三角形の配列の順に、それぞれ個数の後ろに並ぶ。
+    //       シェーダが範囲外を読まないよう、各メッシュレットの範囲と頂点の番号を全て確かめる。
+    modelData->meshletsCount = 0;
+    modelData->meshlets = NULL;
+    modelData->meshletVerticesCount = 0;
+    modelData->meshletVertices = NULL;
+    modelData->meshletTrianglesCount = 0;
+    modelData->meshletTriangles = NULL;
+    if (flags & MODEL_FLAG_MESHLET) {
+        const uint64_t meshletWordsCount = sizeof(ModelMeshlet) / sizeof(uint32_t);
+        CHECK(sectionAt < wordsCount, "メッシュレットが不足している");
+        const uint32_t meshletsCount = dataUInt32[sectionAt];
+        const uint64_t verticesCountAt = sectionAt + 1 + meshletWordsCount * (uint64_t)meshletsCount;
+        CHECK(verticesCountAt < wordsCount, "メッシュレットが不足している");
+        const uint32_t meshletVerticesCount = dataUInt32[verticesCountAt];
+        const uint64_t trianglesCountAt = verticesCountAt + 1 + (uint64_t)meshletVerticesCount;
+        CHECK(trianglesCountAt < wordsCount, "メッシュレットの頂点が不足している");
+        const uint32_t meshletTrianglesCount = dataUInt32[trianglesCountAt];
+        CHECK(trianglesCountAt + 1 + (uint64_t)meshletTrianglesCount <= wordsCount, "メッシュレットの三角形が不足している");
+
+        const ModelMeshlet *meshlets = (const ModelMeshlet *)&dataUInt32[sectionAt + 1];
+        const uint32_t *meshletVertices = &dataUInt32[verticesCountAt + 1];
+        const uint32_t *meshletTriangles = &dataUInt32[trianglesCountAt + 1];
+        for (uint32_t i = 0; i < meshletsCount; ++i) {
+            const ModelMeshlet *m = &meshlets[i];
+            CHECK(m->vertexCount <= MODEL_MESHLET_MAX_VERTICES && m->triangleCount <= MODEL_MESHLET_MAX_TRIANGLES, "メッシュレットが大きすぎる");
+            CHECK((uint64_t)m->vertexOffset + (uint64_t)m->vertexCount <= (uint64_t)meshletVerticesCount, "メッシュレットの頂点の範囲が無効");
+            CHECK((uint64_t)m->triangleOffset + (uint64_t)m->triangleCount <= (uint64_t)meshletTrianglesCount, "メッシュレットの三角形の範囲が無効");
+            for (uint32_t j = 0; j < m->vertexCount; ++j) {
+                CHECK(meshletVertices[m->vertexOffset + j] < verticesCount, "メッシュレットの頂点インデックスが頂点数を超えている");
+            }
+            for (uint32_t j = 0; j < m->triangleCount; ++j) {
+                const uint32_t packed = meshletTriangles[m->triangleOffset + j];
+                CHECK(
+                    (packed & 0xFF) < m->vertexCount && ((packed >> 8) & 0xFF) < m->vertexCount && ((packed >> 16) & 0xFF) < m->vertexCount,
+                    "メッシュレットの三角形の頂点の番号が無効"
+                );
+            }
+        }
+        modelData->meshletsCount = meshletsCount;
+        modelData->meshlets = meshlets;
+        modelData->meshletVerticesCount = meshletVerticesCount;
+        modelData->meshletVertices = meshletVertices;
+        modelData->meshletTrianglesCount = meshletTrianglesCount;
+        modelData->meshletTriangles = meshletTriangles;
+    }
+
+    return 1;
+
+#undef CHECK
+}
+
+// uploadModelBuffers()関数の中で一時的に作成されるオブジェクトを持つ構造体
+typedef struct TempObjsUploadModelBuffers_t {
+    Buffer staging;
+    void *mapped;
+    VkCommandBuffer cmdBuffer;
+    VkFence fence;
+} TempObjsUploadModelBuffers;
+
+static void deleteTempObjsUploadModelBuffers(const VkDevice device, VkCommandPool cmdPool, TempObjsUploadModelBuffers *temp) {
+    vkDeviceWaitIdle(device);
+    if (temp->fence != NULL) vkDestroyFence(device, temp->fence, NULL);
+    if (temp->cmdBuffer != NULL) vkFreeCommandBuffers(device, cmdPool, 1, &temp->cmdBuffer);
+    if (temp->mapped != NULL) vkUnmapMemory(device, temp->staging->devMemory);
+    if (temp->staging != NULL) deleteBuffer(device, temp->staging);
+}
+
+// モデルの各バッファへデータをアップロードする関数
+//
+// NOTE: 全てのデータを一つのステージングバッファに詰め、一回の提出でそれぞれのバッファへコピーし、完了まで待機する。
+//       ローカル座標のみの頂点バッファ(データがNULL)は、頂点データから抜き出してステージングバッファへ直接詰める。
+//       コピーの後のバリアで、以降に提出される描画やカリングからコピーの書込みが見えるようにする。
+static int uploadModelBuffers(
+    const VkDevice device,
+    MemoryAllocator allocator,
+    VkQueue queue,
+    VkCommandPool cmdPool,
+    const ModelData *modelData,
+    uint32_t buffersCount,
+    const Buffer *buffers,
+    const uint32_t *sizes,
+    const void *const *sources
+) {
+#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "uploadModelBuffers()", (m), (p), deleteTempObjsUploadModelBuffers(device, cmdPool, &temp), 0)
+#define CHECK(p, m)    ERROR_IF     (!(p),              "uploadModelBuffers()", (m),      deleteTempObjsUploadModelBuffers(device, cmdPool, &temp), 0)
+
+    TempObjsUploadModelBuffers temp = {
+        NULL,
+        NULL,
+        NULL,
+        NULL,
+    };
+
+    // ステージングバッファ内のそれぞれのデータの位置を決める
+    VkDeviceSize offsets[MODEL_BUFFERS_COUNT];
+    VkDeviceSize stagingSize = 0;
+    for (uint32_t i = 0; i < buffersCount; ++i) {
+        offsets[i] = stagingSize;
+        stagingSize += sizes[i];
+    }
+
+    // ステージングバッファを作成し、データを詰める
+    {
+        temp.staging = createBuffer(device, allocator, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MEMORY_USAGE_UPLOAD, stagingSize);
+        CHECK(temp.staging != NULL, "ステージングバッファの作成に失敗");
+        CHECK_VK(vkMapMemory(device, temp.staging->devMemory, 0, VK_WHOLE_SIZE, 0, &temp.mapped), "ステージングバッファのマップに失敗");
+        for (uint32_t i = 0; i < buffersCount; ++i) {
+            uint8_t *dst = (uint8_t *)temp.mapped + offsets[i];
+            if (sources[i] != NULL) {
+                memcpy((void *)dst, sources[i], sizes[i]);
+                continue;
+            }
+            for (uint32_t j = 0; j < modelData->verticesCount; ++j) {
+                memcpy(
+                    (void *)(dst + (size_t)j * sizeof(float) * 3),
+                    (const void *)&modelData->vertices[(size_t)j * modelData->sizePerVertex],
+                    sizeof(float) * 3
+                );
+            }
+        }
+    }
+
+    // コピーを記録する
+    {
+        const VkCommandBufferAllocateInfo ai = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            NULL,
+            cmdPool,
+            VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            1,
+        };
+        CHECK_VK(vkAllocateCommandBuffers(device, &ai, &temp.cmdBuffer), "コマンドバッファの確保に失敗");
+        const VkCommandBufferBeginInfo bi = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            NULL,
+            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+            NULL,
+        };
+        CHECK_VK(vkBeginCommandBuffer(temp.cmdBuffer, &bi), "コマンドバッファへの記録の開始に失敗");
+        for (uint32_t i = 0; i < buffersCount; ++i) {
+            const VkBufferCopy region = { offsets[i], 0, sizes[i] };
+            vkCmdCopyBuffer(temp.cmdBuffer, temp.staging->buffer, buffers[i]->buffer, 1, &region);
+        }
+        const VkMemoryBarrier barrier = {
+            VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            NULL,
+            VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+        };
+        vkCmdPipelineBarrier(
+            temp.cmdBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0,
+            1,
+            &barrier,
+            0,
+            NULL,
+            0,
+            NULL
+        );
+        CHECK_VK(vkEndCommandBuffer(temp.cmdBuffer), "コマンドバッファへの記録の終了に失敗");
+    }
+
+    // 提出し、完了を待機する
+    {
+        const VkFenceCreateInfo ci = {
+            VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+            NULL,
+            0,
+        };
+        CHECK_VK(vkCreateFence(device, &ci, NULL, &temp.fence), "フェンスの作成に失敗");
+        const VkSubmitInfo si = {
+            VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            NULL,
+            0,
+            NULL,
+            NULL,
+            1,
+            &temp.cmdBuffer,
+            0,
+            NULL,
+        };
+        CHECK_VK(vkQueueSubmit(queue, 1, &si, temp.fence), "コマンドバッファの提出に失敗");
+        CHECK_VK(vkWaitForFences(device, 1, &temp.fence, VK_TRUE, UINT64_MAX), "コピーの完了の待機に失敗");
+    }
+
+    deleteTempObjsUploadModelBuffers(device, cmdPool, &temp);
+    return 1;
+
+#undef CHECK
+#undef CHECK_VK
+}
+
+Model createModelFromFile(
+    const VkDevice device,
+    MemoryAllocator allocator,
+    VkQueue queue,
+    VkCommandPool cmdPool,
+    const char *path
+) {
 #define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "createModelFromFile()", (m), (p), deleteModel(device, model), NULL)
 #define CHECK(p, m)    ERROR_IF     (!(p),              "createModelFromFile()", (m),      deleteModel(device, model), NULL)
 
-    ((void*)physDevMemProps);
-
     const Model model = (Model)malloc(sizeof(struct Model_t));
     CHECK(model != NULL, "Modelの確保に失敗");
     memset(model, 0, sizeof(struct Model_t));
 
     // モデルデータを読み込む
+    long int size = 0;
     {
-        model->data = readBinaryFile(path, NULL);
+        model->data = readBinaryFile(path, &size);
         CHECK(model->data != NULL, "モデルデータの読込みに失敗");
     }
 
-    // キャスト済み配列を用意する
-    const uint32_t *dataUInt32 = (const uint32_t *)model->data;
-    const float *dataFloat = (const float *)model->data;
-
-    // 一頂点におけるサイズを取得する
-    uint32_t sizePerVertex = 3;
+    // モデルデータを解釈する
+    ModelData modelData;
     {
-        const uint32_t flags = dataUInt32[0];
-        // normal
-        if (flags & 1) sizePerVertex += 3;
-        // uv
-        if (flags & 2) sizePerVertex += 2;
+        CHECK(parseModelData(model->data, size, &modelData), "モデルデータの解釈に失敗");
     }
-
-    // 頂点数を取得する
-    const uint32_t verticesCount = dataUInt32[1];
-    // 頂点データを取得する
-    const float *vertices = &dataFloat[2];
-    const uint32_t verticesSize = sizeof(float) * sizePerVertex * verticesCount;
-    // インデックス数を取得する
-    const uint32_t indicesCount = dataUInt32[1 + 1 + sizePerVertex * verticesCount];
-    // インデックスデータを取得する
-    const uint32_t *indices = &dataUInt32[1 + 1 + sizePerVertex * verticesCount + 1];
+    const float *vertices = modelData.vertices;
+    const uint32_t verticesSize = sizeof(float) * modelData.sizePerVertex * modelData.verticesCount;
+    const uint32_t indicesCount = modelData.indicesCount;
+    const uint32_t *indices = modelData.indices;
     const uint32_t indicesSize = sizeof(uint32_t) * indicesCount;
 
-    // 頂点バッファを作成しアップロードする
-    {
-        model->vtxBuffer = createBuffer(
+    // バッファデバイスアドレスが有効ならば、シェーダからポインタで参照できるようにする
+    const VkBufferUsageFlags addressUsage = allocator->getBufferDeviceAddress != NULL ? VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT : 0;
+
+    // バッファ毎の使用方法・サイズ・アップロードするデータを決める
+    //
+    // NOTE: 頂点バッファ・ローカル座標のみの頂点バッファ・インデックスバッファ・メッシュレットの3つのストレージバッファの順。
+    //       ローカル座標は各頂点の先頭にあるため、それだけを抜き出して詰める (データをNULLとし、アップロード時に抜き出す)。
+    //       メッシュレットのストレージバッファは、いずれもカリングのコンピュートシェーダからのみ読む。
+    const uint32_t buffersCount = modelData.meshletsCount > 0 ? MODEL_BUFFERS_COUNT : 3;
+    Buffer *buffers[MODEL_BUFFERS_COUNT] = {
+        &model->vtxBuffer,
+        &model->posBuffer,
+        &model->idxBuffer,
+        &model->meshletBuffer,
+        &model->meshletVtxBuffer,
+        &model->meshletTriBuffer,
+    };
+    const VkBufferUsageFlags usages[MODEL_BUFFERS_COUNT] = {
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | addressUsage,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | addressUsage,
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | addressUsage,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+    };
+    const uint32_t sizes[MODEL_BUFFERS_COUNT] = {
+        verticesSize,
+        (uint32_t)sizeof(float) * 3 * modelData.verticesCount,
+        indicesSize,
+        (uint32_t)sizeof(ModelMeshlet) * modelData.meshletsCount,
+        (uint32_t)sizeof(uint32_t) * modelData.meshletVerticesCount,
+        (uint32_t)sizeof(uint32_t) * modelData.meshletTrianglesCount,
+    };
+    const void *sources[MODEL_BUFFERS_COUNT] = {
+        vertices,
+        NULL,
+        indices,
+        modelData.meshlets,
+        modelData.meshletVertices,
+        modelData.meshletTriangles,
+    };
+
+    // バッファを作成する
+    //
+    // NOTE: 一度アップロードしたら書き換えないため、デバイスローカルメモリ(MEMORY_USAGE_GPU_ONLY)に置き、ステージングバッファからコピーする。
+    for (uint32_t i = 0; i < buffersCount; ++i) {
+        CHECK(sizes[i] > 0, "バッファのデータが空");
+        *buffers[i] = createBuffer(
             device,
-            physDevMemProps,
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-            verticesSize            
+            allocator,
+            usages[i] | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            MEMORY_USAGE_GPU_ONLY,
+            sizes[i]
         );
-        CHECK(model->vtxBuffer != NULL, "頂点バッファの作成に失敗");
-        CHECK(uploadToDeviceMemory(device, model->vtxBuffer->devMemory, vertices, verticesSize), "頂点データのアップロードに失敗");
+        CHECK(*buffers[i] != NULL, "バッファの作成に失敗");
     }
 
-    // インデックスバッファを作成しアップロードする
+    // アップロードする
     {
-        model->idxBuffer = createBuffer(
-            device,
-            physDevMemProps,
-            VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-            indicesSize            
+        Buffer dsts[MODEL_BUFFERS_COUNT];
+        for (uint32_t i = 0; i < buffersCount; ++i) {
+            dsts[i] = *buffers[i];
+        }
+        CHECK(
+            uploadModelBuffers(device, allocator, queue, cmdPool, &modelData, buffersCount, dsts, sizes, sources),
+            "モデルデータのアップロードに失敗"
         );
-        CHECK(model->idxBuffer != NULL, "インデックスバッファの作成に失敗");
-        CHECK(uploadToDeviceMemory(device, model->idxBuffer->devMemory, indices, indicesSize), "インデックスデータのアップロードに失敗");
     }
 
     // データを解放する
+    //
+    // NOTE: deleteModel()関数で再び解放しないようNULLにしておく。
     {
         free((void *)model->data);
+        model->data = NULL;
     }
 
-    // インデックス数を格納する
+    // 頂点データの形式とインデックス数とLODを格納する
     {
-        model->indicesCount = indicesCount;
+        model->flags = modelData.flags;
+        model->sizePerVertex = modelData.sizePerVertex;
+        model->indicesCount = (int)modelData.lods[0].indicesCount;
+        model->lodsCount = modelData.lodsCount;
+        model->meshletsCount = modelData.meshletsCount;
+        memcpy((void *)model->lods, (const void *)modelData.lods, sizeof(ModelLod) * modelData.lodsCount);
     }
 
     return model;
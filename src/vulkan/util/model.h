@@ -5,23 +5,144 @@
 
 #include "memory/buffer.h"
 
+#include <stdint.h>
 #include <vulkan/vulkan.h>
 
+/// @brief 頂点データに法線ベクトルが含まれることを表すフラグ
+#define MODEL_FLAG_NORMAL 0x1
+
+/// @brief 頂点データにUV座標が含まれることを表すフラグ
+#define MODEL_FLAG_UV 0x2
+
+/// @brief インデックスデータの後ろにLODの表が続くことを表すフラグ
+#define MODEL_FLAG_LOD 0x4
+
+/// @brief LODの表の後ろにLOD0のメッシュレットが続くことを表すフラグ
+#define MODEL_FLAG_MESHLET 0x8
+
+/// @brief 一つのモデルが持てるLODの最大数 (LOD0を含む)
+#define MODEL_MAX_LODS 8
+
+/// @brief メッシュレット一つあたりの頂点数の上限
+#define MODEL_MESHLET_MAX_VERTICES 64
+
+/// @brief メッシュレット一つあたりの三角形数の上限
+#define MODEL_MESHLET_MAX_TRIANGLES 124
+
+/// @brief 一つのLODのインデックスデータの範囲と誤差
+typedef struct ModelLod_t {
+    // インデックスバッファ内の先頭のインデックス
+    uint32_t firstIndex;
+    uint32_t indicesCount;
+    // 元のモデルからの誤差の上限 (モデル空間での距離。LOD0は0)
+    float error;
+} ModelLod;
+
+/// @brief 一つのメッシュレット (モデルデータファイルとシェーダでの並びと同じ)
+typedef struct ModelMeshlet_t {
+    // メッシュレットの頂点の配列内の先頭と個数
+    uint32_t vertexOffset;
+    uint32_t vertexCount;
+    // メッシュレットの三角形の配列内の先頭と個数
+    uint32_t triangleOffset;
+    uint32_t triangleCount;
+    // 境界球 (中心xyz, 半径)
+    float sphere[4];
+    // 法線の円錐 (軸xyz, cutoff)
+    //
+    // NOTE: 視点から中心への向きと軸の成すcosがcutoffを超えれば、全ての三角形が裏を向いている。
+    float cone[4];
+} ModelMeshlet;
+
 typedef struct Model_t {
+    // 一頂点にどのデータが含まれるかのフラグ (MODEL_FLAG_*)
+    uint32_t flags;
+    // 一頂点あたりのfloatの数
+    uint32_t sizePerVertex;
+    // LOD0のインデックス数
     int indicesCount;
+    // LODの数 (LODの表を持たなければ1)
+    uint32_t lodsCount;
+    // 詳細な順に並んだLOD
+    ModelLod lods[MODEL_MAX_LODS];
+    // LOD0のメッシュレットの数 (メッシュレットを持たなければ0)
+    uint32_t meshletsCount;
     Buffer vtxBuffer;
+    // ローカル座標(float * 3)のみを詰めた頂点バッファ
+    //
+    // NOTE: 深度プリパスで用いる。読む頂点データが小さくなり、頂点の取得にかかる帯域とキャッシュを節約できる。
+    Buffer posBuffer;
     Buffer idxBuffer;
+    // メッシュレット(ModelMeshlet)・メッシュレットの頂点・メッシュレットの三角形のストレージバッファ
+    //
+    // NOTE: メッシュレットを持たなければNULL。
+    Buffer meshletBuffer;
+    Buffer meshletVtxBuffer;
+    Buffer meshletTriBuffer;
     const char *data;
 } *Model;
 
+/// @brief モデルデータファイルの内容を解釈した結果
+///
+/// 配列はいずれも解釈元のデータを指し、所有しない。
+typedef struct ModelData_t {
+    // 一頂点にどのデータが含まれるかのフラグ (MODEL_FLAG_*)
+    uint32_t flags;
+    // 一頂点あたりのfloatの数
+    uint32_t sizePerVertex;
+    uint32_t verticesCount;
+    const float *vertices;
+    // 全てのLODのインデックス数の合計
+    uint32_t indicesCount;
+    const uint32_t *indices;
+    // LODの数 (LODの表を持たなければ1であり、lods[0]がインデックスデータ全体を指す)
+    uint32_t lodsCount;
+    ModelLod lods[MODEL_MAX_LODS];
+    // LOD0のメッシュレット (メッシュレットを持たなければmeshletsCountが0)
+    uint32_t meshletsCount;
+    const ModelMeshlet *meshlets;
+    // 頂点インデックスの配列
+    uint32_t meshletVerticesCount;
+    const uint32_t *meshletVertices;
+    // メッシュレット内の頂点の番号を8ビットずつ詰めた三角形の配列
+    uint32_t meshletTrianglesCount;
+    const uint32_t *meshletTriangles;
+} ModelData;
+
+/// @brief モデルデータファイルの内容を解釈する関数
+///
+/// デバイスを必要としない。
+/// 頂点数やインデックス数がデータのサイズを超えていればエラーとする。
+/// LODの表があれば、各LODの範囲がインデックスデータに収まることも確かめる。
+/// メッシュレットがあれば、各メッシュレットの範囲と頂点の番号が収まることも確かめる。
+///
+/// @param data モデルデータファイルの内容 (4バイト境界に揃っていること)
+/// @param size dataのサイズ
+/// @param modelData 解釈結果の格納先
+/// @returns 失敗時に0を返す。
+int parseModelData(const char *data, long int size, ModelData *modelData);
+
 /// @brief Modelを破棄する関数
 /// @param device 論理デバイス
 /// @param model モデルハンドル
 void deleteModel(const VkDevice device, Model model);
 
 /// @brief モデルデータファイルからモデルを作成する関数
+///
+/// 頂点データをそのまま持つ頂点バッファの他に、ローカル座標のみを詰めた頂点バッファも作成する。
+/// メッシュレットを持つならば、そのストレージバッファも作成する。
+/// バッファはデバイスローカルメモリに置き、ステージングバッファからのコピーをqueueへ提出して完了まで待機する。
+///
 /// @param device 論理デバイス
-/// @param physDevMemProps 物理デバイス上のメモリプロパティ
+/// @param allocator メモリ集計オブジェクトハンドル
+/// @param queue コピーを提出するキュー
+/// @param cmdPool コピーのコマンドバッファを確保するコマンドプール (queueのキューファミリーのもの)
 /// @param path ファイルパス
 /// @returns 失敗時にNULLを返す。
-Model createModelFromFile(const VkDevice device, const VkPhysicalDeviceMemoryProperties *physDevMemProps, const char *path);
+Model createModelFromFile(
+    const VkDevice device,
+    MemoryAllocator allocator,
+    VkQueue queue,
+    VkCommandPool cmdPool,
+    const char *path
+);
@@ -0,0 +1,864 @@
+#include "pipeline.h"
+
+#include "error.h"
+#include "file.h"
+#include "profiler.h"
+#include "timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// NOTE: 詰めたキーのビット配置は次の通り。
+//       最上位ビットは常に1とし、0を空きを表す値として使えるようにする。
+#define KEY_BLEND_SHIFT    0
+#define KEY_BLEND_BITS     2
+#define KEY_CULL_SHIFT     2
+#define KEY_CULL_BITS      2
+#define KEY_TOPOLOGY_SHIFT 4
+#define KEY_TOPOLOGY_BITS  4
+#define KEY_STRIDE_SHIFT   8
+#define KEY_STRIDE_BITS    16
+#define KEY_FEATURES_SHIFT 24
+#define KEY_FEATURES_BITS  PIPELINE_VARIANT_MAX_FEATURES
+#define KEY_DEPTH_SHIFT    40
+#define KEY_DEPTH_BITS     2
+#define KEY_VALID_BIT      (1ULL << 63)
+
+#define KEY_FIELD(v, s, b) (((uint64_t)(v) & ((1ULL << (b)) - 1)) << (s))
+#define KEY_FITS(v, b)     ((uint64_t)(v) < (1ULL << (b)))
+#define KEY_GET(k, s, b)   (uint32_t)(((k) >> (s)) & ((1ULL << (b)) - 1))
+
+uint64_t packPipelineVariantKey(const PipelineVariantKey *key) {
+    if (!KEY_FITS(key->blendMode, KEY_BLEND_BITS)
+        || !KEY_FITS(key->cullMode, KEY_CULL_BITS)
+        || !KEY_FITS(key->topology, KEY_TOPOLOGY_BITS)
+        || !KEY_FITS(key->vertexStride, KEY_STRIDE_BITS)
+        || !KEY_FITS(key->features, KEY_FEATURES_BITS)
+        || !KEY_FITS(key->depthMode, KEY_DEPTH_BITS))
+    {
+        return 0;
+    }
+    return KEY_VALID_BIT
+        | KEY_FIELD(key->blendMode, KEY_BLEND_SHIFT, KEY_BLEND_BITS)
+        | KEY_FIELD(key->cullMode, KEY_CULL_SHIFT, KEY_CULL_BITS)
+        | KEY_FIELD(key->topology, KEY_TOPOLOGY_SHIFT, KEY_TOPOLOGY_BITS)
+        | KEY_FIELD(key->vertexStride, KEY_STRIDE_SHIFT, KEY_STRIDE_BITS)
+        | KEY_FIELD(key->features, KEY_FEATURES_SHIFT, KEY_FEATURES_BITS)
+        | KEY_FIELD(key->depthMode, KEY_DEPTH_SHIFT, KEY_DEPTH_BITS);
+}
+
+// 詰めたキーを元に戻す関数
+static void unpackPipelineVariantKey(uint64_t packed, PipelineVariantKey *key) {
+    key->blendMode = (PipelineBlendMode)KEY_GET(packed, KEY_BLEND_SHIFT, KEY_BLEND_BITS);
+    key->cullMode = (VkCullModeFlags)KEY_GET(packed, KEY_CULL_SHIFT, KEY_CULL_BITS);
+    key->topology = (VkPrimitiveTopology)KEY_GET(packed, KEY_TOPOLOGY_SHIFT, KEY_TOPOLOGY_BITS);
+    key->vertexStride = KEY_GET(packed, KEY_STRIDE_SHIFT, KEY_STRIDE_BITS);
+    key->features = KEY_GET(packed, KEY_FEATURES_SHIFT, KEY_FEATURES_BITS);
+    key->depthMode = (PipelineDepthMode)KEY_GET(packed, KEY_DEPTH_SHIFT, KEY_DEPTH_BITS);
+}
+
+#undef KEY_GET
+#undef KEY_FITS
+#undef KEY_FIELD
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// 詰めたキーからハッシュマップの開始位置を求める関数
+//
+// NOTE: キーの下位ビットには偏りがあるため、黄金比に基づく乗算で上位ビットへ混ぜてから使う。
+static uint32_t hashKey(uint64_t key, uint32_t capacity) {
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (capacity - 1);
+}
+
+// キーに対応する要素を探す関数
+//
+// NOTE: ミューテックスをロックしてから呼ぶこと。
+static PipelineVariantEntry *findEntry(PipelineVariants variants, uint64_t key) {
+    if (variants->entriesCapacity == 0) {
+        return NULL;
+    }
+    uint32_t i = hashKey(key, variants->entriesCapacity);
+    while (variants->entries[i].key != 0) {
+        if (variants->entries[i].key == key) {
+            return &variants->entries[i];
+        }
+        i = (i + 1) & (variants->entriesCapacity - 1);
+    }
+    return NULL;
+}
+
+// キーに対応する空の要素を追加する関数
+//
+// NOTE: ミューテックスをロックしてから呼ぶこと。
+//       要素数が容量の7割を超えないように、容量を倍にしてから追加する。
+static PipelineVariantEntry *insertEntry(PipelineVariants variants, uint64_t key) {
+    if ((variants->entriesCount + 1) * 10 > variants->entriesCapacity * 7) {
+        const uint32_t capacity = variants->entriesCapacity > 0 ? variants->entriesCapacity * 2 : 16;
+        PipelineVariantEntry *entries = (PipelineVariantEntry *)malloc(sizeof(PipelineVariantEntry) * capacity);
+        if (entries == NULL) {
+            return NULL;
+        }
+        memset(entries, 0, sizeof(PipelineVariantEntry) * capacity);
+        for (uint32_t i = 0; i < variants->entriesCapacity; ++i) {
+            const PipelineVariantEntry *src = &variants->entries[i];
+            if (src->key == 0) {
+                continue;
+            }
+            uint32_t j = hashKey(src->key, capacity);
+            while (entries[j].key != 0) {
+                j = (j + 1) & (capacity - 1);
+            }
+            entries[j] = *src;
+        }
+        free((void *)variants->entries);
+        variants->entries = entries;
+        variants->entriesCapacity = capacity;
+    }
+    uint32_t i = hashKey(key, variants->entriesCapacity);
+    while (variants->entries[i].key != 0) {
+        i = (i + 1) & (variants->entriesCapacity - 1);
+    }
+    variants->entries[i].key = key;
+    variants->entries[i].pipeline = NULL;
+    variants->entries[i].failed = 0;
+    variants->entriesCount += 1;
+    return &variants->entries[i];
+}
+
+// キーに対応する要素を取り除く関数
+//
+// NOTE: ミューテックスをロックしてから呼ぶこと。
+//       線形探索が途切れないように、後続の要素を本来の位置へ近づけるよう詰め直す。
+static void removeEntry(PipelineVariants variants, uint64_t key) {
+    PipelineVariantEntry *entry = findEntry(variants, key);
+    if (entry == NULL) {
+        return;
+    }
+    const uint32_t mask = variants->entriesCapacity - 1;
+    uint32_t hole = (uint32_t)(entry - variants->entries);
+    uint32_t i = (hole + 1) & mask;
+    while (variants->entries[i].key != 0) {
+        const uint32_t home = hashKey(variants->entries[i].key, variants->entriesCapacity);
+        // NOTE: 本来の位置からholeまでの距離がiまでの距離以下なら、holeへ移しても探索できる。
+        if (((hole - home) & mask) <= ((i - home) & mask)) {
+            variants->entries[hole] = variants->entries[i];
+            hole = i;
+        }
+        i = (i + 1) & mask;
+    }
+    memset(&variants->entries[hole], 0, sizeof(PipelineVariantEntry));
+    variants->entriesCount -= 1;
+}
+
+// 作成したパイプラインを要素に格納し、待機しているスレッドに通知する関数
+static void completeEntry(PipelineVariants variants, uint64_t key, VkPipeline pipeline) {
+    lockMutex(variants->mutex);
+    PipelineVariantEntry *entry = findEntry(variants, key);
+    if (entry != NULL) {
+        entry->pipeline = pipeline;
+        entry->failed = pipeline == NULL;
+    }
+    broadcastCondVar(variants->compiled);
+    unlockMutex(variants->mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// バリアントのパイプラインを作成する関数
+//
+// NOTE: PipelineVariantsの状態には触れないため、ミューテックスをロックせずにどのスレッドからでも呼べる。
+//       パイプラインキャッシュは外部同期を要しない。
+static VkPipeline createVariantPipeline(const PipelineVariants variants, uint64_t packed) {
+#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "createVariantPipeline()", (m), (p), {}, NULL)
+#define CHECK(p, m)    ERROR_IF     (!(p),              "createVariantPipeline()", (m),      {}, NULL)
+#define SHADERS_COUNT 2
+#define VERT_INP_BIND_DESCS_COUNT 1
+#define VIEWPORTS_COUNT 1
+#define COLOR_BLEND_ATTACHMENTS_COUNT 1
+
+    const PipelineVariantsBase *base = &variants->base;
+    PipelineVariantKey key;
+    unpackPipelineVariantKey(packed, &key);
+
+    // 特殊化定数
+    //
+    // NOTE: 機能フラグはシェーダ内の分岐ではなく特殊化定数で与える。
+    //       ドライバが定数として畳み込むため、無効な機能のコードはパイプラインから取り除かれる。
+    //       シェーダが宣言していないconstant_idの要素は無視される。
+    VkBool32 specData[PIPELINE_VARIANT_MAX_FEATURES];
+    VkSpecializationMapEntry specEntries[PIPELINE_VARIANT_MAX_FEATURES];
+    for (uint32_t i = 0; i < PIPELINE_VARIANT_MAX_FEATURES; ++i) {
+        specData[i] = (key.features >> i) & 1 ? VK_TRUE : VK_FALSE;
+        specEntries[i].constantID = i;
+        specEntries[i].offset = (uint32_t)(sizeof(VkBool32) * i);
+        specEntries[i].size = sizeof(VkBool32);
+    }
+    const VkSpecializationInfo specInfo = {
+        PIPELINE_VARIANT_MAX_FEATURES,
+        specEntries,
+        sizeof(specData),
+        (const void *)specData,
+    };
+
+    // シェーダステージ
+    //
+    // NOTE: フラグメントシェーダが無ければ、ヴァーテックスシェーダのみのステージとする。
+    const uint32_t shadersCount = base->fragShader != NULL ? SHADERS_COUNT : 1;
+    const VkPipelineShaderStageCreateInfo shaderCIs[SHADERS_COUNT] = {
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            NULL,
+            0,
+            VK_SHADER_STAGE_VERTEX_BIT,
+            base->vertShader->module,
+            "main",
+            &specInfo,
+        },
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            NULL,
+            0,
+            VK_SHADER_STAGE_FRAGMENT_BIT,
+            base->fragShader != NULL ? base->fragShader->module : NULL,
+            "main",
+            &specInfo,
+        },
+    };
+
+    // 頂点入力ステート
+    VkVertexInputAttributeDescription vertInpAttrDescs[SHADER_REFLECTION_MAX_INPUTS];
+    uint32_t vertInpStride = 0;
+    const uint32_t vertInpAttrDescsCount = buildVertexInputAttributes(base->vertShader, 0, vertInpAttrDescs, &vertInpStride);
+    if (key.vertexStride != 0) {
+        CHECK(key.vertexStride >= vertInpStride, "頂点一つあたりのサイズが頂点入力より小さい");
+        vertInpStride = key.vertexStride;
+    }
+    const VkVertexInputBindingDescription vertInpBindDescs[VERT_INP_BIND_DESCS_COUNT] = {
+        { 0, vertInpStride, VK_VERTEX_INPUT_RATE_VERTEX },
+    };
+    const VkPipelineVertexInputStateCreateInfo vertInpCI = {
+        VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        NULL,
+        0,
+        VERT_INP_BIND_DESCS_COUNT,
+        vertInpBindDescs,
+        vertInpAttrDescsCount,
+        vertInpAttrDescs,
+    };
+
+    // 入力アセンブリステート
+    const VkPipelineInputAssemblyStateCreateInfo inpAssemCI = {
+        VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        NULL,
+        0,
+        key.topology,
+        VK_FALSE,
+    };
+
+    // ビューポートステート
+    const VkViewport viewports[VIEWPORTS_COUNT] = {
+        { 0.0f, 0.0f, (float)base->width, (float)base->height, 0.0f, 1.0f },
+    };
+    const VkRect2D scissors[VIEWPORTS_COUNT] = {
+        { {0, 0}, {base->width, base->height} },
+    };
+    const VkPipelineViewportStateCreateInfo viewportCI = {
+        VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        NULL,
+        0,
+        VIEWPORTS_COUNT,
+        viewports,
+        VIEWPORTS_COUNT,
+        scissors,
+    };
+
+    // ラスタライゼーションステート
+    const VkPipelineRasterizationStateCreateInfo rasterCI = {
+        VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        NULL,
+        0,
+        VK_FALSE,
+        VK_FALSE,
+        VK_POLYGON_MODE_FILL,
+        key.cullMode,
+        VK_FRONT_FACE_COUNTER_CLOCKWISE,
+        VK_FALSE,
+        0.0f,
+        0.0f,
+        0.0f,
+        1.0f,
+    };
+
+    // マルチサンプルステート
+    const VkPipelineMultisampleStateCreateInfo multisampleCI = {
+        VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        NULL,
+        0,
+        base->samples,
+        VK_FALSE,
+        0.0f,
+        NULL,
+        VK_FALSE,
+        VK_FALSE,
+    };
+
+    // 深度ステンシルステート
+    //
+    // NOTE: 深度の比較にLESSではなくLESS_OR_EQUALを用いるのは、深度プリパスの後で同じ深度を書き込み直しても通すため。
+    const VkPipelineDepthStencilStateCreateInfo depthStencilCI = {
+        VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        NULL,
+        0,
+        key.depthMode != PIPELINE_DEPTH_MODE_NONE ? VK_TRUE : VK_FALSE,
+        key.depthMode == PIPELINE_DEPTH_MODE_TEST_WRITE ? VK_TRUE : VK_FALSE,
+        key.depthMode == PIPELINE_DEPTH_MODE_EQUAL ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS_OR_EQUAL,
+        VK_FALSE,
+        VK_FALSE,
+        { 0 },
+        { 0 },
+        0.0f,
+        1.0f,
+    };
+
+    // カラーブレンドステート
+    //
+    // NOTE: フラグメントシェーダが無ければ出力は未定義となるため、カラーアタッチメントに書き込まない。
+    VkPipelineColorBlendAttachmentState colorBlendAttchs[COLOR_BLEND_ATTACHMENTS_COUNT] = {
+        {
+            VK_FALSE,
+            VK_BLEND_FACTOR_ONE,
+            VK_BLEND_FACTOR_ZERO,
+            VK_BLEND_OP_ADD,
+            VK_BLEND_FACTOR_ONE,
+            VK_BLEND_FACTOR_ZERO,
+            VK_BLEND_OP_ADD,
+            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+        }
+    };
+    switch (key.blendMode) {
+    case PIPELINE_BLEND_MODE_ALPHA:
+        colorBlendAttchs[0].blendEnable = VK_TRUE;
+        colorBlendAttchs[0].srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        colorBlendAttchs[0].dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        colorBlendAttchs[0].srcAlphaBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        colorBlendAttchs[0].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        break;
+    case PIPELINE_BLEND_MODE_ADDITIVE:
+        colorBlendAttchs[0].blendEnable = VK_TRUE;
+        colorBlendAttchs[0].srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        colorBlendAttchs[0].dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttchs[0].srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+        colorBlendAttchs[0].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        break;
+    default:
+        break;
+    }
+    if (base->fragShader == NULL) {
+        colorBlendAttchs[0].blendEnable = VK_FALSE;
+        colorBlendAttchs[0].colorWriteMask = 0;
+    }
+    const VkPipelineColorBlendStateCreateInfo colorBlendCI = {
+        VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        NULL,
+        0,
+        VK_FALSE,
+        (VkLogicOp)0,
+        COLOR_BLEND_ATTACHMENTS_COUNT,
+        colorBlendAttchs,
+        {0.0f, 0.0f, 0.0f, 0.0f},
+    };
+
+    const VkGraphicsPipelineCreateInfo ci = {
+        VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        NULL,
+        0,
+        shadersCount,
+        shaderCIs,
+        &vertInpCI,
+        &inpAssemCI,
+        NULL,
+        &viewportCI,
+        &rasterCI,
+        &multisampleCI,
+        &depthStencilCI,
+        &colorBlendCI,
+        NULL,
+        base->layout,
+        base->renderPass,
+        base->subpass,
+        NULL,
+        0,
+    };
+    VkPipeline pipeline = NULL;
+    CHECK_VK(vkCreateGraphicsPipelines(variants->device, variants->pipelineCache, 1, &ci, NULL, &pipeline), "パイプラインの作成に失敗");
+
+    return pipeline;
+
+#undef COLOR_BLEND_ATTACHMENTS_COUNT
+#undef VIEWPORTS_COUNT
+#undef VERT_INP_BIND_DESCS_COUNT
+#undef SHADERS_COUNT
+#undef CHECK
+#undef CHECK_VK
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define MS(ns) ((double)(ns) / 1000000.0)
+
+// 統計に作成一回分を加える関数
+//
+// NOTE: compiler->mutexをロックしてから呼ぶこと。
+static void recordPipelineCompile(PipelineCompiler compiler, uint64_t compileNs, uint64_t latencyNs, int failed) {
+    if (failed) {
+        compiler->failedCount += 1;
+        return;
+    }
+    compiler->compiledCount += 1;
+    compiler->totalCompileNs += compileNs;
+    compiler->totalLatencyNs += latencyNs;
+    if (compileNs > compiler->maxCompileNs) {
+        compiler->maxCompileNs = compileNs;
+    }
+    if (latencyNs > compiler->maxLatencyNs) {
+        compiler->maxLatencyNs = latencyNs;
+    }
+}
+
+// 要求を待ち行列に入れる関数
+//
+// NOTE: frontが1なら待ち行列の先頭に入れ、他の要求より先に処理させる。
+//
+// NOTE: variants->mutexをロックしたまま呼んでよい。
+//       ロックの順序は常にvariants->mutex、compiler->mutexの順とし、デッドロックを防ぐ。
+static int enqueuePipelineCompileJob(PipelineCompiler compiler, PipelineVariants variants, uint64_t key, int front) {
+    lockMutex(compiler->mutex);
+    if (compiler->jobsCount >= PIPELINE_COMPILER_MAX_JOBS) {
+        unlockMutex(compiler->mutex);
+        return 0;
+    }
+    uint32_t index;
+    if (front) {
+        compiler->jobsHead = (compiler->jobsHead + PIPELINE_COMPILER_MAX_JOBS - 1) % PIPELINE_COMPILER_MAX_JOBS;
+        index = compiler->jobsHead;
+    } else {
+        index = (compiler->jobsHead + compiler->jobsCount) % PIPELINE_COMPILER_MAX_JOBS;
+    }
+    compiler->jobs[index].variants = variants;
+    compiler->jobs[index].key = key;
+    compiler->jobs[index].requestedNs = getTimeNs();
+    compiler->jobsCount += 1;
+    variants->jobsCount += 1;
+    signalCondVar(compiler->queued);
+    unlockMutex(compiler->mutex);
+    return 1;
+}
+
+// ワーカースレッドの処理
+//
+// NOTE: 待ち行列から要求を一つずつ取り出して作成する。
+//       作成中はミューテックスをアンロックし、他のワーカースレッドや描画スレッドを妨げないようにする。
+//
+// NOTE: 作成したパイプラインをPipelineVariantsに格納してからjobsCountを減らす。
+//       jobsCountが0になった後はPipelineVariantsが破棄されうるため、以降は触れてはならない。
+static void runPipelineCompilerWorker(void *arg) {
+    const PipelineCompiler compiler = (PipelineCompiler)arg;
+    PROFILE_THREAD_NAME("pipeline-compiler");
+    lockMutex(compiler->mutex);
+    while (1) {
+        while (!compiler->quit && compiler->jobsCount == 0) {
+            waitCondVar(compiler->queued, compiler->mutex);
+        }
+        if (compiler->quit) {
+            break;
+        }
+        const PipelineCompileJob job = compiler->jobs[compiler->jobsHead];
+        compiler->jobsHead = (compiler->jobsHead + 1) % PIPELINE_COMPILER_MAX_JOBS;
+        compiler->jobsCount -= 1;
+        compiler->runningCount += 1;
+        unlockMutex(compiler->mutex);
+
+        PROFILE_ZONE_BEGIN("createVariantPipeline");
+        const uint64_t startNs = getTimeNs();
+        const VkPipeline pipeline = createVariantPipeline(job.variants, job.key);
+        const uint64_t endNs = getTimeNs();
+        PROFILE_ZONE_END("createVariantPipeline");
+        completeEntry(job.variants, job.key, pipeline);
+
+        lockMutex(compiler->mutex);
+        recordPipelineCompile(compiler, endNs - startNs, endNs - job.requestedNs, pipeline == NULL);
+        job.variants->jobsCount -= 1;
+        compiler->runningCount -= 1;
+        broadcastCondVar(compiler->finished);
+    }
+    unlockMutex(compiler->mutex);
+}
+
+void deletePipelineCompiler(PipelineCompiler compiler) {
+    if (compiler == NULL) {
+        return;
+    }
+    if (compiler->mutex != NULL) {
+        lockMutex(compiler->mutex);
+        compiler->quit = 1;
+        if (compiler->queued != NULL) broadcastCondVar(compiler->queued);
+        unlockMutex(compiler->mutex);
+    }
+    for (uint32_t i = 0; i < compiler->workersCount; ++i) {
+        joinThread(compiler->workers[i]);
+    }
+    if (compiler->finished != NULL) deleteCondVar(compiler->finished);
+    if (compiler->queued != NULL) deleteCondVar(compiler->queued);
+    if (compiler->mutex != NULL) deleteMutex(compiler->mutex);
+    free((void *)compiler);
+}
+
+PipelineCompiler createPipelineCompiler(uint32_t workersCount) {
+#define CHECK(p, m) ERROR_IF(!(p), "createPipelineCompiler()", (m), deletePipelineCompiler(compiler), NULL)
+
+    const PipelineCompiler compiler = (PipelineCompiler)malloc(sizeof(struct PipelineCompiler_t));
+    CHECK(compiler != NULL, "PipelineCompilerの確保に失敗");
+    memset(compiler, 0, sizeof(struct PipelineCompiler_t));
+
+    // 同期プリミティブを作成する
+    {
+        compiler->mutex = createMutex();
+        CHECK(compiler->mutex != NULL, "ミューテックスの作成に失敗");
+        compiler->queued = createCondVar();
+        CHECK(compiler->queued != NULL, "条件変数の作成に失敗");
+        compiler->finished = createCondVar();
+        CHECK(compiler->finished != NULL, "条件変数の作成に失敗");
+    }
+
+    // ワーカースレッドを開始する
+    //
+    // NOTE: 描画スレッドの分として論理プロセッサを一つ残す。
+    //       ドライバによってはパイプラインの作成を内部で直列化するため、多すぎても速くならない。
+    {
+        if (workersCount == 0) {
+            const uint32_t processorsCount = getProcessorsCount();
+            workersCount = processorsCount > 1 ? processorsCount - 1 : 1;
+        }
+        if (workersCount > PIPELINE_COMPILER_MAX_WORKERS) {
+            workersCount = PIPELINE_COMPILER_MAX_WORKERS;
+        }
+        for (uint32_t i = 0; i < workersCount; ++i) {
+            compiler->workers[i] = createThread(runPipelineCompilerWorker, (void *)compiler);
+            CHECK(compiler->workers[i] != NULL, "ワーカースレッドの作成に失敗");
+            compiler->workersCount += 1;
+        }
+    }
+
+    return compiler;
+
+#undef CHECK
+}
+
+void waitPipelineCompilerIdle(PipelineCompiler compiler) {
+    lockMutex(compiler->mutex);
+    while (compiler->jobsCount > 0 || compiler->runningCount > 0) {
+        waitCondVar(compiler->finished, compiler->mutex);
+    }
+    unlockMutex(compiler->mutex);
+}
+
+void printPipelineCompilerStats(PipelineCompiler compiler) {
+    lockMutex(compiler->mutex);
+    const uint64_t count = compiler->compiledCount > 0 ? compiler->compiledCount : 1;
+    printf(
+        "[ info ] pipeline: workers=%u compiled=%llu failed=%llu compile-avg=%.2fms compile-max=%.2fms latency-avg=%.2fms latency-max=%.2fms\n",
+        compiler->workersCount,
+        (unsigned long long)compiler->compiledCount,
+        (unsigned long long)compiler->failedCount,
+        MS(compiler->totalCompileNs / count),
+        MS(compiler->maxCompileNs),
+        MS(compiler->totalLatencyNs / count),
+        MS(compiler->maxLatencyNs)
+    );
+    unlockMutex(compiler->mutex);
+}
+
+#undef MS
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void deletePipelineVariants(const VkDevice device, PipelineVariants variants) {
+    if (variants == NULL) {
+        return;
+    }
+
+    // PipelineCompilerへの要求を取り消す
+    //
+    // NOTE: 待ち行列に残る要求は取り除き、処理中の要求は完了を待つ。
+    if (variants->compiler != NULL && variants->compiler->mutex != NULL) {
+        const PipelineCompiler compiler = variants->compiler;
+        lockMutex(compiler->mutex);
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < compiler->jobsCount; ++i) {
+            const PipelineCompileJob job = compiler->jobs[(compiler->jobsHead + i) % PIPELINE_COMPILER_MAX_JOBS];
+            if (job.variants == variants) {
+                variants->jobsCount -= 1;
+                continue;
+            }
+            compiler->jobs[(compiler->jobsHead + kept) % PIPELINE_COMPILER_MAX_JOBS] = job;
+            kept += 1;
+        }
+        compiler->jobsCount = kept;
+        while (variants->jobsCount > 0) {
+            waitCondVar(compiler->finished, compiler->mutex);
+        }
+        broadcastCondVar(compiler->finished);
+        unlockMutex(compiler->mutex);
+    }
+
+    if (variants->entries != NULL) {
+        for (uint32_t i = 0; i < variants->entriesCapacity; ++i) {
+            if (variants->entries[i].pipeline != NULL) vkDestroyPipeline(device, variants->entries[i].pipeline, NULL);
+        }
+        free((void *)variants->entries);
+    }
+    if (variants->compiled != NULL) deleteCondVar(variants->compiled);
+    if (variants->mutex != NULL) deleteMutex(variants->mutex);
+    free((void *)variants);
+}
+
+PipelineVariants createPipelineVariants(
+    const VkDevice device,
+    const VkPipelineCache pipelineCache,
+    PipelineCompiler compiler,
+    const PipelineVariantsBase *base
+) {
+#define CHECK(p, m) ERROR_IF(!(p), "createPipelineVariants()", (m), deletePipelineVariants(device, variants), NULL)
+
+    const PipelineVariants variants = (PipelineVariants)malloc(sizeof(struct PipelineVariants_t));
+    CHECK(variants != NULL, "PipelineVariantsの確保に失敗");
+    memset(variants, 0, sizeof(struct PipelineVariants_t));
+    variants->device = device;
+    variants->pipelineCache = pipelineCache;
+    variants->compiler = compiler;
+    variants->base = *base;
+
+    // 同期プリミティブを作成する
+    {
+        variants->mutex = createMutex();
+        CHECK(variants->mutex != NULL, "ミューテックスの作成に失敗");
+        variants->compiled = createCondVar();
+        CHECK(variants->compiled != NULL, "条件変数の作成に失敗");
+    }
+
+    return variants;
+
+#undef CHECK
+}
+
+VkPipeline getPipelineVariant(PipelineVariants variants, const PipelineVariantKey *key) {
+#define CHECK(p, m) ERROR_IF(!(p), "getPipelineVariant()", (m), {}, NULL)
+
+    const uint64_t packed = packPipelineVariantKey(key);
+    CHECK(packed != 0, "バリアントの状態が表現できない値を含む");
+
+    // 既に要求されたバリアントを探す
+    //
+    // NOTE: ワーカースレッドで作成中ならば、完了するまで待機する。
+    //       待機中にハッシュマップが拡張されうるため、起きるたびに探し直す。
+    lockMutex(variants->mutex);
+    PipelineVariantEntry *entry = findEntry(variants, packed);
+    if (entry != NULL) {
+        while (entry->pipeline == NULL && !entry->failed) {
+            waitCondVar(variants->compiled, variants->mutex);
+            entry = findEntry(variants, packed);
+        }
+        const VkPipeline pipeline = entry->pipeline;
+        variants->hitsCount += 1;
+        unlockMutex(variants->mutex);
+        return pipeline;
+    }
+
+    // 作成中として登録する
+    entry = insertEntry(variants, packed);
+    variants->missesCount += 1;
+    unlockMutex(variants->mutex);
+    CHECK(entry != NULL, "ハッシュマップの拡張に失敗");
+
+    // 呼び出したスレッドで作成する
+    const uint64_t startNs = getTimeNs();
+    const VkPipeline pipeline = createVariantPipeline(variants, packed);
+    const uint64_t endNs = getTimeNs();
+    completeEntry(variants, packed, pipeline);
+    if (variants->compiler != NULL) {
+        lockMutex(variants->compiler->mutex);
+        recordPipelineCompile(variants->compiler, endNs - startNs, endNs - startNs, pipeline == NULL);
+        unlockMutex(variants->compiler->mutex);
+    }
+
+    return pipeline;
+
+#undef CHECK
+}
+
+// 作成済みの代替のバリアントを探す関数
+//
+// NOTE: variants->mutexをロックしてから呼ぶこと。
+static VkPipeline findFallback(PipelineVariants variants) {
+    if (variants->fallbackKey == 0) {
+        return NULL;
+    }
+    const PipelineVariantEntry *entry = findEntry(variants, variants->fallbackKey);
+    return entry != NULL ? entry->pipeline : NULL;
+}
+
+VkPipeline requestPipelineVariant(PipelineVariants variants, const PipelineVariantKey *key) {
+#define CHECK(p, m) ERROR_IF(!(p), "requestPipelineVariant()", (m), {}, NULL)
+
+    if (variants->compiler == NULL) {
+        return getPipelineVariant(variants, key);
+    }
+
+    const uint64_t packed = packPipelineVariantKey(key);
+    CHECK(packed != 0, "バリアントの状態が表現できない値を含む");
+
+    lockMutex(variants->mutex);
+
+    // 既に要求されたバリアントを探す
+    //
+    // NOTE: 作成中あるいは作成に失敗していれば、代替のバリアントを返す。
+    const PipelineVariantEntry *found = findEntry(variants, packed);
+    if (found != NULL) {
+        VkPipeline pipeline = found->pipeline;
+        if (pipeline != NULL) {
+            variants->hitsCount += 1;
+        } else {
+            pipeline = findFallback(variants);
+        }
+        unlockMutex(variants->mutex);
+        return pipeline;
+    }
+
+    // PipelineCompilerに要求する
+    //
+    // NOTE: 待ち行列が満杯ならば登録せずに諦める。次に要求されたときに改めて要求する。
+    if (insertEntry(variants, packed) != NULL) {
+        if (enqueuePipelineCompileJob(variants->compiler, variants, packed, 0)) {
+            variants->missesCount += 1;
+        } else {
+            // NOTE: 登録を取り消すため、空きに戻した上で後続の要素を詰め直す。
+            removeEntry(variants, packed);
+        }
+    }
+    const VkPipeline fallback = findFallback(variants);
+
+    unlockMutex(variants->mutex);
+    return fallback;
+
+#undef CHECK
+}
+
+int setPipelineVariantFallback(PipelineVariants variants, const PipelineVariantKey *key) {
+#define CHECK(p, m) ERROR_IF(!(p), "setPipelineVariantFallback()", (m), unlockMutex(variants->mutex), 0)
+
+    const uint64_t packed = packPipelineVariantKey(key);
+    if (packed == 0) {
+        ERROR_LOG("setPipelineVariantFallback()", "バリアントの状態が表現できない値を含む");
+        return 0;
+    }
+
+    lockMutex(variants->mutex);
+    variants->fallbackKey = packed;
+
+    // 未要求なら待ち行列の先頭に入れる
+    //
+    // NOTE: PipelineCompilerを持たなければ、最初に取得されたときに作成される。
+    if (variants->compiler != NULL && findEntry(variants, packed) == NULL) {
+        CHECK(insertEntry(variants, packed) != NULL, "ハッシュマップの拡張に失敗");
+        if (!enqueuePipelineCompileJob(variants->compiler, variants, packed, 1)) {
+            removeEntry(variants, packed);
+            CHECK(0, "待ち行列が満杯");
+        }
+        variants->missesCount += 1;
+    }
+
+    unlockMutex(variants->mutex);
+    return 1;
+
+#undef CHECK
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+VkPipelineCache loadPipelineCache(const VkDevice device, const char *path) {
+#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "loadPipelineCache()", (m), (p), free((void *)data), VK_NULL_HANDLE)
+
+    // ファイルがあれば読み込む
+    //
+    // NOTE: 初回起動時にはファイルが無いのが普通であるため、無くてもエラーとしない。
+    const char *data = NULL;
+    long int dataSize = 0;
+    if (existsFile(path)) {
+        data = readBinaryFile(path, &dataSize);
+        if (data == NULL) {
+            dataSize = 0;
+        }
+    }
+
+    // パイプラインキャッシュを作成する
+    //
+    // NOTE: 初期データのヘッダ(ベンダID・デバイスID・UUID)が一致しなければ、ドライバは初期データを無視する。
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    {
+        const VkPipelineCacheCreateInfo ci = {
+            VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+            NULL,
+            0,
+            (size_t)dataSize,
+            (const void *)data,
+        };
+        CHECK_VK(vkCreatePipelineCache(device, &ci, NULL, &pipelineCache), "パイプラインキャッシュの作成に失敗");
+    }
+
+    free((void *)data);
+
+    return pipelineCache;
+
+#undef CHECK_VK
+}
+
+int savePipelineCache(const VkDevice device, const VkPipelineCache pipelineCache, const char *path) {
+#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "savePipelineCache()", (m), (p), free(data), 0)
+#define CHECK(p, m)    ERROR_IF     (!(p),              "savePipelineCache()", (m),      free(data), 0)
+
+    void *data = NULL;
+
+    // 内容を取得する
+    size_t dataSize = 0;
+    {
+        CHECK_VK(vkGetPipelineCacheData(device, pipelineCache, &dataSize, NULL), "パイプラインキャッシュのサイズの取得に失敗");
+        data = malloc(dataSize > 0 ? dataSize : 1);
+        CHECK(data != NULL, "パイプラインキャッシュの内容のための領域の確保に失敗");
+        CHECK_VK(vkGetPipelineCacheData(device, pipelineCache, &dataSize, data), "パイプラインキャッシュの内容の取得に失敗");
+    }
+
+    // 書き出す
+    CHECK(writeBinaryFile(path, data, dataSize), "パイプラインキャッシュファイルの書出しに失敗");
+
+    free(data);
+
+    return 1;
+
+#undef CHECK
+#undef CHECK_VK
+}
@@ -0,0 +1,254 @@
+/// @file pipeline.h
+/// @brief グラフィックスパイプラインのバリアントを管理するモジュール
+///
+/// - PipelineVariantKey
+///   - ブレンドモード・カリングモード・トポロジ・頂点レイアウト・深度テスト・特殊化定数をまとめたもの
+///   - 64bitに詰めた値をハッシュマップのキーとする
+/// - PipelineCompiler
+///   - ワーカースレッドでパイプラインを作成する
+///   - 要求から作成完了までの時間を集計する
+/// - PipelineVariants
+///   - シェーダ・パイプラインレイアウト・レンダーパスを共有するパイプラインの集合
+///   - バリアントは初めて要求されたときに作成し、以降はハッシュマップから返す
+///   - PipelineCompilerに作成を任せ、完了するまでは代替のバリアントを返すこともできる
+/// - loadPipelineCache() / savePipelineCache()
+///   - パイプラインキャッシュをファイルから読み込む・ファイルへ書き出す
+
+#pragma once
+
+#include "shader.h"
+#include "thread.h"
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+/// @brief 特殊化定数として与えられる機能フラグの最大数
+#define PIPELINE_VARIANT_MAX_FEATURES 16
+
+/// @brief PipelineCompilerのワーカースレッドの最大数
+#define PIPELINE_COMPILER_MAX_WORKERS 4
+
+/// @brief PipelineCompilerの待ち行列に入れられる要求の最大数
+#define PIPELINE_COMPILER_MAX_JOBS 256
+
+/// @brief カラーブレンドの方法
+typedef enum PipelineBlendMode_t {
+    // ブレンドしない
+    PIPELINE_BLEND_MODE_OPAQUE = 0,
+    // src.alpha * src.color + (1 - src.alpha) * dst.color
+    PIPELINE_BLEND_MODE_ALPHA,
+    // src.alpha * src.color + dst.color
+    PIPELINE_BLEND_MODE_ADDITIVE,
+} PipelineBlendMode;
+
+/// @brief 深度テストの方法
+typedef enum PipelineDepthMode_t {
+    // 深度テストも深度の書込みもしない
+    PIPELINE_DEPTH_MODE_NONE = 0,
+    // 手前(深度が小さいか等しい)なら通し、深度を書き込む
+    PIPELINE_DEPTH_MODE_TEST_WRITE,
+    // 深度が等しければ通し、深度を書き込まない
+    //
+    // NOTE: 深度プリパスで書き込んだ深度と比べ、最も手前のフラグメントのみをシェーディングするために用いる。
+    PIPELINE_DEPTH_MODE_EQUAL,
+} PipelineDepthMode;
+
+/// @brief バリアント毎に異なるパイプラインの状態
+typedef struct PipelineVariantKey_t {
+    PipelineBlendMode blendMode;
+    VkCullModeFlags cullMode;
+    VkPrimitiveTopology topology;
+    // 頂点一つあたりのサイズ (0ならヴァーテックスシェーダの頂点入力を詰めたサイズ)
+    //
+    // NOTE: 頂点入力より大きなサイズを与えれば、頂点データの先頭部分だけを読むパイプラインを作れる。
+    uint32_t vertexStride;
+    // 機能フラグ (i番目のビットをconstant_id=iのboolの特殊化定数として与える)
+    uint32_t features;
+    PipelineDepthMode depthMode;
+} PipelineVariantKey;
+
+/// @brief PipelineVariantKeyを64bitに詰める関数
+/// @param key バリアントの状態
+/// @returns 表現できない値を含む場合に0を返す。
+uint64_t packPipelineVariantKey(const PipelineVariantKey *key);
+
+/// @brief 全てのバリアントに共通するパイプラインの状態
+///
+/// いずれのオブジェクトも所有しない。
+typedef struct PipelineVariantsBase_t {
+    Shader vertShader;
+    // NULLならフラグメントシェーダを持たず、カラーアタッチメントにも書き込まない (深度のみのパイプライン)
+    Shader fragShader;
+    VkPipelineLayout layout;
+    VkRenderPass renderPass;
+    uint32_t subpass;
+    // サブパスのアタッチメントのサンプル数
+    VkSampleCountFlagBits samples;
+    // ビューポート
+    uint32_t width;
+    uint32_t height;
+} PipelineVariantsBase;
+
+/// @brief PipelineVariantsのハッシュマップの要素
+typedef struct PipelineVariantEntry_t {
+    // 詰めたキー (0なら空き)
+    uint64_t key;
+    // 作成中ならNULL
+    VkPipeline pipeline;
+    // 作成に失敗したら1
+    int failed;
+} PipelineVariantEntry;
+
+/// @brief PipelineCompilerへの要求
+typedef struct PipelineCompileJob_t {
+    struct PipelineVariants_t *variants;
+    uint64_t key;
+    // 要求した時刻(ns)
+    uint64_t requestedNs;
+} PipelineCompileJob;
+
+/// @brief ワーカースレッドでパイプラインを作成するためのオブジェクトを持つ構造体
+typedef struct PipelineCompiler_t {
+    // 待ち行列と統計と各PipelineVariantsのjobsCountを保護するミューテックス
+    Mutex mutex;
+    // 待ち行列に要求が入ったことを通知する条件変数
+    CondVar queued;
+    // 要求を一つ処理し終えたことを通知する条件変数
+    CondVar finished;
+    uint32_t workersCount;
+    Thread workers[PIPELINE_COMPILER_MAX_WORKERS];
+    // 待ち行列 (リングバッファ)
+    PipelineCompileJob jobs[PIPELINE_COMPILER_MAX_JOBS];
+    uint32_t jobsHead;
+    uint32_t jobsCount;
+    // ワーカースレッドが処理中の要求の数
+    uint32_t runningCount;
+    int quit;
+    // 統計
+    // - compile: パイプラインの作成そのものにかかった時間
+    // - latency: 要求してから作成が完了するまでの時間 (待ち行列で待った時間を含む)
+    uint64_t compiledCount;
+    uint64_t failedCount;
+    uint64_t totalCompileNs;
+    uint64_t maxCompileNs;
+    uint64_t totalLatencyNs;
+    uint64_t maxLatencyNs;
+} *PipelineCompiler;
+
+/// @brief PipelineCompilerを破棄する関数
+///
+/// 待ち行列に残った要求は処理せずに捨て、全てのワーカースレッドの終了を待つ。
+/// PipelineCompilerを使う全てのPipelineVariantsを破棄してから呼ぶこと。
+///
+/// @param compiler パイプライン作成オブジェクトハンドル
+void deletePipelineCompiler(PipelineCompiler compiler);
+
+/// @brief PipelineCompilerを作成する関数
+/// @param workersCount ワーカースレッドの数 (0なら論理プロセッサ数から決める)
+/// @returns 失敗時にNULLを返す。
+PipelineCompiler createPipelineCompiler(uint32_t workersCount);
+
+/// @brief 待ち行列が空になり、全ての要求の処理が終わるまで待機する関数
+/// @param compiler パイプライン作成オブジェクトハンドル
+void waitPipelineCompilerIdle(PipelineCompiler compiler);
+
+/// @brief PipelineCompilerの統計情報を標準出力に出力する関数
+/// @param compiler パイプライン作成オブジェクトハンドル
+void printPipelineCompilerStats(PipelineCompiler compiler);
+
+/// @brief パイプラインのバリアントを管理するためのオブジェクトを持つ構造体
+typedef struct PipelineVariants_t {
+    // ワーカースレッドが使う論理デバイス
+    VkDevice device;
+    // パイプラインキャッシュ (所有しない。VK_NULL_HANDLEでもよい)
+    VkPipelineCache pipelineCache;
+    // パイプライン作成オブジェクト (所有しない。NULLなら常に呼び出したスレッドで作成する)
+    PipelineCompiler compiler;
+    PipelineVariantsBase base;
+    // entriesを保護するミューテックス
+    Mutex mutex;
+    // バリアントの作成が終わったことを通知する条件変数
+    CondVar compiled;
+    // オープンアドレス法のハッシュマップ (容量は2の冪)
+    uint32_t entriesCount;
+    uint32_t entriesCapacity;
+    PipelineVariantEntry *entries;
+    // 代替のバリアントの詰めたキー (0なら無し)
+    uint64_t fallbackKey;
+    // PipelineCompilerに要求して処理が終わっていない数 (compiler->mutexで保護する)
+    uint32_t jobsCount;
+    // バリアントの要求のうち、既存のパイプラインを返した数と作成した数
+    uint64_t hitsCount;
+    uint64_t missesCount;
+} *PipelineVariants;
+
+/// @brief PipelineVariantsを破棄する関数
+///
+/// PipelineCompilerへの未処理の要求を取り消し、処理中の要求の完了を待ってから、作成した全てのパイプラインを破棄する。
+/// デバイスがパイプラインを使い終わってから呼ぶこと。
+///
+/// @param device 論理デバイス
+/// @param variants バリアント管理オブジェクトハンドル
+void deletePipelineVariants(const VkDevice device, PipelineVariants variants);
+
+/// @brief PipelineVariantsを作成する関数
+/// @param device 論理デバイス
+/// @param pipelineCache パイプラインキャッシュ (VK_NULL_HANDLEでもよい)
+/// @param compiler パイプライン作成オブジェクトハンドル (NULLでもよい)
+/// @param base 全てのバリアントに共通するパイプラインの状態
+/// @returns 失敗時にNULLを返す。
+PipelineVariants createPipelineVariants(
+    const VkDevice device,
+    const VkPipelineCache pipelineCache,
+    PipelineCompiler compiler,
+    const PipelineVariantsBase *base
+);
+
+/// @brief バリアントを取得する関数
+///
+/// まだ作成されていなければ、呼び出したスレッドで作成する。
+/// ワーカースレッドで作成中であれば、完了するまで待機する。
+/// 返したパイプラインはPipelineVariantsが所有するため、破棄してはならない。
+///
+/// @param variants バリアント管理オブジェクトハンドル
+/// @param key バリアントの状態
+/// @returns 失敗時にNULLを返す。
+VkPipeline getPipelineVariant(PipelineVariants variants, const PipelineVariantKey *key);
+
+/// @brief 待機せずにバリアントを取得する関数
+///
+/// 作成済みであればそれを返す。
+/// まだ作成されていなければPipelineCompilerに作成を要求し、代替のバリアントが作成済みであればそれを返す。
+/// PipelineCompilerを持たないPipelineVariantsでは、getPipelineVariant()関数と同じ振舞いをする。
+///
+/// @param variants バリアント管理オブジェクトハンドル
+/// @param key バリアントの状態
+/// @returns 要求したバリアントも代替のバリアントも作成済みでない場合や、失敗時にNULLを返す。
+VkPipeline requestPipelineVariant(PipelineVariants variants, const PipelineVariantKey *key);
+
+/// @brief 代替のバリアントを設定する関数
+///
+/// 代替のバリアントは、待ち行列の先頭に入れて他のバリアントより優先して作成する。
+/// 機能を削った安価なバリアントを設定するとよい。
+///
+/// @param variants バリアント管理オブジェクトハンドル
+/// @param key 代替のバリアントの状態
+/// @returns 失敗時に0を返す。
+int setPipelineVariantFallback(PipelineVariants variants, const PipelineVariantKey *key);
+
+/// @brief パイプラインキャッシュを作成する関数
+///
+/// ファイルがあれば、その内容を初期データとして与える。
+/// 内容が別のデバイスやドライバのものであれば、ドライバが無視するため空のパイプラインキャッシュとなる。
+///
+/// @param device 論理デバイス
+/// @param path パイプラインキャッシュファイルのパス
+/// @returns 失敗時にVK_NULL_HANDLEを返す。
+VkPipelineCache loadPipelineCache(const VkDevice device, const char *path);
+
+/// @brief パイプラインキャッシュの内容をファイルへ書き出す関数
+/// @param device 論理デバイス
+/// @param pipelineCache パイプラインキャッシュ
+/// @param path パイプラインキャッシュファイルのパス
+/// @returns 失敗時に0を返す。
+int savePipelineCache(const VkDevice device, const VkPipelineCache pipelineCache, const char *path);
@@ -0,0 +1,310 @@
+#include "profiler.h"
+
+// fopen()関数の使用に対してwarningを出さないためにこのマクロを定義する
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+
+#ifndef ENABLE_PROFILER
+
+int startProfiler(const char *path) {
+    (void)path;
+    printf("[ info ] startProfiler(): ENABLE_PROFILERを定義せずにビルドされたため無効\n");
+    return 0;
+}
+
+void stopProfiler(void) {
+}
+
+void recordProfileEvent(const char *name, char phase) {
+    (void)name;
+    (void)phase;
+}
+
+void nameProfileThread(const char *name) {
+    (void)name;
+}
+
+#else
+
+#include "error.h"
+#include "thread.h"
+#include "timer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+# include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+# include <x86intrin.h>
+#endif
+
+// NOTE: リングバッファの位置は、書込み側と読出し側の二つのスレッドのみが触れる(SPSC)。
+//       相手が書いた位置を読むときはacquire、自分の位置を公開するときはreleaseとし、
+//       イベントの内容が位置より先に相手から見えるようにする。
+//       MSVC(x64)ではvolatileの読み書きがacquire・releaseとなる。
+#ifdef _MSC_VER
+# define THREAD_LOCAL __declspec(thread)
+# define LOAD_ACQUIRE(p)     (*(volatile uint64_t *)(p))
+# define STORE_RELEASE(p, v) (*(volatile uint64_t *)(p) = (v))
+#else
+# define THREAD_LOCAL _Thread_local
+# define LOAD_ACQUIRE(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+# define STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#endif
+
+// 時刻を取得する関数
+//
+// NOTE: x86ではrdtsc命令でタイムスタンプカウンタを読む。
+//       clock_gettime()関数やQueryPerformanceCounter()関数よりも安価である。
+//       カウンタの周波数はstartProfiler()関数で較正する。
+static uint64_t readTimestamp(void) {
+#if defined(_M_X64) || defined(__x86_64__) || defined(__i386__)
+    return (uint64_t)__rdtsc();
+#else
+    return getTimeNs();
+#endif
+}
+
+// イベント
+typedef struct ProfileEvent_t {
+    const char *name;
+    uint64_t time;
+    // 'B'(開始)・'E'(終了)・'M'(スレッド名)
+    char phase;
+} ProfileEvent;
+
+// スレッド毎のリングバッファ
+//
+// NOTE: headとtailは別のスレッドが更新するため、別のキャッシュラインに置いて偽共有を防ぐ。
+typedef struct ProfileRing_t {
+    // 書込み側のみが更新する
+    uint64_t head;
+    uint64_t droppedCount;
+    uint8_t padding0[48];
+    // 読出し側のみが更新する
+    uint64_t tail;
+    uint8_t padding1[56];
+    uint32_t tid;
+    ProfileEvent events[PROFILER_RING_CAPACITY];
+} ProfileRing;
+
+// プロファイラの状態
+static struct Profiler_t {
+    uint64_t enabled;
+    uint64_t quit;
+    FILE *file;
+    // ringsを保護するミューテックス
+    Mutex mutex;
+    uint32_t ringsCount;
+    ProfileRing *rings[PROFILER_MAX_THREADS];
+    Thread collector;
+    // タイムスタンプの起点とns単位への換算係数
+    uint64_t baseTimestamp;
+    double nsPerTick;
+    uint64_t eventsCount;
+} profiler;
+
+static THREAD_LOCAL ProfileRing *threadRing = NULL;
+static THREAD_LOCAL int threadRingFailed = 0;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// 呼び出したスレッドのリングバッファを取得する関数
+//
+// NOTE: 初めてイベントを記録するときに作成して登録する。
+//       ミューテックスをロックするのはこのときだけである。
+static ProfileRing *getThreadRing(void) {
+    if (threadRing != NULL || threadRingFailed) {
+        return threadRing;
+    }
+    ProfileRing *ring = (ProfileRing *)malloc(sizeof(ProfileRing));
+    if (ring == NULL) {
+        threadRingFailed = 1;
+        return NULL;
+    }
+    memset(ring, 0, sizeof(ProfileRing));
+    lockMutex(profiler.mutex);
+    if (profiler.ringsCount >= PROFILER_MAX_THREADS) {
+        unlockMutex(profiler.mutex);
+        free((void *)ring);
+        threadRingFailed = 1;
+        return NULL;
+    }
+    ring->tid = profiler.ringsCount + 1;
+    profiler.rings[profiler.ringsCount] = ring;
+    profiler.ringsCount += 1;
+    unlockMutex(profiler.mutex);
+    threadRing = ring;
+    return ring;
+}
+
+void recordProfileEvent(const char *name, char phase) {
+    if (!LOAD_ACQUIRE(&profiler.enabled)) {
+        return;
+    }
+    ProfileRing *ring = getThreadRing();
+    if (ring == NULL) {
+        return;
+    }
+    const uint64_t head = ring->head;
+    if (head - LOAD_ACQUIRE(&ring->tail) >= PROFILER_RING_CAPACITY) {
+        ring->droppedCount += 1;
+        return;
+    }
+    ProfileEvent *event = &ring->events[head & (PROFILER_RING_CAPACITY - 1)];
+    event->name = name;
+    event->time = readTimestamp();
+    event->phase = phase;
+    STORE_RELEASE(&ring->head, head + 1);
+}
+
+void nameProfileThread(const char *name) {
+    recordProfileEvent(name, 'M');
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// 全てのリングバッファからイベントを取り出して書き出す関数
+static void collectProfileEvents(void) {
+    ProfileRing *rings[PROFILER_MAX_THREADS];
+    lockMutex(profiler.mutex);
+    const uint32_t ringsCount = profiler.ringsCount;
+    memcpy((void *)rings, (const void *)profiler.rings, sizeof(ProfileRing *) * ringsCount);
+    unlockMutex(profiler.mutex);
+
+    for (uint32_t i = 0; i < ringsCount; ++i) {
+        ProfileRing *ring = rings[i];
+        const uint64_t head = LOAD_ACQUIRE(&ring->head);
+        for (uint64_t j = ring->tail; j < head; ++j) {
+            const ProfileEvent *event = &ring->events[j & (PROFILER_RING_CAPACITY - 1)];
+            fputs(profiler.eventsCount > 0 ? ",\n" : "\n", profiler.file);
+            if (event->phase == 'M') {
+                fprintf(
+                    profiler.file,
+                    "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                    ring->tid,
+                    event->name
+                );
+            } else {
+                const double us = (double)(event->time - profiler.baseTimestamp) * profiler.nsPerTick / 1000.0;
+                fprintf(
+                    profiler.file,
+                    "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+                    event->name,
+                    event->phase,
+                    us,
+                    ring->tid
+                );
+            }
+            profiler.eventsCount += 1;
+        }
+        STORE_RELEASE(&ring->tail, head);
+    }
+}
+
+// 収集スレッドの処理
+static void runProfileCollector(void *arg) {
+    (void)arg;
+    while (!LOAD_ACQUIRE(&profiler.quit)) {
+        sleepThread(PROFILER_COLLECT_INTERVAL_MS);
+        collectProfileEvents();
+    }
+}
+
+int startProfiler(const char *path) {
+#define CHECK(p, m) ERROR_IF(!(p), "startProfiler()", (m), stopProfiler(), 0)
+
+    ERROR_IF(profiler.file != NULL || profiler.mutex != NULL, "startProfiler()", "プロファイラは既に開始されている", {}, 0);
+
+    // タイムスタンプカウンタの周波数を較正する
+    //
+    // NOTE: 単調増加する時刻との比を取る。短すぎると誤差が大きくなるため、少し待機する。
+    {
+        const uint64_t beginNs = getTimeNs();
+        const uint64_t beginTick = readTimestamp();
+        sleepThread(20);
+        const uint64_t endNs = getTimeNs();
+        const uint64_t endTick = readTimestamp();
+        profiler.baseTimestamp = beginTick;
+        profiler.nsPerTick = endTick > beginTick ? (double)(endNs - beginNs) / (double)(endTick - beginTick) : 1.0;
+    }
+
+    // JSONファイルを開く
+    {
+        profiler.file = fopen(path, "w");
+        CHECK(profiler.file != NULL, "JSONファイルのオープンに失敗");
+        fputs("{\"traceEvents\":[", profiler.file);
+    }
+
+    // 収集スレッドを開始する
+    {
+        profiler.mutex = createMutex();
+        CHECK(profiler.mutex != NULL, "ミューテックスの作成に失敗");
+        STORE_RELEASE(&profiler.enabled, 1);
+        profiler.collector = createThread(runProfileCollector, NULL);
+        CHECK(profiler.collector != NULL, "収集スレッドの作成に失敗");
+    }
+
+    PROFILE_THREAD_NAME("main");
+
+    return 1;
+
+#undef CHECK
+}
+
+void stopProfiler(void) {
+    STORE_RELEASE(&profiler.enabled, 0);
+
+    // 収集スレッドを終了させ、残ったイベントを書き出す
+    if (profiler.collector != NULL) {
+        STORE_RELEASE(&profiler.quit, 1);
+        joinThread(profiler.collector);
+        profiler.collector = NULL;
+    }
+    uint64_t droppedCount = 0;
+    if (profiler.file != NULL) {
+        if (profiler.mutex != NULL) {
+            collectProfileEvents();
+        }
+        for (uint32_t i = 0; i < profiler.ringsCount; ++i) {
+            droppedCount += profiler.rings[i]->droppedCount;
+        }
+        fprintf(
+            profiler.file,
+            "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":%llu}}\n",
+            (unsigned long long)droppedCount
+        );
+        fclose(profiler.file);
+        profiler.file = NULL;
+        printf(
+            "[ info ] profiler: events=%llu dropped=%llu\n",
+            (unsigned long long)profiler.eventsCount,
+            (unsigned long long)droppedCount
+        );
+    }
+
+    // リングバッファを破棄する
+    //
+    // NOTE: 各スレッドはリングバッファへのポインタを持ち続けるため、再び開始することはできない。
+    for (uint32_t i = 0; i < profiler.ringsCount; ++i) {
+        free((void *)profiler.rings[i]);
+        profiler.rings[i] = NULL;
+    }
+    profiler.ringsCount = 0;
+    if (profiler.mutex != NULL) {
+        deleteMutex(profiler.mutex);
+        profiler.mutex = NULL;
+    }
+}
+
+#undef STORE_RELEASE
+#undef LOAD_ACQUIRE
+#undef THREAD_LOCAL
+
+#endif
@@ -0,0 +1,74 @@
+/// @file profiler.h
+/// @brief CPU側の処理時間を計測するプロファイラを定義するモジュール
+///
+/// ENABLE_PROFILERマクロを定義してビルドしたときのみ有効となる。
+/// 定義しなければ、計測用のマクロは何も展開されず、オーバーヘッドは生じない。
+///
+/// - 計測区間(ゾーン)の開始と終了をイベントとして記録する
+/// - イベントはスレッド毎のロックフリーなリングバッファに書き込む
+/// - 収集スレッドが定期的にリングバッファからイベントを取り出し、Chrome Trace形式のJSONファイルへ書き出す
+///   - chrome://tracing や https://ui.perfetto.dev で閲覧できる
+///
+/// 使い方:
+/// ```
+/// PROFILE_ZONE_BEGIN("createVulkanAppCore");
+/// core = createVulkanAppCore(...);
+/// PROFILE_ZONE_END("createVulkanAppCore");
+/// ```
+///
+/// @warning ゾーンの名前は文字列リテラルとすること。ポインタのみを記録し、書出し時に参照する。
+/// @warning ゾーンの開始と終了の間で関数から戻らないこと。CHECK系マクロによる早期リターンを挟む場合は、呼び出し側で囲むこと。
+
+#pragma once
+
+#include <stdint.h>
+
+/// @brief 一つのスレッドがバッファできるイベントの最大数 (2の冪)
+#define PROFILER_RING_CAPACITY 16384
+
+/// @brief イベントを記録できるスレッドの最大数
+#define PROFILER_MAX_THREADS 64
+
+/// @brief 収集スレッドがリングバッファからイベントを取り出す間隔(ms)
+#define PROFILER_COLLECT_INTERVAL_MS 10
+
+#ifdef ENABLE_PROFILER
+# define PROFILE_ZONE_BEGIN(name) recordProfileEvent((name), 'B')
+# define PROFILE_ZONE_END(name)   recordProfileEvent((name), 'E')
+# define PROFILE_THREAD_NAME(name) nameProfileThread((name))
+#else
+# define PROFILE_ZONE_BEGIN(name)
+# define PROFILE_ZONE_END(name)
+# define PROFILE_THREAD_NAME(name)
+#endif
+
+/// @brief プロファイラを開始する関数
+///
+/// プロセス中で一度だけ呼べる。
+/// ENABLE_PROFILERマクロを定義せずにビルドした場合は何もせず0を返す。
+///
+/// @param path 書き出すJSONファイルのパス
+/// @returns 失敗時に0を返す。
+int startProfiler(const char *path);
+
+/// @brief プロファイラを停止する関数
+///
+/// 残ったイベントを書き出してJSONファイルを閉じる。
+/// 全てのスレッドがイベントの記録を終えてから呼ぶこと。
+void stopProfiler(void);
+
+/// @brief イベントを記録する関数
+///
+/// PROFILE_ZONE_BEGIN・PROFILE_ZONE_ENDマクロから呼ぶ。
+/// リングバッファが満杯であればイベントを捨てる(待機しない)。
+///
+/// @param name ゾーンの名前 (文字列リテラル)
+/// @param phase 'B'(開始)あるいは'E'(終了)
+void recordProfileEvent(const char *name, char phase);
+
+/// @brief 呼び出したスレッドに名前を付ける関数
+///
+/// PROFILE_THREAD_NAMEマクロから呼ぶ。
+///
+/// @param name スレッドの名前 (文字列リテラル)
+void nameProfileThread(const char *name);
@@ -0,0 +1,230 @@
+#include "query.h"
+
+#include "error.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// パイプライン統計クエリで計測する値
+//
+// NOTE: 結果はビットの昇順に並ぶ。DrawStatsPassへの累計もこの順で行う。
+#define DRAW_STATS_PIPELINE_FLAGS (                               \
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT       \
+    | VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT   \
+    | VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT   \
+    | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT        \
+    | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT         \
+    | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT \
+)
+
+void deleteDrawStats(const VkDevice device, DrawStats stats) {
+    if (stats == NULL) {
+        return;
+    }
+    for (uint32_t i = 0; i < DRAW_STATS_MAX_FRAMES; ++i) {
+        if (stats->pipelinePools[i] != NULL) vkDestroyQueryPool(device, stats->pipelinePools[i], NULL);
+        if (stats->occlusionPools[i] != NULL) vkDestroyQueryPool(device, stats->occlusionPools[i], NULL);
+    }
+    free((void *)stats);
+}
+
+DrawStats createDrawStats(const VkDevice device, const VkPhysicalDeviceFeatures *enabledFeatures, uint32_t framesCount) {
+#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "createDrawStats()", (m), (p), deleteDrawStats(device, stats), NULL)
+#define CHECK(p, m)    ERROR_IF     (!(p),              "createDrawStats()", (m),      deleteDrawStats(device, stats), NULL)
+
+    const DrawStats stats = (DrawStats)malloc(sizeof(struct DrawStats_t));
+    CHECK(stats != NULL, "DrawStatsの確保に失敗");
+    memset(stats, 0, sizeof(struct DrawStats_t));
+    CHECK(framesCount > 0 && framesCount <= DRAW_STATS_MAX_FRAMES, "フレーム数が多すぎる");
+    stats->framesCount = framesCount;
+    stats->pipelineStatistics = enabledFeatures->pipelineStatisticsQuery == VK_TRUE;
+    stats->preciseOcclusion = enabledFeatures->occlusionQueryPrecise == VK_TRUE;
+    if (!stats->pipelineStatistics) {
+        printf("[ warning ] createDrawStats(): パイプライン統計クエリが有効でないため、オクルージョンクエリのみで計測する\n");
+    }
+
+    // フレーム毎のクエリプールを作成する
+    {
+        for (uint32_t i = 0; i < framesCount; ++i) {
+            if (stats->pipelineStatistics) {
+                const VkQueryPoolCreateInfo ci = {
+                    VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                    NULL,
+                    0,
+                    VK_QUERY_TYPE_PIPELINE_STATISTICS,
+                    DRAW_STATS_MAX_PASSES,
+                    DRAW_STATS_PIPELINE_FLAGS,
+                };
+                CHECK_VK(vkCreateQueryPool(device, &ci, NULL, &stats->pipelinePools[i]), "パイプライン統計クエリプールの作成に失敗");
+            }
+            const VkQueryPoolCreateInfo ci = {
+                VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                NULL,
+                0,
+                VK_QUERY_TYPE_OCCLUSION,
+                DRAW_STATS_MAX_PASSES,
+                0,
+            };
+            CHECK_VK(vkCreateQueryPool(device, &ci, NULL, &stats->occlusionPools[i]), "オクルージョンクエリプールの作成に失敗");
+        }
+    }
+
+    return stats;
+
+#undef CHECK
+#undef CHECK_VK
+}
+
+// フレームで記録したクエリの結果を回収する関数
+//
+// NOTE: フェンスを待機した後に呼ぶため、結果は得られているはずである。
+//       VK_QUERY_RESULT_WAIT_BITを指定しないのは、得られていなかった場合に描画を止めないため。
+//       その場合はフレームを捨てる。
+static void collectDrawStatsFrame(const VkDevice device, DrawStats stats, uint32_t frame) {
+    const uint32_t count = stats->recordedCounts[frame];
+    if (count == 0) {
+        return;
+    }
+    stats->recordedCounts[frame] = 0;
+
+    uint64_t pipelineValues[DRAW_STATS_MAX_PASSES][DRAW_STATS_PIPELINE_VALUES_COUNT];
+    uint64_t occlusionValues[DRAW_STATS_MAX_PASSES];
+    memset(pipelineValues, 0, sizeof(pipelineValues));
+    if (stats->pipelineStatistics) {
+        const VkResult res = vkGetQueryPoolResults(
+            device,
+            stats->pipelinePools[frame],
+            0,
+            count,
+            sizeof(pipelineValues),
+            (void *)pipelineValues,
+            sizeof(uint64_t) * DRAW_STATS_PIPELINE_VALUES_COUNT,
+            VK_QUERY_RESULT_64_BIT
+        );
+        if (res != VK_SUCCESS) {
+            stats->droppedFramesCount += 1;
+            return;
+        }
+    }
+    {
+        const VkResult res = vkGetQueryPoolResults(
+            device,
+            stats->occlusionPools[frame],
+            0,
+            count,
+            sizeof(occlusionValues),
+            (void *)occlusionValues,
+            sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT
+        );
+        if (res != VK_SUCCESS) {
+            stats->droppedFramesCount += 1;
+            return;
+        }
+    }
+
+    // NOTE: 一つのフレームで同じパスを複数回計測した場合も、そのパスのフレーム数は一つとして数える。
+    uint32_t counted[DRAW_STATS_MAX_PASSES];
+    memset(counted, 0, sizeof(counted));
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint32_t passIndex = stats->recordedPasses[frame][i];
+        DrawStatsPass *pass = &stats->passes[passIndex];
+        if (!counted[passIndex]) {
+            pass->framesCount += 1;
+            counted[passIndex] = 1;
+        }
+        pass->inputVertices += pipelineValues[i][0];
+        pass->inputPrimitives += pipelineValues[i][1];
+        pass->vertexInvocations += pipelineValues[i][2];
+        pass->clippingInvocations += pipelineValues[i][3];
+        pass->clippingPrimitives += pipelineValues[i][4];
+        pass->fragmentInvocations += pipelineValues[i][5];
+        pass->samplesPassed += occlusionValues[i];
+    }
+}
+
+void beginDrawStatsFrame(const VkDevice device, DrawStats stats, VkCommandBuffer cmdBuffer, uint32_t frame) {
+    collectDrawStatsFrame(device, stats, frame);
+    stats->frame = frame;
+    if (stats->pipelineStatistics) vkCmdResetQueryPool(cmdBuffer, stats->pipelinePools[frame], 0, DRAW_STATS_MAX_PASSES);
+    vkCmdResetQueryPool(cmdBuffer, stats->occlusionPools[frame], 0, DRAW_STATS_MAX_PASSES);
+}
+
+int beginDrawStatsPass(VkCommandBuffer cmdBuffer, DrawStats stats, const char *name) {
+    const uint32_t frame = stats->frame;
+    const uint32_t query = stats->recordedCounts[frame];
+    if (query >= DRAW_STATS_MAX_PASSES) {
+        return 0;
+    }
+
+    // パスを探し、無ければ追加する
+    uint32_t passIndex = 0;
+    for (; passIndex < stats->passesCount; ++passIndex) {
+        if (strcmp(stats->passes[passIndex].name, name) == 0) {
+            break;
+        }
+    }
+    if (passIndex == stats->passesCount) {
+        if (stats->passesCount >= DRAW_STATS_MAX_PASSES) {
+            return 0;
+        }
+        memset(&stats->passes[passIndex], 0, sizeof(DrawStatsPass));
+        stats->passes[passIndex].name = name;
+        stats->passesCount += 1;
+    }
+
+    stats->recordedPasses[frame][query] = passIndex;
+    stats->recordedCounts[frame] = query + 1;
+    if (stats->pipelineStatistics) vkCmdBeginQuery(cmdBuffer, stats->pipelinePools[frame], query, 0);
+    vkCmdBeginQuery(cmdBuffer, stats->occlusionPools[frame], query, stats->preciseOcclusion ? VK_QUERY_CONTROL_PRECISE_BIT : 0);
+    return 1;
+}
+
+void endDrawStatsPass(VkCommandBuffer cmdBuffer, DrawStats stats) {
+    const uint32_t frame = stats->frame;
+    const uint32_t query = stats->recordedCounts[frame] - 1;
+    vkCmdEndQuery(cmdBuffer, stats->occlusionPools[frame], query);
+    if (stats->pipelineStatistics) vkCmdEndQuery(cmdBuffer, stats->pipelinePools[frame], query);
+}
+
+void flushDrawStats(const VkDevice device, DrawStats stats) {
+    for (uint32_t i = 0; i < stats->framesCount; ++i) {
+        collectDrawStatsFrame(device, stats, i);
+    }
+}
+
+void printDrawStats(const DrawStats stats) {
+    for (uint32_t i = 0; i < stats->passesCount; ++i) {
+        const DrawStatsPass *pass = &stats->passes[i];
+        if (pass->framesCount == 0) {
+            continue;
+        }
+        const double frames = (double)pass->framesCount;
+        printf(
+            "[ info ] draw-stats: pass=%s frames=%llu samples-passed=%.0f%s",
+            pass->name,
+            (unsigned long long)pass->framesCount,
+            (double)pass->samplesPassed / frames,
+            stats->preciseOcclusion ? "" : "(imprecise)"
+        );
+        if (stats->pipelineStatistics) {
+            printf(
+                " vertices=%.0f primitives=%.0f vs=%.0f clip-in=%.0f clip-out=%.0f fs=%.0f vertex-reuse=%.3f acmr=%.3f fragments/sample=%.3f",
+                (double)pass->inputVertices / frames,
+                (double)pass->inputPrimitives / frames,
+                (double)pass->vertexInvocations / frames,
+                (double)pass->clippingInvocations / frames,
+                (double)pass->clippingPrimitives / frames,
+                (double)pass->fragmentInvocations / frames,
+                pass->inputVertices > 0 ? (double)pass->vertexInvocations / (double)pass->inputVertices : 0.0,
+                pass->inputPrimitives > 0 ? (double)pass->vertexInvocations / (double)pass->inputPrimitives : 0.0,
+                pass->samplesPassed > 0 ? (double)pass->fragmentInvocations / (double)pass->samplesPassed : 0.0
+            );
+        }
+        printf("\n");
+    }
+    if (stats->droppedFramesCount > 0) {
+        printf("[ warning ] draw-stats: 結果が得られずに捨てたフレーム数: %llu\n", (unsigned long long)stats->droppedFramesCount);
+    }
+}
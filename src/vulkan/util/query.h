@@ -0,0 +1,134 @@
+/// @file query.h
+/// @brief クエリで描画の仕事量を計測するモジュール
+///
+/// - 名前付きのパス毎に、描画コマンドをパイプライン統計クエリとオクルージョンクエリで囲む
+///   - パイプライン統計クエリ: 頂点シェーダ・クリッピング・フラグメントシェーダの実行回数等
+///   - オクルージョンクエリ: 深度・ステンシルテストを通過したサンプル数
+/// - クエリプールはフレーム毎に用意し、そのフレームのフェンスを待機した後で結果を回収する
+///   - 結果を待機しないため、描画を止めない
+/// - 回収した結果はパス毎に累計し、オーバードローや頂点の再利用率等を求めて出力する
+///
+/// 使い方:
+/// ```
+/// // フェンスを待機しコマンドバッファの記録を開始した後、レンダーパスの外で
+/// beginDrawStatsFrame(device, stats, cmdBuffer, frame);
+/// // レンダーパスの中で
+/// beginDrawStatsPass(cmdBuffer, stats, "ui");
+/// vkCmdDrawIndexed(...);
+/// endDrawStatsPass(cmdBuffer, stats);
+/// ```
+
+#pragma once
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+/// @brief 一つのフレームで計測できるパスの最大数
+#define DRAW_STATS_MAX_PASSES 16
+
+/// @brief 同時に計測できるフレームの最大数
+#define DRAW_STATS_MAX_FRAMES 4
+
+/// @brief パイプライン統計クエリで計測する値の数
+#define DRAW_STATS_PIPELINE_VALUES_COUNT 6
+
+/// @brief パス毎の計測結果の累計
+typedef struct DrawStatsPass_t {
+    // 名前 (文字列リテラル)
+    const char *name;
+    // 結果を回収したフレーム数
+    uint64_t framesCount;
+    // 入力アセンブラが読んだ頂点数とプリミティブ数
+    uint64_t inputVertices;
+    uint64_t inputPrimitives;
+    uint64_t vertexInvocations;
+    // クリッピングの入力と出力のプリミティブ数
+    uint64_t clippingInvocations;
+    uint64_t clippingPrimitives;
+    uint64_t fragmentInvocations;
+    // 深度・ステンシルテストを通過したサンプル数
+    uint64_t samplesPassed;
+} DrawStatsPass;
+
+/// @brief 描画の仕事量を計測するためのオブジェクトを持つ構造体
+typedef struct DrawStats_t {
+    // パイプライン統計クエリを使えるか (使えなければオクルージョンクエリのみ)
+    int pipelineStatistics;
+    // オクルージョンクエリが正確なサンプル数を返すか
+    int preciseOcclusion;
+    uint32_t framesCount;
+    VkQueryPool pipelinePools[DRAW_STATS_MAX_FRAMES];
+    VkQueryPool occlusionPools[DRAW_STATS_MAX_FRAMES];
+    // フレーム毎に、記録したクエリがどのパスのものか
+    uint32_t recordedCounts[DRAW_STATS_MAX_FRAMES];
+    uint32_t recordedPasses[DRAW_STATS_MAX_FRAMES][DRAW_STATS_MAX_PASSES];
+    // 記録中のフレーム
+    uint32_t frame;
+    // 結果が得られずに捨てたフレーム数
+    uint64_t droppedFramesCount;
+    uint32_t passesCount;
+    DrawStatsPass passes[DRAW_STATS_MAX_PASSES];
+} *DrawStats;
+
+/// @brief DrawStatsを破棄する関数
+///
+/// デバイスがクエリを使い終わってから呼ぶこと。
+///
+/// @param device 論理デバイス
+/// @param stats 計測オブジェクトハンドル
+void deleteDrawStats(const VkDevice device, DrawStats stats);
+
+/// @brief DrawStatsを作成する関数
+/// @param device 論理デバイス
+/// @param enabledFeatures 論理デバイスで有効にした機能
+/// @param framesCount 同時に処理されうるフレーム数 (DRAW_STATS_MAX_FRAMES以下)
+/// @returns 失敗時にNULLを返す。
+DrawStats createDrawStats(const VkDevice device, const VkPhysicalDeviceFeatures *enabledFeatures, uint32_t framesCount);
+
+/// @brief フレームの計測を開始する関数
+///
+/// 同じフレームで前回記録したクエリの結果を回収してから、クエリをリセットするコマンドを記録する。
+/// そのフレームのフェンスを待機した後、レンダーパスの外で呼ぶこと。
+///
+/// @param device 論理デバイス
+/// @param stats 計測オブジェクトハンドル
+/// @param cmdBuffer 記録中のコマンドバッファ
+/// @param frame フレームのインデックス (framesCount未満)
+void beginDrawStatsFrame(const VkDevice device, DrawStats stats, VkCommandBuffer cmdBuffer, uint32_t frame);
+
+/// @brief パスの計測を開始する関数
+///
+/// パスの計測は入れ子にできない。
+/// 計測できるパスの数を超えた場合は何もしない。
+///
+/// @param cmdBuffer 記録中のコマンドバッファ
+/// @param stats 計測オブジェクトハンドル
+/// @param name パスの名前 (文字列リテラル)
+/// @returns 計測を開始しなかった場合に0を返す。
+int beginDrawStatsPass(VkCommandBuffer cmdBuffer, DrawStats stats, const char *name);
+
+/// @brief パスの計測を終了する関数
+///
+/// beginDrawStatsPass()関数が0を返した場合は呼ばないこと。
+///
+/// @param cmdBuffer 記録中のコマンドバッファ
+/// @param stats 計測オブジェクトハンドル
+void endDrawStatsPass(VkCommandBuffer cmdBuffer, DrawStats stats);
+
+/// @brief 全てのフレームの結果を回収する関数
+///
+/// デバイスがクエリを使い終わってから呼ぶこと。
+///
+/// @param device 論理デバイス
+/// @param stats 計測オブジェクトハンドル
+void flushDrawStats(const VkDevice device, DrawStats stats);
+
+/// @brief パス毎の計測結果を標準出力に出力する関数
+///
+/// 一フレームあたりの平均と、次の指標を出力する。
+/// - vertex-reuse: 頂点シェーダの実行回数 / 入力頂点数 (小さいほど頂点キャッシュが効いている)
+/// - acmr: 頂点シェーダの実行回数 / 入力プリミティブ数 (Average Cache Miss Ratio)
+/// - fragments/sample: フラグメントシェーダの実行回数 / テストを通過したサンプル数 (1を超えた分は無駄になったシェーディング)
+///
+/// @param stats 計測オブジェクトハンドル
+void printDrawStats(const DrawStats stats);
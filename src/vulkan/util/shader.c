@@ -6,6 +6,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 VkShaderModule createShaderModuleFromFile(const VkDevice device, const char *path) {
 #define CHECK_VK(p, m, d) ERROR_IF_WITH((p) != VK_SUCCESS, "createShaderModuleFromFile()", (m), (p), d, NULL)
@@ -42,3 +43,320 @@ VkShaderModule createShaderModuleFromFile(const VkDevice device, const char *pat
 #undef CHECK
 #undef CHECK_VK
 }
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// FNV-1aでハッシュ値を計算する関数
+static uint64_t hashFnv1a(const void *data, size_t size) {
+    const uint8_t *p = (const uint8_t *)data;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= (uint64_t)p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+void deleteShaderLibrary(const VkDevice device, ShaderLibrary library) {
+    if (library == NULL) {
+        return;
+    }
+    vkDeviceWaitIdle(device);
+    if (library->layouts != NULL) {
+        for (uint32_t i = 0; i < library->layoutsCount; ++i) {
+            vkDestroyPipelineLayout(device, library->layouts[i]->layout, NULL);
+            free((void *)library->layouts[i]);
+        }
+        free((void *)library->layouts);
+    }
+    if (library->shaders != NULL) {
+        for (uint32_t i = 0; i < library->shadersCount; ++i) {
+            vkDestroyShaderModule(device, library->shaders[i]->module, NULL);
+            free((void *)library->shaders[i]->code);
+            free((void *)library->shaders[i]);
+        }
+        free((void *)library->shaders);
+    }
+    free((void *)library);
+}
+
+ShaderLibrary createShaderLibrary(DescriptorSetLayoutCache descSetLayoutCache) {
+#define CHECK(p, m) ERROR_IF(!(p), "createShaderLibrary()", (m), deleteShaderLibrary(NULL, library), NULL)
+
+    const ShaderLibrary library = (ShaderLibrary)malloc(sizeof(struct ShaderLibrary_t));
+    CHECK(library != NULL, "ShaderLibraryの確保に失敗");
+    memset(library, 0, sizeof(struct ShaderLibrary_t));
+
+    library->descSetLayoutCache = descSetLayoutCache;
+
+    return library;
+
+#undef CHECK
+}
+
+Shader loadShader(const VkDevice device, ShaderLibrary library, const char *path) {
+#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "loadShader()", (m), (p), { free((void *)binary); free((void *)shader); }, NULL)
+#define CHECK(p, m)    ERROR_IF     (!(p),              "loadShader()", (m),      { free((void *)binary); free((void *)shader); }, NULL)
+
+    Shader shader = NULL;
+
+    // ファイルを読み込む
+    const char *binary = NULL;
+    long int binarySize = 0;
+    {
+        binary = readBinaryFile(path, &binarySize);
+        CHECK(binary != NULL, "シェーダファイルの読込みに失敗");
+        CHECK(binarySize > 0 && binarySize % sizeof(uint32_t) == 0, "SPIR-Vバイナリのサイズが不正");
+    }
+
+    // 内容が同じシェーダを探す
+    //
+    // NOTE: パスではなく内容で比べるため、同じ内容の別ファイルも一つのシェーダモジュールにまとまる。
+    //       ハッシュ値とサイズが一致しても、衝突の可能性があるため内容そのものも比べる。
+    const uint64_t hash = hashFnv1a((const void *)binary, (size_t)binarySize);
+    for (uint32_t i = 0; i < library->shadersCount; ++i) {
+        const Shader other = library->shaders[i];
+        if (other->hash == hash
+            && other->codeSize == (uint32_t)binarySize
+            && memcmp((const void *)other->code, (const void *)binary, (size_t)binarySize) == 0
+        ) {
+            free((void *)binary);
+            other->refsCount += 1;
+            library->hitsCount += 1;
+            return other;
+        }
+    }
+    library->missesCount += 1;
+
+    // シェーダの配列を拡張する
+    if (library->shadersCount >= library->shadersCapacity) {
+        const uint32_t capacity = library->shadersCapacity > 0 ? library->shadersCapacity * 2 : 8;
+        Shader *shaders = (Shader *)realloc((void *)library->shaders, sizeof(Shader) * capacity);
+        CHECK(shaders != NULL, "シェーダの配列の拡張に失敗");
+        library->shaders = shaders;
+        library->shadersCapacity = capacity;
+    }
+
+    shader = (Shader)malloc(sizeof(struct Shader_t));
+    CHECK(shader != NULL, "Shaderの確保に失敗");
+    memset(shader, 0, sizeof(struct Shader_t));
+    shader->hash = hash;
+    shader->codeSize = (uint32_t)binarySize;
+
+    // インターフェースを読み取る
+    {
+        CHECK(reflectSpirv((const uint32_t *)binary, (size_t)binarySize, &shader->reflection), "SPIR-Vバイナリの読み取りに失敗");
+    }
+
+    // シェーダモジュールを作成する
+    {
+        const VkShaderModuleCreateInfo ci = {
+            VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+            NULL,
+            0,
+            (size_t)binarySize,
+            (const uint32_t *)binary,
+        };
+        CHECK_VK(vkCreateShaderModule(device, &ci, NULL, &shader->module), "シェーダモジュールの作成に失敗");
+    }
+
+    // NOTE: 以降の読込みで内容を比べるため、バイナリは解放せずにシェーダに持たせる。
+    shader->code = (const uint32_t *)binary;
+    shader->refsCount = 1;
+    library->shaders[library->shadersCount] = shader;
+    library->shadersCount += 1;
+
+    return shader;
+
+#undef CHECK
+#undef CHECK_VK
+}
+
+void releaseShader(const VkDevice device, ShaderLibrary library, Shader shader) {
+    if (library == NULL || shader == NULL) {
+        return;
+    }
+    if (shader->refsCount > 1) {
+        shader->refsCount -= 1;
+        return;
+    }
+
+    // 配列から取り除き、シェーダモジュールを破棄する
+    //
+    // NOTE: 作成済みのパイプラインはシェーダモジュールに依存しないため、デバイスの待機は不要である。
+    //       パイプラインレイアウトは他のシェーダとも共有し得るため、ShaderLibraryの破棄まで残す。
+    for (uint32_t i = 0; i < library->shadersCount; ++i) {
+        if (library->shaders[i] == shader) {
+            library->shaders[i] = library->shaders[library->shadersCount - 1];
+            library->shadersCount -= 1;
+            break;
+        }
+    }
+    vkDestroyShaderModule(device, shader->module, NULL);
+    free((void *)shader->code);
+    free((void *)shader);
+}
+
+const ShaderLibraryLayout *getPipelineLayoutForShaders(
+    const VkDevice device,
+    ShaderLibrary library,
+    uint32_t shadersCount,
+    const Shader *shaders,
+    uint32_t overridesCount,
+    const ShaderReflectionBinding *overrides
+) {
+#define CHECK_VK(p, m) ERROR_IF_WITH((p) != VK_SUCCESS, "getPipelineLayoutForShaders()", (m), (p), free((void *)layout), NULL)
+#define CHECK(p, m)    ERROR_IF     (!(p),              "getPipelineLayoutForShaders()", (m),      free((void *)layout), NULL)
+#define MAX_BINDINGS (SHADER_REFLECTION_MAX_BINDINGS * 2)
+
+    ShaderLibraryLayout *layout = NULL;
+
+    // 全てのシェーダのバインディングを一つにまとめる
+    //
+    // NOTE: 複数のシェーダが同じバインディングを使う場合は、ステージを合成する。
+    uint32_t sets[MAX_BINDINGS];
+    VkDescriptorSetLayoutBinding bindings[MAX_BINDINGS];
+    uint32_t bindingsCount = 0;
+    VkPushConstantRange pushConstantRange = { 0, 0, 0 };
+    uint32_t setsCount = 0;
+    for (uint32_t i = 0; i < shadersCount; ++i) {
+        const ShaderReflection *reflection = &shaders[i]->reflection;
+        for (uint32_t j = 0; j < reflection->bindingsCount; ++j) {
+            const ShaderReflectionBinding *src = &reflection->bindings[j];
+            CHECK(src->set < SHADER_LIBRARY_MAX_SETS, "ディスクリプタセットの番号が大きすぎる");
+            uint32_t k = 0;
+            for (; k < bindingsCount; ++k) {
+                if (sets[k] == src->set && bindings[k].binding == src->binding) {
+                    break;
+                }
+            }
+            if (k < bindingsCount) {
+                CHECK(
+                    bindings[k].descriptorType == src->descriptorType && bindings[k].descriptorCount == src->descriptorCount,
+                    "ステージ間でバインディングが一致しない"
+                );
+                bindings[k].stageFlags |= reflection->stage;
+                continue;
+            }
+            CHECK(bindingsCount < MAX_BINDINGS, "バインディングが多すぎる");
+            sets[bindingsCount] = src->set;
+            bindings[bindingsCount].binding = src->binding;
+            bindings[bindingsCount].descriptorType = src->descriptorType;
+            bindings[bindingsCount].descriptorCount = src->descriptorCount;
+            bindings[bindingsCount].stageFlags = reflection->stage;
+            bindings[bindingsCount].pImmutableSamplers = NULL;
+            bindingsCount += 1;
+            if (src->set + 1 > setsCount) {
+                setsCount = src->set + 1;
+            }
+        }
+        // NOTE: プッシュ定数は一つの範囲にまとめ、使う全てのステージから見えるようにする。
+        if (reflection->pushConstantSize > 0) {
+            pushConstantRange.stageFlags |= reflection->stage;
+            if (reflection->pushConstantSize > pushConstantRange.size) {
+                pushConstantRange.size = reflection->pushConstantSize;
+            }
+        }
+    }
+
+    // ディスクリプタの種類を上書きする
+    for (uint32_t i = 0; i < overridesCount; ++i) {
+        for (uint32_t j = 0; j < bindingsCount; ++j) {
+            if (sets[j] == overrides[i].set && bindings[j].binding == overrides[i].binding) {
+                bindings[j].descriptorType = overrides[i].descriptorType;
+            }
+        }
+    }
+
+    // セット毎にディスクリプタセットレイアウトを取得する
+    //
+    // NOTE: バインディングの無いセット番号にも空のディスクリプタセットレイアウトを割り当てる。
+    VkDescriptorSetLayout setLayouts[SHADER_LIBRARY_MAX_SETS];
+    for (uint32_t set = 0; set < setsCount; ++set) {
+        VkDescriptorSetLayoutBinding setBindings[MAX_BINDINGS];
+        uint32_t setBindingsCount = 0;
+        for (uint32_t i = 0; i < bindingsCount; ++i) {
+            if (sets[i] == set) {
+                setBindings[setBindingsCount] = bindings[i];
+                setBindingsCount += 1;
+            }
+        }
+        setLayouts[set] = getDescriptorSetLayout(device, library->descSetLayoutCache, setBindingsCount, setBindings);
+        CHECK(setLayouts[set] != NULL, "ディスクリプタセットレイアウトの取得に失敗");
+    }
+
+    // 同じパイプラインレイアウトを探す
+    //
+    // NOTE: ディスクリプタセットレイアウトは共有されているため、ハンドルを比べればよい。
+    for (uint32_t i = 0; i < library->layoutsCount; ++i) {
+        const ShaderLibraryLayout *other = library->layouts[i];
+        if (other->setLayoutsCount != setsCount
+            || other->pushConstantRange.stageFlags != pushConstantRange.stageFlags
+            || other->pushConstantRange.size != pushConstantRange.size
+            || memcmp((const void *)other->setLayouts, (const void *)setLayouts, sizeof(VkDescriptorSetLayout) * setsCount) != 0
+        ) {
+            continue;
+        }
+        return other;
+    }
+
+    // パイプラインレイアウトの配列を拡張する
+    if (library->layoutsCount >= library->layoutsCapacity) {
+        const uint32_t capacity = library->layoutsCapacity > 0 ? library->layoutsCapacity * 2 : 8;
+        ShaderLibraryLayout **layouts = (ShaderLibraryLayout **)realloc((void *)library->layouts, sizeof(ShaderLibraryLayout *) * capacity);
+        CHECK(layouts != NULL, "パイプラインレイアウトの配列の拡張に失敗");
+        library->layouts = layouts;
+        library->layoutsCapacity = capacity;
+    }
+
+    layout = (ShaderLibraryLayout *)malloc(sizeof(ShaderLibraryLayout));
+    CHECK(layout != NULL, "ShaderLibraryLayoutの確保に失敗");
+    memset(layout, 0, sizeof(ShaderLibraryLayout));
+    layout->setLayoutsCount = setsCount;
+    memcpy((void *)layout->setLayouts, (const void *)setLayouts, sizeof(VkDescriptorSetLayout) * setsCount);
+    layout->pushConstantRange = pushConstantRange;
+
+    // パイプラインレイアウトを作成する
+    {
+        const VkPipelineLayoutCreateInfo ci = {
+            VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            NULL,
+            0,
+            setsCount,
+            setLayouts,
+            pushConstantRange.size > 0 ? 1 : 0,
+            pushConstantRange.size > 0 ? &layout->pushConstantRange : NULL,
+        };
+        CHECK_VK(vkCreatePipelineLayout(device, &ci, NULL, &layout->layout), "パイプラインレイアウトの作成に失敗");
+    }
+
+    library->layouts[library->layoutsCount] = layout;
+    library->layoutsCount += 1;
+
+    return layout;
+
+#undef MAX_BINDINGS
+#undef CHECK
+#undef CHECK_VK
+}
+
+uint32_t buildVertexInputAttributes(
+    const Shader vertShader,
+    uint32_t binding,
+    VkVertexInputAttributeDescription *attrs,
+    uint32_t *stride
+) {
+    const ShaderReflection *reflection = &vertShader->reflection;
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < reflection->inputsCount; ++i) {
+        attrs[i].location = reflection->inputs[i].location;
+        attrs[i].binding = binding;
+        attrs[i].format = reflection->inputs[i].format;
+        attrs[i].offset = offset;
+        offset += reflection->inputs[i].size;
+    }
+    *stride = offset;
+    return reflection->inputsCount;
+}
@@ -1,12 +1,137 @@
 /// @file shader.h
 /// @brief シェーダモジュールオブジェクトに関するモジュール
+///
+/// - createShaderModuleFromFile()
+///   - SPIR-Vバイナリファイルからシェーダモジュールを一つ作成する
+/// - ShaderLibrary
+///   - シェーダモジュールを内容のハッシュ値で共有する
+///   - 参照するパイプラインが無くなったシェーダモジュールを破棄する
+///   - SPIR-Vバイナリから読み取ったインターフェースを基に、パイプラインレイアウトや頂点入力を作る
+///   - 同じインターフェースを持つパイプラインレイアウトを一つにまとめる
 
 #pragma once
 
+#include "descriptor.h"
+#include "spirv.h"
+
+#include <stdint.h>
 #include <vulkan/vulkan.h>
 
+/// @brief パイプラインレイアウトが持てるディスクリプタセットレイアウトの最大数
+#define SHADER_LIBRARY_MAX_SETS 4
+
 /// @brief SPIR-Vバイナリファイルからシェーダモジュールを作成する関数
 /// @param device 論理デバイス
 /// @param path SPIR-Vバイナリファイルのパス
 /// @returns 失敗時にNULLを返す。
 VkShaderModule createShaderModuleFromFile(const VkDevice device, const char *path);
+
+/// @brief ShaderLibraryが持つシェーダを表す構造体
+typedef struct Shader_t {
+    // SPIR-Vバイナリの内容のハッシュ値とサイズ
+    uint64_t hash;
+    uint32_t codeSize;
+    // SPIR-Vバイナリの内容 (ハッシュ値が衝突しても別のシェーダとして扱うため、比較用に保持する)
+    const uint32_t *code;
+    // loadShader()で返してからreleaseShader()で返されていない数
+    uint32_t refsCount;
+    VkShaderModule module;
+    ShaderReflection reflection;
+} *Shader;
+
+/// @brief ShaderLibraryが持つパイプラインレイアウトを表す構造体
+typedef struct ShaderLibraryLayout_t {
+    uint32_t setLayoutsCount;
+    VkDescriptorSetLayout setLayouts[SHADER_LIBRARY_MAX_SETS];
+    // プッシュ定数の範囲 (プッシュ定数を使わないならsizeが0)
+    VkPushConstantRange pushConstantRange;
+    VkPipelineLayout layout;
+} ShaderLibraryLayout;
+
+/// @brief シェーダとパイプラインレイアウトを共有するためのオブジェクトを持つ構造体
+typedef struct ShaderLibrary_t {
+    // ディスクリプタセットレイアウトの共有先 (所有しない)
+    DescriptorSetLayoutCache descSetLayoutCache;
+    uint32_t shadersCount;
+    uint32_t shadersCapacity;
+    Shader *shaders;
+    uint32_t layoutsCount;
+    uint32_t layoutsCapacity;
+    ShaderLibraryLayout **layouts;
+    // シェーダの読込み要求のうち、既存のシェーダモジュールを返した数と作成した数
+    uint64_t hitsCount;
+    uint64_t missesCount;
+} *ShaderLibrary;
+
+/// @brief ShaderLibraryを破棄する関数
+///
+/// 作成した全てのシェーダモジュールとパイプラインレイアウトも破棄する。
+///
+/// @param device 論理デバイス
+/// @param library シェーダ共有オブジェクトハンドル
+void deleteShaderLibrary(const VkDevice device, ShaderLibrary library);
+
+/// @brief ShaderLibraryを作成する関数
+/// @param descSetLayoutCache ディスクリプタセットレイアウトの共有先
+/// @returns 失敗時にNULLを返す。
+ShaderLibrary createShaderLibrary(DescriptorSetLayoutCache descSetLayoutCache);
+
+/// @brief SPIR-Vバイナリファイルからシェーダを読み込む関数
+///
+/// 内容が同じSPIR-Vバイナリを既に読み込んでいれば、そのシェーダを返す。
+/// 返したシェーダはShaderLibraryが所有するため、破棄してはならない。
+/// 使い終わったらreleaseShader()で返すこと。
+///
+/// @param device 論理デバイス
+/// @param library シェーダ共有オブジェクトハンドル
+/// @param path SPIR-Vバイナリファイルのパス
+/// @returns 失敗時にNULLを返す。
+Shader loadShader(const VkDevice device, ShaderLibrary library, const char *path);
+
+/// @brief loadShader()で取得したシェーダを返す関数
+///
+/// 全ての参照が返されたシェーダは、シェーダモジュールごと破棄する。
+/// シェーダを使うパイプラインの作成が全て終わってから呼ぶこと。
+///
+/// @param device 論理デバイス
+/// @param library シェーダ共有オブジェクトハンドル
+/// @param shader 返すシェーダ (NULLなら何もしない)
+void releaseShader(const VkDevice device, ShaderLibrary library, Shader shader);
+
+/// @brief シェーダのインターフェースに合うパイプラインレイアウトを取得する関数
+///
+/// 全てのシェーダのバインディングとプッシュ定数をまとめたパイプラインレイアウトを返す。
+/// 同じインターフェースを持つパイプラインレイアウトが既にあればそれを返す。
+/// 返したパイプラインレイアウトはShaderLibraryが所有するため、破棄してはならない。
+///
+/// @param device 論理デバイス
+/// @param library シェーダ共有オブジェクトハンドル
+/// @param shadersCount shadersの要素数
+/// @param shaders パイプラインを構成するシェーダの配列
+/// @param overridesCount overridesの要素数
+/// @param overrides ディスクリプタの種類を上書きするバインディングの配列 (ダイナミックユニフォームバッファ等、SPIR-Vからは判別できないもの)
+/// @returns 失敗時にNULLを返す。
+const ShaderLibraryLayout *getPipelineLayoutForShaders(
+    const VkDevice device,
+    ShaderLibrary library,
+    uint32_t shadersCount,
+    const Shader *shaders,
+    uint32_t overridesCount,
+    const ShaderReflectionBinding *overrides
+);
+
+/// @brief ヴァーテックスシェーダの頂点入力から頂点入力アトリビュートを作る関数
+///
+/// 頂点データは、全ての頂点入力がロケーションの順に一つのバッファへ詰めて並んでいるとみなす。
+///
+/// @param vertShader ヴァーテックスシェーダ
+/// @param binding 頂点バッファのバインディング番号
+/// @param attrs 頂点入力アトリビュートの格納先 (SHADER_REFLECTION_MAX_INPUTS個以上)
+/// @param stride 頂点一つあたりのサイズの格納先
+/// @returns 頂点入力アトリビュートの個数を返す。
+uint32_t buildVertexInputAttributes(
+    const Shader vertShader,
+    uint32_t binding,
+    VkVertexInputAttributeDescription *attrs,
+    uint32_t *stride
+);
@@ -0,0 +1,418 @@
+#include "spirv.h"
+
+#include "error.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SPIRV_MAGIC 0x07230203
+#define SPIRV_HEADER_WORDS_COUNT 5
+// 型の入れ子の深さの上限 (不正なバイナリで無限に再帰しないようにするため)
+#define SPIRV_MAX_TYPE_DEPTH 16
+
+// 命令
+#define SPIRV_OP_ENTRY_POINT 15
+#define SPIRV_OP_TYPE_BOOL 20
+#define SPIRV_OP_TYPE_INT 21
+#define SPIRV_OP_TYPE_FLOAT 22
+#define SPIRV_OP_TYPE_VECTOR 23
+#define SPIRV_OP_TYPE_MATRIX 24
+#define SPIRV_OP_TYPE_IMAGE 25
+#define SPIRV_OP_TYPE_SAMPLER 26
+#define SPIRV_OP_TYPE_SAMPLED_IMAGE 27
+#define SPIRV_OP_TYPE_ARRAY 28
+#define SPIRV_OP_TYPE_RUNTIME_ARRAY 29
+#define SPIRV_OP_TYPE_STRUCT 30
+#define SPIRV_OP_TYPE_POINTER 32
+#define SPIRV_OP_CONSTANT 43
+#define SPIRV_OP_VARIABLE 59
+#define SPIRV_OP_DECORATE 71
+#define SPIRV_OP_MEMBER_DECORATE 72
+
+// 装飾
+#define SPIRV_DECORATION_BUFFER_BLOCK 3
+#define SPIRV_DECORATION_ARRAY_STRIDE 6
+#define SPIRV_DECORATION_BUILT_IN 11
+#define SPIRV_DECORATION_LOCATION 30
+#define SPIRV_DECORATION_BINDING 33
+#define SPIRV_DECORATION_DESCRIPTOR_SET 34
+#define SPIRV_DECORATION_OFFSET 35
+
+// ストレージクラス
+#define SPIRV_STORAGE_CLASS_UNIFORM_CONSTANT 0
+#define SPIRV_STORAGE_CLASS_INPUT 1
+#define SPIRV_STORAGE_CLASS_UNIFORM 2
+#define SPIRV_STORAGE_CLASS_PUSH_CONSTANT 9
+#define SPIRV_STORAGE_CLASS_STORAGE_BUFFER 12
+
+// イメージの次元
+#define SPIRV_DIM_BUFFER 5
+
+// IDの定義と装飾を持つ構造体
+typedef struct SpirvId_t {
+    // 定義した命令 (未定義なら0)
+    uint32_t op;
+    // 定義した命令の先頭ワードのインデックス
+    uint32_t wordIndex;
+    uint32_t set;
+    uint32_t binding;
+    uint32_t location;
+    uint32_t arrayStride;
+    uint8_t hasBinding;
+    uint8_t hasLocation;
+    uint8_t isBuiltIn;
+    uint8_t isBufferBlock;
+} SpirvId;
+
+// SPIR-Vバイナリを読み取る間の状態を持つ構造体
+typedef struct SpirvParser_t {
+    const uint32_t *code;
+    size_t wordsCount;
+    uint32_t bound;
+    SpirvId *ids;
+} SpirvParser;
+
+// IDを定義した命令のオペランドを取得する関数
+static uint32_t getOperand(const SpirvParser *parser, uint32_t id, uint32_t index) {
+    return parser->code[parser->ids[id].wordIndex + index];
+}
+
+// IDが指定した命令で定義されているかを確認する関数
+static int isDefinedBy(const SpirvParser *parser, uint32_t id, uint32_t op) {
+    return id < parser->bound && parser->ids[id].op == op;
+}
+
+// 構造体のメンバのオフセットを取得する関数
+//
+// NOTE: Offset装飾が無ければUINT32_MAXを返す。
+static uint32_t getMemberOffset(const SpirvParser *parser, uint32_t structId, uint32_t member) {
+    size_t i = SPIRV_HEADER_WORDS_COUNT;
+    while (i < parser->wordsCount) {
+        const uint32_t wordsCount = parser->code[i] >> 16;
+        const uint32_t op = parser->code[i] & 0xFFFF;
+        if (op == SPIRV_OP_MEMBER_DECORATE
+            && wordsCount >= 5
+            && parser->code[i + 1] == structId
+            && parser->code[i + 2] == member
+            && parser->code[i + 3] == SPIRV_DECORATION_OFFSET
+        ) {
+            return parser->code[i + 4];
+        }
+        i += wordsCount;
+    }
+    return UINT32_MAX;
+}
+
+// 型のサイズを取得する関数
+//
+// NOTE: 行列は列ベクトルが詰めて並んでいるとみなす。
+//       std140の3行の行列のように、列の間に余白がある場合は正しくない。
+static uint32_t getTypeSize(const SpirvParser *parser, uint32_t typeId, int depth) {
+    if (typeId >= parser->bound || depth > SPIRV_MAX_TYPE_DEPTH) {
+        return 0;
+    }
+    switch (parser->ids[typeId].op) {
+        case SPIRV_OP_TYPE_BOOL:
+            return 4;
+        case SPIRV_OP_TYPE_INT:
+        case SPIRV_OP_TYPE_FLOAT:
+            return getOperand(parser, typeId, 2) / 8;
+        case SPIRV_OP_TYPE_VECTOR:
+        case SPIRV_OP_TYPE_MATRIX:
+            return getTypeSize(parser, getOperand(parser, typeId, 2), depth + 1) * getOperand(parser, typeId, 3);
+        case SPIRV_OP_TYPE_ARRAY: {
+            const uint32_t lengthId = getOperand(parser, typeId, 3);
+            if (!isDefinedBy(parser, lengthId, SPIRV_OP_CONSTANT)) {
+                return 0;
+            }
+            const uint32_t length = getOperand(parser, lengthId, 3);
+            const uint32_t stride = parser->ids[typeId].arrayStride;
+            return (stride > 0 ? stride : getTypeSize(parser, getOperand(parser, typeId, 2), depth + 1)) * length;
+        }
+        case SPIRV_OP_TYPE_STRUCT: {
+            // NOTE: 最後のメンバの終端を構造体のサイズとする。
+            const uint32_t membersCount = (parser->code[parser->ids[typeId].wordIndex] >> 16) - 2;
+            uint32_t size = 0;
+            uint32_t packed = 0;
+            for (uint32_t i = 0; i < membersCount; ++i) {
+                const uint32_t memberSize = getTypeSize(parser, getOperand(parser, typeId, 2 + i), depth + 1);
+                uint32_t offset = getMemberOffset(parser, typeId, i);
+                if (offset == UINT32_MAX) {
+                    offset = packed;
+                }
+                packed = offset + memberSize;
+                if (packed > size) {
+                    size = packed;
+                }
+            }
+            return size;
+        }
+        default:
+            return 0;
+    }
+}
+
+// 頂点入力の型からフォーマットを決める関数
+static VkFormat getInputFormat(const SpirvParser *parser, uint32_t typeId) {
+    uint32_t componentsCount = 1;
+    uint32_t scalarId = typeId;
+    if (isDefinedBy(parser, typeId, SPIRV_OP_TYPE_VECTOR)) {
+        componentsCount = getOperand(parser, typeId, 3);
+        scalarId = getOperand(parser, typeId, 2);
+    }
+    if (scalarId >= parser->bound || getOperand(parser, scalarId, 2) != 32 || componentsCount < 1 || componentsCount > 4) {
+        return VK_FORMAT_UNDEFINED;
+    }
+    const VkFormat floatFormats[4] = {
+        VK_FORMAT_R32_SFLOAT,
+        VK_FORMAT_R32G32_SFLOAT,
+        VK_FORMAT_R32G32B32_SFLOAT,
+        VK_FORMAT_R32G32B32A32_SFLOAT,
+    };
+    const VkFormat sintFormats[4] = {
+        VK_FORMAT_R32_SINT,
+        VK_FORMAT_R32G32_SINT,
+        VK_FORMAT_R32G32B32_SINT,
+        VK_FORMAT_R32G32B32A32_SINT,
+    };
+    const VkFormat uintFormats[4] = {
+        VK_FORMAT_R32_UINT,
+        VK_FORMAT_R32G32_UINT,
+        VK_FORMAT_R32G32B32_UINT,
+        VK_FORMAT_R32G32B32A32_UINT,
+    };
+    if (parser->ids[scalarId].op == SPIRV_OP_TYPE_FLOAT) {
+        return floatFormats[componentsCount - 1];
+    }
+    if (parser->ids[scalarId].op == SPIRV_OP_TYPE_INT) {
+        return getOperand(parser, scalarId, 3) ? sintFormats[componentsCount - 1] : uintFormats[componentsCount - 1];
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+// ユニフォーム変数の型からディスクリプタの種類を決める関数
+//
+// NOTE: 対応していない型であればVK_DESCRIPTOR_TYPE_MAX_ENUMを返す。
+static VkDescriptorType getDescriptorType(const SpirvParser *parser, uint32_t storageClass, uint32_t typeId) {
+    if (typeId >= parser->bound) {
+        return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+    }
+    switch (storageClass) {
+        case SPIRV_STORAGE_CLASS_UNIFORM:
+            return parser->ids[typeId].isBufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        case SPIRV_STORAGE_CLASS_STORAGE_BUFFER:
+            return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        case SPIRV_STORAGE_CLASS_UNIFORM_CONSTANT:
+            switch (parser->ids[typeId].op) {
+                case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+                    return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                case SPIRV_OP_TYPE_SAMPLER:
+                    return VK_DESCRIPTOR_TYPE_SAMPLER;
+                case SPIRV_OP_TYPE_IMAGE: {
+                    const int storage = getOperand(parser, typeId, 7) == 2;
+                    if (getOperand(parser, typeId, 3) == SPIRV_DIM_BUFFER) {
+                        return storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+                    }
+                    return storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+                }
+                default:
+                    return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+            }
+        default:
+            return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+    }
+}
+
+int reflectSpirv(const uint32_t *code, size_t size, ShaderReflection *reflection) {
+#define CHECK(p, m) ERROR_IF(!(p), "reflectSpirv()", (m), free((void *)parser.ids), 0)
+
+    SpirvParser parser = {
+        code,
+        size / sizeof(uint32_t),
+        0,
+        NULL,
+    };
+    memset(reflection, 0, sizeof(ShaderReflection));
+
+    // ヘッダを確認する
+    //
+    // NOTE: ヘッダは マジックナンバー・バージョン・生成器・IDの上限・予約 の5ワード。
+    {
+        CHECK(parser.wordsCount > SPIRV_HEADER_WORDS_COUNT && code[0] == SPIRV_MAGIC, "SPIR-Vバイナリではない");
+        parser.bound = code[3];
+        parser.ids = (SpirvId *)calloc(parser.bound, sizeof(SpirvId));
+        CHECK(parser.ids != NULL, "IDの配列の確保に失敗");
+    }
+
+    // 全ての命令を走査し、IDの定義と装飾を記録する
+    //
+    // NOTE: 各命令の先頭ワードの上位16ビットは命令のワード数、下位16ビットは命令の種類。
+    {
+        size_t i = SPIRV_HEADER_WORDS_COUNT;
+        while (i < parser.wordsCount) {
+            const uint32_t wordsCount = code[i] >> 16;
+            const uint32_t op = code[i] & 0xFFFF;
+            CHECK(wordsCount > 0 && i + wordsCount <= parser.wordsCount, "命令のワード数が不正");
+
+            // 定義された結果のIDの位置
+            uint32_t resultIndex = 0;
+            switch (op) {
+                case SPIRV_OP_ENTRY_POINT: {
+                    CHECK(wordsCount >= 3, "OpEntryPointが不正");
+                    const VkShaderStageFlagBits stages[6] = {
+                        VK_SHADER_STAGE_VERTEX_BIT,
+                        VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT,
+                        VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT,
+                        VK_SHADER_STAGE_GEOMETRY_BIT,
+                        VK_SHADER_STAGE_FRAGMENT_BIT,
+                        VK_SHADER_STAGE_COMPUTE_BIT,
+                    };
+                    CHECK(code[i + 1] < 6, "未対応の実行モデル");
+                    reflection->stage = stages[code[i + 1]];
+                    break;
+                }
+                case SPIRV_OP_DECORATE: {
+                    CHECK(wordsCount >= 3 && code[i + 1] < parser.bound, "OpDecorateが不正");
+                    SpirvId *target = &parser.ids[code[i + 1]];
+                    const uint32_t value = wordsCount >= 4 ? code[i + 3] : 0;
+                    switch (code[i + 2]) {
+                        case SPIRV_DECORATION_BUFFER_BLOCK: target->isBufferBlock = 1; break;
+                        case SPIRV_DECORATION_ARRAY_STRIDE: target->arrayStride = value; break;
+                        case SPIRV_DECORATION_BUILT_IN: target->isBuiltIn = 1; break;
+                        case SPIRV_DECORATION_LOCATION: target->location = value; target->hasLocation = 1; break;
+                        case SPIRV_DECORATION_BINDING: target->binding = value; target->hasBinding = 1; break;
+                        case SPIRV_DECORATION_DESCRIPTOR_SET: target->set = value; break;
+                        default: break;
+                    }
+                    break;
+                }
+                case SPIRV_OP_TYPE_BOOL:
+                case SPIRV_OP_TYPE_INT:
+                case SPIRV_OP_TYPE_FLOAT:
+                case SPIRV_OP_TYPE_VECTOR:
+                case SPIRV_OP_TYPE_MATRIX:
+                case SPIRV_OP_TYPE_IMAGE:
+                case SPIRV_OP_TYPE_SAMPLER:
+                case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+                case SPIRV_OP_TYPE_ARRAY:
+                case SPIRV_OP_TYPE_RUNTIME_ARRAY:
+                case SPIRV_OP_TYPE_STRUCT:
+                case SPIRV_OP_TYPE_POINTER:
+                    resultIndex = 1;
+                    break;
+                case SPIRV_OP_CONSTANT:
+                case SPIRV_OP_VARIABLE:
+                    resultIndex = 2;
+                    break;
+                default:
+                    break;
+            }
+            if (resultIndex > 0) {
+                CHECK(wordsCount > resultIndex && code[i + resultIndex] < parser.bound, "結果のIDが不正");
+                // NOTE: オペランドを参照する型の命令は、最低限必要なワード数を持っていなければならない。
+                const uint32_t minWordsCounts[SPIRV_OP_TYPE_POINTER + 1] = {
+                    [SPIRV_OP_TYPE_INT] = 4,
+                    [SPIRV_OP_TYPE_FLOAT] = 3,
+                    [SPIRV_OP_TYPE_VECTOR] = 4,
+                    [SPIRV_OP_TYPE_MATRIX] = 4,
+                    [SPIRV_OP_TYPE_IMAGE] = 9,
+                    [SPIRV_OP_TYPE_ARRAY] = 4,
+                    [SPIRV_OP_TYPE_RUNTIME_ARRAY] = 3,
+                    [SPIRV_OP_TYPE_STRUCT] = 2,
+                    [SPIRV_OP_TYPE_POINTER] = 4,
+                };
+                CHECK(op > SPIRV_OP_TYPE_POINTER || wordsCount >= minWordsCounts[op], "型の命令のワード数が不正");
+                CHECK(op != SPIRV_OP_CONSTANT || wordsCount >= 4, "OpConstantのワード数が不正");
+                CHECK(op != SPIRV_OP_VARIABLE || wordsCount >= 4, "OpVariableのワード数が不正");
+                parser.ids[code[i + resultIndex]].op = op;
+                parser.ids[code[i + resultIndex]].wordIndex = (uint32_t)i;
+            }
+            i += wordsCount;
+        }
+    }
+
+    // 変数を走査し、インターフェースを読み取る
+    for (uint32_t id = 0; id < parser.bound; ++id) {
+        const SpirvId *var = &parser.ids[id];
+        if (var->op != SPIRV_OP_VARIABLE) {
+            continue;
+        }
+        const uint32_t storageClass = getOperand(&parser, id, 3);
+        const uint32_t ptrTypeId = getOperand(&parser, id, 1);
+        CHECK(isDefinedBy(&parser, ptrTypeId, SPIRV_OP_TYPE_POINTER), "変数の型がポインタではない");
+        uint32_t typeId = getOperand(&parser, ptrTypeId, 3);
+        CHECK(typeId < parser.bound, "変数の型が不正");
+
+        switch (storageClass) {
+            case SPIRV_STORAGE_CLASS_UNIFORM:
+            case SPIRV_STORAGE_CLASS_UNIFORM_CONSTANT:
+            case SPIRV_STORAGE_CLASS_STORAGE_BUFFER: {
+                if (!var->hasBinding) {
+                    break;
+                }
+                // NOTE: 配列であれば要素数をディスクリプタ数とする。
+                //       サイズ未定の配列はディスクリプタ数1とみなす。
+                uint32_t descriptorCount = 1;
+                if (isDefinedBy(&parser, typeId, SPIRV_OP_TYPE_ARRAY)) {
+                    const uint32_t lengthId = getOperand(&parser, typeId, 3);
+                    CHECK(isDefinedBy(&parser, lengthId, SPIRV_OP_CONSTANT), "配列の長さが定数ではない");
+                    descriptorCount = getOperand(&parser, lengthId, 3);
+                    typeId = getOperand(&parser, typeId, 2);
+                } else if (isDefinedBy(&parser, typeId, SPIRV_OP_TYPE_RUNTIME_ARRAY)) {
+                    typeId = getOperand(&parser, typeId, 2);
+                }
+                const VkDescriptorType descriptorType = getDescriptorType(&parser, storageClass, typeId);
+                CHECK(descriptorType != VK_DESCRIPTOR_TYPE_MAX_ENUM, "未対応のディスクリプタの種類");
+                CHECK(reflection->bindingsCount < SHADER_REFLECTION_MAX_BINDINGS, "バインディングが多すぎる");
+                ShaderReflectionBinding *binding = &reflection->bindings[reflection->bindingsCount];
+                binding->set = var->set;
+                binding->binding = var->binding;
+                binding->descriptorType = descriptorType;
+                binding->descriptorCount = descriptorCount;
+                reflection->bindingsCount += 1;
+                break;
+            }
+            case SPIRV_STORAGE_CLASS_PUSH_CONSTANT: {
+                reflection->pushConstantSize = getTypeSize(&parser, typeId, 0);
+                CHECK(reflection->pushConstantSize > 0, "プッシュ定数のサイズの取得に失敗");
+                break;
+            }
+            case SPIRV_STORAGE_CLASS_INPUT: {
+                // NOTE: gl_VertexIndex等の組込み変数や、構造体(他のステージのgl_PerVertex等)は頂点入力ではない。
+                if (reflection->stage != VK_SHADER_STAGE_VERTEX_BIT
+                    || var->isBuiltIn
+                    || !var->hasLocation
+                    || isDefinedBy(&parser, typeId, SPIRV_OP_TYPE_STRUCT)
+                ) {
+                    break;
+                }
+                CHECK(reflection->inputsCount < SHADER_REFLECTION_MAX_INPUTS, "頂点入力が多すぎる");
+                ShaderReflectionInput *input = &reflection->inputs[reflection->inputsCount];
+                input->location = var->location;
+                input->format = getInputFormat(&parser, typeId);
+                input->size = getTypeSize(&parser, typeId, 0);
+                CHECK(input->format != VK_FORMAT_UNDEFINED, "未対応の頂点入力の型");
+                reflection->inputsCount += 1;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    // 頂点入力をロケーションの昇順に並べる
+    for (uint32_t i = 1; i < reflection->inputsCount; ++i) {
+        const ShaderReflectionInput target = reflection->inputs[i];
+        uint32_t j = i;
+        for (; j > 0 && reflection->inputs[j - 1].location > target.location; --j) {
+            reflection->inputs[j] = reflection->inputs[j - 1];
+        }
+        reflection->inputs[j] = target;
+    }
+
+    free((void *)parser.ids);
+    return 1;
+
+#undef CHECK
+}
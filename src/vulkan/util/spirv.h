@@ -0,0 +1,58 @@
+/// @file spirv.h
+/// @brief SPIR-Vバイナリからシェーダのインターフェースを読み取るモジュール
+///
+/// パイプラインの作成に必要な以下の情報のみを読み取る。
+/// - ディスクリプタのバインディング (セット番号・バインディング番号・種類・個数)
+/// - プッシュ定数のサイズ
+/// - 頂点入力 (ロケーション・フォーマット)
+///
+/// SPIR-Vの仕様: https://registry.khronos.org/SPIR-V/specs/unified1/SPIRV.html
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+/// @brief 読み取れるディスクリプタのバインディングの最大数
+#define SHADER_REFLECTION_MAX_BINDINGS 16
+
+/// @brief 読み取れる頂点入力の最大数
+#define SHADER_REFLECTION_MAX_INPUTS 16
+
+/// @brief ディスクリプタのバインディング
+typedef struct ShaderReflectionBinding_t {
+    uint32_t set;
+    uint32_t binding;
+    VkDescriptorType descriptorType;
+    uint32_t descriptorCount;
+} ShaderReflectionBinding;
+
+/// @brief 頂点入力
+typedef struct ShaderReflectionInput_t {
+    uint32_t location;
+    VkFormat format;
+    uint32_t size;
+} ShaderReflectionInput;
+
+/// @brief シェーダのインターフェース
+typedef struct ShaderReflection_t {
+    VkShaderStageFlagBits stage;
+    uint32_t bindingsCount;
+    ShaderReflectionBinding bindings[SHADER_REFLECTION_MAX_BINDINGS];
+    // プッシュ定数のサイズ (プッシュ定数を使わないなら0)
+    uint32_t pushConstantSize;
+    // ロケーションの昇順に並べた頂点入力 (ヴァーテックスシェーダのみ)
+    uint32_t inputsCount;
+    ShaderReflectionInput inputs[SHADER_REFLECTION_MAX_INPUTS];
+} ShaderReflection;
+
+/// @brief SPIR-Vバイナリからシェーダのインターフェースを読み取る関数
+///
+/// エントリポイントは一つだけであることを前提とする。
+///
+/// @param code SPIR-Vバイナリ
+/// @param size SPIR-Vバイナリのサイズ (バイト)
+/// @param reflection 読み取ったインターフェースの格納先
+/// @returns 失敗時に0を返す。
+int reflectSpirv(const uint32_t *code, size_t size, ShaderReflection *reflection);
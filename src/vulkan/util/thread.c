@@ -0,0 +1,226 @@
+// nanosleep()関数を使うためにこのマクロを<time.h>を含むいかなるinclude前にも定義する
+#ifndef _WIN32
+# define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "thread.h"
+
+#include "error.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+# include <Windows.h>
+#else
+# include <errno.h>
+# include <pthread.h>
+# include <time.h>
+# include <unistd.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct Thread_t {
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+    ThreadFunction function;
+    void *arg;
+};
+
+// スレッドの開始点
+//
+// NOTE: プラットフォーム毎にスレッド関数の型が異なるため、ここで吸収する。
+#ifdef _WIN32
+static DWORD WINAPI threadEntry(LPVOID param) {
+    const Thread thread = (Thread)param;
+    thread->function(thread->arg);
+    return 0;
+}
+#else
+static void *threadEntry(void *param) {
+    const Thread thread = (Thread)param;
+    thread->function(thread->arg);
+    return NULL;
+}
+#endif
+
+Thread createThread(ThreadFunction function, void *arg) {
+#define CHECK(p, m) ERROR_IF(!(p), "createThread()", (m), free((void *)thread), NULL)
+
+    const Thread thread = (Thread)malloc(sizeof(struct Thread_t));
+    CHECK(thread != NULL, "Threadの確保に失敗");
+    thread->function = function;
+    thread->arg = arg;
+
+#ifdef _WIN32
+    thread->handle = CreateThread(NULL, 0, threadEntry, (LPVOID)thread, 0, NULL);
+    CHECK(thread->handle != NULL, "スレッドの作成に失敗");
+#else
+    CHECK(pthread_create(&thread->handle, NULL, threadEntry, (void *)thread) == 0, "スレッドの作成に失敗");
+#endif
+
+    return thread;
+
+#undef CHECK
+}
+
+void joinThread(Thread thread) {
+    if (thread == NULL) {
+        return;
+    }
+#ifdef _WIN32
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+#else
+    pthread_join(thread->handle, NULL);
+#endif
+    free((void *)thread);
+}
+
+void sleepThread(uint32_t ms) {
+#ifdef _WIN32
+    Sleep((DWORD)ms);
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ms / 1000);
+    ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+    // NOTE: シグナルで中断されたら残り時間だけ停止し直す。
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+#endif
+}
+
+uint32_t getProcessorsCount(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (uint32_t)info.dwNumberOfProcessors : 1;
+#else
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (uint32_t)count : 1;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct Mutex_t {
+#ifdef _WIN32
+    SRWLOCK lock;
+#else
+    pthread_mutex_t lock;
+#endif
+};
+
+void deleteMutex(Mutex mutex) {
+    if (mutex == NULL) {
+        return;
+    }
+#ifndef _WIN32
+    pthread_mutex_destroy(&mutex->lock);
+#endif
+    free((void *)mutex);
+}
+
+Mutex createMutex(void) {
+#define CHECK(p, m) ERROR_IF(!(p), "createMutex()", (m), free((void *)mutex), NULL)
+
+    const Mutex mutex = (Mutex)malloc(sizeof(struct Mutex_t));
+    CHECK(mutex != NULL, "Mutexの確保に失敗");
+
+#ifdef _WIN32
+    InitializeSRWLock(&mutex->lock);
+#else
+    CHECK(pthread_mutex_init(&mutex->lock, NULL) == 0, "ミューテックスの初期化に失敗");
+#endif
+
+    return mutex;
+
+#undef CHECK
+}
+
+void lockMutex(Mutex mutex) {
+#ifdef _WIN32
+    AcquireSRWLockExclusive(&mutex->lock);
+#else
+    pthread_mutex_lock(&mutex->lock);
+#endif
+}
+
+void unlockMutex(Mutex mutex) {
+#ifdef _WIN32
+    ReleaseSRWLockExclusive(&mutex->lock);
+#else
+    pthread_mutex_unlock(&mutex->lock);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct CondVar_t {
+#ifdef _WIN32
+    CONDITION_VARIABLE cond;
+#else
+    pthread_cond_t cond;
+#endif
+};
+
+void deleteCondVar(CondVar condVar) {
+    if (condVar == NULL) {
+        return;
+    }
+#ifndef _WIN32
+    pthread_cond_destroy(&condVar->cond);
+#endif
+    free((void *)condVar);
+}
+
+CondVar createCondVar(void) {
+#define CHECK(p, m) ERROR_IF(!(p), "createCondVar()", (m), free((void *)condVar), NULL)
+
+    const CondVar condVar = (CondVar)malloc(sizeof(struct CondVar_t));
+    CHECK(condVar != NULL, "CondVarの確保に失敗");
+
+#ifdef _WIN32
+    InitializeConditionVariable(&condVar->cond);
+#else
+    CHECK(pthread_cond_init(&condVar->cond, NULL) == 0, "条件変数の初期化に失敗");
+#endif
+
+    return condVar;
+
+#undef CHECK
+}
+
+void waitCondVar(CondVar condVar, Mutex mutex) {
+#ifdef _WIN32
+    SleepConditionVariableSRW(&condVar->cond, &mutex->lock, INFINITE, 0);
+#else
+    pthread_cond_wait(&condVar->cond, &mutex->lock);
+#endif
+}
+
+void signalCondVar(CondVar condVar) {
+#ifdef _WIN32
+    WakeConditionVariable(&condVar->cond);
+#else
+    pthread_cond_signal(&condVar->cond);
+#endif
+}
+
+void broadcastCondVar(CondVar condVar) {
+#ifdef _WIN32
+    WakeAllConditionVariable(&condVar->cond);
+#else
+    pthread_cond_broadcast(&condVar->cond);
+#endif
+}
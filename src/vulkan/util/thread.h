@@ -0,0 +1,79 @@
+/// @file thread.h
+/// @brief スレッドと同期プリミティブをプラットフォームに依らず扱うためのモジュール
+///
+/// WindowsではWin32APIを、それ以外ではPOSIXスレッドを用いる。
+
+#pragma once
+
+#include <stdint.h>
+
+/// @brief スレッドで実行する関数の型
+typedef void (*ThreadFunction)(void *arg);
+
+/// @brief スレッドオブジェクトハンドル
+typedef struct Thread_t *Thread;
+
+/// @brief ミューテックスオブジェクトハンドル
+typedef struct Mutex_t *Mutex;
+
+/// @brief 条件変数オブジェクトハンドル
+typedef struct CondVar_t *CondVar;
+
+/// @brief スレッドを作成し実行を開始する関数
+/// @param function スレッドで実行する関数
+/// @param arg functionに与える引数
+/// @returns 失敗時にNULLを返す。
+Thread createThread(ThreadFunction function, void *arg);
+
+/// @brief スレッドの終了を待機し破棄する関数
+/// @param thread スレッドオブジェクトハンドル
+void joinThread(Thread thread);
+
+/// @brief 呼び出したスレッドを一定時間停止させる関数
+/// @param ms 停止する時間(ms)
+void sleepThread(uint32_t ms);
+
+/// @brief 論理プロセッサ数を取得する関数
+/// @returns 取得できなければ1を返す。
+uint32_t getProcessorsCount(void);
+
+/// @brief ミューテックスを破棄する関数
+/// @param mutex ミューテックスオブジェクトハンドル
+void deleteMutex(Mutex mutex);
+
+/// @brief ミューテックスを作成する関数
+/// @returns 失敗時にNULLを返す。
+Mutex createMutex(void);
+
+/// @brief ミューテックスをロックする関数
+/// @param mutex ミューテックスオブジェクトハンドル
+void lockMutex(Mutex mutex);
+
+/// @brief ミューテックスをアンロックする関数
+/// @param mutex ミューテックスオブジェクトハンドル
+void unlockMutex(Mutex mutex);
+
+/// @brief 条件変数を破棄する関数
+/// @param condVar 条件変数オブジェクトハンドル
+void deleteCondVar(CondVar condVar);
+
+/// @brief 条件変数を作成する関数
+/// @returns 失敗時にNULLを返す。
+CondVar createCondVar(void);
+
+/// @brief 条件変数が通知されるまで待機する関数
+///
+/// 待機中はミューテックスをアンロックし、戻る前に再びロックする。
+/// 通知が無くとも戻ることがあるため、条件は呼び出し側で確認し直すこと。
+///
+/// @param condVar 条件変数オブジェクトハンドル
+/// @param mutex ロック中のミューテックスオブジェクトハンドル
+void waitCondVar(CondVar condVar, Mutex mutex);
+
+/// @brief 条件変数を待機しているスレッドを一つ起こす関数
+/// @param condVar 条件変数オブジェクトハンドル
+void signalCondVar(CondVar condVar);
+
+/// @brief 条件変数を待機している全てのスレッドを起こす関数
+/// @param condVar 条件変数オブジェクトハンドル
+void broadcastCondVar(CondVar condVar);
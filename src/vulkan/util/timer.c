@@ -0,0 +1,91 @@
+// clock_gettime()関数とnanosleep()関数を使うためにこのマクロを<time.h>を含むいかなるinclude前にも定義する
+#ifndef _WIN32
+# define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "timer.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+# include <Windows.h>
+#else
+# include <time.h>
+#endif
+
+uint64_t getTimeNs(void) {
+#ifdef _WIN32
+    // NOTE: QueryPerformanceFrequency()関数の値はシステム起動中に変化しないため、一度だけ取得すればよい。
+    static LARGE_INTEGER freq = { 0 };
+    if (freq.QuadPart == 0) {
+        QueryPerformanceFrequency(&freq);
+    }
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    const uint64_t sec = (uint64_t)(counter.QuadPart / freq.QuadPart);
+    const uint64_t rem = (uint64_t)(counter.QuadPart % freq.QuadPart);
+    return sec * 1000000000ULL + rem * 1000000000ULL / (uint64_t)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+void sleepNs(uint64_t ns) {
+#ifdef _WIN32
+    // NOTE: Sleep()関数はミリ秒単位で、既定ではタイマの粒度(約15.6ms)に丸められる。
+    //       切り捨てて眠り、残りは呼び出し側の空回りに任せる。
+    const DWORD ms = (DWORD)(ns / 1000000ULL);
+    if (ms > 0) {
+        Sleep(ms);
+    }
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ns / 1000000000ULL);
+    ts.tv_nsec = (long)(ns % 1000000000ULL);
+    while (nanosleep(&ts, &ts) != 0) {
+        // NOTE: シグナルで中断された場合は残りの時間を眠り直す。
+    }
+#endif
+}
+
+void initFramePacer(FramePacer *pacer, uint32_t fps) {
+    memset(pacer, 0, sizeof(FramePacer));
+    pacer->intervalNs = fps > 0 ? 1000000000ULL / fps : 0;
+}
+
+void waitFramePacer(FramePacer *pacer) {
+    pacer->framesCount += 1;
+    if (pacer->intervalNs == 0) {
+        return;
+    }
+
+    const uint64_t startNs = getTimeNs();
+
+    // 最初のフレームは待たない
+    if (pacer->nextNs == 0) {
+        pacer->nextNs = startNs + pacer->intervalNs;
+        return;
+    }
+
+    // 予定より一フレーム以上遅れていれば、待たずに現在時刻から数え直す
+    if (startNs >= pacer->nextNs + pacer->intervalNs) {
+        pacer->lateFramesCount += 1;
+        pacer->nextNs = startNs + pacer->intervalNs;
+        return;
+    }
+
+    // 予定の時刻まで眠り、最後は空回りして待つ
+    //
+    // NOTE: 予定の時刻は前の予定の時刻から数えるため、寝過ごしや処理時間のばらつきが積み重ならない。
+    if (pacer->nextNs > startNs + FRAME_PACER_SPIN_NS) {
+        sleepNs(pacer->nextNs - startNs - FRAME_PACER_SPIN_NS);
+    }
+    uint64_t nowNs = getTimeNs();
+    while (nowNs < pacer->nextNs) {
+        nowNs = getTimeNs();
+    }
+    pacer->totalWaitNs += nowNs - startNs;
+    pacer->nextNs += pacer->intervalNs;
+}
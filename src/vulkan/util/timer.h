@@ -0,0 +1,52 @@
+/// @file timer.h
+/// @brief 時間計測に関するユーティリティを定義するモジュール
+
+#pragma once
+
+#include <stdint.h>
+
+/// @brief 単調増加する時刻をナノ秒単位で取得する関数
+///
+/// 起点は不定であるため、二つの時刻の差を取って経過時間として用いること。
+///
+/// @returns 現在時刻(ns)
+uint64_t getTimeNs(void);
+
+/// @brief 少なくとも与えた時間だけスレッドを眠らせる関数
+///
+/// OSのスケジューラの粒度により、与えた時間より長く眠ることがある。
+///
+/// @param ns 眠る時間(ns)
+void sleepNs(uint64_t ns);
+
+/// @brief フレームを一定の間隔で開始させるCPU側のフレームリミッタ
+///
+/// 次のフレームを開始してよい時刻を持ち、それまで待つ。
+/// 待ちの大部分は眠って過ごし、OSのスケジューラの粒度で寝過ごさないよう最後のFRAME_PACER_SPIN_NSだけ空回りする。
+/// 描画が間に合わず予定より一フレーム以上遅れた場合は、遅れを取り戻そうと連続してフレームを開始することはせず、
+/// 現在時刻から数え直す。
+typedef struct FramePacer_t {
+    // フレームの間隔(ns) (0なら制限しない)
+    uint64_t intervalNs;
+    // 次のフレームを開始してよい時刻(ns) (0なら最初のフレーム)
+    uint64_t nextNs;
+    // 統計
+    uint64_t framesCount;
+    uint64_t lateFramesCount;
+    uint64_t totalWaitNs;
+} FramePacer;
+
+/// @brief 眠らずに空回りして待つ時間(ns)
+#define FRAME_PACER_SPIN_NS 2000000ULL
+
+/// @brief FramePacerを初期化する関数
+/// @param pacer フレームリミッタ
+/// @param fps 一秒あたりのフレーム数の上限 (0なら制限しない)
+void initFramePacer(FramePacer *pacer, uint32_t fps);
+
+/// @brief 次のフレームを開始してよい時刻まで待つ関数
+///
+/// フレームの開始時(入力の処理や次のイメージの取得の前)に呼ぶ。
+///
+/// @param pacer フレームリミッタ
+void waitFramePacer(FramePacer *pacer);
@@ -0,0 +1,220 @@
+// opendir()関数等を使うためにこのマクロを<dirent.h>等のいかなるinclude前にも定義する
+#ifndef _WIN32
+# define _DEFAULT_SOURCE
+#endif
+
+#include "watcher.h"
+
+// strcpy()関数の使用に対してwarningを出さないためにこのマクロを定義する
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "error.h"
+#include "timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+# include <Windows.h>
+#elif defined(__linux__)
+# include <errno.h>
+# include <fcntl.h>
+# include <sys/inotify.h>
+# include <unistd.h>
+#else
+# include <dirent.h>
+# include <sys/stat.h>
+#endif
+
+// NOTE: inotifyが無い環境では、ファイル名と更新時刻の組を覚えておき、変化したものを変更とみなす。
+#ifndef __linux__
+typedef struct WatchedFile_t {
+    char name[FILE_WATCHER_MAX_NAME];
+    uint64_t modifiedTime;
+    int changed;
+} WatchedFile;
+#endif
+
+struct FileWatcher_t {
+#ifdef __linux__
+    int fd;
+    int wd;
+    // 読み込んだが取り出されていないイベント
+    char buffer[4096];
+    size_t bufferSize;
+    size_t bufferOffset;
+#else
+    char dirPath[FILE_WATCHER_MAX_NAME];
+    uint32_t filesCount;
+    WatchedFile files[FILE_WATCHER_MAX_FILES];
+    uint64_t lastPollTime;
+#endif
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef __linux__
+
+// ファイルの更新時刻を記録し、変化していれば変更とみなす関数
+//
+// NOTE: 初めて見つけたファイルは新規作成されたものとして扱う。
+static void updateWatchedFile(FileWatcher watcher, const char *name, uint64_t modifiedTime, int markChanged) {
+    uint32_t i = 0;
+    for (; i < watcher->filesCount; ++i) {
+        if (strcmp(watcher->files[i].name, name) == 0) {
+            break;
+        }
+    }
+    if (i == watcher->filesCount) {
+        if (i >= FILE_WATCHER_MAX_FILES || strlen(name) >= FILE_WATCHER_MAX_NAME) {
+            return;
+        }
+        strcpy(watcher->files[i].name, name);
+        watcher->filesCount += 1;
+    } else if (watcher->files[i].modifiedTime == modifiedTime) {
+        return;
+    }
+    watcher->files[i].modifiedTime = modifiedTime;
+    watcher->files[i].changed = markChanged;
+}
+
+// ディレクトリ直下のファイルの更新時刻を調べる関数
+//
+// NOTE: markChangedが0なら、更新時刻を覚えるだけで変更とはみなさない(初回用)。
+static void scanWatchedFiles(FileWatcher watcher, int markChanged) {
+# ifdef _WIN32
+    char pattern[FILE_WATCHER_MAX_NAME + 3];
+    snprintf(pattern, sizeof(pattern), "%s\\*", watcher->dirPath);
+    WIN32_FIND_DATAA data;
+    const HANDLE find = FindFirstFileA(pattern, &data);
+    if (find == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    do {
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            continue;
+        }
+        const uint64_t t = ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | (uint64_t)data.ftLastWriteTime.dwLowDateTime;
+        updateWatchedFile(watcher, data.cFileName, t, markChanged);
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+# else
+    DIR *dir = opendir(watcher->dirPath);
+    if (dir == NULL) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        char path[FILE_WATCHER_MAX_NAME * 2 + 2];
+        snprintf(path, sizeof(path), "%s/%s", watcher->dirPath, entry->d_name);
+        struct stat st;
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+        const uint64_t t = (uint64_t)st.st_mtime;
+        updateWatchedFile(watcher, entry->d_name, t, markChanged);
+    }
+    closedir(dir);
+# endif
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void deleteFileWatcher(FileWatcher watcher) {
+    if (watcher == NULL) {
+        return;
+    }
+#ifdef __linux__
+    if (watcher->fd >= 0) close(watcher->fd);
+#endif
+    free((void *)watcher);
+}
+
+FileWatcher createFileWatcher(const char *dirPath) {
+#define CHECK(p, m) ERROR_IF(!(p), "createFileWatcher()", (m), deleteFileWatcher(watcher), NULL)
+
+    const FileWatcher watcher = (FileWatcher)malloc(sizeof(struct FileWatcher_t));
+    CHECK(watcher != NULL, "FileWatcherの確保に失敗");
+    memset(watcher, 0, sizeof(struct FileWatcher_t));
+
+#ifdef __linux__
+    // inotifyでディレクトリを監視する
+    //
+    // NOTE: 書込みを終えてクローズしたときと、別名で書いてからリネームしたとき(多くのエディタの保存方法)を拾う。
+    //       IN_MODIFYは書込みの途中でも通知されるため使わない。
+    {
+        watcher->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        CHECK(watcher->fd >= 0, "inotifyの初期化に失敗");
+        watcher->wd = inotify_add_watch(watcher->fd, dirPath, IN_CLOSE_WRITE | IN_MOVED_TO);
+        CHECK(watcher->wd >= 0, "ディレクトリの監視の開始に失敗");
+    }
+#else
+    // 現在の更新時刻を覚える
+    {
+        CHECK(strlen(dirPath) < FILE_WATCHER_MAX_NAME, "ディレクトリのパスが長すぎる");
+        strcpy(watcher->dirPath, dirPath);
+        scanWatchedFiles(watcher, 0);
+        watcher->lastPollTime = getTimeNs();
+    }
+#endif
+
+    return watcher;
+
+#undef CHECK
+}
+
+int pollFileWatcher(FileWatcher watcher, char *name) {
+#ifdef __linux__
+    while (1) {
+        // 読み込み済みのイベントを取り出す
+        while (watcher->bufferOffset < watcher->bufferSize) {
+            const struct inotify_event *event = (const struct inotify_event *)(watcher->buffer + watcher->bufferOffset);
+            watcher->bufferOffset += sizeof(struct inotify_event) + event->len;
+            if (event->len == 0 || (event->mask & IN_ISDIR) || strlen(event->name) >= FILE_WATCHER_MAX_NAME) {
+                continue;
+            }
+            strcpy(name, event->name);
+            return 1;
+        }
+
+        // 新たなイベントを読み込む
+        //
+        // NOTE: ノンブロッキングであるため、イベントが無ければEAGAINで失敗する。
+        const ssize_t size = read(watcher->fd, watcher->buffer, sizeof(watcher->buffer));
+        if (size <= 0) {
+            if (size < 0 && errno != EAGAIN) {
+                ERROR_LOG("pollFileWatcher()", "inotifyのイベントの読込みに失敗");
+            }
+            watcher->bufferSize = 0;
+            watcher->bufferOffset = 0;
+            return 0;
+        }
+        watcher->bufferSize = (size_t)size;
+        watcher->bufferOffset = 0;
+    }
+#else
+    // 前回調べてから時間が経っていれば調べ直す
+    const uint64_t now = getTimeNs();
+    if (now - watcher->lastPollTime >= (uint64_t)FILE_WATCHER_POLL_INTERVAL_MS * 1000000ULL) {
+        watcher->lastPollTime = now;
+        scanWatchedFiles(watcher, 1);
+    }
+
+    // 変更されたファイルを一つ取り出す
+    for (uint32_t i = 0; i < watcher->filesCount; ++i) {
+        if (watcher->files[i].changed) {
+            watcher->files[i].changed = 0;
+            strcpy(name, watcher->files[i].name);
+            return 1;
+        }
+    }
+    return 0;
+#endif
+}
@@ -0,0 +1,44 @@
+/// @file watcher.h
+/// @brief ディレクトリ内のファイルの変更を監視するモジュール
+///
+/// - Linux: inotifyで変更を通知させる
+/// - その他: 一定間隔でファイルの更新時刻を調べる
+///
+/// 監視するのはディレクトリ直下のファイルのみであり、サブディレクトリは対象外とする。
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief 監視できるファイル名の最大長 (終端文字を含む)
+#define FILE_WATCHER_MAX_NAME 128
+
+/// @brief 更新時刻を調べる方式で監視できるファイルの最大数
+#define FILE_WATCHER_MAX_FILES 64
+
+/// @brief 更新時刻を調べる間隔(ms)
+#define FILE_WATCHER_POLL_INTERVAL_MS 250
+
+/// @brief ファイル監視オブジェクトハンドル
+typedef struct FileWatcher_t *FileWatcher;
+
+/// @brief FileWatcherを破棄する関数
+/// @param watcher ファイル監視オブジェクトハンドル
+void deleteFileWatcher(FileWatcher watcher);
+
+/// @brief FileWatcherを作成する関数
+/// @param dirPath 監視するディレクトリのパス
+/// @returns 失敗時にNULLを返す。
+FileWatcher createFileWatcher(const char *dirPath);
+
+/// @brief 変更されたファイルの名前を一つ取り出す関数
+///
+/// 待機しない。
+/// 変更されたファイルが無くなるまで繰り返し呼ぶこと。
+/// 一つのファイルに対する連続した変更は、一度にまとめられることがある。
+///
+/// @param watcher ファイル監視オブジェクトハンドル
+/// @param name ファイル名(ディレクトリを含まない)の格納先 (FILE_WATCHER_MAX_NAMEバイト以上)
+/// @returns 変更されたファイルが無ければ0を返す。
+int pollFileWatcher(FileWatcher watcher, char *name);